@@ -0,0 +1,237 @@
+//micro benchmark for the animation kernels: play_anim and blend_anims against the per joint
+//HandmadeMath code they replaced, which is kept here as the reference
+//usage: bench [<model.iqm>] [iterations], defaults to assets/game_base.iqm
+//build with -DHANDMADE_MATH_NO_SIMD to time the scalar fallback of the kernels instead of SSE/NEON
+#include "core.h"
+#define SOKOL_IMPL
+#define SOKOL_DUMMY_BACKEND
+#include "deps/sokol_gfx.h"
+#include "deps/sokol_gl.h"
+#include "deps/sokol_audio.h"
+#include "deps/sokol_debugtext.h"
+#include "deps/sokol_log.h"
+#include "deps/sokol_fetch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+static double now(void) {
+    struct timespec t;
+    timespec_get(&t, TIME_UTC);
+    return (double)t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+//REFERENCE, the sampling code from before the kernels
+
+static HMM_Mat4 ref_trs(HMM_Vec3 pos, HMM_Quat rotation, HMM_Vec3 scale) {
+    HMM_Mat4 T = HMM_Translate(pos);
+    HMM_Mat4 R = HMM_QToM4(rotation);
+    HMM_Mat4 S = HMM_Scale(scale);
+    return HMM_MulM4(HMM_MulM4(T, R), S);
+}
+
+static HMM_Quat ref_quat_unpack(const uint16_t in[3]) {
+    int largest = (in[0] >> 15) | ((in[1] >> 15) << 1);
+    HMM_Quat q;
+    float sum = 0.0f;
+    for (int i = 0, n = 0; i < 4; i++) {
+        if (i == largest) continue;
+        float c = ((in[n++] & 0x7fff) / 32767.0f * 2.0f - 1.0f) * ANIM_QUAT_RANGE;
+        q.Elements[i] = c;
+        sum += c * c;
+    }
+    q.Elements[largest] = sqrtf(HMM_MAX(1.0f - sum, 0.0f));
+    return q;
+}
+
+static void ref_sample_keys(HMM_Mat4* out, const AnimSet* set, int frame1, int frame2, float t) {
+    HMM_Mat4 global[MAX_BONES];
+    int num_joints = set->num_joints;
+    const AnimKey* k1 = &set->keys[frame1 * num_joints];
+    const AnimKey* k2 = &set->keys[frame2 * num_joints];
+    const uint16_t* s1 = set->scale_keys ? &set->scale_keys[frame1 * num_joints * 3] : NULL;
+    const uint16_t* s2 = set->scale_keys ? &set->scale_keys[frame2 * num_joints * 3] : NULL;
+
+    for (int i = 0; i < num_joints; i++) {
+        const AnimJointRange* r = &set->ranges[i];
+        HMM_Quat q1 = ref_quat_unpack(k1[i].rot);
+        HMM_Quat q2 = ref_quat_unpack(k2[i].rot);
+        if (HMM_DotQ(q1, q2) < 0.0f) q2 = HMM_MulQF(q2, -1.0f);
+        HMM_Quat rot = HMM_NLerp(q1, t, q2);
+
+        HMM_Vec3 pos, scl = r->scale_offset;
+        for (int c = 0; c < 3; c++) {
+            pos.Elements[c] = r->pos_offset.Elements[c] + HMM_Lerp((float)k1[i].pos[c], t, (float)k2[i].pos[c]) * r->pos_scale.Elements[c];
+            if (s1) scl.Elements[c] += HMM_Lerp((float)s1[i * 3 + c], t, (float)s2[i * 3 + c]) * r->scale_scale.Elements[c];
+        }
+
+        HMM_Mat4 local = ref_trs(pos, rot, scl);
+        int parent = set->joint_parents[i];
+        global[i] = parent >= 0 ? HMM_MulM4(global[parent], local) : local;
+        out[i] = HMM_MulM4(global[i], set->inverse_bind[i]);
+    }
+}
+
+static void ref_play_anim(HMM_Mat4* out, AnimSet* set, AnimState* state) {
+    AnimInfo* anim = &set->anims[state->anim];
+    float curframe = state->current_frame;
+    int frame1 = (int)floor(curframe);
+    int frame2 = frame1 + 1;
+    float frameoffset = curframe - frame1;
+    frame1 = frame1 % (int)anim->num_frames;
+    frame2 = frame2 % (int)anim->num_frames;
+    int global_frame1 = anim->first_frame + frame1;
+    int global_frame2 = anim->first_frame + frame2;
+
+    if (set->storage == ANIM_STORAGE_QUANTIZED) {
+        ref_sample_keys(out, set, global_frame1, global_frame2, frameoffset);
+        return;
+    }
+    HMM_Mat4* mat1 = &set->frames[global_frame1 * set->num_joints];
+    HMM_Mat4* mat2 = &set->frames[global_frame2 * set->num_joints];
+    for (int i = 0; i < set->num_joints; i++) {
+        HMM_Mat4 first = HMM_MulM4F(mat1[i], 1.0f - frameoffset);
+        HMM_Mat4 second = HMM_MulM4F(mat2[i], frameoffset);
+        HMM_Mat4 mat = HMM_AddM4(first, second);
+        out[i] = set->joint_parents[i] >= 0 ? HMM_MulM4(out[set->joint_parents[i]], mat) : mat;
+    }
+}
+
+static void ref_blend_anims(HMM_Mat4* out_a, const HMM_Mat4* out_b, float weight, int num_joints) {
+    for (int i = 0; i < num_joints; i++) {
+        HMM_Mat4 a = HMM_MulM4F(out_a[i], 1.0f - weight);
+        HMM_Mat4 b = HMM_MulM4F(out_b[i], weight);
+        out_a[i] = HMM_AddM4(a, b);
+    }
+}
+
+//BENCHMARK
+
+typedef void (*PlayFunc)(HMM_Mat4* out, AnimSet* set, AnimState* state);
+typedef void (*BlendFunc)(HMM_Mat4* out_a, const HMM_Mat4* out_b, float weight, int num_joints);
+
+//walks every clip at fractional frames, so both keys of a sample differ
+static inline AnimState bench_state(const AnimSet* set, int i) {
+    return (AnimState){ .flags = ANIM_FLAG_LOOP, .anim = i % set->num_anims, .current_frame = (i % 97) * 0.37f };
+}
+
+#define BENCH_ROUNDS 5 //the fastest round counts, the others absorb scheduling noise
+
+//the function pointers go through volatile locals so neither side gets inlined into the loop
+static double time_play(PlayFunc play, AnimSet* set, int iterations, float* sink) {
+    PlayFunc volatile fn = play;
+    HMM_Mat4 pose[MAX_BONES];
+    double best = 1e30;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        double t0 = now();
+        for (int i = 0; i < iterations; i++) {
+            AnimState state = bench_state(set, i);
+            fn(pose, set, &state);
+            *sink += pose[set->num_joints - 1].Elements[3][0];
+        }
+        best = HMM_MIN(best, now() - t0);
+    }
+    return best / iterations * 1e9;
+}
+
+static double time_blend(BlendFunc blend, const HMM_Mat4* b, int num_joints, int iterations, float* sink) {
+    BlendFunc volatile fn = blend;
+    HMM_Mat4 pose[MAX_BONES];
+    double best = 1e30;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        memcpy(pose, b, num_joints * sizeof(HMM_Mat4));
+        double t0 = now();
+        for (int i = 0; i < iterations; i++) {
+            fn(pose, b + (i & 1) * MAX_BONES, 0.3f, num_joints);
+        }
+        best = HMM_MIN(best, now() - t0);
+        *sink += pose[0].Elements[3][0];
+    }
+    return best / iterations * 1e9;
+}
+
+//largest element difference over every clip and a spread of frames, the kernels may round differently
+static float max_diff_play(AnimSet* set) {
+    HMM_Mat4 a[MAX_BONES], b[MAX_BONES];
+    float diff = 0.0f;
+    for (int i = 0; i < 4096; i++) {
+        AnimState state = bench_state(set, i);
+        ref_play_anim(a, set, &state);
+        play_anim(b, set, &state);
+        for (int j = 0; j < set->num_joints * 16; j++) {
+            diff = HMM_MAX(diff, fabsf(((float*)a)[j] - ((float*)b)[j]));
+        }
+    }
+    return diff;
+}
+
+static float max_diff_blend(const HMM_Mat4* targets, int num_joints) {
+    HMM_Mat4 a[MAX_BONES], b[MAX_BONES];
+    memcpy(a, targets, num_joints * sizeof(HMM_Mat4));
+    memcpy(b, targets, num_joints * sizeof(HMM_Mat4));
+    ref_blend_anims(a, targets + MAX_BONES, 0.3f, num_joints);
+    blend_anims(b, targets + MAX_BONES, 0.3f, num_joints);
+    float diff = 0.0f;
+    for (int j = 0; j < num_joints * 16; j++) diff = HMM_MAX(diff, fabsf(((float*)a)[j] - ((float*)b)[j]));
+    return diff;
+}
+
+static void report(const char* name, double before, double after, float diff) {
+    printf("%-20s %9.1f ns %9.1f ns %6.2fx   max diff %g\n", name, before, after, before / after, diff);
+}
+
+int main(int argc, char** argv) {
+    const char* path = argc > 1 ? argv[1] : "assets/game_base.iqm";
+    int iterations = argc > 2 ? atoi(argv[2]) : 100000;
+    if (iterations <= 0) iterations = 1;
+
+    Allocator alloc = default_allocator();
+    size_t arena_size = 64 << 20;
+    ArenaAlloc file_arena = {0}, baked_arena = {0}, quant_arena = {0};
+    IoMemory iqm = {0};
+    AnimSet baked = {0}, quant = {0};
+    bool ok = arena_init(&file_arena, core_alloc(&alloc, arena_size, 16), arena_size) &&
+              arena_init(&baked_arena, core_alloc(&alloc, arena_size, 16), arena_size) &&
+              arena_init(&quant_arena, core_alloc(&alloc, arena_size, 16), arena_size) &&
+              load_file(&file_arena, &iqm, path, false) == RESULT_SUCCESS &&
+              load_anims(&baked_arena, &baked, &iqm, ANIM_STORAGE_BAKED) == RESULT_SUCCESS &&
+              load_anims(&quant_arena, &quant, &iqm, ANIM_STORAGE_QUANTIZED) == RESULT_SUCCESS;
+    if (!ok || baked.num_anims <= 0 || baked.num_joints <= 0) {
+        LOG_ERROR("Failed to load animations from %s\n", path);
+        return 1;
+    }
+
+#if defined(HANDMADE_MATH__USE_SSE)
+    const char* simd = "SSE";
+#elif defined(HANDMADE_MATH__USE_NEON)
+    const char* simd = "NEON";
+#else
+    const char* simd = "scalar";
+#endif
+    printf("%s: %d joints, %d clips, %d frames, kernels: %s, %d x %d iterations\n",
+        path, baked.num_joints, baked.num_anims, baked.num_frames, simd, BENCH_ROUNDS, iterations);
+    printf("%-20s %12s %12s %7s\n", "", "reference", "kernels", "");
+
+    float sink = 0.0f;
+    report("play_anim baked", time_play(ref_play_anim, &baked, iterations, &sink),
+        time_play(play_anim, &baked, iterations, &sink), max_diff_play(&baked));
+    report("play_anim quantized", time_play(ref_play_anim, &quant, iterations, &sink),
+        time_play(play_anim, &quant, iterations, &sink), max_diff_play(&quant));
+
+    //two poses to blend towards, alternated so the loop can't be folded
+    static HMM_Mat4 targets[2 * MAX_BONES];
+    AnimState s0 = bench_state(&baked, 1), s1 = bench_state(&baked, 2);
+    play_anim(targets, &baked, &s0);
+    play_anim(targets + MAX_BONES, &baked, &s1);
+    report("blend_anims", time_blend(ref_blend_anims, targets, baked.num_joints, iterations, &sink),
+        time_blend(blend_anims, targets, baked.num_joints, iterations, &sink), max_diff_blend(targets, baked.num_joints));
+
+    printf("(%g)\n", sink); //keeps the results alive
+    core_free(&alloc, file_arena.buffer);
+    core_free(&alloc, baked_arena.buffer);
+    core_free(&alloc, quant_arena.buffer);
+    return 0;
+}
@@ -0,0 +1,7 @@
+#/bin/bash 2>nul || goto :windows
+# bash, the trailing # keeps the CR of these CRLF lines out of the arguments
+cc check.c core.c deps/headers.c deps/tmixer.c deps/tlsf.c deps/dds-ktx.c deps/ne.cc -O2 -fno-exceptions -fno-rtti -DNDEBUG -o check -lstdc++ -lasound -lpthread -ldl -lm #
+exit #
+
+:windows
+clang check.c core.c deps/headers.c deps/tmixer.c deps/tlsf.c deps/dds-ktx.c deps/ne.cc -O2 -fno-exceptions -fno-rtti -DNDEBUG -D_CRT_SECURE_NO_WARNINGS -fuse-ld=lld -o check.exe
@@ -0,0 +1,9 @@
+#/bin/bash 2>nul || goto :windows
+# bash, the trailing # keeps the CR of these CRLF lines out of the arguments
+./wa2c game.wasm game_native.c || exit #
+cc -shared -fPIC game_native.c -O2 -DNDEBUG -o game_native.so -lm #
+exit #
+
+:windows
+wa2c game.wasm game_native.c
+clang -shared game_native.c -O2 -DNDEBUG -D_CRT_SECURE_NO_WARNINGS -fuse-ld=lld -o game_native.dll
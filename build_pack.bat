@@ -0,0 +1 @@
+clang pack.c core.c deps/headers.c deps/tmixer.c deps/tlsf.c deps/dds-ktx.c deps/ne.cc -O2 -fno-exceptions -fno-rtti -DNDEBUG -D_CRT_SECURE_NO_WARNINGS -fuse-ld=lld -o pack.exe
@@ -0,0 +1,7 @@
+#/bin/bash 2>nul || goto :windows
+# bash, the trailing # keeps the CR of these CRLF lines out of the arguments
+cc wa2c.c -O2 -DNDEBUG -o wa2c -lm #
+exit #
+
+:windows
+clang wa2c.c -O2 -DNDEBUG -D_CRT_SECURE_NO_WARNINGS -fuse-ld=lld -o wa2c.exe
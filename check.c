@@ -0,0 +1,204 @@
+//headless regression checks on the sokol dummy backend: nothing reaches a gpu, but gfx_render
+//runs its whole cpu side and fills RenderStats
+//usage: check [<assets dir>], defaults to assets. exits with 1 if a check fails
+#include "core.h"
+#define SOKOL_IMPL
+#define SOKOL_DUMMY_BACKEND
+#include "deps/sokol_gfx.h"
+#include "deps/sokol_gl.h"
+#include "deps/sokol_audio.h"
+#include "deps/sokol_debugtext.h"
+#include "deps/sokol_log.h"
+#include "deps/sokol_fetch.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static int failed;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("  FAILED %s (line %d)\n", #cond, __LINE__); \
+        failed++; \
+    } \
+} while (0)
+
+static const char* assets = "assets";
+static uint8_t file_buffer[8 << 20];
+
+static IoMemory load_asset(ArenaAlloc* arena, const char* name) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", assets, name);
+    IoMemory mem = {0};
+    if (load_file(arena, &mem, path, false) != RESULT_SUCCESS) {
+        printf("  missing %s\n", path);
+        failed++;
+    }
+    return mem;
+}
+
+static ModelHandle load_model_asset(RenderContext* gfx, const char* name) {
+    ArenaAlloc arena = {0};
+    arena_init(&arena, file_buffer, sizeof(file_buffer));
+    IoMemory mem = load_asset(&arena, name);
+    return mem.ptr ? gfx_load_model(gfx, &arena, &mem) : (ModelHandle){ HP_INVALID_HANDLE };
+}
+
+static AnimSetHandle load_anims_asset(RenderContext* gfx, const char* name) {
+    ArenaAlloc arena = {0};
+    arena_init(&arena, file_buffer, sizeof(file_buffer));
+    IoMemory mem = load_asset(&arena, name);
+    return mem.ptr ? gfx_load_anims(gfx, &mem) : (AnimSetHandle){ HP_INVALID_HANDLE };
+}
+
+static RenderContext* new_context(Allocator* alloc) {
+    return gfx_new_context(alloc, &(RenderContextDesc){
+        .environment = { .defaults = { .color_format = SG_PIXELFORMAT_RGBA8, .depth_format = SG_PIXELFORMAT_DEPTH_STENCIL, .sample_count = 1 } },
+        .width = 640, .height = 480,
+        .max_anim_data = 4 << 20, .max_anim_sets = 8, .max_meshes = 16, .max_textures = 16,
+    });
+}
+
+static RenderStats render_frame(RenderContext* gfx, Scene* scene, Camera* cam) {
+    scene_update_transforms(scene);
+    anim_update(scene, gfx, cam, 1.0f / 60.0f);
+    gfx_render(gfx, scene, cam, (sg_swapchain){
+        .width = 640, .height = 480,
+        .color_format = SG_PIXELFORMAT_RGBA8, .depth_format = SG_PIXELFORMAT_DEPTH_STENCIL, .sample_count = 1,
+    });
+    return gfx_get_stats(gfx);
+}
+
+//CULLING
+
+//cubes inside, across the edge of and outside the frustum, plus one skinned model on each side
+static void check_culling(Allocator* alloc) {
+    printf("culling\n");
+    RenderContext* gfx = new_context(alloc);
+    Scene* scene = scene_new(alloc, 64);
+    ModelHandle cube = load_model_asset(gfx, "cube.iqm");
+    ModelHandle npc = load_model_asset(gfx, "game_base.iqm");
+    AnimSetHandle anims = load_anims_asset(gfx, "game_base.iqm");
+
+    //camera at z 10 looking down -z, the left edge of the view is at x -7.7 on the z 0 plane
+    Camera cam = { .fov = 60.0f, .nearz = 0.1f, .farz = 100.0f, .position = HMM_V3(0, 0, 10), .target = HMM_V3(0, 0, 0) };
+    const HMM_Vec3 inside[] = { {{0, 0, 0}}, {{3, 2, -5}}, {{-4, -2, -20}}, {{0, 0, -80}}, {{-8, 0, 0}} };
+    const HMM_Vec3 outside[] = { {{0, 0, 20}}, {{-500, 0, 0}}, {{0, 300, 0}}, {{0, 0, -150}}, {{40, 0, 0}} };
+    for (int i = 0; i < 10; i++) {
+        Entity e = entity_new(scene);
+        entity_set_model(scene, e, cube);
+        entity_set_position(scene, e, i < 5 ? inside[i] : outside[i - 5]);
+    }
+    for (int i = 0; i < 2; i++) {
+        Entity e = entity_new(scene);
+        entity_set_model(scene, e, npc);
+        entity_set_anim(scene, e, anims, (AnimState){ .flags = ANIM_FLAG_PLAY | ANIM_FLAG_LOOP });
+        entity_set_position(scene, e, i == 0 ? HMM_V3(0, -1, -3) : HMM_V3(0, -1, 40));
+    }
+
+    RenderStats stats = render_frame(gfx, scene, &cam);
+    printf("  visible %d, culled %d, skeletons sampled %d\n", stats.visible, stats.culled, stats.skeletons_sampled);
+    CHECK(stats.visible == 6);
+    CHECK(stats.culled == 6);
+    CHECK(stats.skeletons_sampled == 1);
+
+    scene_destroy(alloc, scene);
+    gfx_shutdown(gfx);
+}
+
+//RENDER QUEUE
+
+static TextureHandle load_texture_asset(RenderContext* gfx, const char* name) {
+    ArenaAlloc arena = {0};
+    arena_init(&arena, file_buffer, sizeof(file_buffer));
+    IoMemory mem = load_asset(&arena, name);
+    return mem.ptr ? gfx_load_texture(gfx, &mem) : (TextureHandle){ HP_INVALID_HANDLE };
+}
+
+//static entities in handle order alternate model and texture, so every draw changes state unless
+//the queue sorts them. the figures are from when the queue went in, more state changes than
+//that is a regression
+static void check_render_queue(Allocator* alloc) {
+    printf("render queue\n");
+    RenderContext* gfx = new_context(alloc);
+    Scene* scene = scene_new(alloc, 512);
+    ModelHandle models[2] = { load_model_asset(gfx, "cube.iqm"), load_model_asset(gfx, "plane.iqm") };
+    ModelHandle npc = load_model_asset(gfx, "game_base.iqm");
+    AnimSetHandle anims = load_anims_asset(gfx, "game_base.iqm");
+    TextureHandle textures[2] = { load_texture_asset(gfx, "floor.webp"), load_texture_asset(gfx, "skin_head.webp") };
+
+    Camera cam = { .fov = 60.0f, .nearz = 0.1f, .farz = 200.0f, .position = HMM_V3(0, 10, 20), .target = HMM_V3(0, 0, -10) };
+    int num_meshes = 0;
+    for (int i = 0; i < 240; i++) {
+        Entity e = entity_new(scene);
+        TextureHandle tex = textures[(i / 3) % 2];
+        entity_set_model(scene, e, models[i % 2]);
+        entity_set_textures(scene, e, (TextureSet){ { tex, tex, tex, tex } });
+        entity_set_position(scene, e, HMM_V3((i % 20) - 10.0f, 0, -(i / 20) * 2.0f));
+        num_meshes++;
+    }
+    for (int i = 0; i < 20; i++) {
+        Entity e = entity_new(scene);
+        entity_set_model(scene, e, npc);
+        entity_set_textures(scene, e, (TextureSet){ { textures[0], textures[1], textures[0], textures[1] } });
+        entity_set_anim(scene, e, anims, (AnimState){ .flags = ANIM_FLAG_PLAY | ANIM_FLAG_LOOP, .current_frame = (float)i });
+        entity_set_position(scene, e, HMM_V3(i % 10 - 5.0f, 0, -(i / 10) * 3.0f));
+        num_meshes += 2;
+    }
+
+    sg_enable_stats();
+    render_frame(gfx, scene, &cam);
+    RenderStats stats = render_frame(gfx, scene, &cam);
+    sg_frame_stats frame = sg_query_stats().prev_frame;
+    printf("  %d visible entities, %d meshes without a queue\n", stats.visible, num_meshes);
+    printf("  draws %d, pipeline changes %d, binding changes %d\n", stats.draw_calls, stats.pipeline_changes, stats.binding_changes);
+    printf("  sokol: %u draws, %u pipelines, %u bindings, all passes\n", frame.num_draw + frame.num_draw_ex, frame.num_apply_pipeline, frame.num_apply_bindings);
+    CHECK(stats.visible == 260);
+    CHECK(stats.draw_calls <= 44);
+    CHECK(stats.pipeline_changes <= 2);
+    CHECK(stats.binding_changes <= 6);
+    //the counters are what actually reached sokol, the display pass adds one of each
+    CHECK(frame.num_draw + frame.num_draw_ex == (uint32_t)stats.draw_calls + 1);
+    CHECK(frame.num_apply_pipeline == (uint32_t)stats.pipeline_changes + 1);
+    CHECK(frame.num_apply_bindings == (uint32_t)stats.binding_changes + 1);
+    sg_disable_stats();
+
+    scene_destroy(alloc, scene);
+    gfx_shutdown(gfx);
+}
+
+//MESH OPTIMIZER
+
+static uint8_t decode_buffer[32 << 20];
+
+static int measure_acmr(const char* name, uint32_t flags, float* acmr) {
+    ArenaAlloc arena = {0}, decode = {0};
+    arena_init(&arena, file_buffer, sizeof(file_buffer));
+    arena_init(&decode, decode_buffer, sizeof(decode_buffer));
+    IoMemory mem = load_asset(&arena, name);
+    return mem.ptr ? model_measure_acmr(&decode, &mem, flags, acmr, MODEL_MAX_MESHES) : 0;
+}
+
+//vertex cache misses per triangle on the bundled character, as exported and after MODEL_LOAD_OPTIMIZE.
+//the optimized order has to beat the file order by 5% or more on every mesh
+static void check_acmr(void) {
+    printf("acmr\n");
+    float before[MODEL_MAX_MESHES], after[MODEL_MAX_MESHES];
+    int count = measure_acmr("game_base.iqm", 0, before);
+    CHECK(count > 0);
+    CHECK(measure_acmr("game_base.iqm", MODEL_LOAD_OPTIMIZE, after) == count);
+    for (int m = 0; m < count; m++) {
+        printf("  mesh %d: %.3f -> %.3f\n", m, before[m], after[m]);
+        CHECK(after[m] <= before[m] * 0.95f);
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) assets = argv[1];
+    Allocator alloc = default_allocator();
+    check_culling(&alloc);
+    check_render_queue(&alloc);
+    check_acmr();
+    printf(failed ? "%d checks FAILED\n" : "all checks passed\n", failed);
+    return failed ? 1 : 0;
+}
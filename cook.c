@@ -0,0 +1,78 @@
+//offline model cooker, converts iqm meshes into the layout gfx_load_model uploads as is
+//usage: cook [-compact] [-optimize] <in.iqm> <out.lmdl> [<in.iqm> <out.lmdl> ...]
+//-compact stores unskinned meshes as VertexCompact, see MESH_COMPACT
+//-optimize reorders triangles and vertices for the gpu caches and logs acmr, see MODEL_LOAD_OPTIMIZE
+//skeleton and clips go along as quantized keys, gfx_load_anims takes the .lmdl like it takes the .iqm
+#include "core.h"
+#define SOKOL_IMPL
+#define SOKOL_DUMMY_BACKEND
+#include "deps/sokol_gfx.h"
+#include "deps/sokol_gl.h"
+#include "deps/sokol_audio.h"
+#include "deps/sokol_debugtext.h"
+#include "deps/sokol_log.h"
+#include "deps/sokol_fetch.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static bool cook_file(Allocator* alloc, const char* in_path, const char* out_path, uint32_t flags) {
+    IoMemory iqm = {0};
+    ArenaAlloc src = {0};
+    if (map_file(NULL, &iqm, in_path) != RESULT_SUCCESS) {
+        //no mapping on this platform, read it into a buffer the size of the file
+        FILE* f = fopen(in_path, "rb");
+        if (!f) {
+            LOG_ERROR("Failed to open %s\n", in_path);
+            return false;
+        }
+        fseek(f, 0, SEEK_END);
+        size_t size = (size_t)ftell(f);
+        fclose(f);
+        if (!arena_init(&src, core_alloc(alloc, size + 16, 16), size + 16) ||
+            load_file(&src, &iqm, in_path, false) != RESULT_SUCCESS) {
+            core_free(alloc, src.buffer);
+            return false;
+        }
+    }
+
+    size_t scratch_size = cook_model_size(&iqm, flags);
+    ArenaAlloc scratch = {0};
+    IoMemory cooked = {0};
+    bool ok = scratch_size > 0 && arena_init(&scratch, core_alloc(alloc, scratch_size, 16), scratch_size) &&
+              cook_model(&scratch, &cooked, &iqm, flags) == RESULT_SUCCESS;
+
+    FILE* out = ok ? fopen(out_path, "wb") : NULL;
+    ok = out && fwrite(cooked.ptr, 1, cooked.size, out) == cooked.size;
+    if (out) fclose(out);
+    if (ok) {
+        LOG_INFO("Cooked %s -> %s (%zu bytes)\n", in_path, out_path, cooked.size);
+    } else {
+        LOG_ERROR("Failed to cook %s\n", in_path);
+    }
+
+    core_free(alloc, scratch.buffer);
+    release_file(&iqm);
+    core_free(alloc, src.buffer);
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    int first = 1;
+    uint32_t flags = 0;
+    for (; first < argc && argv[first][0] == '-'; first++) {
+        if (strcmp(argv[first], "-compact") == 0) flags |= MODEL_LOAD_COMPACT;
+        else if (strcmp(argv[first], "-optimize") == 0) flags |= MODEL_LOAD_OPTIMIZE;
+        else break;
+    }
+    if (argc - first < 2 || (argc - first) % 2 != 0) {
+        printf("usage: cook [-compact] [-optimize] <in.iqm> <out.lmdl> [<in.iqm> <out.lmdl> ...]\n");
+        return 1;
+    }
+    Allocator alloc = default_allocator();
+    int failed = 0;
+    for (int i = first; i + 1 < argc; i += 2) {
+        failed += !cook_file(&alloc, argv[i], argv[i + 1], flags);
+    }
+    return failed ? 1 : 0;
+}
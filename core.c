@@ -5,15 +5,29 @@
 #include "deps/sokol_debugtext.h"
 #include "deps/sokol_audio.h"
 #include "deps/sokol_log.h"
+#include "deps/sokol_fetch.h"
 #include "deps/dds-ktx.h"
 #include "deps/tiny_webp.h"
 #include "deps/iqm.h"
 #include "deps/tinyendian.c"
 #include "deps/tmixer.h"
+#include "deps/thread.h"
 
 #include <stdio.h>
 #include <assert.h>
 #include <string.h>
+#include <float.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+#define CORE_HAS_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <dlfcn.h>
+#endif
 
 //--ALLOCATORS-------------------------------------------------------
 
@@ -52,10 +66,195 @@ Allocator default_allocator(void) {
 
 //--IO------------------------------------------------------------------------------------------------------------------
 
+//file formats are little endian, so on most hosts this doesn't write to (and dirty) mapped pages
+static void _le32_inplace(void* data, size_t count) {
+    if (!IS_BIG_ENDIAN) return;
+    uint32_t* p = data;
+    for (size_t i = 0; i < count; i++) p[i] = swap32(p[i]);
+}
+
+static void _le16_inplace(void* data, size_t count) {
+    if (!IS_BIG_ENDIAN) return;
+    uint16_t* p = data;
+    for (size_t i = 0; i < count; i++) p[i] = swap16(p[i]);
+}
+
+uint64_t asset_key(const char* path) {
+    if (!path) return 1;
+    while (path[0] == '.' && (path[1] == '/' || path[1] == '\\')) path += 2;
+    //fnv-1a, separators folded so packs built on windows resolve everywhere
+    uint64_t h = 14695981039346656037ull;
+    for (const char* c = path; *c; c++) {
+        uint8_t b = *c == '\\' ? '/' : (uint8_t)*c;
+        h = (h ^ b) * 1099511628211ull;
+    }
+    return h ? h : 1;
+}
+
+bool lz4_decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size) {
+    size_t ip = 0, op = 0;
+    while (ip < src_size) {
+        uint8_t token = src[ip++];
+        size_t lit = token >> 4;
+        if (lit == 15) {
+            uint8_t b;
+            do {
+                if (ip >= src_size) return false;
+                b = src[ip++];
+                lit += b;
+            } while (b == 255);
+        }
+        if (lit > src_size - ip || lit > dst_size - op) return false;
+        memcpy(dst + op, src + ip, lit);
+        ip += lit;
+        op += lit;
+        if (ip == src_size) break; //the last sequence has no match
+
+        if (src_size - ip < 2) return false;
+        size_t offset = (size_t)src[ip] | ((size_t)src[ip + 1] << 8);
+        ip += 2;
+        size_t len = token & 15;
+        if (len == 15) {
+            uint8_t b;
+            do {
+                if (ip >= src_size) return false;
+                b = src[ip++];
+                len += b;
+            } while (b == 255);
+        }
+        len += 4;
+        if (offset == 0 || offset > op || len > dst_size - op) return false;
+        if (offset >= len) {
+            memcpy(dst + op, dst + op - offset, len);
+            op += len;
+        } else {
+            //overlapping match repeats the last offset bytes
+            for (size_t i = 0; i < len; i++, op++) dst[op] = dst[op - offset];
+        }
+    }
+    return op == dst_size;
+}
+
+typedef struct PakMount {
+    IoMemory file;
+    Allocator alloc; //owns file.ptr when it isn't mapped
+    const PakEntry* entries;
+    uint32_t num_entries;
+} PakMount;
+
+static struct {
+    PakMount mounts[PAK_MAX_MOUNTS];
+    int count;
+} _paks;
+
+Result pak_mount(Allocator* alloc, const char* path) {
+    if (!alloc || !path) return RESULT_INVALID_PARAMS;
+    if (_paks.count >= PAK_MAX_MOUNTS) {
+        LOG_ERROR("Can't mount %s, %d packs are mounted already\n", path, PAK_MAX_MOUNTS);
+        return RESULT_NOMEM;
+    }
+    struct stat st;
+    if (stat(path, &st) != 0 || st.st_size < (off_t)sizeof(PakHeader)) return RESULT_FILE_NOT_FOUND;
+
+    PakMount* m = &_paks.mounts[_paks.count];
+    memset(m, 0, sizeof(PakMount));
+    if (map_file(NULL, &m->file, path) != RESULT_SUCCESS) {
+        ArenaAlloc whole = {0};
+        size_t size = (size_t)st.st_size;
+        if (!arena_init(&whole, core_alloc(alloc, size + 1, 16), size + 1) ||
+            load_file(&whole, &m->file, path, false) != RESULT_SUCCESS) {
+            core_free(alloc, whole.buffer);
+            return RESULT_NOMEM;
+        }
+        m->alloc = *alloc;
+    }
+
+    PakHeader* header = (PakHeader*)m->file.ptr;
+    _le32_inplace(&header->version, (sizeof(PakHeader) - sizeof(header->magic)) / sizeof(uint32_t));
+    size_t table = (size_t)header->num_entries * sizeof(PakEntry);
+    bool ok = memcmp(header->magic, PAK_MAGIC, sizeof(header->magic)) == 0 && header->version == PAK_VERSION &&
+              header->ofs_entries % 8 == 0 && header->ofs_entries <= m->file.size && table <= m->file.size - header->ofs_entries;
+    if (ok) {
+        PakEntry* entries = (PakEntry*)(m->file.ptr + header->ofs_entries);
+        for (uint32_t i = 0; i < header->num_entries && ok; i++) {
+            if (IS_BIG_ENDIAN) entries[i].hash = tole64(entries[i].hash); //keeps the mapped pages clean
+            _le32_inplace(&entries[i].offset, 4);
+            ok = entries[i].offset <= m->file.size && entries[i].size <= m->file.size - entries[i].offset;
+        }
+        m->entries = entries;
+        m->num_entries = header->num_entries;
+    }
+    if (!ok) {
+        LOG_ERROR("Invalid asset pack: %s\n", path);
+        if (m->file.mapped) release_file(&m->file);
+        else core_free(&m->alloc, m->file.ptr);
+        return RESULT_INVALID_PARAMS;
+    }
+    _paks.count++;
+    LOG_INFO("Mounted pack: %s (%u entries)\n", path, m->num_entries);
+    return RESULT_SUCCESS;
+}
+
+void pak_unmount_all(void) {
+    for (int i = 0; i < _paks.count; i++) {
+        PakMount* m = &_paks.mounts[i];
+        if (m->file.mapped) release_file(&m->file);
+        else core_free(&m->alloc, m->file.ptr);
+    }
+    memset(&_paks, 0, sizeof(_paks));
+}
+
+static const PakEntry* _pak_find(const char* path, const PakMount** out) {
+    if (_paks.count == 0 || !path) return NULL;
+    uint64_t key = asset_key(path);
+    for (int i = _paks.count - 1; i >= 0; i--) {
+        const PakMount* m = &_paks.mounts[i];
+        uint32_t lo = 0, hi = m->num_entries;
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (m->entries[mid].hash < key) lo = mid + 1;
+            else hi = mid;
+        }
+        if (lo < m->num_entries && m->entries[lo].hash == key) {
+            *out = m;
+            return &m->entries[lo];
+        }
+    }
+    return NULL;
+}
+
+static Result _pak_read(const PakMount* m, const PakEntry* entry, uint8_t* dst) {
+    const uint8_t* src = m->file.ptr + entry->offset;
+    if (entry->flags & PAK_ENTRY_LZ4) {
+        if (!lz4_decompress(src, entry->size, dst, entry->raw_size)) {
+            LOG_ERROR("Corrupt pack entry %016llx\n", (unsigned long long)entry->hash);
+            return RESULT_UNKNOWN_ERROR;
+        }
+    } else {
+        memcpy(dst, src, entry->raw_size);
+    }
+    return RESULT_SUCCESS;
+}
 
 Result load_file(ArenaAlloc *alloc, IoMemory* out, const char *path, bool null_terminate) {
     if (!alloc || !out || !path) return RESULT_INVALID_PARAMS;
 
+    const PakMount* pak = NULL;
+    const PakEntry* entry = _pak_find(path, &pak);
+    if (entry) {
+        out->ptr = arena_alloc(alloc, entry->raw_size + 1, 16);
+        if (!out->ptr) {
+            LOG_ERROR("Failed to allocate IoMemory for file: %s", path);
+            return RESULT_NOMEM;
+        }
+        Result result = _pak_read(pak, entry, out->ptr);
+        if (result != RESULT_SUCCESS) return result;
+        if (null_terminate) out->ptr[entry->raw_size] = '\0';
+        out->size = entry->raw_size;
+        out->mapped = false;
+        return RESULT_SUCCESS;
+    }
+
     FILE *file = fopen(path, "rb");
     if (!file) {
         LOG_ERROR("Failed to open file: %s", path);
@@ -84,6 +283,127 @@ Result load_file(ArenaAlloc *alloc, IoMemory* out, const char *path, bool null_t
     return RESULT_SUCCESS;
 }
 
+Result map_file(ArenaAlloc* fallback, IoMemory* out, const char* path) {
+    if (!out || !path) return RESULT_INVALID_PARAMS;
+    *out = (IoMemory){0};
+
+    //stored entries are handed out in place. big endian hosts fix up files in place, so they
+    //and compressed entries get a copy
+    const PakMount* pak = NULL;
+    const PakEntry* entry = _pak_find(path, &pak);
+    if (entry && !(entry->flags & PAK_ENTRY_LZ4) && !IS_BIG_ENDIAN) {
+        out->ptr = pak->file.ptr + entry->offset;
+        out->size = entry->raw_size;
+        return RESULT_SUCCESS;
+    }
+    if (entry) {
+        if (!fallback) return RESULT_INVALID_PARAMS;
+        return load_file(fallback, out, path, false);
+    }
+
+#ifdef CORE_HAS_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        LOG_ERROR("Failed to open file: %s", path);
+        return RESULT_FILE_NOT_FOUND;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        //private and writable, so in-place fixups stay copy-on-write and never reach the file
+        void* map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            close(fd);
+            out->ptr = map;
+            out->size = (size_t)st.st_size;
+            out->mapped = true;
+            LOG_INFO("Mapped file: %s (%zu bytes)\n", path, out->size);
+            return RESULT_SUCCESS;
+        }
+    }
+    close(fd);
+#endif
+    if (!fallback) return RESULT_INVALID_PARAMS;
+    return load_file(fallback, out, path, false);
+}
+
+void release_file(IoMemory* mem) {
+    if (!mem) return;
+#ifdef CORE_HAS_MMAP
+    if (mem->mapped) munmap(mem->ptr, mem->size);
+#endif
+    *mem = (IoMemory){0};
+}
+
+void* lib_open(const char* path) {
+#if defined(_WIN32)
+    return (void*)LoadLibraryA(path);
+#elif defined(CORE_HAS_MMAP)
+    return dlopen(path, RTLD_NOW | RTLD_LOCAL);
+#else
+    (void)path;
+    return NULL;
+#endif
+}
+
+void* lib_symbol(void* lib, const char* name) {
+    if (!lib) return NULL;
+#if defined(_WIN32)
+    return (void*)GetProcAddress((HMODULE)lib, name);
+#elif defined(CORE_HAS_MMAP)
+    return dlsym(lib, name);
+#else
+    (void)name;
+    return NULL;
+#endif
+}
+
+void lib_close(void* lib) {
+    if (!lib) return;
+#if defined(_WIN32)
+    FreeLibrary((HMODULE)lib);
+#elif defined(CORE_HAS_MMAP)
+    dlclose(lib);
+#endif
+}
+
+bool asset_cache_init(AssetCache* cache, Allocator* alloc, int capacity) {
+    cache->keys = core_alloc(alloc, capacity * sizeof(uint64_t), alignof(uint64_t));
+    cache->refs = core_alloc(alloc, capacity * sizeof(uint32_t), alignof(uint32_t));
+    if (!cache->keys || !cache->refs) return false;
+    memset(cache->keys, 0, capacity * sizeof(uint64_t));
+    memset(cache->refs, 0, capacity * sizeof(uint32_t));
+    cache->hold = false;
+    return true;
+}
+
+hp_Handle asset_cache_acquire(AssetCache* cache, const hp_Pool* pool, uint64_t key) {
+    //pools hold a few hundred assets at most, a scan is cheaper than keeping a map in sync
+    for (int i = 0; i < pool->count; i++) {
+        hp_Handle hnd = hp_handle_at(pool, i);
+        int idx = hp_index(hnd);
+        if (cache->keys[idx] == key) {
+            cache->refs[idx]++;
+            return hnd;
+        }
+    }
+    return HP_INVALID_HANDLE;
+}
+
+void asset_cache_insert(AssetCache* cache, hp_Handle hnd, uint64_t key) {
+    int idx = hp_index(hnd);
+    cache->keys[idx] = key;
+    cache->refs[idx] = 1;
+}
+
+bool asset_cache_release(AssetCache* cache, hp_Handle hnd) {
+    int idx = hp_index(hnd);
+    if (cache->refs[idx] > 0) cache->refs[idx]--;
+    if (cache->refs[idx] > 0) return false;
+    if (cache->hold && cache->keys[idx] != 0) return false;
+    cache->keys[idx] = 0;
+    return true;
+}
+
 
 
 //--CAMERA-------------------------------------------------------------------------------
@@ -97,6 +417,28 @@ HMM_Mat4 camera_proj_mtx(Camera *cam, int width, int height) {
     return HMM_Perspective_RH_ZO(cam->fov * HMM_DegToRad, (float)width / (float)height, cam->nearz, cam->farz);
 }
 
+Frustum frustum_from_mtx(HMM_Mat4 vp) {
+    //Gribb/Hartmann plane extraction, rows of the column-major matrix, zero-to-one depth
+    HMM_Vec4 r0 = HMM_V4(vp.Columns[0].X, vp.Columns[1].X, vp.Columns[2].X, vp.Columns[3].X);
+    HMM_Vec4 r1 = HMM_V4(vp.Columns[0].Y, vp.Columns[1].Y, vp.Columns[2].Y, vp.Columns[3].Y);
+    HMM_Vec4 r2 = HMM_V4(vp.Columns[0].Z, vp.Columns[1].Z, vp.Columns[2].Z, vp.Columns[3].Z);
+    HMM_Vec4 r3 = HMM_V4(vp.Columns[0].W, vp.Columns[1].W, vp.Columns[2].W, vp.Columns[3].W);
+
+    Frustum f;
+    f.planes[0] = HMM_AddV4(r3, r0); //left
+    f.planes[1] = HMM_SubV4(r3, r0); //right
+    f.planes[2] = HMM_AddV4(r3, r1); //bottom
+    f.planes[3] = HMM_SubV4(r3, r1); //top
+    f.planes[4] = r2;                //near
+    f.planes[5] = HMM_SubV4(r3, r2); //far
+
+    for (int i = 0; i < 6; i++) {
+        float len = HMM_LenV3(f.planes[i].XYZ);
+        if (len > 0.0f) f.planes[i] = HMM_DivV4F(f.planes[i], len);
+    }
+    return f;
+}
+
 
 //--IMAGES-------------------------------------------------------------------------------
 
@@ -141,61 +483,414 @@ sg_image_type dds_to_sg_image_type(unsigned int flags) {
     return SG_IMAGETYPE_2D;
 }
 
-Result load_texture(ArenaAlloc* alloc, Texture* out, const IoMemory* mem) {
+//cpu side of a texture, filled without touching sokol_gfx so it can run on a loader thread
+typedef struct TextureData {
+    sg_image_desc desc;    //dds mips point into the file, which has to outlive _create_texture
+    unsigned char* pixels; //decoded webp mip chain or cached dds file, freed by _create_texture
+} TextureData;
+
+//MIP CHAINS
+
+//full chain down to 1x1, as far as sokol takes it
+static int _mip_count(int width, int height) {
+    int n = 1;
+    while ((width > 1 || height > 1) && n < SG_MAX_MIPMAPS) {
+        width = HMM_MAX(width / 2, 1);
+        height = HMM_MAX(height / 2, 1);
+        n++;
+    }
+    return n;
+}
+
+//bytes of one level, bc3 packs 4x4 blocks into 16 bytes and pads the edges to whole blocks
+static inline size_t _mip_size(int width, int height, bool bc3) {
+    return bc3 ? (size_t)((width + 3) / 4) * ((height + 3) / 4) * 16 : (size_t)width * height * 4;
+}
+
+static size_t _mip_chain_size(int width, int height, int num_mips, bool bc3) {
+    size_t size = 0;
+    for (int i = 0; i < num_mips; i++) {
+        size += _mip_size(width, height, bc3);
+        width = HMM_MAX(width / 2, 1);
+        height = HMM_MAX(height / 2, 1);
+    }
+    return size;
+}
+
+//2x2 box filter on RGBA8, each level from the one above it. color is averaged in linear space so
+//minified textures don't darken, alpha as is. odd sizes repeat their last row or column.
+//pixels holds the whole chain with level 0 filled in, desc gets the ranges
+static void _generate_mips(uint8_t* pixels, int width, int height, int num_mips, sg_image_desc* desc) {
+    //per call, so decode threads share nothing. linear values are 16 bit, sums of 4 index the
+    //14 bit table back to srgb, filled from the midpoints between neighbouring srgb values.
+    //4 * 65535 rounds up to index 1 << 14, hence the extra entry.
+    //scalar on purpose: every texel is 4 table gathers, which the SSE/NEON kernels of the
+    //animation code don't cover, and the webp decode before this costs far more
+    uint16_t to_linear[256];
+    uint8_t to_srgb[(1 << 14) + 1];
+    for (int s = 0; s < 256; s++) {
+        float c = s / 255.0f;
+        float l = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+        to_linear[s] = (uint16_t)(l * 65535.0f + 0.5f);
+    }
+    int s = 0;
+    for (int i = 0; i <= (1 << 14); i++) {
+        uint32_t l = (uint32_t)i << 2;
+        while (s < 255 && l * 2 >= (uint32_t)to_linear[s] + to_linear[s + 1]) s++;
+        to_srgb[i] = (uint8_t)s;
+    }
+
+    desc->num_mipmaps = num_mips;
+    desc->data.mip_levels[0] = (sg_range){ pixels, (size_t)width * height * 4 };
+    const uint8_t* src = pixels;
+    int sw = width, sh = height;
+    for (int level = 1; level < num_mips; level++) {
+        uint8_t* dst = (uint8_t*)src + (size_t)sw * sh * 4;
+        int dw = HMM_MAX(sw / 2, 1), dh = HMM_MAX(sh / 2, 1);
+        for (int y = 0; y < dh; y++) {
+            const uint8_t* r0 = src + (size_t)HMM_MIN(y * 2, sh - 1) * sw * 4;
+            const uint8_t* r1 = src + (size_t)HMM_MIN(y * 2 + 1, sh - 1) * sw * 4;
+            uint8_t* out = dst + (size_t)y * dw * 4;
+            for (int x = 0; x < dw; x++) {
+                int x0 = HMM_MIN(x * 2, sw - 1) * 4, x1 = HMM_MIN(x * 2 + 1, sw - 1) * 4;
+                for (int c = 0; c < 3; c++) {
+                    uint32_t sum = (uint32_t)to_linear[r0[x0 + c]] + to_linear[r0[x1 + c]] +
+                                   to_linear[r1[x0 + c]] + to_linear[r1[x1 + c]];
+                    out[x * 4 + c] = to_srgb[(sum + 8) >> 4];
+                }
+                out[x * 4 + 3] = (uint8_t)((r0[x0 + 3] + r0[x1 + 3] + r1[x0 + 3] + r1[x1 + 3] + 2) >> 2);
+            }
+        }
+        desc->data.mip_levels[level] = (sg_range){ dst, (size_t)dw * dh * 4 };
+        src = dst;
+        sw = dw;
+        sh = dh;
+    }
+}
+
+//BC3 block from 4x4 RGBA8 texels: bounding box endpoints inset by 1/16 to pull them towards the
+//bulk of the colors, then the nearest palette entry per texel. no search, it only has to beat the
+//decode it replaces
+static void _bc3_block(uint8_t out[16], const uint8_t texels[64]) {
+    uint8_t amin = 255, amax = 0;
+    int cmin[3] = { 255, 255, 255 }, cmax[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; i++) {
+        const uint8_t* t = &texels[i * 4];
+        for (int c = 0; c < 3; c++) {
+            cmin[c] = HMM_MIN(cmin[c], t[c]);
+            cmax[c] = HMM_MAX(cmax[c], t[c]);
+        }
+        amin = HMM_MIN(amin, t[3]);
+        amax = HMM_MAX(amax, t[3]);
+    }
+
+    //alpha: 8 interpolated values between amax and amin
+    int apal[8] = { amax, amin };
+    for (int i = 1; i < 7; i++) apal[i + 1] = ((7 - i) * amax + i * amin) / 7;
+    uint64_t abits = 0;
+    for (int i = 0; i < 16 && amax > amin; i++) {
+        int best = 0, best_err = 256;
+        for (int k = 0; k < 8; k++) {
+            int err = abs(texels[i * 4 + 3] - apal[k]);
+            if (err < best_err) {
+                best = k;
+                best_err = err;
+            }
+        }
+        abits |= (uint64_t)best << (i * 3);
+    }
+    out[0] = amax;
+    out[1] = amin;
+    for (int i = 0; i < 6; i++) out[2 + i] = (uint8_t)(abits >> (i * 8));
+
+    //color: 565 endpoints, always the four color mode
+    for (int c = 0; c < 3; c++) {
+        int inset = (cmax[c] - cmin[c]) / 16;
+        cmin[c] += inset;
+        cmax[c] -= inset;
+    }
+    uint16_t c0 = (uint16_t)(((cmax[0] >> 3) << 11) | ((cmax[1] >> 2) << 5) | (cmax[2] >> 3));
+    uint16_t c1 = (uint16_t)(((cmin[0] >> 3) << 11) | ((cmin[1] >> 2) << 5) | (cmin[2] >> 3));
+    uint32_t cbits = 0;
+    if (c0 != c1) {
+        if (c0 < c1) {
+            uint16_t tmp = c0;
+            c0 = c1;
+            c1 = tmp;
+        }
+        int pal[4][3];
+        for (int k = 0; k < 2; k++) {
+            uint16_t e = k ? c1 : c0;
+            pal[k][0] = ((e >> 11) & 31) * 255 / 31;
+            pal[k][1] = ((e >> 5) & 63) * 255 / 63;
+            pal[k][2] = (e & 31) * 255 / 31;
+        }
+        for (int c = 0; c < 3; c++) {
+            pal[2][c] = (2 * pal[0][c] + pal[1][c]) / 3;
+            pal[3][c] = (pal[0][c] + 2 * pal[1][c]) / 3;
+        }
+        for (int i = 0; i < 16; i++) {
+            const uint8_t* t = &texels[i * 4];
+            int best = 0, best_err = INT32_MAX;
+            for (int k = 0; k < 4; k++) {
+                int dr = t[0] - pal[k][0], dg = t[1] - pal[k][1], db = t[2] - pal[k][2];
+                int err = dr * dr + dg * dg + db * db;
+                if (err < best_err) {
+                    best = k;
+                    best_err = err;
+                }
+            }
+            cbits |= (uint32_t)best << (i * 2);
+        }
+    }
+    out[8] = (uint8_t)c0;
+    out[9] = (uint8_t)(c0 >> 8);
+    out[10] = (uint8_t)c1;
+    out[11] = (uint8_t)(c1 >> 8);
+    for (int i = 0; i < 4; i++) out[12 + i] = (uint8_t)(cbits >> (i * 8));
+}
+
+//compresses every level of desc into dst, sized by _mip_chain_size. blocks past the edge of small
+//levels repeat the last row and column
+static void _bc3_chain(uint8_t* dst, sg_image_desc* desc) {
+    int width = desc->width, height = desc->height;
+    for (int level = 0; level < desc->num_mipmaps; level++) {
+        const uint8_t* src = desc->data.mip_levels[level].ptr;
+        uint8_t* out = dst;
+        for (int by = 0; by < height; by += 4) {
+            for (int bx = 0; bx < width; bx += 4) {
+                uint8_t texels[64];
+                for (int y = 0; y < 4; y++) {
+                    for (int x = 0; x < 4; x++) {
+                        size_t s = ((size_t)HMM_MIN(by + y, height - 1) * width + HMM_MIN(bx + x, width - 1)) * 4;
+                        memcpy(&texels[(y * 4 + x) * 4], &src[s], 4);
+                    }
+                }
+                _bc3_block(out, texels);
+                out += 16;
+            }
+        }
+        desc->data.mip_levels[level] = (sg_range){ dst, (size_t)(out - dst) };
+        dst = out;
+        width = HMM_MAX(width / 2, 1);
+        height = HMM_MAX(height / 2, 1);
+    }
+    desc->pixel_format = SG_PIXELFORMAT_BC3_RGBA;
+}
+
+//decoded webp chains are kept on disk as dds, RGBA8 or BC3, named after a hash of the source
+//file. bumping the version orphans every old entry
+#define TEXTURE_CACHE_VERSION 2
+
+//how _decode_texture caches, a copy goes into loader jobs so decode threads never read the context
+typedef struct TextureCache {
+    const char* dir; //NULL when webp textures are decoded every time
+    bool bc3;        //entries are compressed, only when the gpu samples BC3
+    uint64_t hash;   //_texture_cache_hash of the source when it is known already, 0 hashes it again
+} TextureCache;
+
+typedef struct DdsHeader {
+    char magic[4];
+    uint32_t size, flags, height, width, pitch, depth, mip_count, reserved1[11];
+    uint32_t pf_size, pf_flags, pf_fourcc, pf_bits, pf_masks[4];
+    uint32_t caps1, caps2, caps3, caps4, reserved2;
+} DdsHeader;
+
+//fnv-1a over 8 byte words, folded so the high bits of each word reach the low ones. not portable
+//across byte orders, neither is a cache directory
+static uint64_t _texture_cache_hash(const IoMemory* mem) {
+    uint64_t h = 14695981039346656037ull ^ TEXTURE_CACHE_VERSION;
+    size_t i = 0;
+    for (; i + 8 <= mem->size; i += 8) {
+        uint64_t w;
+        memcpy(&w, mem->ptr + i, sizeof(w));
+        h = (h ^ w) * 1099511628211ull;
+        h ^= h >> 32;
+    }
+    for (; i < mem->size; i++) h = (h ^ mem->ptr[i]) * 1099511628211ull;
+    return h;
+}
+
+static bool _texture_cache_path(char* path, size_t size, const TextureCache* cache, const IoMemory* mem) {
+    uint64_t h = cache->hash ? cache->hash : _texture_cache_hash(mem);
+    int n = snprintf(path, size, "%s/%016llx%s.dds", cache->dir, (unsigned long long)h, cache->bc3 ? "_bc3" : "");
+    return n > 0 && (size_t)n < size;
+}
+
+//the whole file goes into out->pixels, the mip ranges point into it. a bc3 cache also holds RGBA8
+//entries, for textures whose size isn't a multiple of 4
+static bool _texture_cache_read(TextureData* out, const char* path, bool bc3) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    unsigned char* file = size > 0 ? malloc((size_t)size) : NULL;
+    bool ok = file && fread(file, 1, (size_t)size, f) == (size_t)size;
+    fclose(f);
+
+    ddsktx_texture_info tc = {0};
+    ok = ok && ddsktx_parse(&tc, file, (int)size, NULL);
+    bc3 = ok && bc3 && tc.format == DDSKTX_FORMAT_BC3;
+    ok = ok && (bc3 || tc.format == DDSKTX_FORMAT_RGBA8) && tc.num_mips == _mip_count(tc.width, tc.height) &&
+         (size_t)tc.size_bytes >= _mip_chain_size(tc.width, tc.height, tc.num_mips, bc3);
+    if (!ok) {
+        LOG_WARN("Ignoring broken texture cache entry %s\n", path);
+        free(file);
+        return false;
+    }
+    out->pixels = file;
+    out->desc = (sg_image_desc){
+        .width = tc.width,
+        .height = tc.height,
+        .pixel_format = bc3 ? SG_PIXELFORMAT_BC3_RGBA : SG_PIXELFORMAT_RGBA8,
+        .num_mipmaps = tc.num_mips,
+    };
+    for (int mip = 0; mip < tc.num_mips; mip++) {
+        ddsktx_sub_data sub;
+        ddsktx_get_sub(&tc, &sub, file, (int)size, 0, 0, mip);
+        out->desc.data.mip_levels[mip] = (sg_range){ sub.buff, sub.size_bytes };
+    }
+    return true;
+}
+
+//written under a temporary name first, a crash never leaves half an entry behind
+static void _texture_cache_write(const char* path, const sg_image_desc* desc) {
+    bool bc3 = desc->pixel_format == SG_PIXELFORMAT_BC3_RGBA;
+    DdsHeader header = {
+        .magic = { 'D', 'D', 'S', ' ' },
+        .size = 124,
+        //caps, height, width, pixelformat, mipmapcount and pitch or linearsize
+        .flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | (bc3 ? 0x80000 : 0x8),
+        .height = (uint32_t)desc->height,
+        .width = (uint32_t)desc->width,
+        .pitch = bc3 ? (uint32_t)desc->data.mip_levels[0].size : (uint32_t)desc->width * 4,
+        .mip_count = (uint32_t)desc->num_mipmaps,
+        .pf_size = 32,
+        .caps1 = 0x1000 | 0x8 | 0x400000, //texture, complex, mipmap
+    };
+    if (bc3) {
+        header.pf_flags = 0x4; //fourcc
+        memcpy(&header.pf_fourcc, "DXT5", 4);
+    } else {
+        header.pf_flags = 0x40 | 0x1; //rgb, alphapixels
+        header.pf_bits = 32;
+        uint32_t masks[4] = { 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000 };
+        memcpy(header.pf_masks, masks, sizeof(masks));
+    }
+    _le32_inplace(&header.size, (sizeof(DdsHeader) - sizeof(header.magic)) / sizeof(uint32_t));
+
+    //decode threads can write the same entry at once, each through its own file
+    static mt_atomic_int32 tmp_counter;
+    char tmp[512];
+    int32_t n = mt_atomic_increment(&tmp_counter);
+    if (snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, (int)n) >= (int)sizeof(tmp)) return;
+    FILE* f = fopen(tmp, "wb");
+    bool ok = f && fwrite(&header, sizeof(header), 1, f) == 1;
+    for (int mip = 0; ok && mip < desc->num_mipmaps; mip++) {
+        const sg_range* level = &desc->data.mip_levels[mip];
+        ok = fwrite(level->ptr, 1, level->size, f) == level->size;
+    }
+    if (f) fclose(f);
+    remove(path); //rename doesn't replace on windows
+    if (!ok || rename(tmp, path) != 0) {
+        LOG_WARN("Failed to write texture cache entry %s\n", path);
+        remove(tmp);
+    }
+}
+
+static bool _is_webp(const IoMemory* mem) {
     //webp magic is "RIFF" at [0] and "WEBP" at [8]
-    if (mem->size >= 12 &&
-        memcmp(mem->ptr,     "RIFF", 4) == 0 &&
-        memcmp(mem->ptr + 8, "WEBP", 4) == 0) {
+    return mem->size >= 12 && memcmp(mem->ptr, "RIFF", 4) == 0 && memcmp(mem->ptr + 8, "WEBP", 4) == 0;
+}
+
+//cache can be NULL, webp textures are then decoded every time
+static Result _decode_texture(TextureData* out, const IoMemory* mem, const TextureCache* cache) {
+    memset(out, 0, sizeof(TextureData));
+
+    if (_is_webp(mem)) {
+        char cache_path[512];
+        bool cached = cache && cache->dir && _texture_cache_path(cache_path, sizeof(cache_path), cache, mem);
+        if (cached && _texture_cache_read(out, cache_path, cache->bc3)) return RESULT_SUCCESS;
+
         int width, height;
-        unsigned char* rgba = twp_read_from_memory(
+        out->pixels = twp_read_from_memory(
             (void*)mem->ptr, (int)mem->size, &width, &height, twp_FORMAT_RGBA, 0);
-        if (!rgba) {
+        if (!out->pixels) {
             LOG_ERROR("Failed to decode WebP texture\n");
             return RESULT_UNKNOWN_ERROR;
         }
-        sg_image_desc desc = {
+        int num_mips = _mip_count(width, height);
+        unsigned char* chain = realloc(out->pixels, _mip_chain_size(width, height, num_mips, false));
+        if (!chain) {
+            free(out->pixels);
+            out->pixels = NULL;
+            return RESULT_NOMEM;
+        }
+        out->pixels = chain;
+        out->desc = (sg_image_desc){
             .width = width,
             .height = height,
             .pixel_format = SG_PIXELFORMAT_RGBA8,
-            .data.mip_levels[0] = (sg_range){ rgba, (size_t)(width * height * 4) },
         };
-        out->image = sg_make_image(&desc);
-        free(rgba);
-        out->view = sg_make_view(&(sg_view_desc){
-            .texture = out->image,
-        });
+        _generate_mips(chain, width, height, num_mips, &out->desc);
+        if (!cached) return RESULT_SUCCESS;
+        //d3d11 only creates block compressed textures with a top level made of whole blocks
+        if (cache->bc3 && width % 4 == 0 && height % 4 == 0) {
+            //what gets uploaded matches what later runs read back
+            unsigned char* blocks = malloc(_mip_chain_size(width, height, num_mips, true));
+            if (blocks) {
+                _bc3_chain(blocks, &out->desc);
+                free(chain);
+                out->pixels = blocks;
+            }
+        }
+        _texture_cache_write(cache_path, &out->desc);
         return RESULT_SUCCESS;
     }
 
     ddsktx_texture_info tc = {0};
     if (ddsktx_parse(&tc, (const void*)mem->ptr, (int)mem->size, NULL)) {
-        sg_image_desc desc = {0};
-        desc.num_mipmaps = tc.num_mips;
-        desc.num_slices = tc.num_layers;
-        desc.pixel_format = dds_to_sg_pixelformt(tc.format);
-        desc.width = tc.width;
-        desc.height = tc.height;
-        desc.type = dds_to_sg_image_type(tc.flags);
+        sg_image_desc* desc = &out->desc;
+        desc->num_mipmaps = tc.num_mips;
+        desc->num_slices = tc.num_layers;
+        desc->pixel_format = dds_to_sg_pixelformt(tc.format);
+        desc->width = tc.width;
+        desc->height = tc.height;
+        desc->type = dds_to_sg_image_type(tc.flags);
 
         for (int mip = 0; mip < tc.num_mips; mip++) {
             ddsktx_sub_data sub_data;
             ddsktx_get_sub(&tc, &sub_data, (const void*)mem->ptr, (int)mem->size, 0, 0, mip);
-            void* ptr = arena_alloc(alloc, sub_data.size_bytes, 0);
-            assert(ptr);
-            memcpy(ptr, sub_data.buff, sub_data.size_bytes);
-            desc.data.mip_levels[mip] = (sg_range){ptr, sub_data.size_bytes};
-        }
-        if (desc.pixel_format != SG_PIXELFORMAT_NONE && !sg_query_pixelformat(desc.pixel_format).sample) {
-            LOG_ERROR("Pixel format %d not supported by GPU (compressed texture not available?)\n", desc.pixel_format);
-            return RESULT_UNKNOWN_ERROR;
+            desc->data.mip_levels[mip] = (sg_range){sub_data.buff, sub_data.size_bytes};
         }
-        out->image = sg_make_image(&desc);
+        return RESULT_SUCCESS;
+    }
+    return RESULT_UNKNOWN_ERROR;
+}
+
+static Result _create_texture(Texture* out, TextureData* data) {
+    sg_pixel_format fmt = data->desc.pixel_format;
+    Result result = RESULT_SUCCESS;
+    if (fmt != SG_PIXELFORMAT_NONE && !sg_query_pixelformat(fmt).sample) {
+        LOG_ERROR("Pixel format %d not supported by GPU (compressed texture not available?)\n", fmt);
+        result = RESULT_UNKNOWN_ERROR;
+    } else {
+        out->image = sg_make_image(&data->desc);
         out->view = sg_make_view(&(sg_view_desc) {
             .texture = out->image,
         });
-        return RESULT_SUCCESS;
     }
-    return RESULT_UNKNOWN_ERROR;
+    free(data->pixels);
+    data->pixels = NULL;
+    return result;
+}
+
+Result load_texture(Texture* out, const IoMemory* mem, const TextureCache* cache) {
+    TextureData data;
+    Result result = _decode_texture(&data, mem, cache);
+    if (result != RESULT_SUCCESS) return result;
+    return _create_texture(out, &data);
 }
 
 //--MODEL--------------------------------------------------------------------------------
@@ -227,44 +922,526 @@ sg_vertex_layout_state skinned_vtx_layout() {
     };
 }
 
+//swaps the first three attributes for the VertexCompact ones, the instance stream stays as is
+static sg_vertex_layout_state _format_vtx_layout(sg_vertex_layout_state layout, uint8_t format) {
+    if (format & MESH_COMPACT) {
+        layout.buffers[0].stride = sizeof(VertexCompact);
+        layout.attrs[0].format = SG_VERTEXFORMAT_SHORT4N;
+        layout.attrs[1].format = SG_VERTEXFORMAT_SHORT2N;
+        layout.attrs[2].format = SG_VERTEXFORMAT_HALF2;
+        layout.attrs[0].offset = offsetof(VertexCompact, pos);
+        layout.attrs[1].offset = offsetof(VertexCompact, nrm);
+        layout.attrs[2].offset = offsetof(VertexCompact, uv);
+    }
+    return layout;
+}
 
-Result load_model(ArenaAlloc *alloc, Model* out, const IoMemory* mem) {
-    assert(mem && mem->size > sizeof(iqmheader));
-    iqmheader* header = (iqmheader*)mem->ptr;
+sg_vertex_layout_state instanced_vtx_layout() {
+    return (sg_vertex_layout_state) {
+        .buffers = {
+            [0].stride = sizeof(VertexPNT),
+            [1] = {.stride = sizeof(HMM_Mat4), .step_func = SG_VERTEXSTEP_PER_INSTANCE},
+        },
+        .attrs = {
+            [0] = {.buffer_index = 0, .format = SG_VERTEXFORMAT_FLOAT3},
+            [1] = {.buffer_index = 0, .format = SG_VERTEXFORMAT_FLOAT3},
+            [2] = {.buffer_index = 0, .format = SG_VERTEXFORMAT_FLOAT2},
+            [3] = {.buffer_index = 1, .format = SG_VERTEXFORMAT_FLOAT4},
+            [4] = {.buffer_index = 1, .format = SG_VERTEXFORMAT_FLOAT4},
+            [5] = {.buffer_index = 1, .format = SG_VERTEXFORMAT_FLOAT4},
+            [6] = {.buffer_index = 1, .format = SG_VERTEXFORMAT_FLOAT4},
+        }
+    };
+}
+
+
+//cpu side of a model, filled without touching sokol_gfx so it can run on a loader thread
+typedef struct ModelData {
+    Bounds bounds;
+    float qcenter[3], qextent[3]; //quantization box of MESH_COMPACT meshes
+    int meshes_count;
+    bool has_skin;
+    struct {
+        void* verts;   //VertexPNT, or VertexCompact with MESH_COMPACT
+        VertexSkin* skin;
+        void* indices; //uint32_t, or uint16_t with MESH_INDEX16
+        uint32_t num_verts;
+        uint32_t num_indices;
+        uint8_t format;
+    } meshes[MODEL_MAX_MESHES];
+} ModelData;
+
+static inline size_t _vertex_size(uint8_t format) {
+    return (format & MESH_COMPACT) ? sizeof(VertexCompact) : sizeof(VertexPNT);
+}
+
+static inline size_t _index_size(uint8_t format) {
+    return (format & MESH_INDEX16) ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+static int16_t _snorm16(float x) {
+    x = HMM_Clamp(-1.0f, x, 1.0f) * 32767.0f;
+    return (int16_t)(x >= 0.0f ? x + 0.5f : x - 0.5f);
+}
+
+//unit vector onto the octahedron, the lower half folded over the diagonals.
+//oct_decode in shaders/common.inc.glsl turns it back
+static void _oct_encode(HMM_Vec3 n, int16_t out[2]) {
+    float sum = fabsf(n.X) + fabsf(n.Y) + fabsf(n.Z);
+    float x = sum > 0.0f ? n.X / sum : 0.0f;
+    float y = sum > 0.0f ? n.Y / sum : 0.0f;
+    if (n.Z < 0.0f) {
+        float fx = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        y = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = fx;
+    }
+    out[0] = _snorm16(x);
+    out[1] = _snorm16(y);
+}
+
+static uint16_t _half(float f) {
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    uint16_t sign = (uint16_t)((x >> 16) & 0x8000);
+    int exp = (int)((x >> 23) & 0xff) - 127 + 15;
+    uint32_t mant = x & 0x7fffff;
+    if (exp <= 0) {
+        //subnormal, or zero below that
+        if (exp < -10) return sign;
+        mant |= 0x800000;
+        uint32_t shift = (uint32_t)(14 - exp);
+        uint16_t h = (uint16_t)(mant >> shift);
+        if ((mant >> (shift - 1)) & 1) h++;
+        return sign | h;
+    }
+    if (exp >= 31) return sign | 0x7c00;
+    uint16_t h = (uint16_t)(sign | (exp << 10) | (mant >> 13));
+    if (mant & 0x1000) h++; //a carry into the exponent still rounds right
+    return h;
+}
+
+//converts in place, both formats are at most as big as what they replace. indices always shrink
+//when they fit, vertices only when asked for and the model has no skin
+static void _compact_model(ModelData* data, bool compact_verts) {
+    for (int m = 0; m < data->meshes_count; m++) {
+        if (data->meshes[m].num_verts > 65536) continue;
+        uint32_t* src = data->meshes[m].indices;
+        uint16_t* dst = data->meshes[m].indices;
+        for (uint32_t i = 0; i < data->meshes[m].num_indices; i++) dst[i] = (uint16_t)src[i];
+        data->meshes[m].format |= MESH_INDEX16;
+    }
+    if (!compact_verts || data->has_skin || data->meshes_count == 0) return;
+
+    //one box for the whole model, so all its meshes share Model.dequant
+    HMM_Vec3 mn = HMM_V3(FLT_MAX, FLT_MAX, FLT_MAX), mx = HMM_V3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (int m = 0; m < data->meshes_count; m++) {
+        const VertexPNT* verts = data->meshes[m].verts;
+        for (uint32_t v = 0; v < data->meshes[m].num_verts; v++) {
+            HMM_Vec3 p = verts[v].pos;
+            mn = HMM_V3(HMM_MIN(mn.X, p.X), HMM_MIN(mn.Y, p.Y), HMM_MIN(mn.Z, p.Z));
+            mx = HMM_V3(HMM_MAX(mx.X, p.X), HMM_MAX(mx.Y, p.Y), HMM_MAX(mx.Z, p.Z));
+        }
+    }
+    if (mn.X > mx.X) return;
+    HMM_Vec3 c = HMM_MulV3F(HMM_AddV3(mn, mx), 0.5f);
+    HMM_Vec3 e = HMM_MulV3F(HMM_SubV3(mx, mn), 0.5f);
+    //flat models (planes) still need an invertible box for the normals
+    float min_extent = HMM_MAX(HMM_MAX(HMM_MAX(e.X, e.Y), e.Z) * 1e-3f, 1e-6f);
+    e = HMM_V3(HMM_MAX(e.X, min_extent), HMM_MAX(e.Y, min_extent), HMM_MAX(e.Z, min_extent));
+    memcpy(data->qcenter, c.Elements, sizeof(data->qcenter));
+    memcpy(data->qextent, e.Elements, sizeof(data->qextent));
+
+    for (int m = 0; m < data->meshes_count; m++) {
+        const VertexPNT* src = data->meshes[m].verts;
+        VertexCompact* dst = data->meshes[m].verts;
+        for (uint32_t v = 0; v < data->meshes[m].num_verts; v++) {
+            VertexPNT in = src[v]; //dst[v] overlaps src[v / 2]
+            HMM_Vec3 p = HMM_DivV3(HMM_SubV3(in.pos, c), e);
+            dst[v] = (VertexCompact){
+                .pos = { _snorm16(p.X), _snorm16(p.Y), _snorm16(p.Z), 0 },
+                .uv = { _half(in.uv.X), _half(in.uv.Y) },
+            };
+            _oct_encode(HMM_DivV3(in.nrm, e), dst[v].nrm);
+        }
+        data->meshes[m].format |= MESH_COMPACT;
+    }
+}
+
+//average cache miss ratio: vertices transformed per triangle on a fifo cache of MODEL_VCACHE_SIZE
+//entries, 3 with no reuse at all, around 0.6 for a well ordered regular grid. stamp[num_verts]
+//is scratch, a vertex is cached while fewer than MODEL_VCACHE_SIZE misses came after its own
+static float _mesh_acmr(const uint32_t* indices, uint32_t num_indices, uint32_t* stamp, uint32_t num_verts) {
+    if (num_indices < 3) return 0.0f;
+    memset(stamp, 0, sizeof(uint32_t) * num_verts);
+    uint32_t misses = 0;
+    for (uint32_t i = 0; i < num_indices; i++) {
+        uint32_t v = indices[i];
+        if (stamp[v] && misses - stamp[v] < MODEL_VCACHE_SIZE) continue;
+        stamp[v] = ++misses;
+    }
+    return (float)misses / (float)(num_indices / 3);
+}
+
+//tipsify (Sander, Nehab, Barczak 2007): emits the fans around the vertex that stays cached the
+//longest, and restarts from the most recent dead end when none is left. the first triangle after
+//each restart begins a cluster, returns how many there are
+static uint32_t _mesh_tipsify(uint32_t* out, uint32_t* clusters, const uint32_t* indices, uint32_t num_indices, uint32_t num_verts, ArenaAlloc* scratch) {
+    uint32_t num_tris = num_indices / 3;
+    uint32_t* adj_ofs = arena_alloc(scratch, sizeof(uint32_t) * (num_verts + 1), alignof(uint32_t));
+    uint32_t* adj = arena_alloc(scratch, sizeof(uint32_t) * num_indices, alignof(uint32_t));
+    uint32_t* live = arena_alloc(scratch, sizeof(uint32_t) * num_verts, alignof(uint32_t));
+    uint32_t* stamp = arena_alloc(scratch, sizeof(uint32_t) * num_verts, alignof(uint32_t));
+    uint32_t* dead = arena_alloc(scratch, sizeof(uint32_t) * num_indices, alignof(uint32_t));
+    uint8_t* emitted = arena_alloc(scratch, num_tris, 1);
+    if (!adj_ofs || !adj || !live || !stamp || !dead || !emitted) return 0;
+
+    //triangles around each vertex, live counts the ones not emitted yet
+    memset(live, 0, sizeof(uint32_t) * num_verts);
+    for (uint32_t i = 0; i < num_indices; i++) live[indices[i]]++;
+    adj_ofs[0] = 0;
+    for (uint32_t v = 0; v < num_verts; v++) {
+        adj_ofs[v + 1] = adj_ofs[v] + live[v];
+        stamp[v] = adj_ofs[v];
+    }
+    for (uint32_t i = 0; i < num_indices; i++) adj[stamp[indices[i]]++] = i / 3;
+    memset(stamp, 0, sizeof(uint32_t) * num_verts);
+    memset(emitted, 0, num_tris);
+
+    uint32_t time = MODEL_VCACHE_SIZE + 1, cursor = 0, num_dead = 0, written = 0, num_clusters = 1;
+    clusters[0] = 0;
+    uint32_t fan = 0;
+    while (fan != UINT32_MAX) {
+        uint32_t fan_begin = written;
+        for (uint32_t a = adj_ofs[fan]; a < adj_ofs[fan + 1]; a++) {
+            uint32_t t = adj[a];
+            if (emitted[t]) continue;
+            emitted[t] = 1;
+            for (int k = 0; k < 3; k++) {
+                uint32_t v = indices[t * 3 + k];
+                out[written++] = v;
+                dead[num_dead++] = v;
+                live[v]--;
+                if (time - stamp[v] > MODEL_VCACHE_SIZE) stamp[v] = time++;
+            }
+        }
+
+        //next fan: a vertex of this one that is still cached after its remaining triangles
+        uint32_t next = UINT32_MAX;
+        uint32_t best = 0;
+        for (uint32_t i = fan_begin; i < written; i++) {
+            uint32_t v = out[i];
+            if (!live[v]) continue;
+            uint32_t age = time - stamp[v];
+            uint32_t priority = age + 2 * live[v] <= MODEL_VCACHE_SIZE ? age : 0;
+            if (next == UINT32_MAX || priority > best) {
+                next = v;
+                best = priority;
+            }
+        }
+        if (next == UINT32_MAX) {
+            while (num_dead > 0 && next == UINT32_MAX) {
+                uint32_t v = dead[--num_dead];
+                if (live[v]) next = v;
+            }
+            for (; next == UINT32_MAX && cursor < num_verts; cursor++) {
+                if (live[cursor]) next = cursor;
+            }
+            if (next != UINT32_MAX && written / 3 > clusters[num_clusters - 1]) clusters[num_clusters++] = written / 3;
+        }
+        fan = next;
+    }
+    assert(written == num_indices);
+    return num_clusters;
+}
+
+typedef struct ClusterKey {
+    float key;
+    uint32_t cluster;
+} ClusterKey;
+
+static int _cluster_key_cmp(const void* a, const void* b) {
+    const ClusterKey* ca = a;
+    const ClusterKey* cb = b;
+    if (ca->key != cb->key) return ca->key > cb->key ? -1 : 1;
+    return ca->cluster < cb->cluster ? -1 : 1;
+}
 
-    {
-        uint32_t* fields = &header->version;
-        int n = (sizeof(iqmheader) - sizeof(header->magic)) / sizeof(uint32_t);
-        for (int i = 0; i < n; i++) fields[i] = tole32(fields[i]);
+//approximate front to back order (same paper): a cluster facing away from the mesh center covers
+//the ones behind it from most directions it can be seen from, so those go first. normals come
+//from the vertices, the winding isn't reliable across exporters
+static bool _mesh_sort_clusters(uint32_t* out, const uint32_t* indices, uint32_t num_indices, uint32_t* clusters, uint32_t num_clusters, const VertexPNT* verts, ArenaAlloc* scratch) {
+    ClusterKey* keys = arena_alloc(scratch, sizeof(ClusterKey) * num_clusters, alignof(ClusterKey));
+    if (!keys) return false;
+    uint32_t num_tris = num_indices / 3;
+
+    HMM_Vec3 center = HMM_V3(0.0f, 0.0f, 0.0f);
+    float total_area = 0.0f;
+    for (uint32_t t = 0; t < num_tris; t++) {
+        HMM_Vec3 a = verts[indices[t * 3]].pos, b = verts[indices[t * 3 + 1]].pos, c = verts[indices[t * 3 + 2]].pos;
+        float area = HMM_LenV3(HMM_Cross(HMM_SubV3(b, a), HMM_SubV3(c, a)));
+        center = HMM_AddV3(center, HMM_MulV3F(HMM_AddV3(HMM_AddV3(a, b), c), area / 3.0f));
+        total_area += area;
     }
+    if (total_area <= 0.0f) return false;
+    center = HMM_MulV3F(center, 1.0f / total_area);
+
+    for (uint32_t k = 0; k < num_clusters; k++) {
+        uint32_t end = k + 1 < num_clusters ? clusters[k + 1] : num_tris;
+        HMM_Vec3 centroid = HMM_V3(0.0f, 0.0f, 0.0f), normal = HMM_V3(0.0f, 0.0f, 0.0f);
+        float area_sum = 0.0f;
+        for (uint32_t t = clusters[k]; t < end; t++) {
+            const VertexPNT* a = &verts[indices[t * 3]];
+            const VertexPNT* b = &verts[indices[t * 3 + 1]];
+            const VertexPNT* c = &verts[indices[t * 3 + 2]];
+            float area = HMM_LenV3(HMM_Cross(HMM_SubV3(b->pos, a->pos), HMM_SubV3(c->pos, a->pos)));
+            centroid = HMM_AddV3(centroid, HMM_MulV3F(HMM_AddV3(HMM_AddV3(a->pos, b->pos), c->pos), area / 3.0f));
+            normal = HMM_AddV3(normal, HMM_MulV3F(HMM_AddV3(HMM_AddV3(a->nrm, b->nrm), c->nrm), area));
+            area_sum += area;
+        }
+        float len = HMM_LenV3(normal);
+        keys[k].key = area_sum > 0.0f && len > 0.0f ?
+            HMM_DotV3(HMM_SubV3(HMM_MulV3F(centroid, 1.0f / area_sum), center), HMM_MulV3F(normal, 1.0f / len)) : 0.0f;
+        keys[k].cluster = k;
+    }
+    qsort(keys, num_clusters, sizeof(ClusterKey), _cluster_key_cmp);
+
+    uint32_t written = 0;
+    for (uint32_t k = 0; k < num_clusters; k++) {
+        uint32_t c = keys[k].cluster;
+        uint32_t end = c + 1 < num_clusters ? clusters[c + 1] : num_tris;
+        memcpy(&out[written], &indices[clusters[c] * 3], sizeof(uint32_t) * (end - clusters[c]) * 3);
+        written += (end - clusters[c]) * 3;
+    }
+    return true;
+}
 
+//renumbers vertices in the order the triangles first use them, so fetches walk the buffer
+//forward. unused vertices keep their relative order at the end
+static bool _mesh_remap_vertices(uint32_t* indices, uint32_t num_indices, VertexPNT* verts, VertexSkin* skin, uint32_t num_verts, ArenaAlloc* scratch) {
+    uint32_t* remap = arena_alloc(scratch, sizeof(uint32_t) * num_verts, alignof(uint32_t));
+    VertexPNT* old_verts = arena_alloc(scratch, sizeof(VertexPNT) * num_verts, alignof(VertexPNT));
+    VertexSkin* old_skin = skin ? arena_alloc(scratch, sizeof(VertexSkin) * num_verts, alignof(VertexSkin)) : NULL;
+    if (!remap || !old_verts || (skin && !old_skin)) return false;
+
+    memset(remap, 0xff, sizeof(uint32_t) * num_verts);
+    uint32_t next = 0;
+    for (uint32_t i = 0; i < num_indices; i++) {
+        if (remap[indices[i]] == UINT32_MAX) remap[indices[i]] = next++;
+        indices[i] = remap[indices[i]];
+    }
+    for (uint32_t v = 0; v < num_verts; v++) {
+        if (remap[v] == UINT32_MAX) remap[v] = next++;
+    }
+
+    memcpy(old_verts, verts, sizeof(VertexPNT) * num_verts);
+    for (uint32_t v = 0; v < num_verts; v++) verts[remap[v]] = old_verts[v];
+    if (skin) {
+        memcpy(old_skin, skin, sizeof(VertexSkin) * num_verts);
+        for (uint32_t v = 0; v < num_verts; v++) skin[remap[v]] = old_skin[v];
+    }
+    return true;
+}
+
+//scratch _optimize_model takes at most for a mesh of this size, given back after each mesh
+static size_t _optimize_scratch_size(size_t num_verts, size_t num_indices) {
+    return num_verts * (sizeof(VertexPNT) + sizeof(VertexSkin) + 4 * sizeof(uint32_t)) +
+           num_indices * 6 * sizeof(uint32_t) + 16 * 16;
+}
+
+//runs on the decoded iqm data, before _compact_model. only the order changes, the triangles and
+//vertices stay the same
+static void _optimize_model(ModelData* data, ArenaAlloc* scratch) {
+    for (int m = 0; m < data->meshes_count; m++) {
+        uint32_t* indices = data->meshes[m].indices;
+        uint32_t num_indices = data->meshes[m].num_indices;
+        uint32_t num_verts = data->meshes[m].num_verts;
+        if (num_indices < 6) continue;
+
+        size_t mark = scratch->offset;
+        uint32_t* stamp = arena_alloc(scratch, sizeof(uint32_t) * num_verts, alignof(uint32_t));
+        uint32_t* tipsified = arena_alloc(scratch, sizeof(uint32_t) * num_indices, alignof(uint32_t));
+        uint32_t* sorted = arena_alloc(scratch, sizeof(uint32_t) * num_indices, alignof(uint32_t));
+        uint32_t* clusters = arena_alloc(scratch, sizeof(uint32_t) * (num_indices / 3 + 1), alignof(uint32_t));
+        uint32_t num_clusters = stamp && tipsified && sorted && clusters ?
+            _mesh_tipsify(tipsified, clusters, indices, num_indices, num_verts, scratch) : 0;
+        float before = 0.0f, after = 0.0f;
+        if (num_clusters > 0) {
+            before = _mesh_acmr(indices, num_indices, stamp, num_verts);
+            after = _mesh_acmr(tipsified, num_indices, stamp, num_verts);
+            //the cluster order is only worth a little cache efficiency
+            if (_mesh_sort_clusters(sorted, tipsified, num_indices, clusters, num_clusters, data->meshes[m].verts, scratch)) {
+                float sorted_acmr = _mesh_acmr(sorted, num_indices, stamp, num_verts);
+                if (sorted_acmr <= after * 1.05f) {
+                    tipsified = sorted;
+                    after = sorted_acmr;
+                }
+            }
+            if (after <= before) memcpy(indices, tipsified, sizeof(uint32_t) * num_indices);
+            else after = before;
+        }
+        scratch->offset = mark;
+
+        bool remapped = num_clusters > 0 &&
+            _mesh_remap_vertices(indices, num_indices, data->meshes[m].verts, data->has_skin ? data->meshes[m].skin : NULL, num_verts, scratch);
+        scratch->offset = mark;
+        if (!remapped) {
+            LOG_WARN("Mesh %d is too big to optimize in the scratch arena\n", m);
+            continue;
+        }
+        LOG_INFO("Mesh %d: acmr %.3f -> %.3f, %u clusters\n", m, before, after, num_clusters);
+    }
+}
+
+//byte order of the vertex and index arrays, VertexCompact is made of 16 bit fields
+static void _le_mesh_inplace(void* verts, uint32_t num_verts, void* indices, uint32_t num_indices, uint8_t format) {
+    if (format & MESH_COMPACT) {
+        VertexCompact* v = verts;
+        for (uint32_t i = 0; i < num_verts; i++) {
+            _le16_inplace(v[i].pos, 4);
+            _le16_inplace(v[i].nrm, 2);
+            _le16_inplace(v[i].uv, 2);
+        }
+    } else {
+        _le32_inplace(verts, num_verts * sizeof(VertexPNT) / sizeof(uint32_t));
+    }
+    if (format & MESH_INDEX16) _le16_inplace(indices, num_indices);
+    else _le32_inplace(indices, num_indices);
+}
+
+//cooked models, see cook_model. little endian, offsets are from the start of the file and 16
+//byte aligned, so the vertex and index ranges can go to sg_make_buffer straight from the file
+#define MODEL_COOKED_SKINNED 1u
+#define MODEL_COOKED_ANIMS 2u      //skeleton and clips as quantized keys, see load_anims
+#define MODEL_COOKED_SCALE_KEYS 4u //some joint animates its scale
+
+typedef struct CookedMesh {
+    uint32_t num_verts;
+    uint32_t num_indices;
+    uint32_t ofs_verts;   //VertexPNT or VertexCompact [num_verts]
+    uint32_t ofs_skin;    //VertexSkin[num_verts], only with MODEL_COOKED_SKINNED
+    uint32_t ofs_indices; //uint32_t or uint16_t [num_indices]
+    uint32_t format;      //MESH_* bits
+} CookedMesh;
+
+typedef struct CookedAnim {
+    char name[MAX_NAME_LEN];
+    uint32_t first_frame;
+    uint32_t num_frames;
+    float framerate;
+} CookedAnim;
+
+typedef struct CookedModelHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t num_meshes;
+    uint32_t file_size;
+    Bounds bounds;
+    float qcenter[3], qextent[3];
+    CookedMesh meshes[MODEL_MAX_MESHES];
+    //only with MODEL_COOKED_ANIMS
+    uint32_t num_joints;
+    uint32_t num_frames;
+    uint32_t num_anims;
+    uint32_t ofs_parents;      //int32_t[num_joints], parents come before their children
+    uint32_t ofs_bind;         //HMM_Mat4[num_joints], bind pose with the parents applied
+    uint32_t ofs_inverse_bind; //HMM_Mat4[num_joints]
+    uint32_t ofs_ranges;       //AnimJointRange[num_joints]
+    uint32_t ofs_anims;        //CookedAnim[num_anims]
+    uint32_t ofs_keys;         //AnimKey[num_frames * num_joints]
+    uint32_t ofs_scale_keys;   //uint16_t[3 * num_frames * num_joints], only with MODEL_COOKED_SCALE_KEYS
+} CookedModelHeader;
+
+bool model_is_cooked(const IoMemory* mem) {
+    return mem && mem->ptr && mem->size >= sizeof(CookedModelHeader) &&
+           memcmp(mem->ptr, MODEL_COOKED_MAGIC, sizeof(((CookedModelHeader*)0)->magic)) == 0;
+}
+
+static inline size_t _align16(size_t x) {
+    return (x + 15) & ~(size_t)15;
+}
+
+static bool _cooked_range(const IoMemory* mem, uint32_t ofs, size_t size) {
+    return ofs % 16 == 0 && ofs <= mem->size && size <= mem->size - ofs;
+}
+
+//the header is read from a copy, load_anims may take the same mapping after it
+static Result _decode_cooked_model(ModelData* out, const IoMemory* mem) {
+    CookedModelHeader copy;
+    memcpy(&copy, mem->ptr, sizeof(CookedModelHeader));
+    CookedModelHeader* header = &copy;
+    _le32_inplace(&header->version, (sizeof(CookedModelHeader) - sizeof(header->magic)) / sizeof(uint32_t));
+    if (header->version != MODEL_COOKED_VERSION || header->num_meshes > MODEL_MAX_MESHES) {
+        LOG_ERROR("Unsupported cooked model (version %u, %u meshes)\n", header->version, header->num_meshes);
+        return RESULT_INVALID_PARAMS;
+    }
+
+    memset(out, 0, sizeof(ModelData));
+    out->bounds = header->bounds;
+    memcpy(out->qcenter, header->qcenter, sizeof(out->qcenter));
+    memcpy(out->qextent, header->qextent, sizeof(out->qextent));
+    out->meshes_count = (int)header->num_meshes;
+    out->has_skin = (header->flags & MODEL_COOKED_SKINNED) != 0;
+
+    for (int m = 0; m < out->meshes_count; m++) {
+        const CookedMesh* cm = &header->meshes[m];
+        uint8_t format = (uint8_t)cm->format;
+        if (cm->format >= MESH_FORMAT_COUNT || ((format & MESH_COMPACT) && out->has_skin) ||
+            !_cooked_range(mem, cm->ofs_verts, cm->num_verts * _vertex_size(format)) ||
+            !_cooked_range(mem, cm->ofs_indices, cm->num_indices * _index_size(format)) ||
+            (out->has_skin && !_cooked_range(mem, cm->ofs_skin, cm->num_verts * sizeof(VertexSkin)))) {
+            LOG_ERROR("Cooked model mesh %d is out of bounds\n", m);
+            return RESULT_INVALID_PARAMS;
+        }
+        out->meshes[m].verts = mem->ptr + cm->ofs_verts;
+        out->meshes[m].skin = out->has_skin ? (VertexSkin*)(mem->ptr + cm->ofs_skin) : NULL;
+        out->meshes[m].indices = mem->ptr + cm->ofs_indices;
+        out->meshes[m].num_verts = cm->num_verts;
+        out->meshes[m].num_indices = cm->num_indices;
+        out->meshes[m].format = format;
+        _le_mesh_inplace(out->meshes[m].verts, cm->num_verts, out->meshes[m].indices, cm->num_indices, format);
+    }
+    return RESULT_SUCCESS;
+}
+
+size_t model_decode_size(const IoMemory* mem, uint32_t flags) {
+    if (!mem->ptr || mem->size <= sizeof(iqmheader) || model_is_cooked(mem)) return 0;
+    const iqmheader* header = (const iqmheader*)mem->ptr;
+    size_t num_verts = tole32(header->num_vertexes);
+    size_t num_tris = tole32(header->num_triangles);
+    return num_verts * (sizeof(VertexPNT) + sizeof(VertexSkin)) + num_tris * 3 * sizeof(uint32_t) +
+           (MODEL_MAX_MESHES + 2) * 16 + ((flags & MODEL_LOAD_OPTIMIZE) ? _optimize_scratch_size(num_verts, num_tris * 3) : 0);
+}
+
+//cooked models come as they were cooked, flags only apply to iqm
+static Result _decode_model(ArenaAlloc *alloc, ModelData* out, const IoMemory* mem, uint32_t flags) {
+    if (model_is_cooked(mem)) return _decode_cooked_model(out, mem);
+    assert(mem && mem->size > sizeof(iqmheader));
+    iqmheader* header = (iqmheader*)mem->ptr;
+
+    _le32_inplace(&header->version, (sizeof(iqmheader) - sizeof(header->magic)) / sizeof(uint32_t));
     if (header->num_vertexarrays) {
-        uint32_t* p = (uint32_t*)(mem->ptr + header->ofs_vertexarrays);
-        for (unsigned int i = 0; i < header->num_vertexarrays * sizeof(iqmvertexarray) / sizeof(uint32_t); i++) p[i] = tole32(p[i]);
+        _le32_inplace(mem->ptr + header->ofs_vertexarrays, header->num_vertexarrays * sizeof(iqmvertexarray) / sizeof(uint32_t));
     }
     if (header->num_triangles) {
-        uint32_t* p = (uint32_t*)(mem->ptr + header->ofs_triangles);
-        for (unsigned int i = 0; i < header->num_triangles * sizeof(iqmtriangle) / sizeof(uint32_t); i++) p[i] = tole32(p[i]);
+        _le32_inplace(mem->ptr + header->ofs_triangles, header->num_triangles * sizeof(iqmtriangle) / sizeof(uint32_t));
     }
     if (header->num_meshes) {
-        uint32_t* p = (uint32_t*)(mem->ptr + header->ofs_meshes);
-        for (unsigned int i = 0; i < header->num_meshes * sizeof(iqmmesh) / sizeof(uint32_t); i++) p[i] = tole32(p[i]);
+        _le32_inplace(mem->ptr + header->ofs_meshes, header->num_meshes * sizeof(iqmmesh) / sizeof(uint32_t));
     }
     if (header->num_joints) {
-        uint32_t* p = (uint32_t*)(mem->ptr + header->ofs_joints);
-        for (unsigned int i = 0; i < header->num_joints * sizeof(iqmjoint) / sizeof(uint32_t); i++) p[i] = tole32(p[i]);
+        _le32_inplace(mem->ptr + header->ofs_joints, header->num_joints * sizeof(iqmjoint) / sizeof(uint32_t));
     }
     if (header->ofs_bounds) {
-        uint32_t* p = (uint32_t*)(mem->ptr + header->ofs_bounds);
-        for (unsigned int i = 0; i < header->num_frames * sizeof(iqmbounds) / sizeof(uint32_t); i++) p[i] = tole32(p[i]);
+        _le32_inplace(mem->ptr + header->ofs_bounds, header->num_frames * sizeof(iqmbounds) / sizeof(uint32_t));
     }
 
     iqmmesh* imesh = (iqmmesh*)(mem->ptr + header->ofs_meshes);
     iqmtriangle* tri = (iqmtriangle*)(mem->ptr + header->ofs_triangles);
     iqmvertexarray* va = (iqmvertexarray*)(mem->ptr + header->ofs_vertexarrays);
 
-    memset(out, 0, sizeof(Model));
-    out->meshes_count = header->num_meshes > 4 ? 4 : (int)header->num_meshes;
+    memset(out, 0, sizeof(ModelData));
+    out->meshes_count = header->num_meshes > MODEL_MAX_MESHES ? MODEL_MAX_MESHES : (int)header->num_meshes;
 
     uint32_t total_verts = header->num_vertexes;
     VertexPNT* vertices = arena_alloc(alloc, sizeof(VertexPNT) * total_verts, alignof(VertexPNT));
@@ -273,13 +1450,12 @@ Result load_model(ArenaAlloc *alloc, Model* out, const IoMemory* mem) {
     memset(vertices, 0, sizeof(VertexPNT) * total_verts);
     memset(skin, 0, sizeof(VertexSkin) * total_verts);
 
-    bool has_skin = false;
     for (unsigned int i = 0; i < header->num_vertexarrays; i++) {
         switch (va[i].type) {
         case IQM_POSITION: {
             assert(va[i].format == IQM_FLOAT && va[i].size == 3);
             float* positions = (float*)(mem->ptr + va[i].offset);
-            { uint32_t* p = (uint32_t*)positions; for (unsigned int k = 0; k < 3 * total_verts; k++) p[k] = tole32(p[k]); }
+            _le32_inplace(positions, 3 * total_verts);
             for (unsigned int v = 0; v < total_verts; v++) {
                 vertices[v].pos = HMM_V3(positions[v*3+0], positions[v*3+1], positions[v*3+2]);
             }
@@ -287,7 +1463,7 @@ Result load_model(ArenaAlloc *alloc, Model* out, const IoMemory* mem) {
         case IQM_NORMAL: {
             assert(va[i].format == IQM_FLOAT && va[i].size == 3);
             float* normals = (float*)(mem->ptr + va[i].offset);
-            { uint32_t* p = (uint32_t*)normals; for (unsigned int k = 0; k < 3 * total_verts; k++) p[k] = tole32(p[k]); }
+            _le32_inplace(normals, 3 * total_verts);
             for (unsigned int v = 0; v < total_verts; v++) {
                 vertices[v].nrm = HMM_V3(normals[v*3+0], normals[v*3+1], normals[v*3+2]);
             }
@@ -295,14 +1471,14 @@ Result load_model(ArenaAlloc *alloc, Model* out, const IoMemory* mem) {
         case IQM_TEXCOORD: {
             assert(va[i].format == IQM_FLOAT && va[i].size == 2);
             float* uvs = (float*)(mem->ptr + va[i].offset);
-            { uint32_t* p = (uint32_t*)uvs; for (unsigned int k = 0; k < 2 * total_verts; k++) p[k] = tole32(p[k]); }
+            _le32_inplace(uvs, 2 * total_verts);
             for (unsigned int v = 0; v < total_verts; v++) {
                 vertices[v].uv = HMM_V2(uvs[v*2+0], uvs[v*2+1]);
             }
         } break;
         case IQM_BLENDINDEXES: {
             assert(va[i].format == IQM_UBYTE && va[i].size == 4);
-            has_skin = true;
+            out->has_skin = true;
             uint8_t* bi = (uint8_t*)(mem->ptr + va[i].offset);
             for (unsigned int v = 0; v < total_verts; v++) {
                 skin[v].indices[0] = bi[v*4+0]; skin[v].indices[1] = bi[v*4+1];
@@ -320,59 +1496,398 @@ Result load_model(ArenaAlloc *alloc, Model* out, const IoMemory* mem) {
         }
     }
 
-    if (header->ofs_bounds) {
-        iqmbounds* bounds = (iqmbounds*)(mem->ptr + header->ofs_bounds);
-        memcpy(out->bounds.min, bounds->bbmin, sizeof(float) * 3);
-        memcpy(out->bounds.max, bounds->bbmax, sizeof(float) * 3);
-        out->bounds.radius_xy = bounds->xyradius;
-        out->bounds.radius = bounds->radius;
+    if (header->ofs_bounds && header->num_frames > 0) {
+        //union of all frames, so animated meshes don't pop out when culled
+        iqmbounds* bounds = (iqmbounds*)(mem->ptr + header->ofs_bounds);
+        memcpy(out->bounds.min, bounds[0].bbmin, sizeof(float) * 3);
+        memcpy(out->bounds.max, bounds[0].bbmax, sizeof(float) * 3);
+        out->bounds.radius_xy = bounds[0].xyradius;
+        out->bounds.radius = bounds[0].radius;
+        for (unsigned int f = 1; f < header->num_frames; f++) {
+            for (int k = 0; k < 3; k++) {
+                out->bounds.min[k] = HMM_MIN(out->bounds.min[k], bounds[f].bbmin[k]);
+                out->bounds.max[k] = HMM_MAX(out->bounds.max[k], bounds[f].bbmax[k]);
+            }
+            out->bounds.radius_xy = HMM_MAX(out->bounds.radius_xy, bounds[f].xyradius);
+            out->bounds.radius = HMM_MAX(out->bounds.radius, bounds[f].radius);
+        }
+    } else if (total_verts > 0) {
+        //no bounds in the file, derive them from the bind pose
+        HMM_Vec3 mn = vertices[0].pos, mx = vertices[0].pos;
+        float r2 = 0.0f, rxy2 = 0.0f;
+        for (unsigned int v = 0; v < total_verts; v++) {
+            HMM_Vec3 p = vertices[v].pos;
+            mn = HMM_V3(HMM_MIN(mn.X, p.X), HMM_MIN(mn.Y, p.Y), HMM_MIN(mn.Z, p.Z));
+            mx = HMM_V3(HMM_MAX(mx.X, p.X), HMM_MAX(mx.Y, p.Y), HMM_MAX(mx.Z, p.Z));
+            r2 = HMM_MAX(r2, HMM_LenSqrV3(p));
+            rxy2 = HMM_MAX(rxy2, p.X * p.X + p.Y * p.Y);
+        }
+        memcpy(out->bounds.min, mn.Elements, sizeof(float) * 3);
+        memcpy(out->bounds.max, mx.Elements, sizeof(float) * 3);
+        out->bounds.radius_xy = HMM_SqrtF(rxy2);
+        out->bounds.radius = HMM_SqrtF(r2);
+    }
+
+    for (int m = 0; m < out->meshes_count; m++) {
+        uint32_t num_indices = imesh[m].num_triangles * 3;
+        uint32_t* mesh_indices = arena_alloc(alloc, sizeof(uint32_t) * num_indices, alignof(uint32_t));
+        if (!mesh_indices) return RESULT_NOMEM;
+
+        int tcounter = 0;
+        for (unsigned int i = imesh[m].first_triangle;
+             i < imesh[m].first_triangle + imesh[m].num_triangles; i++) {
+            mesh_indices[tcounter++] = tri[i].vertex[0] - imesh[m].first_vertex;
+            mesh_indices[tcounter++] = tri[i].vertex[1] - imesh[m].first_vertex;
+            mesh_indices[tcounter++] = tri[i].vertex[2] - imesh[m].first_vertex;
+        }
+
+        out->meshes[m].verts = &vertices[imesh[m].first_vertex];
+        out->meshes[m].skin = &skin[imesh[m].first_vertex];
+        out->meshes[m].indices = mesh_indices;
+        out->meshes[m].num_verts = imesh[m].num_vertexes;
+        out->meshes[m].num_indices = num_indices;
+    }
+    if (flags & MODEL_LOAD_OPTIMIZE) _optimize_model(out, alloc);
+    _compact_model(out, (flags & MODEL_LOAD_COMPACT) != 0);
+
+    LOG_INFO("Loaded IQM model (%d meshes, %u verts)\n", out->meshes_count, total_verts);
+
+    return RESULT_SUCCESS;
+}
+
+//GEOMETRY
+
+static bool _geo_pool_init(RenderContext* ctx, int pool) {
+    GeoPool* p = &ctx->geometry.pools[pool];
+    if (p->shadow) return true;
+    size_t size = (size_t)p->capacity * p->stride;
+    bool mirrored = pool == GEO_POOL_SKIN; //allocated through GEO_POOL_VERTS
+    p->shadow = core_alloc(&ctx->geometry.alloc, size, 16);
+    p->free = mirrored ? NULL : core_alloc(&ctx->geometry.alloc, ctx->geometry.max_ranges * sizeof(GeoRange), alignof(GeoRange));
+    if (!p->shadow || (!mirrored && !p->free)) {
+        LOG_ERROR("Failed to allocate shared geometry buffer (%zu bytes)\n", size);
+        core_free(&ctx->geometry.alloc, p->shadow);
+        core_free(&ctx->geometry.alloc, p->free);
+        p->shadow = NULL;
+        p->free = NULL;
+        return false;
+    }
+    memset(p->shadow, 0, size);
+    if (!mirrored) {
+        p->free[0] = (GeoRange){ 0, p->capacity };
+        p->num_free = 1;
+    }
+    p->buf = sg_make_buffer(&(sg_buffer_desc){
+        .size = size,
+        .usage = { .index_buffer = pool >= GEO_POOL_INDEX16, .dynamic_update = true },
+        .label = "shared geometry buffer"
+    });
+    return true;
+}
+
+//first fit, false when no free range is big enough
+static bool _geo_alloc(GeoPool* p, uint32_t count, uint32_t* start) {
+    for (int i = 0; i < p->num_free; i++) {
+        if (p->free[i].count < count) continue;
+        *start = p->free[i].start;
+        p->free[i].start += count;
+        p->free[i].count -= count;
+        if (p->free[i].count == 0) {
+            memmove(&p->free[i], &p->free[i + 1], (p->num_free - i - 1) * sizeof(GeoRange));
+            p->num_free--;
+        }
+        p->used_end = HMM_MAX(p->used_end, *start + count);
+        return true;
+    }
+    return false;
+}
+
+//merges with its neighbours, so there are never more free ranges than live ones plus one
+static void _geo_free(GeoPool* p, uint32_t start, uint32_t count) {
+    int i = 0;
+    while (i < p->num_free && p->free[i].start < start) i++;
+    bool join_prev = i > 0 && p->free[i - 1].start + p->free[i - 1].count == start;
+    bool join_next = i < p->num_free && start + count == p->free[i].start;
+    if (join_prev && join_next) {
+        p->free[i - 1].count += count + p->free[i].count;
+        memmove(&p->free[i], &p->free[i + 1], (p->num_free - i - 1) * sizeof(GeoRange));
+        p->num_free--;
+    } else if (join_prev) {
+        p->free[i - 1].count += count;
+    } else if (join_next) {
+        p->free[i].start = start;
+        p->free[i].count += count;
+    } else {
+        memmove(&p->free[i + 1], &p->free[i], (p->num_free - i) * sizeof(GeoRange));
+        p->free[i] = (GeoRange){ start, count };
+        p->num_free++;
+    }
+    const GeoRange* last = &p->free[p->num_free - 1];
+    if (last->start + last->count == p->capacity) p->used_end = last->start;
+}
+
+static void _geo_write(GeoPool* p, uint32_t start, const void* data, uint32_t count) {
+    memcpy(p->shadow + (size_t)start * p->stride, data, (size_t)count * p->stride);
+    p->dirty = true;
+}
+
+//puts a mesh into the shared buffers, false when they are full and it needs buffers of its own
+static bool _geo_add_mesh(RenderContext* ctx, Mesh* mesh, const ModelData* data, int m) {
+    uint8_t format = data->meshes[m].format;
+    uint32_t num_verts = data->meshes[m].num_verts;
+    uint32_t num_indices = data->meshes[m].num_indices;
+    int vpool = (format & MESH_COMPACT) ? GEO_POOL_COMPACT : GEO_POOL_VERTS;
+    int ipool = (format & MESH_INDEX16) ? GEO_POOL_INDEX16 : GEO_POOL_INDEX32;
+    if (num_verts == 0 || num_indices == 0 || !_geo_pool_init(ctx, vpool) || !_geo_pool_init(ctx, ipool) ||
+        (data->has_skin && !_geo_pool_init(ctx, GEO_POOL_SKIN))) {
+        return false;
+    }
+
+    GeoPool* pools = ctx->geometry.pools;
+    uint32_t base, first;
+    if (!_geo_alloc(&pools[vpool], num_verts, &base)) return false;
+    if (!_geo_alloc(&pools[ipool], num_indices, &first)) {
+        _geo_free(&pools[vpool], base, num_verts);
+        return false;
     }
+    _geo_write(&pools[vpool], base, data->meshes[m].verts, num_verts);
+    _geo_write(&pools[ipool], first, data->meshes[m].indices, num_indices);
+    mesh->vbufs[0] = pools[vpool].buf;
+    if (data->has_skin) {
+        _geo_write(&pools[GEO_POOL_SKIN], base, data->meshes[m].skin, num_verts);
+        mesh->vbufs[1] = pools[GEO_POOL_SKIN].buf;
+    }
+    mesh->ibuf = pools[ipool].buf;
+    mesh->base_vertex = (int)base;
+    mesh->first_element = (int)first;
+    mesh->shared = true;
+    return true;
+}
 
-    for (int m = 0; m < out->meshes_count; m++) {
-        uint32_t num_indices = imesh[m].num_triangles * 3;
-        uint32_t* mesh_indices = arena_alloc(alloc, sizeof(uint32_t) * num_indices, alignof(uint32_t));
-        if (!mesh_indices) return RESULT_NOMEM;
+static void _geo_remove_mesh(RenderContext* ctx, const Mesh* mesh) {
+    int vpool = (mesh->format & MESH_COMPACT) ? GEO_POOL_COMPACT : GEO_POOL_VERTS;
+    int ipool = (mesh->format & MESH_INDEX16) ? GEO_POOL_INDEX16 : GEO_POOL_INDEX32;
+    _geo_free(&ctx->geometry.pools[vpool], (uint32_t)mesh->base_vertex, (uint32_t)mesh->vertex_count);
+    _geo_free(&ctx->geometry.pools[ipool], (uint32_t)mesh->first_element, (uint32_t)mesh->element_count);
+}
 
-        int tcounter = 0;
-        for (unsigned int i = imesh[m].first_triangle;
-             i < imesh[m].first_triangle + imesh[m].num_triangles; i++) {
-            mesh_indices[tcounter++] = tri[i].vertex[0] - imesh[m].first_vertex;
-            mesh_indices[tcounter++] = tri[i].vertex[1] - imesh[m].first_vertex;
-            mesh_indices[tcounter++] = tri[i].vertex[2] - imesh[m].first_vertex;
-        }
+//once per frame before anything draws, sokol allows one update per buffer and frame
+static void _geo_flush(RenderContext* ctx) {
+    for (int i = 0; i < GEO_POOL_COUNT; i++) {
+        GeoPool* p = &ctx->geometry.pools[i];
+        uint32_t end = i == GEO_POOL_SKIN ? ctx->geometry.pools[GEO_POOL_VERTS].used_end : p->used_end;
+        if (!p->dirty || end == 0) continue;
+        sg_update_buffer(p->buf, &(sg_range){ p->shadow, (size_t)end * p->stride });
+        p->dirty = false;
+    }
+}
+
+static void _create_model(RenderContext* ctx, Model* out, const ModelData* data) {
+    memset(out, 0, sizeof(Model));
+    out->bounds = data->bounds;
+    out->meshes_count = data->meshes_count;
+    out->dequant = HMM_M4D(1.0f);
+    if (data->meshes_count > 0 && (data->meshes[0].format & MESH_COMPACT)) {
+        HMM_Vec3 c = HMM_V3(data->qcenter[0], data->qcenter[1], data->qcenter[2]);
+        HMM_Vec3 e = HMM_V3(data->qextent[0], data->qextent[1], data->qextent[2]);
+        out->dequant = HMM_MulM4(HMM_Translate(c), HMM_Scale(e));
+    }
 
-        VertexPNT* mesh_verts = &vertices[imesh[m].first_vertex];
-        VertexSkin* mesh_skin = &skin[imesh[m].first_vertex];
+    for (int m = 0; m < data->meshes_count; m++) {
+        uint8_t format = data->meshes[m].format;
+        out->meshes[m].format = format;
+        out->meshes[m].element_count = (int)data->meshes[m].num_indices;
+        out->meshes[m].vertex_count = (int)data->meshes[m].num_verts;
+        if (_geo_add_mesh(ctx, &out->meshes[m], data, m)) continue;
 
         out->meshes[m].vbufs[0] = sg_make_buffer(&(sg_buffer_desc){
-            .data = (sg_range){ mesh_verts, sizeof(VertexPNT) * imesh[m].num_vertexes },
+            .data = (sg_range){ data->meshes[m].verts, _vertex_size(format) * data->meshes[m].num_verts },
             .label = "iqm vertex buffer"
         });
 
-        if (has_skin) {
+        if (data->has_skin) {
             out->meshes[m].vbufs[1] = sg_make_buffer(&(sg_buffer_desc){
-                .data = (sg_range){ mesh_skin, sizeof(VertexSkin) * imesh[m].num_vertexes },
+                .data = (sg_range){ data->meshes[m].skin, sizeof(VertexSkin) * data->meshes[m].num_verts },
                 .label = "iqm skin buffer"
             });
         }
 
         out->meshes[m].ibuf = sg_make_buffer(&(sg_buffer_desc){
             .usage.index_buffer = true,
-            .data = (sg_range){ mesh_indices, sizeof(uint32_t) * num_indices },
+            .data = (sg_range){ data->meshes[m].indices, _index_size(format) * data->meshes[m].num_indices },
             .label = "iqm index buffer"
         });
+    }
+}
+
+Result load_model(RenderContext* ctx, ArenaAlloc *alloc, Model* out, const IoMemory* mem, uint32_t flags) {
+    ModelData data;
+    Result result = _decode_model(alloc, &data, mem, flags);
+    if (result != RESULT_SUCCESS) return result;
+    _create_model(ctx, out, &data);
+    return RESULT_SUCCESS;
+}
 
-        out->meshes[m].first_element = 0;
-        out->meshes[m].element_count = num_indices;
+int model_measure_acmr(ArenaAlloc* alloc, const IoMemory* iqm, uint32_t flags, float* acmr, int max_meshes) {
+    if (!alloc || !iqm || !iqm->ptr || iqm->size <= sizeof(iqmheader) || model_is_cooked(iqm)) return 0;
+    ModelData data;
+    if (_decode_model(alloc, &data, iqm, flags) != RESULT_SUCCESS) return 0;
+    int count = HMM_MIN(data.meshes_count, max_meshes);
+    for (int m = 0; m < count; m++) {
+        uint32_t num_indices = data.meshes[m].num_indices;
+        uint32_t* stamp = arena_alloc(alloc, sizeof(uint32_t) * data.meshes[m].num_verts, alignof(uint32_t));
+        uint32_t* indices = data.meshes[m].indices;
+        if (data.meshes[m].format & MESH_INDEX16) {
+            indices = arena_alloc(alloc, sizeof(uint32_t) * num_indices, alignof(uint32_t));
+            for (uint32_t i = 0; indices && i < num_indices; i++) indices[i] = ((uint16_t*)data.meshes[m].indices)[i];
+        }
+        if (!stamp || !indices) return m;
+        acmr[m] = _mesh_acmr(indices, num_indices, stamp, data.meshes[m].num_verts);
     }
+    return count;
+}
 
-    LOG_INFO("Loaded IQM model (%d meshes, %u verts)\n", out->meshes_count, total_verts);
+//the decoded model, the quantized anim set and the cooked copy of both
+size_t cook_model_size(const IoMemory* iqm, uint32_t flags) {
+    size_t size = model_decode_size(iqm, flags);
+    if (size == 0) return 0;
+    const iqmheader* header = (const iqmheader*)iqm->ptr;
+    size_t num_joints = tole32(header->num_joints);
+    size_t num_keys = (size_t)tole32(header->num_frames) * num_joints;
+    size_t anims = tole32(header->num_anims) * (sizeof(AnimInfo) + sizeof(CookedAnim)) +
+                   num_keys * (sizeof(AnimKey) + 3 * sizeof(uint16_t)) * 2 +
+                   num_joints * (sizeof(int) + sizeof(AnimJointRange) + 4 * sizeof(HMM_Mat4)) * 2;
+    return size * 2 + anims + 32 * 16;
+}
+
+//the sections of _load_cooked_anims, from an anim set loaded with ANIM_STORAGE_QUANTIZED
+static size_t _cook_anims_layout(CookedModelHeader* header, const AnimSet* set, size_t size) {
+    size_t num_joints = (size_t)set->num_joints;
+    size_t num_keys = (size_t)set->num_frames * num_joints;
+    header->flags |= MODEL_COOKED_ANIMS | (set->scale_keys ? MODEL_COOKED_SCALE_KEYS : 0);
+    header->num_joints = (uint32_t)set->num_joints;
+    header->num_frames = (uint32_t)set->num_frames;
+    header->num_anims = (uint32_t)set->num_anims;
+    header->ofs_parents = (uint32_t)size;
+    size = _align16(size + num_joints * sizeof(int32_t));
+    header->ofs_bind = (uint32_t)size;
+    size = _align16(size + num_joints * sizeof(HMM_Mat4));
+    header->ofs_inverse_bind = (uint32_t)size;
+    size = _align16(size + num_joints * sizeof(HMM_Mat4));
+    header->ofs_ranges = (uint32_t)size;
+    size = _align16(size + num_joints * sizeof(AnimJointRange));
+    header->ofs_anims = (uint32_t)size;
+    size = _align16(size + set->num_anims * sizeof(CookedAnim));
+    header->ofs_keys = (uint32_t)size;
+    size = _align16(size + num_keys * sizeof(AnimKey));
+    if (set->scale_keys) {
+        header->ofs_scale_keys = (uint32_t)size;
+        size = _align16(size + num_keys * 3 * sizeof(uint16_t));
+    }
+    return size;
+}
+
+static void _cook_anims_write(uint8_t* file, const CookedModelHeader* header, const AnimSet* set) {
+    size_t num_joints = header->num_joints;
+    size_t num_keys = (size_t)header->num_frames * num_joints;
+    int32_t* parents = (int32_t*)(file + header->ofs_parents);
+    HMM_Mat4* bind = (HMM_Mat4*)(file + header->ofs_bind);
+    for (size_t i = 0; i < num_joints; i++) {
+        parents[i] = set->joint_parents[i];
+        bind[i] = HMM_InvGeneralM4(set->inverse_bind[i]);
+    }
+    memcpy(file + header->ofs_inverse_bind, set->inverse_bind, num_joints * sizeof(HMM_Mat4));
+    memcpy(file + header->ofs_ranges, set->ranges, num_joints * sizeof(AnimJointRange));
+    CookedAnim* anims = (CookedAnim*)(file + header->ofs_anims);
+    for (int i = 0; i < set->num_anims; i++) {
+        memcpy(anims[i].name, set->anims[i].name, MAX_NAME_LEN);
+        anims[i].first_frame = set->anims[i].first_frame;
+        anims[i].num_frames = set->anims[i].num_frames;
+        anims[i].framerate = set->anims[i].framerate;
+        _le32_inplace(&anims[i].first_frame, 3);
+    }
+    memcpy(file + header->ofs_keys, set->keys, num_keys * sizeof(AnimKey));
+    if (set->scale_keys) memcpy(file + header->ofs_scale_keys, set->scale_keys, num_keys * 3 * sizeof(uint16_t));
+
+    _le32_inplace(file + header->ofs_parents, num_joints);
+    _le32_inplace(file + header->ofs_bind, num_joints * sizeof(HMM_Mat4) / sizeof(uint32_t));
+    _le32_inplace(file + header->ofs_inverse_bind, num_joints * sizeof(HMM_Mat4) / sizeof(uint32_t));
+    _le32_inplace(file + header->ofs_ranges, num_joints * sizeof(AnimJointRange) / sizeof(uint32_t));
+    _le16_inplace(file + header->ofs_keys, num_keys * sizeof(AnimKey) / sizeof(uint16_t));
+    if (set->scale_keys) _le16_inplace(file + header->ofs_scale_keys, num_keys * 3);
+}
+
+Result cook_model(ArenaAlloc* alloc, IoMemory* out, const IoMemory* iqm, uint32_t flags) {
+    if (!alloc || !out || !iqm || !iqm->ptr || iqm->size <= sizeof(iqmheader) || model_is_cooked(iqm)) {
+        return RESULT_INVALID_PARAMS;
+    }
+    ModelData data;
+    Result result = _decode_model(alloc, &data, iqm, flags);
+    if (result != RESULT_SUCCESS) return result;
+
+    //_decode_model left the header in host order
+    const iqmheader* iqm_header = (const iqmheader*)iqm->ptr;
+    AnimSet anims = {0};
+    bool has_anims = iqm_header->num_joints && iqm_header->num_poses && iqm_header->num_anims && iqm_header->num_frames;
+    if (has_anims) {
+        result = load_anims(alloc, &anims, iqm, ANIM_STORAGE_QUANTIZED);
+        if (result != RESULT_SUCCESS) return result;
+    }
+
+    CookedModelHeader header = {0};
+    memcpy(header.magic, MODEL_COOKED_MAGIC, sizeof(header.magic));
+    header.version = MODEL_COOKED_VERSION;
+    header.flags = data.has_skin ? MODEL_COOKED_SKINNED : 0;
+    header.num_meshes = (uint32_t)data.meshes_count;
+    header.bounds = data.bounds;
+    memcpy(header.qcenter, data.qcenter, sizeof(header.qcenter));
+    memcpy(header.qextent, data.qextent, sizeof(header.qextent));
+
+    size_t size = _align16(sizeof(CookedModelHeader));
+    for (int m = 0; m < data.meshes_count; m++) {
+        CookedMesh* cm = &header.meshes[m];
+        cm->num_verts = data.meshes[m].num_verts;
+        cm->num_indices = data.meshes[m].num_indices;
+        cm->format = data.meshes[m].format;
+        cm->ofs_verts = (uint32_t)size;
+        size = _align16(size + cm->num_verts * _vertex_size(data.meshes[m].format));
+        if (data.has_skin) {
+            cm->ofs_skin = (uint32_t)size;
+            size = _align16(size + cm->num_verts * sizeof(VertexSkin));
+        }
+        cm->ofs_indices = (uint32_t)size;
+        size = _align16(size + cm->num_indices * _index_size(data.meshes[m].format));
+    }
+    if (has_anims) size = _cook_anims_layout(&header, &anims, size);
+    header.file_size = (uint32_t)size;
+
+    uint8_t* file = arena_alloc(alloc, size, 16);
+    if (!file) return RESULT_NOMEM;
+    memset(file, 0, size);
+    for (int m = 0; m < data.meshes_count; m++) {
+        const CookedMesh* cm = &header.meshes[m];
+        uint8_t format = data.meshes[m].format;
+        memcpy(file + cm->ofs_verts, data.meshes[m].verts, cm->num_verts * _vertex_size(format));
+        if (data.has_skin) memcpy(file + cm->ofs_skin, data.meshes[m].skin, cm->num_verts * sizeof(VertexSkin));
+        memcpy(file + cm->ofs_indices, data.meshes[m].indices, cm->num_indices * _index_size(format));
+        _le_mesh_inplace(file + cm->ofs_verts, cm->num_verts, file + cm->ofs_indices, cm->num_indices, format);
+    }
+    if (has_anims) _cook_anims_write(file, &header, &anims);
+    _le32_inplace(&header.version, (sizeof(CookedModelHeader) - sizeof(header.magic)) / sizeof(uint32_t));
+    memcpy(file, &header, sizeof(CookedModelHeader));
 
+    out->ptr = file;
+    out->size = size;
+    out->mapped = false;
     return RESULT_SUCCESS;
 }
 
-void release_model(Model* model) {
+void release_model(RenderContext* ctx, Model* model) {
     for (int m = 0; m < model->meshes_count; m++) {
+        if (model->meshes[m].shared) {
+            _geo_remove_mesh(ctx, &model->meshes[m]);
+            continue;
+        }
         for (int i = 0; i < MESH_MAX_VBUFS; ++i) {
             sg_destroy_buffer(model->meshes[m].vbufs[i]);
         }
@@ -381,6 +1896,32 @@ void release_model(Model* model) {
     memset(model, 0, sizeof(Model));
 }
 
+bool bounds_in_frustum(const Frustum* frustum, const Bounds* bounds, HMM_Mat4 world) {
+    //transform the local aabb into a world aabb (center + absolute extents)
+    HMM_Vec3 c = HMM_V3((bounds->min[0] + bounds->max[0]) * 0.5f,
+                        (bounds->min[1] + bounds->max[1]) * 0.5f,
+                        (bounds->min[2] + bounds->max[2]) * 0.5f);
+    HMM_Vec3 e = HMM_V3((bounds->max[0] - bounds->min[0]) * 0.5f,
+                        (bounds->max[1] - bounds->min[1]) * 0.5f,
+                        (bounds->max[2] - bounds->min[2]) * 0.5f);
+
+    HMM_Vec3 wc = HMM_MulM4V4(world, HMM_V4V(c, 1.0f)).XYZ;
+    HMM_Vec3 we;
+    for (int i = 0; i < 3; i++) {
+        we.Elements[i] = HMM_ABS(world.Columns[0].Elements[i]) * e.X
+                       + HMM_ABS(world.Columns[1].Elements[i]) * e.Y
+                       + HMM_ABS(world.Columns[2].Elements[i]) * e.Z;
+    }
+
+    for (int i = 0; i < 6; i++) {
+        HMM_Vec4 p = frustum->planes[i];
+        float d = HMM_DotV3(p.XYZ, wc) + p.W;
+        float r = HMM_ABS(p.X) * we.X + HMM_ABS(p.Y) * we.Y + HMM_ABS(p.Z) * we.Z;
+        if (d + r < 0.0f) return false;
+    }
+    return true;
+}
+
 //--ANIMATION----------------------------------------------------------------------------
 
 
@@ -391,14 +1932,165 @@ static HMM_Mat4 HMM_TRS(HMM_Vec3 pos, HMM_Quat rotation, HMM_Vec3 scale) {
     return HMM_MulM4(HMM_MulM4(T, R), S);
 }
 
-Result load_anims(ArenaAlloc* allocator, AnimSet* out, const IoMemory* mem) {
+//smallest three: drop the largest component, its index goes into the top bits of out[0] and out[1]
+static void _quat_pack(uint16_t out[3], HMM_Quat q) {
+    int largest = 0;
+    for (int i = 1; i < 4; i++) {
+        if (fabsf(q.Elements[i]) > fabsf(q.Elements[largest])) largest = i;
+    }
+    //q and -q are the same rotation, flip so the dropped component is positive
+    float sign = q.Elements[largest] < 0.0f ? -1.0f : 1.0f;
+    for (int i = 0, n = 0; i < 4; i++) {
+        if (i == largest) continue;
+        float c = HMM_Clamp(-ANIM_QUAT_RANGE, q.Elements[i] * sign, ANIM_QUAT_RANGE);
+        out[n++] = (uint16_t)((c / ANIM_QUAT_RANGE * 0.5f + 0.5f) * 32767.0f + 0.5f);
+    }
+    out[0] |= (uint16_t)((largest & 1) << 15);
+    out[1] |= (uint16_t)((largest >> 1) << 15);
+}
+
+static inline HMM_Quat _quat_unpack(const uint16_t in[3]) {
+    const float scale = 2.0f * ANIM_QUAT_RANGE / 32767.0f;
+    float a = (in[0] & 0x7fff) * scale - ANIM_QUAT_RANGE;
+    float b = (in[1] & 0x7fff) * scale - ANIM_QUAT_RANGE;
+    float c = (in[2] & 0x7fff) * scale - ANIM_QUAT_RANGE;
+    float d = sqrtf(HMM_MAX(1.0f - a * a - b * b - c * c, 0.0f));
+    switch ((in[0] >> 15) | ((in[1] >> 15) << 1)) {
+        case 0: return HMM_Q(d, a, b, c);
+        case 1: return HMM_Q(a, d, b, c);
+        case 2: return HMM_Q(a, b, d, c);
+        default: return HMM_Q(a, b, c, d);
+    }
+}
+
+//cooked anims are the quantized keys already, baked storage composes its matrices from them
+static Result _load_cooked_anims(ArenaAlloc* allocator, AnimSet* out, const IoMemory* mem, AnimStorage storage) {
+    CookedModelHeader header;
+    memcpy(&header, mem->ptr, sizeof(CookedModelHeader));
+    _le32_inplace(&header.version, (sizeof(CookedModelHeader) - sizeof(header.magic)) / sizeof(uint32_t));
+    if (header.version != MODEL_COOKED_VERSION || !(header.flags & MODEL_COOKED_ANIMS)) {
+        LOG_ERROR("Cooked model has no animations (version %u)\n", header.version);
+        return RESULT_INVALID_PARAMS;
+    }
+    if (!header.num_joints || header.num_joints > MAX_BONES) {
+        LOG_ERROR("Cooked skeleton has %u joints, max is %d!\n", header.num_joints, MAX_BONES);
+        return RESULT_INVALID_PARAMS;
+    }
+
+    size_t num_joints = header.num_joints;
+    size_t num_keys = (size_t)header.num_frames * num_joints;
+    bool has_scale = (header.flags & MODEL_COOKED_SCALE_KEYS) != 0;
+    if (!_cooked_range(mem, header.ofs_parents, num_joints * sizeof(int32_t)) ||
+        !_cooked_range(mem, header.ofs_bind, num_joints * sizeof(HMM_Mat4)) ||
+        !_cooked_range(mem, header.ofs_inverse_bind, num_joints * sizeof(HMM_Mat4)) ||
+        !_cooked_range(mem, header.ofs_ranges, num_joints * sizeof(AnimJointRange)) ||
+        !_cooked_range(mem, header.ofs_anims, (size_t)header.num_anims * sizeof(CookedAnim)) ||
+        !_cooked_range(mem, header.ofs_keys, num_keys * sizeof(AnimKey)) ||
+        (has_scale && !_cooked_range(mem, header.ofs_scale_keys, num_keys * 3 * sizeof(uint16_t)))) {
+        LOG_ERROR("Cooked animations are out of bounds\n");
+        return RESULT_INVALID_PARAMS;
+    }
+
+    int32_t* parents = (int32_t*)(mem->ptr + header.ofs_parents);
+    HMM_Mat4* bind = (HMM_Mat4*)(mem->ptr + header.ofs_bind);
+    HMM_Mat4* inverse_bind = (HMM_Mat4*)(mem->ptr + header.ofs_inverse_bind);
+    AnimJointRange* ranges = (AnimJointRange*)(mem->ptr + header.ofs_ranges);
+    CookedAnim* anims = (CookedAnim*)(mem->ptr + header.ofs_anims);
+    AnimKey* keys = (AnimKey*)(mem->ptr + header.ofs_keys);
+    uint16_t* scale_keys = has_scale ? (uint16_t*)(mem->ptr + header.ofs_scale_keys) : NULL;
+    _le32_inplace(parents, num_joints);
+    _le32_inplace(bind, num_joints * sizeof(HMM_Mat4) / sizeof(uint32_t));
+    _le32_inplace(inverse_bind, num_joints * sizeof(HMM_Mat4) / sizeof(uint32_t));
+    _le32_inplace(ranges, num_joints * sizeof(AnimJointRange) / sizeof(uint32_t));
+    _le16_inplace(keys, num_keys * sizeof(AnimKey) / sizeof(uint16_t));
+    if (scale_keys) _le16_inplace(scale_keys, num_keys * 3);
+
+    //play_anim walks the joints in order, a parent after its child would read garbage
+    for (size_t i = 0; i < num_joints; i++) {
+        if (parents[i] >= (int32_t)i) {
+            LOG_ERROR("Cooked joint %zu has parent %d after it\n", i, parents[i]);
+            return RESULT_INVALID_PARAMS;
+        }
+    }
+    for (uint32_t i = 0; i < header.num_anims; i++) {
+        _le32_inplace(&anims[i].first_frame, 3);
+        if (anims[i].first_frame > header.num_frames || anims[i].num_frames > header.num_frames - anims[i].first_frame) {
+            LOG_ERROR("Cooked anim %u is out of bounds\n", i);
+            return RESULT_INVALID_PARAMS;
+        }
+    }
+
+    size_t arena_start = allocator->offset;
+    *out = (AnimSet){
+        .storage = storage,
+        .num_joints = (int)header.num_joints,
+        .num_frames = (int)header.num_frames,
+        .num_anims = (int)header.num_anims,
+    };
+    out->joint_parents = arena_alloc(allocator, sizeof(int) * num_joints, alignof(int));
+    out->anims = arena_alloc(allocator, sizeof(AnimInfo) * header.num_anims, alignof(AnimInfo));
+    if (!out->joint_parents || (header.num_anims && !out->anims)) return RESULT_NOMEM;
+    for (size_t i = 0; i < num_joints; i++) out->joint_parents[i] = parents[i];
+    for (uint32_t i = 0; i < header.num_anims; i++) {
+        memcpy(out->anims[i].name, anims[i].name, MAX_NAME_LEN);
+        out->anims[i].name[MAX_NAME_LEN - 1] = '\0';
+        out->anims[i].first_frame = anims[i].first_frame;
+        out->anims[i].num_frames = anims[i].num_frames;
+        out->anims[i].framerate = anims[i].framerate;
+    }
+
+    if (storage == ANIM_STORAGE_QUANTIZED) {
+        out->keys = arena_alloc(allocator, sizeof(AnimKey) * num_keys, alignof(AnimKey));
+        if (scale_keys) out->scale_keys = arena_alloc(allocator, sizeof(uint16_t) * 3 * num_keys, alignof(uint16_t));
+        out->ranges = arena_alloc(allocator, sizeof(AnimJointRange) * num_joints, alignof(AnimJointRange));
+        out->inverse_bind = arena_alloc(allocator, sizeof(HMM_Mat4) * num_joints, alignof(HMM_Mat4));
+        if (!out->keys || (scale_keys && !out->scale_keys) || !out->ranges || !out->inverse_bind) return RESULT_NOMEM;
+        memcpy(out->keys, keys, sizeof(AnimKey) * num_keys);
+        if (scale_keys) memcpy(out->scale_keys, scale_keys, sizeof(uint16_t) * 3 * num_keys);
+        memcpy(out->ranges, ranges, sizeof(AnimJointRange) * num_joints);
+        memcpy(out->inverse_bind, inverse_bind, sizeof(HMM_Mat4) * num_joints);
+    } else {
+        out->frames = arena_alloc(allocator, sizeof(HMM_Mat4) * num_keys, alignof(HMM_Mat4));
+        if (!out->frames) return RESULT_NOMEM;
+        //same matrices the iqm path bakes, from the keys instead of the channels
+        for (size_t k = 0; k < num_keys; k++) {
+            size_t j = k % num_joints;
+            const AnimJointRange* r = &ranges[j];
+            HMM_Vec3 pos, scl = r->scale_offset;
+            for (int c = 0; c < 3; c++) {
+                pos.Elements[c] = r->pos_offset.Elements[c] + keys[k].pos[c] * r->pos_scale.Elements[c];
+                if (scale_keys) scl.Elements[c] += scale_keys[k * 3 + c] * r->scale_scale.Elements[c];
+            }
+            HMM_Mat4 m = HMM_TRS(pos, _quat_unpack(keys[k].rot), scl);
+            if (parents[j] >= 0)
+                out->frames[k] = HMM_MulM4(HMM_MulM4(bind[parents[j]], m), inverse_bind[j]);
+            else
+                out->frames[k] = HMM_MulM4(m, inverse_bind[j]);
+        }
+    }
+    out->data_size = allocator->offset - arena_start;
+
+    LOG_INFO("Anim set: %d joints, %d frames, %zu bytes (%s, cooked)\n",
+        out->num_joints, out->num_frames, out->data_size,
+        storage == ANIM_STORAGE_QUANTIZED ? "quantized" : "baked");
+    return RESULT_SUCCESS;
+}
+
+Result load_anims(ArenaAlloc* allocator, AnimSet* out, const IoMemory* mem, AnimStorage storage) {
+    if (model_is_cooked(mem)) return _load_cooked_anims(allocator, out, mem, storage);
     assert(mem && mem->size > sizeof(iqmheader));
     iqmheader* hdr = (iqmheader*)mem->ptr;
+    size_t arena_start = allocator->offset;
+    *out = (AnimSet){ .storage = storage };
 
     if (!hdr->num_joints || !hdr->num_poses) {
         LOG_ERROR("IQM data does not contain skeleton!\n");
         return RESULT_INVALID_PARAMS;
     }
+    if (hdr->num_joints > MAX_BONES) {
+        LOG_ERROR("IQM skeleton has %u joints, max is %d!\n", hdr->num_joints, MAX_BONES);
+        return RESULT_INVALID_PARAMS;
+    }
 
     iqmjoint* joints = (iqmjoint*)&mem->ptr[hdr->ofs_joints];
     out->num_joints = hdr->num_joints;
@@ -419,21 +2111,39 @@ Result load_anims(ArenaAlloc* allocator, AnimSet* out, const IoMemory* mem) {
     iqmanim* iqm_anims = (iqmanim*)&mem->ptr[hdr->ofs_anims];
     iqmpose* poses = (iqmpose*)&mem->ptr[hdr->ofs_poses];
 
-    {
-        uint32_t* p = (uint32_t*)poses;
-        for (unsigned int i = 0; i < hdr->num_poses * sizeof(iqmpose) / sizeof(uint32_t); i++) p[i] = tole32(p[i]);
-    }
-    {
-        uint32_t* p = (uint32_t*)iqm_anims;
-        for (unsigned int i = 0; i < hdr->num_anims * sizeof(iqmanim) / sizeof(uint32_t); i++) p[i] = tole32(p[i]);
-    }
+    _le32_inplace(poses, hdr->num_poses * sizeof(iqmpose) / sizeof(uint32_t));
+    _le32_inplace(iqm_anims, hdr->num_anims * sizeof(iqmanim) / sizeof(uint32_t));
 
     //allocate persistent data first
     out->num_anims = hdr->num_anims;
     out->num_frames = hdr->num_frames;
     out->anims = arena_alloc(allocator, sizeof(AnimInfo) * hdr->num_anims, alignof(AnimInfo));
-    out->frames = arena_alloc(allocator, sizeof(HMM_Mat4) * hdr->num_frames * hdr->num_poses, alignof(HMM_Mat4));
-    if (!out->anims || !out->frames) return RESULT_NOMEM;
+    if (!out->anims) return RESULT_NOMEM;
+
+    size_t num_keys = (size_t)hdr->num_frames * hdr->num_poses;
+    if (storage == ANIM_STORAGE_QUANTIZED) {
+        bool has_scale = false;
+        for (int j = 0; j < (int)hdr->num_poses; j++) {
+            if (poses[j].mask & 0x380) has_scale = true;
+        }
+        out->keys = arena_alloc(allocator, sizeof(AnimKey) * num_keys, alignof(AnimKey));
+        if (has_scale) out->scale_keys = arena_alloc(allocator, sizeof(uint16_t) * 3 * num_keys, alignof(uint16_t));
+        out->ranges = arena_alloc(allocator, sizeof(AnimJointRange) * hdr->num_poses, alignof(AnimJointRange));
+        out->inverse_bind = arena_alloc(allocator, sizeof(HMM_Mat4) * hdr->num_joints, alignof(HMM_Mat4));
+        if (!out->keys || (has_scale && !out->scale_keys) || !out->ranges || !out->inverse_bind) return RESULT_NOMEM;
+
+        for (int j = 0; j < (int)hdr->num_poses; j++) {
+            const float* o = poses[j].channeloffset;
+            const float* s = poses[j].channelscale;
+            out->ranges[j] = (AnimJointRange){
+                .pos_offset = HMM_V3(o[0], o[1], o[2]), .pos_scale = HMM_V3(s[0], s[1], s[2]),
+                .scale_offset = HMM_V3(o[7], o[8], o[9]), .scale_scale = HMM_V3(s[7], s[8], s[9]),
+            };
+        }
+    } else {
+        out->frames = arena_alloc(allocator, sizeof(HMM_Mat4) * num_keys, alignof(HMM_Mat4));
+        if (!out->frames) return RESULT_NOMEM;
+    }
 
     //temp baseframe/inverse_baseframe allocated last so we can pop it after pre-baking
     HMM_Mat4* temp = arena_alloc(allocator, sizeof(HMM_Mat4) * hdr->num_joints * 2, alignof(HMM_Mat4));
@@ -455,30 +2165,30 @@ Result load_anims(ArenaAlloc* allocator, AnimSet* out, const IoMemory* mem) {
     }
 
     uint16_t* framedata = (uint16_t*)&mem->ptr[hdr->ofs_frames];
-    {
-        unsigned int n = hdr->num_frames * hdr->num_framechannels;
-        for (unsigned int i = 0; i < n; i++) framedata[i] = tole16(framedata[i]);
-    }
+    _le16_inplace(framedata, hdr->num_frames * hdr->num_framechannels);
 
-    //just pre-bake the whole shabang
+    //either keep the quantized channels or pre-bake the whole shabang
     for (int i = 0; i < (int)hdr->num_frames; i++) {
         for (int j = 0; j < (int)hdr->num_poses; j++) {
             iqmpose* p = &poses[j];
-            HMM_Quat rotate;
-            HMM_Vec3 translate, scale;
-            translate.X = p->channeloffset[0]; if (p->mask & 0x01) translate.X += *framedata++ * p->channelscale[0];
-            translate.Y = p->channeloffset[1]; if (p->mask & 0x02) translate.Y += *framedata++ * p->channelscale[1];
-            translate.Z = p->channeloffset[2]; if (p->mask & 0x04) translate.Z += *framedata++ * p->channelscale[2];
-            rotate.X = p->channeloffset[3]; if (p->mask & 0x08) rotate.X += *framedata++ * p->channelscale[3];
-            rotate.Y = p->channeloffset[4]; if (p->mask & 0x10) rotate.Y += *framedata++ * p->channelscale[4];
-            rotate.Z = p->channeloffset[5]; if (p->mask & 0x20) rotate.Z += *framedata++ * p->channelscale[5];
-            rotate.W = p->channeloffset[6]; if (p->mask & 0x40) rotate.W += *framedata++ * p->channelscale[6];
-            scale.X = p->channeloffset[7]; if (p->mask & 0x80) scale.X += *framedata++ * p->channelscale[7];
-            scale.Y = p->channeloffset[8]; if (p->mask & 0x100) scale.Y += *framedata++ * p->channelscale[8];
-            scale.Z = p->channeloffset[9]; if (p->mask & 0x200) scale.Z += *framedata++ * p->channelscale[9];
-
-            rotate = HMM_NormQ(rotate);
-            HMM_Mat4 m = HMM_TRS(translate, rotate, scale);
+            //channels: translate xyz, rotate xyzw, scale xyz, unanimated ones stay at their offset
+            uint16_t ch[10];
+            float v[10];
+            for (int c = 0; c < 10; c++) {
+                ch[c] = (p->mask & (1U << c)) ? *framedata++ : 0;
+                v[c] = p->channeloffset[c] + ch[c] * p->channelscale[c];
+            }
+            HMM_Quat rotate = HMM_NormQ(HMM_Q(v[3], v[4], v[5], v[6]));
+
+            if (storage == ANIM_STORAGE_QUANTIZED) {
+                size_t k = (size_t)i * hdr->num_poses + j;
+                _quat_pack(out->keys[k].rot, rotate);
+                memcpy(out->keys[k].pos, &ch[0], sizeof(out->keys[k].pos));
+                if (out->scale_keys) memcpy(&out->scale_keys[k * 3], &ch[7], 3 * sizeof(uint16_t));
+                continue;
+            }
+
+            HMM_Mat4 m = HMM_TRS(HMM_V3(v[0], v[1], v[2]), rotate, HMM_V3(v[7], v[8], v[9]));
             if (p->parent >= 0)
                 out->frames[i * hdr->num_poses + j] = HMM_MulM4(HMM_MulM4(baseframe[p->parent], m), inverse_baseframe[j]);
             else
@@ -486,8 +2196,11 @@ Result load_anims(ArenaAlloc* allocator, AnimSet* out, const IoMemory* mem) {
         }
     }
 
+    if (out->inverse_bind) memcpy(out->inverse_bind, inverse_baseframe, sizeof(HMM_Mat4) * hdr->num_joints);
+
     //temporary baseframe/inverse_baseframe
     arena_pop(allocator);
+    out->data_size = allocator->offset - arena_start;
 
     //copy metadata
     for (int i = 0; i < (int)hdr->num_anims; i++) {
@@ -505,6 +2218,9 @@ Result load_anims(ArenaAlloc* allocator, AnimSet* out, const IoMemory* mem) {
             out->anims[i].framerate
         );
     }
+    LOG_INFO("Anim set: %d joints, %d frames, %zu bytes (%s)\n",
+        out->num_joints, out->num_frames, out->data_size,
+        storage == ANIM_STORAGE_QUANTIZED ? "quantized" : "baked");
 
     return RESULT_SUCCESS;
 }
@@ -528,9 +2244,102 @@ void update_anim_state(AnimState* state, AnimSet* set, float dt) {
     }
 }
 
-void play_anim(u_skeleton_t* out, AnimSet* set, AnimState* state) {
-    if (!out || !set || !state || state->anim < 0 || state->anim >= set->num_anims) return;
-    if (set->num_frames <= 0) return;
+//ANIMATION KERNELS
+//batch matrix math over whole joint arrays, skinning matrices are affine (last row 0 0 0 1)
+
+//out[i] = a[i] * (1 - t) + b[i] * t, out may alias a or b
+//the per matrix HandmadeMath ops, they already compile to SSE/NEON and a flat intrinsics loop was slower
+static inline void _mat4_lerp_n(HMM_Mat4* out, const HMM_Mat4* a, const HMM_Mat4* b, float t, int n) {
+    for (int i = 0; i < n; i++) {
+        out[i] = HMM_AddM4(HMM_MulM4F(a[i], 1.0f - t), HMM_MulM4F(b[i], t));
+    }
+}
+
+//out = l * r, skipping the terms of the constant last row, out may alias l or r
+static inline void _mat4_mul_affine(HMM_Mat4* out, const HMM_Mat4* l, const HMM_Mat4* r) {
+#if defined(HANDMADE_MATH__USE_SSE)
+    __m128 res[4];
+    for (int c = 0; c < 4; c++) {
+        __m128 rc = r->Columns[c].SSE;
+        __m128 v = _mm_mul_ps(l->Columns[0].SSE, _mm_shuffle_ps(rc, rc, 0x00));
+        v = _mm_add_ps(v, _mm_mul_ps(l->Columns[1].SSE, _mm_shuffle_ps(rc, rc, 0x55)));
+        res[c] = _mm_add_ps(v, _mm_mul_ps(l->Columns[2].SSE, _mm_shuffle_ps(rc, rc, 0xaa)));
+    }
+    res[3] = _mm_add_ps(res[3], l->Columns[3].SSE);
+    for (int c = 0; c < 4; c++) out->Columns[c].SSE = res[c];
+#elif defined(HANDMADE_MATH__USE_NEON)
+    float32x4_t res[4];
+    for (int c = 0; c < 4; c++) {
+        float32x4_t rc = r->Columns[c].NEON;
+        float32x4_t v = vmulq_laneq_f32(l->Columns[0].NEON, rc, 0);
+        v = vfmaq_laneq_f32(v, l->Columns[1].NEON, rc, 1);
+        res[c] = vfmaq_laneq_f32(v, l->Columns[2].NEON, rc, 2);
+    }
+    res[3] = vaddq_f32(res[3], l->Columns[3].NEON);
+    for (int c = 0; c < 4; c++) out->Columns[c].NEON = res[c];
+#else
+    HMM_Mat4 res;
+    for (int c = 0; c < 4; c++) {
+        for (int k = 0; k < 4; k++) {
+            res.Elements[c][k] = l->Elements[0][k] * r->Elements[c][0]
+                               + l->Elements[1][k] * r->Elements[c][1]
+                               + l->Elements[2][k] * r->Elements[c][2];
+        }
+    }
+    for (int k = 0; k < 4; k++) res.Elements[3][k] += l->Elements[3][k];
+    *out = res;
+#endif
+}
+
+//m[i] = m[parent] * m[i], parents always come before their children
+static void _mat4_concat_hierarchy(HMM_Mat4* m, const int* parents, int n) {
+    for (int i = 0; i < n; i++) {
+        if (parents[i] >= 0) _mat4_mul_affine(&m[i], &m[parents[i]], &m[i]);
+    }
+}
+
+//same as HMM_TRS for a unit quaternion, without the three intermediate matrices
+static inline void _mat4_trs_affine(HMM_Mat4* out, HMM_Vec3 pos, HMM_Quat q, HMM_Vec3 scale) {
+    float xx = q.X * q.X, yy = q.Y * q.Y, zz = q.Z * q.Z;
+    float xy = q.X * q.Y, xz = q.X * q.Z, yz = q.Y * q.Z;
+    float wx = q.W * q.X, wy = q.W * q.Y, wz = q.W * q.Z;
+    out->Columns[0] = HMM_V4((1.0f - 2.0f * (yy + zz)) * scale.X, 2.0f * (xy + wz) * scale.X, 2.0f * (xz - wy) * scale.X, 0.0f);
+    out->Columns[1] = HMM_V4(2.0f * (xy - wz) * scale.Y, (1.0f - 2.0f * (xx + zz)) * scale.Y, 2.0f * (yz + wx) * scale.Y, 0.0f);
+    out->Columns[2] = HMM_V4(2.0f * (xz + wy) * scale.Z, 2.0f * (yz - wx) * scale.Z, (1.0f - 2.0f * (xx + yy)) * scale.Z, 0.0f);
+    out->Columns[3] = HMM_V4(pos.X, pos.Y, pos.Z, 1.0f);
+}
+
+//local joint matrices from quantized keys: nlerp rotations, lerp translation/scale
+static void _sample_keys(HMM_Mat4* out, const AnimSet* set, int frame1, int frame2, float t) {
+    int num_joints = set->num_joints;
+    const AnimKey* k1 = &set->keys[frame1 * num_joints];
+    const AnimKey* k2 = &set->keys[frame2 * num_joints];
+    const uint16_t* s1 = set->scale_keys ? &set->scale_keys[frame1 * num_joints * 3] : NULL;
+    const uint16_t* s2 = set->scale_keys ? &set->scale_keys[frame2 * num_joints * 3] : NULL;
+
+    for (int i = 0; i < num_joints; i++) {
+        const AnimJointRange* r = &set->ranges[i];
+        HMM_Quat q1 = _quat_unpack(k1[i].rot);
+        HMM_Quat q2 = _quat_unpack(k2[i].rot);
+        //take the short way around
+        if (HMM_DotQ(q1, q2) < 0.0f) q2 = HMM_MulQF(q2, -1.0f);
+        HMM_Quat rot = HMM_NLerp(q1, t, q2);
+
+        HMM_Vec3 pos, scl = r->scale_offset;
+        for (int c = 0; c < 3; c++) {
+            pos.Elements[c] = r->pos_offset.Elements[c] + HMM_Lerp((float)k1[i].pos[c], t, (float)k2[i].pos[c]) * r->pos_scale.Elements[c];
+            if (s1) scl.Elements[c] += HMM_Lerp((float)s1[i * 3 + c], t, (float)s2[i * 3 + c]) * r->scale_scale.Elements[c];
+        }
+
+        _mat4_trs_affine(&out[i], pos, rot, scl);
+    }
+}
+
+//samples one clip into local joint matrices, returns false if the state has nothing to sample.
+//layers and crossfades blend these, _pose_finish turns them into skinning matrices.
+static bool _sample_local(HMM_Mat4* out, const AnimSet* set, const AnimState* state) {
+    if (state->anim < 0 || state->anim >= set->num_anims) return false;
+    if (set->num_frames <= 0) return false;
 
     AnimInfo* anim = &set->anims[state->anim];
     float curframe = state->current_frame;
@@ -550,34 +2359,293 @@ void play_anim(u_skeleton_t* out, AnimSet* set, AnimState* state) {
     int global_frame1 = anim->first_frame + frame1;
     int global_frame2 = anim->first_frame + frame2;
 
-    HMM_Mat4* mat1 = &set->frames[global_frame1 * set->num_joints];
-    HMM_Mat4* mat2 = &set->frames[global_frame2 * set->num_joints];
+    if (set->storage == ANIM_STORAGE_QUANTIZED) {
+        _sample_keys(out, set, global_frame1, global_frame2, frameoffset);
+    } else {
+        HMM_Mat4* mat1 = &set->frames[global_frame1 * set->num_joints];
+        HMM_Mat4* mat2 = &set->frames[global_frame2 * set->num_joints];
+        _mat4_lerp_n(out, mat1, mat2, frameoffset, set->num_joints);
+    }
+    return true;
+}
+
+//baked frames already carry the bind pose, quantized ones need the inverse bind applied after the hierarchy
+static void _pose_finish(HMM_Mat4* pose, const AnimSet* set) {
+    _mat4_concat_hierarchy(pose, set->joint_parents, set->num_joints);
+    if (set->storage == ANIM_STORAGE_QUANTIZED) {
+        for (int i = 0; i < set->num_joints; i++) {
+            _mat4_mul_affine(&pose[i], &pose[i], &set->inverse_bind[i]);
+        }
+    }
+}
+
+static inline bool _mask_empty(const AnimMask* mask) {
+    for (int i = 0; i < MAX_BONES / 32; i++) {
+        if (mask->bits[i]) return false;
+    }
+    return true;
+}
 
-    for (int i = 0; i < set->num_joints; i++) {
-        HMM_Mat4 first = HMM_MulM4F(mat1[i], 1.0f - frameoffset);
-        HMM_Mat4 second = HMM_MulM4F(mat2[i], frameoffset);
-        HMM_Mat4 mat = HMM_AddM4(first, second);
+static inline bool _mask_test(const AnimMask* mask, int joint) {
+    return mask->bits[joint >> 5] & (1U << (joint & 31));
+}
 
-        if (set->joint_parents[i] >= 0) {
-            out->bones[i] = HMM_MulM4(out->bones[set->joint_parents[i]], mat);
-        } else {
-            out->bones[i] = mat;
+//override layers lerp towards their clip, additive ones apply lerp(identity, ref^-1 * clip, weight)
+static void _apply_layer(HMM_Mat4* pose, const AnimSet* set, const AnimLayer* layer) {
+    HMM_Mat4 local[MAX_BONES];
+    if (!_sample_local(local, set, &layer->state)) return;
+
+    int n = set->num_joints;
+    float w = HMM_MIN(layer->weight, 1.0f);
+    bool all = _mask_empty(&layer->mask);
+
+    if (layer->flags & ANIM_LAYER_ADDITIVE) {
+        HMM_Mat4 ref[MAX_BONES];
+        AnimState ref_state = layer->state;
+        ref_state.current_frame = 0.0f;
+        _sample_local(ref, set, &ref_state);
+        HMM_Mat4 identity = HMM_M4D(1.0f);
+        for (int i = 0; i < n; i++) {
+            if (!all && !_mask_test(&layer->mask, i)) continue;
+            HMM_Mat4 delta = HMM_MulM4(HMM_InvGeneralM4(ref[i]), local[i]);
+            _mat4_lerp_n(&delta, &identity, &delta, w, 1);
+            _mat4_mul_affine(&pose[i], &pose[i], &delta);
+        }
+    } else if (all) {
+        _mat4_lerp_n(pose, pose, local, w, n);
+    } else {
+        for (int i = 0; i < n; i++) {
+            if (_mask_test(&layer->mask, i)) _mat4_lerp_n(&pose[i], &pose[i], &local[i], w, 1);
         }
     }
 }
 
-void blend_anims(u_skeleton_t* out_a, const u_skeleton_t* out_b, float weight, int num_joints) {
+void play_anim(HMM_Mat4* out, AnimSet* set, AnimState* state) {
+    if (!out || !set || !state) return;
+    if (_sample_local(out, set, state)) _pose_finish(out, set);
+}
+
+void blend_anims(HMM_Mat4* out_a, const HMM_Mat4* out_b, float weight, int num_joints) {
     if (!out_a || !out_b) return;
-    for (int i = 0; i < num_joints; i++) {
-        HMM_Mat4 a = HMM_MulM4F(out_a->bones[i], 1.0f - weight);
-        HMM_Mat4 b = HMM_MulM4F(out_b->bones[i], weight);
-        out_a->bones[i] = HMM_AddM4(a, b);
+    _mat4_lerp_n(out_a, out_a, out_b, weight, num_joints);
+}
+
+bool anim_mask_add_joint(AnimMask* mask, const AnimSet* set, int joint) {
+    if (!mask || !set || joint < 0 || joint >= set->num_joints) return false;
+    mask->bits[joint >> 5] |= 1U << (joint & 31);
+    //parents come before their children, so one pass picks up the whole subtree
+    for (int i = joint + 1; i < set->num_joints; i++) {
+        int parent = set->joint_parents[i];
+        if (parent >= joint && _mask_test(mask, parent)) mask->bits[i >> 5] |= 1U << (i & 31);
+    }
+    return true;
+}
+
+//ANIMATION JOBS
+
+#define ANIM_JOB_CHUNK 16
+
+typedef struct AnimJob {
+    RenderContext* ctx;
+    Scene* scene;
+    Frustum frustum;
+    HMM_Vec3 eye;
+    float dt;
+    uint32_t frame;
+    mt_atomic_int32 next_chunk;
+    mt_atomic_int32 sampled;
+} AnimJob;
+
+typedef struct AnimWorkers {
+    Allocator alloc;
+    mt_thread threads[ANIM_MAX_THREADS];
+    int num_threads;
+    mt_sema start;
+    mt_sema done;
+    mt_atomic_int32 quit;
+    AnimJob* job;
+} AnimWorkers;
+
+//advances one skinned entity and re-samples its pose if visible and due, returns true if sampled
+static bool _anim_entity(AnimJob* job, int idx) {
+    Scene* scene = job->scene;
+    RenderContext* ctx = job->ctx;
+
+    if (!(scene->model_flags[idx] & ENTITY_HAS_MODEL) || !(scene->anim_flags[idx] & ENTITY_HAS_ANIM)) return false;
+    if (scene->models[idx].id == 0) return false;
+
+    Model* model = &ctx->meshes.data[hp_index(scene->models[idx].id)];
+    AnimSet* set = &ctx->anims.data[hp_index(scene->anims[idx].id)];
+    if (set->num_joints == 0) return false; //still loading
+    AnimState* state = &scene->anim_states[idx];
+    AnimState* prev_state = &scene->prev_anim_states[idx];
+
+    //advance the clocks of every skinned entity, visible or not
+    float blend_weight = scene->anim_blend_weights[idx];
+    update_anim_state(state, set, job->dt);
+    if (blend_weight < 1.0f) {
+        update_anim_state(prev_state, set, job->dt);
+        scene->anim_blend_weights[idx] = HMM_MIN(blend_weight + job->dt / ANIM_BLEND_DURATION, 1.0f);
+    }
+    AnimLayer* layers = &scene->anim_layers[idx * ANIM_MAX_LAYERS];
+    for (int l = 0; l < ANIM_MAX_LAYERS; l++) {
+        if (layers[l].weight > 0.0f) update_anim_state(&layers[l].state, set, job->dt);
+    }
+
+    HMM_Mat4 world = scene->world[idx];
+    if (!bounds_in_frustum(&job->frustum, &model->bounds, world)) {
+        scene->anim_flags[idx] &= ~ENTITY_ANIM_CACHED;
+        return false;
+    }
+
+    //animation lod: distant skeletons are re-sampled every 2nd/4th frame, staggered by index
+    float dist_sq = HMM_LenSqrV3(HMM_SubV3(world.Columns[3].XYZ, job->eye));
+    uint32_t rate = dist_sq > ctx->anim_lod.dist_sq[1] ? 4 : (dist_sq > ctx->anim_lod.dist_sq[0] ? 2 : 1);
+    if ((scene->anim_flags[idx] & ENTITY_ANIM_CACHED) && (job->frame + (uint32_t)idx) % rate != 0) return false;
+
+    //everything is blended in local joint space, the hierarchy is walked once at the end
+    HMM_Mat4* pose = &scene->poses[idx * MAX_BONES];
+    if (!_sample_local(pose, set, state)) {
+        for (int i = 0; i < set->num_joints; i++) pose[i] = HMM_M4D(1.0f);
+        scene->anim_flags[idx] |= ENTITY_ANIM_CACHED;
+        return true;
+    }
+
+    //blend with previous animation if transitioning
+    if (blend_weight < 1.0f) {
+        HMM_Mat4 prev[MAX_BONES];
+        if (_sample_local(prev, set, prev_state)) _mat4_lerp_n(pose, prev, pose, blend_weight, set->num_joints);
+    }
+    for (int l = 0; l < ANIM_MAX_LAYERS; l++) {
+        if (layers[l].weight > 0.0f) _apply_layer(pose, set, &layers[l]);
+    }
+    _pose_finish(pose, set);
+    scene->anim_flags[idx] |= ENTITY_ANIM_CACHED;
+    return true;
+}
+
+//claims chunks of the entity pool until none are left, called by the workers and the calling thread
+static void _anim_run(AnimJob* job) {
+    int count = job->scene->pool.count;
+    int sampled = 0;
+    for (;;) {
+        int first = (mt_atomic_increment(&job->next_chunk) - 1) * ANIM_JOB_CHUNK;
+        if (first >= count) break;
+        int last = HMM_MIN(first + ANIM_JOB_CHUNK, count);
+        for (int i = first; i < last; i++) {
+            int idx = hp_index(hp_handle_at(&job->scene->pool, i));
+            if (_anim_entity(job, idx)) sampled++;
+        }
+    }
+    mt_atomic_add(&job->sampled, sampled);
+}
+
+static void* _anim_worker(void* arg) {
+    AnimWorkers* w = arg;
+    for (;;) {
+        mt_sema_wait(&w->start);
+        if (mt_atomic_load(&w->quit)) break;
+        _anim_run(w->job);
+        mt_sema_post(&w->done, 1);
     }
+    return NULL;
+}
+
+static AnimWorkers* _anim_workers_new(Allocator* alloc, int num_threads) {
+    if (num_threads <= 0) return NULL;
+    if (num_threads > ANIM_MAX_THREADS) num_threads = ANIM_MAX_THREADS;
+
+    AnimWorkers* w = core_alloc(alloc, sizeof(AnimWorkers), alignof(AnimWorkers));
+    if (!w) {
+        LOG_ERROR("Failed to allocate animation workers\n");
+        return NULL;
+    }
+    memset(w, 0, sizeof(AnimWorkers));
+    w->alloc = *alloc;
+
+    if (mt_sema_init(&w->start, 0) != 0) {
+        core_free(alloc, w);
+        return NULL;
+    }
+    if (mt_sema_init(&w->done, 0) != 0) {
+        mt_sema_destroy(&w->start);
+        core_free(alloc, w);
+        return NULL;
+    }
+    mt_atomic_init(&w->quit, 0);
+
+    for (int i = 0; i < num_threads; i++) {
+        if (mt_thread_create(&w->threads[i], _anim_worker, w) != 0) break;
+        w->num_threads++;
+    }
+    if (w->num_threads < num_threads) {
+        LOG_WARN("Started %d of %d animation threads\n", w->num_threads, num_threads);
+    }
+    return w;
+}
+
+static void _anim_workers_destroy(AnimWorkers* w) {
+    if (!w) return;
+    mt_atomic_store(&w->quit, 1);
+    mt_sema_post(&w->start, w->num_threads);
+    for (int i = 0; i < w->num_threads; i++) {
+        mt_thread_join(w->threads[i]);
+    }
+    mt_sema_destroy(&w->start);
+    mt_sema_destroy(&w->done);
+    Allocator alloc = w->alloc;
+    core_free(&alloc, w);
+}
+
+void anim_update(Scene* scene, RenderContext* ctx, Camera* cam, float dt) {
+    if (!scene || !ctx || !cam) return;
+
+    HMM_Mat4 view_proj = HMM_MulM4(camera_proj_mtx(cam, ctx->offscreen.width, ctx->offscreen.height), camera_view_mtx(cam));
+    AnimJob job = {
+        .ctx = ctx,
+        .scene = scene,
+        .frustum = frustum_from_mtx(view_proj),
+        .eye = cam->position,
+        .dt = dt,
+        .frame = ++ctx->anim_lod.frame,
+    };
+    mt_atomic_init(&job.next_chunk, 0);
+    mt_atomic_init(&job.sampled, 0);
+
+    AnimWorkers* w = ctx->anim_workers;
+    int chunks = (scene->pool.count + ANIM_JOB_CHUNK - 1) / ANIM_JOB_CHUNK;
+    int helpers = w ? HMM_MIN(w->num_threads, chunks - 1) : 0;
+
+    if (helpers > 0) {
+        w->job = &job;
+        mt_sema_post(&w->start, helpers);
+        _anim_run(&job);
+        for (int i = 0; i < helpers; i++) {
+            mt_sema_wait(&w->done);
+        }
+        w->job = NULL;
+    } else {
+        _anim_run(&job);
+    }
+
+    ctx->stats.skeletons_sampled = mt_atomic_load(&job.sampled);
 }
 
 
 //--GFX----------------------------------------------------------------------------------
 
+//shaders.glsl.h is sokol-shdc output, run shaders/build.bat after changing shaders.glsl
+#if !defined(ATTR_tex_lit_instanced_inst_mtx0) || !defined(VIEW_bone_tex) || !defined(ATTR_tex_lit_compact_normal)
+#error "shaders/shaders.glsl.h is out of date, regenerate it with shaders/build.bat"
+#endif
+
+//sokol-shdc has no output for the dummy backend, which takes any shader source, so headless
+//runs (check.c) get the glsl variant
+static sg_backend _shader_backend(void) {
+    sg_backend backend = sg_query_backend();
+    return backend == SG_BACKEND_DUMMY ? SG_BACKEND_GLCORE : backend;
+}
+
 RenderContext* gfx_new_context(Allocator* alloc, const RenderContextDesc* desc) {
     RenderContext* ctx = core_alloc(alloc, sizeof(RenderContext), alignof(RenderContext));
     if (!ctx) {
@@ -595,7 +2663,7 @@ RenderContext* gfx_new_context(Allocator* alloc, const RenderContextDesc* desc)
         return NULL;
     }
     ctx->anims.data = core_alloc(alloc, desc->max_anim_sets * sizeof(AnimSet), alignof(AnimSet));
-    if (!ctx->anims.data) {
+    if (!ctx->anims.data || !asset_cache_init(&ctx->anims.cache, alloc, desc->max_anim_sets)) {
         LOG_ERROR("Failed to allocate animation data\n");
         return NULL;
     }
@@ -605,6 +2673,36 @@ RenderContext* gfx_new_context(Allocator* alloc, const RenderContextDesc* desc)
         return NULL;
     }
 
+    float lod_half = desc->anim_lod_distances[0] > 0.0f ? desc->anim_lod_distances[0] : ANIM_LOD_DISTANCE_HALF;
+    float lod_quarter = desc->anim_lod_distances[1] > 0.0f ? desc->anim_lod_distances[1] : ANIM_LOD_DISTANCE_QUARTER;
+    ctx->anims.storage = desc->anim_storage;
+    ctx->meshes.load_flags = (desc->compact_vertices ? MODEL_LOAD_COMPACT : 0) |
+                             (desc->optimize_meshes ? MODEL_LOAD_OPTIMIZE : 0);
+    ctx->anim_lod.dist_sq[0] = lod_half * lod_half;
+    ctx->anim_lod.dist_sq[1] = lod_quarter * lod_quarter;
+    ctx->anim_workers = _anim_workers_new(alloc, desc->anim_threads);
+
+    //init render queue, items are allocated on first use
+    ctx->queue.alloc = *alloc;
+
+    //init instancing
+    ctx->instances.max = desc->max_instances > 0 ? desc->max_instances : GFX_DEFAULT_MAX_INSTANCES;
+    ctx->instances.mtx = core_alloc(alloc, ctx->instances.max * sizeof(HMM_Mat4), alignof(HMM_Mat4));
+    if (!ctx->instances.mtx) {
+        LOG_ERROR("Failed to allocate instance data\n");
+        return NULL;
+    }
+
+    //init bone palette, rounded up to whole texture rows
+    int palette_row = GFX_PALETTE_WIDTH / 4;
+    int palette_bones = desc->max_palette_bones > 0 ? desc->max_palette_bones : GFX_DEFAULT_PALETTE_BONES;
+    ctx->palette.max = (palette_bones + palette_row - 1) / palette_row * palette_row;
+    ctx->palette.mtx = core_alloc(alloc, ctx->palette.max * sizeof(HMM_Mat4), alignof(HMM_Mat4));
+    if (!ctx->palette.mtx) {
+        LOG_ERROR("Failed to allocate bone palette\n");
+        return NULL;
+    }
+
     //init meshes
     hp_Handle* mesh_dense = core_alloc(alloc, desc->max_meshes * sizeof(hp_Handle), alignof(hp_Handle));
     int* mesh_sparse = core_alloc(alloc, desc->max_meshes * sizeof(int), alignof(int));
@@ -613,7 +2711,7 @@ RenderContext* gfx_new_context(Allocator* alloc, const RenderContextDesc* desc)
         return NULL;
     }
     ctx->meshes.data = core_alloc(alloc, desc->max_meshes * sizeof(Model), alignof(Model));
-    if (!ctx->meshes.data) {
+    if (!ctx->meshes.data || !asset_cache_init(&ctx->meshes.cache, alloc, desc->max_meshes)) {
         LOG_ERROR("Failed to allocate mesh data\n");
         return NULL;
     }
@@ -626,10 +2724,23 @@ RenderContext* gfx_new_context(Allocator* alloc, const RenderContextDesc* desc)
         return NULL;
     }
     ctx->textures.data = core_alloc(alloc, desc->max_textures * sizeof(Texture), alignof(Texture));
-    if (!ctx->textures.data) {
+    if (!ctx->textures.data || !asset_cache_init(&ctx->textures.cache, alloc, desc->max_textures)) {
         LOG_ERROR("Failed to allocate texture data\n");
         return NULL;
     }
+    if (desc->texture_cache_dir && desc->texture_cache_dir[0]) {
+        size_t len = strlen(desc->texture_cache_dir);
+        if (len < sizeof(ctx->textures.cache_dir)) {
+            memcpy(ctx->textures.cache_dir, desc->texture_cache_dir, len + 1);
+#ifdef _WIN32
+            _mkdir(ctx->textures.cache_dir);
+#else
+            mkdir(ctx->textures.cache_dir, 0755);
+#endif
+        } else {
+            LOG_WARN("Texture cache path too long, caching is off\n");
+        }
+    }
 
     ctx->offscreen.width = desc->width;
     ctx->offscreen.height = desc->height;
@@ -644,6 +2755,23 @@ RenderContext* gfx_new_context(Allocator* alloc, const RenderContextDesc* desc)
         return NULL;
     }
 
+    //init shared geometry, each buffer is made when the first mesh goes into it
+    static const uint32_t geo_strides[GEO_POOL_COUNT] = {
+        sizeof(VertexPNT), sizeof(VertexSkin), sizeof(VertexCompact), sizeof(uint16_t), sizeof(uint32_t)
+    };
+    int geo_verts = desc->geometry_vertices > 0 ? desc->geometry_vertices : GFX_DEFAULT_GEOMETRY_VERTICES;
+    int geo_indices = desc->geometry_indices > 0 ? desc->geometry_indices : GFX_DEFAULT_GEOMETRY_INDICES;
+    ctx->geometry.alloc = *alloc;
+    ctx->geometry.max_ranges = desc->max_meshes * MODEL_MAX_MESHES + 1;
+    for (int i = 0; i < GEO_POOL_COUNT; i++) {
+        ctx->geometry.pools[i].stride = geo_strides[i];
+        ctx->geometry.pools[i].capacity = (uint32_t)(i >= GEO_POOL_INDEX16 ? geo_indices : geo_verts);
+    }
+    sg_features features = sg_query_features();
+    ctx->geometry.base_vertex = features.draw_base_vertex;
+    ctx->geometry.base_instance = features.draw_base_instance;
+    ctx->textures.cache_bc3 = desc->texture_cache_bc3 && sg_query_pixelformat(SG_PIXELFORMAT_BC3_RGBA).sample;
+
     sgl_setup(&(sgl_desc_t){
         .sample_count = 1,
         .logger.func = slog_func,
@@ -754,43 +2882,94 @@ RenderContext* gfx_new_context(Allocator* alloc, const RenderContextDesc* desc)
                 [ATTR_display_shd_uv].format = SG_VERTEXFORMAT_FLOAT2,
             }
         },
-        .shader = sg_make_shader(display_shd_shader_desc(sg_query_backend())),
+        .shader = sg_make_shader(display_shd_shader_desc(_shader_backend())),
         .index_type = SG_INDEXTYPE_UINT16,
         .primitive_type = SG_PRIMITIVETYPE_TRIANGLES,
         .label = "display_pip",
     });
 
-    ctx->offscreen.pip[GFX_PIP_DEFAULT] = sg_make_pipeline(&(sg_pipeline_desc) {
-        .layout = pnt_vtx_layout(),
-        .shader = sg_make_shader(tex_lit_shader_desc(sg_query_backend())),
-        .index_type = SG_INDEXTYPE_UINT32,
-        .depth = {
-            .pixel_format = SG_PIXELFORMAT_DEPTH,
-            .compare = SG_COMPAREFUNC_LESS_EQUAL,
-            .write_enabled = true,
-        },
-        .colors[0].pixel_format = SG_PIXELFORMAT_RGBA8,
+    //one variant per Mesh.format, skinned meshes are never compact
+    sg_shader lit_shd = sg_make_shader(tex_lit_shader_desc(_shader_backend()));
+    sg_shader skinned_shd = sg_make_shader(tex_lit_skinned_shader_desc(_shader_backend()));
+    sg_shader instanced_shd = sg_make_shader(tex_lit_instanced_shader_desc(_shader_backend()));
+    sg_shader lit_compact_shd = sg_make_shader(tex_lit_compact_shader_desc(_shader_backend()));
+    sg_shader instanced_compact_shd = sg_make_shader(tex_lit_instanced_compact_shader_desc(_shader_backend()));
+    for (uint8_t f = 0; f < MESH_FORMAT_COUNT; f++) {
+        sg_index_type index_type = (f & MESH_INDEX16) ? SG_INDEXTYPE_UINT16 : SG_INDEXTYPE_UINT32;
+
+        ctx->offscreen.pip[GFX_PIP_DEFAULT][f] = sg_make_pipeline(&(sg_pipeline_desc) {
+            .layout = _format_vtx_layout(pnt_vtx_layout(), f),
+            .shader = (f & MESH_COMPACT) ? lit_compact_shd : lit_shd,
+            .index_type = index_type,
+            .depth = {
+                .pixel_format = SG_PIXELFORMAT_DEPTH,
+                .compare = SG_COMPAREFUNC_LESS_EQUAL,
+                .write_enabled = true,
+            },
+            .colors[0].pixel_format = SG_PIXELFORMAT_RGBA8,
+        });
+
+        if (!(f & MESH_COMPACT)) {
+            ctx->offscreen.pip[GFX_PIP_SKINNED][f] = sg_make_pipeline(&(sg_pipeline_desc) {
+                .layout = skinned_vtx_layout(),
+                .shader = skinned_shd,
+                .index_type = index_type,
+                .depth = {
+                    .pixel_format = SG_PIXELFORMAT_DEPTH,
+                    .compare = SG_COMPAREFUNC_LESS_EQUAL,
+                    .write_enabled = true,
+                },
+                .colors[0].pixel_format = SG_PIXELFORMAT_RGBA8,
+            });
+        }
+
+        ctx->offscreen.pip[GFX_PIP_INSTANCED][f] = sg_make_pipeline(&(sg_pipeline_desc) {
+            .layout = _format_vtx_layout(instanced_vtx_layout(), f),
+            .shader = (f & MESH_COMPACT) ? instanced_compact_shd : instanced_shd,
+            .index_type = index_type,
+            .depth = {
+                .pixel_format = SG_PIXELFORMAT_DEPTH,
+                .compare = SG_COMPAREFUNC_LESS_EQUAL,
+                .write_enabled = true,
+            },
+            .colors[0].pixel_format = SG_PIXELFORMAT_RGBA8,
+        });
+    }
+
+    ctx->instances.buf = sg_make_buffer(&(sg_buffer_desc){
+        .size = ctx->instances.max * sizeof(HMM_Mat4),
+        .usage.stream_update = true,
+        .label = "instance buffer"
     });
 
-    ctx->offscreen.pip[GFX_PIP_SKINNED] = sg_make_pipeline(&(sg_pipeline_desc) {
-        .layout = skinned_vtx_layout(),
-        .shader = sg_make_shader(tex_lit_skinned_shader_desc(sg_query_backend())),
-        .index_type = SG_INDEXTYPE_UINT32,
-        .depth = {
-            .pixel_format = SG_PIXELFORMAT_DEPTH,
-            .compare = SG_COMPAREFUNC_LESS_EQUAL,
-            .write_enabled = true,
-        },
-        .colors[0].pixel_format = SG_PIXELFORMAT_RGBA8,
+    int palette_rows = ctx->palette.max / palette_row;
+    for (int rows = 1; ctx->palette.num_sizes < GFX_PALETTE_SIZES; rows *= 2) {
+        int i = ctx->palette.num_sizes++;
+        if (rows >= palette_rows || i == GFX_PALETTE_SIZES - 1) rows = palette_rows;
+        ctx->palette.img[i] = sg_make_image(&(sg_image_desc){
+            .width = GFX_PALETTE_WIDTH,
+            .height = rows,
+            .pixel_format = SG_PIXELFORMAT_RGBA32F,
+            .usage.stream_update = true,
+            .label = "bone palette"
+        });
+        ctx->palette.view[i] = sg_make_view(&(sg_view_desc){ .texture.image = ctx->palette.img[i] });
+        if (rows == palette_rows) break;
+    }
+    ctx->palette.smp = sg_make_sampler(&(sg_sampler_desc){
+        .min_filter = SG_FILTER_NEAREST,
+        .mag_filter = SG_FILTER_NEAREST,
+        .wrap_u = SG_WRAP_CLAMP_TO_EDGE,
+        .wrap_v = SG_WRAP_CLAMP_TO_EDGE,
     });
 
     //CUBEMAP
 
-    ctx->offscreen.pip[GFX_PIP_CUBEMAP] = sg_make_pipeline(&(sg_pipeline_desc) {
+    ctx->offscreen.pip[GFX_PIP_CUBEMAP][0] = sg_make_pipeline(&(sg_pipeline_desc) {
         .layout.attrs = {
             [ATTR_cubemap_pos] = {.format = SG_VERTEXFORMAT_FLOAT3, .buffer_index = 0},
         },
-        .shader = sg_make_shader(cubemap_shader_desc((sg_query_backend()))),
+        .shader = sg_make_shader(cubemap_shader_desc(_shader_backend())),
         .index_type = SG_INDEXTYPE_UINT16,
         .depth = {
             .pixel_format = SG_PIXELFORMAT_DEPTH,
@@ -800,40 +2979,277 @@ RenderContext* gfx_new_context(Allocator* alloc, const RenderContextDesc* desc)
         .colors[0].pixel_format = SG_PIXELFORMAT_RGBA8,
     });
 
-    ctx->offscreen.light = (u_dir_light_t) {
-        .ambient = {0.2f, 0.2f, 0.2f, 1.0f},
-        .diffuse = {1.0f, 1.0f, 1.0f, 1.0f},
-        .direction = {0.25f, -0.75f, -0.25f},
-    };
+    ctx->offscreen.light = (u_dir_light_t) {
+        .ambient = {0.2f, 0.2f, 0.2f, 1.0f},
+        .diffuse = {1.0f, 1.0f, 1.0f, 1.0f},
+        .direction = {0.25f, -0.75f, -0.25f},
+    };
+
+    ctx->offscreen.default_sampler = sg_make_sampler(&(sg_sampler_desc){
+        .wrap_u = SG_WRAP_CLAMP_TO_BORDER,
+        .wrap_v = SG_WRAP_CLAMP_TO_BORDER,
+    });
+
+    LOG_INFO("Graphics initialized.\n");
+    return ctx;
+}
+
+
+//RENDER QUEUE
+
+//sort key layout, state bits above depth so equal states end up adjacent
+#define RQ_PIP_SHIFT    62
+#define RQ_FORMAT_SHIFT 60
+#define RQ_TEX_SHIFT    44
+#define RQ_MODEL_SHIFT  28
+#define RQ_MESH_SHIFT   26
+#define RQ_DEPTH_SHIFT  10
+#define RQ_STATE_MASK   (~((1ULL << RQ_MESH_SHIFT) - 1))
+
+static uint64_t _rq_key(int pip, uint8_t format, hp_Handle tex, hp_Handle model, int mesh, float depth01) {
+    uint64_t depth = (uint64_t)(HMM_Clamp(0.0f, depth01, 1.0f) * 65535.0f);
+    return ((uint64_t)pip << RQ_PIP_SHIFT)
+         | ((uint64_t)(format & 0x3) << RQ_FORMAT_SHIFT)
+         | ((uint64_t)(hp_index(tex) & 0xffff) << RQ_TEX_SHIFT)
+         | ((uint64_t)(hp_index(model) & 0xffff) << RQ_MODEL_SHIFT)
+         | ((uint64_t)(mesh & 0x3) << RQ_MESH_SHIFT)
+         | (depth << RQ_DEPTH_SHIFT);
+}
+
+//lsd radix sort on 8 bit digits, digits shared by all keys are skipped, returns the sorted buffer
+static RenderItem* _rq_sort(RenderItem* items, RenderItem* tmp, int count) {
+    for (int shift = 0; shift < 64 && count > 1; shift += 8) {
+        int hist[256] = {0};
+        for (int i = 0; i < count; i++) hist[(items[i].key >> shift) & 0xff]++;
+        if (hist[(items[0].key >> shift) & 0xff] == count) continue;
+
+        int sum = 0;
+        for (int b = 0; b < 256; b++) {
+            int c = hist[b];
+            hist[b] = sum;
+            sum += c;
+        }
+        for (int i = 0; i < count; i++) {
+            tmp[hist[(items[i].key >> shift) & 0xff]++] = items[i];
+        }
+        RenderItem* swap = items;
+        items = tmp;
+        tmp = swap;
+    }
+    return items;
+}
+
+//collects one item per visible mesh, returns the sorted items or NULL
+static RenderItem* _rq_build(RenderContext* ctx, Scene* scene, const Frustum* frustum, Camera* cam, int* out_count) {
+    *out_count = 0;
+    int cap = scene->pool.capacity * MODEL_MAX_MESHES;
+    if (ctx->queue.cap < cap) {
+        core_free(&ctx->queue.alloc, ctx->queue.items);
+        core_free(&ctx->queue.alloc, ctx->queue.tmp);
+        ctx->queue.items = core_alloc(&ctx->queue.alloc, cap * sizeof(RenderItem), alignof(RenderItem));
+        ctx->queue.tmp = core_alloc(&ctx->queue.alloc, cap * sizeof(RenderItem), alignof(RenderItem));
+        ctx->queue.cap = (ctx->queue.items && ctx->queue.tmp) ? cap : 0;
+        if (!ctx->queue.cap) {
+            LOG_ERROR("Failed to allocate render queue\n");
+            return NULL;
+        }
+    }
+
+    RenderItem* items = ctx->queue.items;
+    int count = 0;
+    int num_bones = 0;
+    int palette_skipped = 0;
+    float inv_far = 1.0f / cam->farz;
+
+    for (int i = 0; i < scene->pool.count; i++) {
+        int idx = hp_index(hp_handle_at(&scene->pool, i));
+        if (!(scene->model_flags[idx] & ENTITY_HAS_MODEL) || scene->models[idx].id == 0) continue;
+
+        Model* model = &ctx->meshes.data[hp_index(scene->models[idx].id)];
+        if (model->meshes_count == 0) continue; //still loading
+        if (!bounds_in_frustum(frustum, &model->bounds, scene->world[idx])) {
+            ctx->stats.culled++;
+            continue;
+        }
+        ctx->stats.visible++;
+
+        bool skinned = scene->anim_flags[idx] & ENTITY_HAS_ANIM;
+        //pose is written by anim_update, nothing to draw until it has sampled one
+        if (skinned && !(scene->anim_flags[idx] & ENTITY_ANIM_CACHED)) continue;
+
+        //copy only the joints the rig uses into this frame's palette
+        int bone_base = 0;
+        if (skinned) {
+            int num_joints = ctx->anims.data[hp_index(scene->anims[idx].id)].num_joints;
+            if (num_joints == 0) continue; //anim set still loading
+            if (num_bones + num_joints > ctx->palette.max) {
+                palette_skipped++;
+                continue;
+            }
+            memcpy(&ctx->palette.mtx[num_bones], &scene->poses[idx * MAX_BONES], num_joints * sizeof(HMM_Mat4));
+            bone_base = num_bones;
+            num_bones += num_joints;
+        }
+
+        float depth = HMM_LenV3(HMM_SubV3(scene->world[idx].Columns[3].XYZ, cam->position)) * inv_far;
+        for (int j = 0; j < model->meshes_count; j++) {
+            Mesh* mesh = &model->meshes[j];
+            if (mesh->vbufs[0].id == SG_INVALID_ID) continue;
+            if (skinned && mesh->vbufs[1].id == SG_INVALID_ID) continue;
+
+            //static models only ever used the first texture
+            int pip = skinned ? GFX_PIP_SKINNED : GFX_PIP_INSTANCED;
+            hp_Handle tex = scene->textures[idx].tex[skinned ? j : 0].id;
+            if (ctx->textures.data[hp_index(tex)].view.id == SG_INVALID_ID) continue; //still loading
+            items[count].key = _rq_key(pip, mesh->format, tex, scene->models[idx].id, j, depth);
+            items[count].idx = idx;
+            items[count].bone_base = bone_base;
+            count++;
+        }
+    }
 
-    ctx->offscreen.default_sampler = sg_make_sampler(&(sg_sampler_desc){
-        .wrap_u = SG_WRAP_CLAMP_TO_BORDER,
-        .wrap_v = SG_WRAP_CLAMP_TO_BORDER,
-    });
+    if (palette_skipped > 0) {
+        LOG_WARN("Bone palette full, skipped %d skinned entities\n", palette_skipped);
+    }
+    if (num_bones > 0) {
+        //sizes but the last have 1 << size rows, so at most twice the used rows go to the gpu
+        int row = GFX_PALETTE_WIDTH / 4;
+        int last = ctx->palette.num_sizes - 1;
+        int size = 0;
+        while (size < last && (1 << size) * row < num_bones) size++;
+        int bones = size < last ? (1 << size) * row : ctx->palette.max;
+        ctx->palette.cur = size;
+        sg_update_image(ctx->palette.img[size], &(sg_image_data){
+            .mip_levels[0] = { ctx->palette.mtx, (size_t)bones * sizeof(HMM_Mat4) }
+        });
+    }
 
-    LOG_INFO("Graphics initialized.\n");
-    return ctx;
+    *out_count = count;
+    return _rq_sort(items, ctx->queue.tmp, count);
 }
 
+//draws the sorted items, consecutive static items with the same state become one instanced draw
+static void _rq_submit(RenderContext* ctx, Scene* scene, const RenderItem* items, int count, u_vs_params_t* u_vs) {
+    //instance data follows queue order, so each instanced run is a contiguous range
+    int num_instanced = 0;
+    for (int i = 0; i < count && num_instanced < ctx->instances.max; i++) {
+        if ((int)(items[i].key >> RQ_PIP_SHIFT) != GFX_PIP_INSTANCED) continue;
+        int idx = items[i].idx;
+        if (((items[i].key >> RQ_FORMAT_SHIFT) & 0x3) & MESH_COMPACT) {
+            const Model* model = &ctx->meshes.data[hp_index(scene->models[idx].id)];
+            ctx->instances.mtx[num_instanced++] = HMM_MulM4(scene->world[idx], model->dequant);
+        } else {
+            ctx->instances.mtx[num_instanced++] = scene->world[idx];
+        }
+    }
+    if (num_instanced > 0) {
+        sg_update_buffer(ctx->instances.buf, &(sg_range){ ctx->instances.mtx, num_instanced * sizeof(HMM_Mat4) });
+    }
+
+    int cur_pip = -1;
+    uint8_t cur_format = 0;
+    int cur_uniforms = -1;
+    bool binds_valid = false;
+    sg_bindings cur_binds = {0};
+    int inst_used = 0;
+
+    for (int i = 0; i < count;) {
+        const RenderItem* item = &items[i];
+        int idx = item->idx;
+        int pip = (int)(item->key >> RQ_PIP_SHIFT);
+        int mesh_idx = (int)((item->key >> RQ_MESH_SHIFT) & 0x3);
+        Model* model = &ctx->meshes.data[hp_index(scene->models[idx].id)];
+        Mesh* mesh = &model->meshes[mesh_idx];
+
+        int run = 1;
+        if (pip == GFX_PIP_INSTANCED) {
+            while (i + run < count && (items[i + run].key & RQ_STATE_MASK) == (item->key & RQ_STATE_MASK)) run++;
+            run = HMM_MIN(run, ctx->instances.max - inst_used);
+            //instance buffer is full, draw the rest one by one
+            if (run == 0) {
+                pip = GFX_PIP_DEFAULT;
+                run = 1;
+            }
+        }
+
+        if (pip != cur_pip || mesh->format != cur_format) {
+            sg_apply_pipeline(ctx->offscreen.pip[pip][mesh->format]);
+            sg_apply_uniforms(UB_u_dir_light, &SG_RANGE(ctx->offscreen.light));
+            if (pip == GFX_PIP_INSTANCED) {
+                u_vs->model = HMM_M4D(1.0f);
+                sg_apply_uniforms(UB_u_vs_params, &(sg_range){ u_vs, sizeof(u_vs_params_t) });
+            }
+            cur_pip = pip;
+            cur_format = mesh->format;
+            cur_uniforms = -1;
+            binds_valid = false;
+            ctx->stats.pipeline_changes++;
+        }
+
+        //with base vertex and instance draws, meshes in the same shared buffers bind the same
+        sg_bindings binds = {0};
+        int base_vertex = ctx->geometry.base_vertex ? mesh->base_vertex : 0;
+        int base_instance = 0;
+        binds.vertex_buffers[0] = mesh->vbufs[0];
+        binds.vertex_buffer_offsets[0] = (mesh->base_vertex - base_vertex) * (int)_vertex_size(mesh->format);
+        if (pip == GFX_PIP_SKINNED) {
+            binds.vertex_buffers[1] = mesh->vbufs[1];
+            binds.vertex_buffer_offsets[1] = (mesh->base_vertex - base_vertex) * (int)sizeof(VertexSkin);
+        } else if (pip == GFX_PIP_INSTANCED) {
+            binds.vertex_buffers[1] = ctx->instances.buf;
+            if (ctx->geometry.base_instance) base_instance = inst_used;
+            else binds.vertex_buffer_offsets[1] = inst_used * (int)sizeof(HMM_Mat4);
+        }
+        binds.index_buffer = mesh->ibuf;
+        binds.samplers[0] = ctx->offscreen.default_sampler;
+        binds.views[0] = ctx->textures.data[hp_index(scene->textures[idx].tex[pip == GFX_PIP_SKINNED ? mesh_idx : 0].id)].view;
+        if (pip == GFX_PIP_SKINNED) {
+            binds.views[VIEW_bone_tex] = ctx->palette.view[ctx->palette.cur];
+            binds.samplers[SMP_bone_smp] = ctx->palette.smp;
+        }
+        if (!binds_valid || memcmp(&binds, &cur_binds, sizeof(sg_bindings)) != 0) {
+            sg_apply_bindings(&binds);
+            cur_binds = binds;
+            binds_valid = true;
+            ctx->stats.binding_changes++;
+        }
+
+        if (pip != GFX_PIP_INSTANCED && idx != cur_uniforms) {
+            u_vs->model = (mesh->format & MESH_COMPACT) ? HMM_MulM4(scene->world[idx], model->dequant) : scene->world[idx];
+            sg_apply_uniforms(UB_u_vs_params, &(sg_range){ u_vs, sizeof(u_vs_params_t) });
+            if (pip == GFX_PIP_SKINNED) {
+                u_skin_t skin = { .bone_base = item->bone_base };
+                sg_apply_uniforms(UB_u_skin, &SG_RANGE(skin));
+            }
+            cur_uniforms = idx;
+        }
 
-void gfx_render(RenderContext* ctx, Scene* scene, Camera* cam, sg_swapchain swapchain, float dt) {
+        sg_draw_ex(mesh->first_element, mesh->element_count, run, base_vertex, base_instance);
+        ctx->stats.draw_calls++;
+        if (pip == GFX_PIP_INSTANCED) inst_used += run;
+        i += run;
+    }
+}
 
-    u_skeleton_t u_skel = {0};
-    u_skeleton_t u_skel_prev = {0};
-    AnimState* anim_states = scene->anim_states;
-    AnimState* prev_anim_states = scene->prev_anim_states;
-    float* blend_weights = scene->anim_blend_weights;
+void gfx_render(RenderContext* ctx, Scene* scene, Camera* cam, sg_swapchain swapchain) {
 
     u_vs_params_t u_vs = {
         .view = camera_view_mtx(cam),
         .proj = camera_proj_mtx(cam, ctx->offscreen.width, ctx->offscreen.height),
     };
+    Frustum frustum = frustum_from_mtx(HMM_MulM4(u_vs.proj, u_vs.view));
+    ctx->stats.visible = 0;
+    ctx->stats.culled = 0;
+    ctx->stats.draw_calls = 0;
+    ctx->stats.pipeline_changes = 0;
+    ctx->stats.binding_changes = 0;
+    _geo_flush(ctx);
 
     //offscreen pass
     sg_begin_pass(&ctx->offscreen.pass);
 
     if(ctx->offscreen.cubemap.vbuf.id != SG_INVALID_ID) {
-        sg_apply_pipeline(ctx->offscreen.pip[GFX_PIP_CUBEMAP]);
+        sg_apply_pipeline(ctx->offscreen.pip[GFX_PIP_CUBEMAP][0]);
         sg_bindings binds = {0};
         binds.vertex_buffers[0] = ctx->offscreen.cubemap.vbuf;
         binds.index_buffer = ctx->offscreen.cubemap.ibuf;
@@ -845,93 +3261,9 @@ void gfx_render(RenderContext* ctx, Scene* scene, Camera* cam, sg_swapchain swap
         sg_draw(0, 36, 1);
     }
 
-    sg_apply_pipeline(ctx->offscreen.pip[GFX_PIP_SKINNED]);
-    sg_apply_uniforms(UB_u_dir_light, &SG_RANGE(ctx->offscreen.light));
-
-    for (int i = 0; i < scene->pool.count; i++) {
-        Entity handle = { .id = hp_handle_at(&scene->pool, i) };
-        int idx = hp_index(handle.id);
-
-        uint16_t model_flags = scene->model_flags[idx];
-        uint16_t anim_flags = scene->anim_flags[idx];
-
-        if ((model_flags & ENTITY_HAS_MODEL) && (anim_flags & ENTITY_HAS_ANIM)) {
-            if (scene->models[idx].id == 0) continue;
-
-            int mdl_idx = hp_index(scene->models[idx].id);
-            Model* model = &ctx->meshes.data[mdl_idx];
-
-            u_vs.model = entity_mtx(scene, handle);
-
-            int anim_idx = hp_index(scene->anims[idx].id);
-            AnimSet* set = &ctx->anims.data[anim_idx];
-
-            //advance and sample current animation
-            update_anim_state(&anim_states[idx], set, dt);
-            memset(&u_skel, 0, sizeof(u_skel));
-            play_anim(&u_skel, set, &anim_states[idx]);
-
-            //blend with previous animation if transitioning
-            if (blend_weights[idx] < 1.0f) {
-                update_anim_state(&prev_anim_states[idx], set, dt);
-                memset(&u_skel_prev, 0, sizeof(u_skel_prev));
-                play_anim(&u_skel_prev, set, &prev_anim_states[idx]);
-                blend_anims(&u_skel, &u_skel_prev, 1.0f - blend_weights[idx], set->num_joints);
-
-                blend_weights[idx] += dt / ANIM_BLEND_DURATION;
-                if (blend_weights[idx] > 1.0f) blend_weights[idx] = 1.0f;
-            }
-
-            sg_apply_uniforms(UB_u_skeleton, &SG_RANGE(u_skel));
-            sg_apply_uniforms(UB_u_vs_params, &SG_RANGE(u_vs));
-
-            for (int j = 0; j < model->meshes_count; j++) {
-                Mesh* mesh = &model->meshes[j];
-                if (mesh->vbufs[0].id == SG_INVALID_ID || mesh->vbufs[1].id == SG_INVALID_ID) continue;
-                sg_bindings binds = {0};
-                memcpy(&binds.vertex_buffers, mesh->vbufs, MESH_MAX_VBUFS * sizeof(sg_buffer));
-                binds.index_buffer = mesh->ibuf;
-                binds.samplers[0] = ctx->offscreen.default_sampler;
-                binds.views[0] = ctx->textures.data[hp_index(scene->textures[idx].tex[j].id)].view;
-                sg_apply_bindings(&binds);
-                sg_draw(0, mesh->element_count, 1);
-            }
-        }
-    }
-
-    sg_apply_pipeline(ctx->offscreen.pip[GFX_PIP_DEFAULT]);
-    sg_apply_uniforms(UB_u_dir_light, &SG_RANGE(ctx->offscreen.light));
-
-    for (int i = 0; i < scene->pool.count; i++) {
-        Entity handle = { .id = hp_handle_at(&scene->pool, i) };
-        int idx = hp_index(handle.id);
-
-        uint16_t model_flags = scene->model_flags[idx];
-        uint16_t anim_flags = scene->anim_flags[idx];
-
-        if ((model_flags & ENTITY_HAS_MODEL) && !(anim_flags & ENTITY_HAS_ANIM)) {
-            if (scene->models[idx].id == 0) continue;
-
-            int mdl_idx = hp_index(scene->models[idx].id);
-            Model* model = &ctx->meshes.data[mdl_idx];
-
-            u_vs.model = entity_mtx(scene, handle);
-
-            sg_apply_uniforms(UB_u_vs_params, &SG_RANGE(u_vs));
-
-            for (int j = 0; j < model->meshes_count; j++) {
-                Mesh* mesh = &model->meshes[j];
-                if (mesh->vbufs[0].id == SG_INVALID_ID) continue;
-                sg_bindings binds = {0};
-                memcpy(&binds.vertex_buffers, mesh->vbufs, MESH_MAX_VBUFS * sizeof(sg_buffer));
-                binds.index_buffer = mesh->ibuf;
-                binds.samplers[0] = ctx->offscreen.default_sampler;
-                binds.views[0] = ctx->textures.data[hp_index(scene->textures[idx].tex[0].id)].view;
-                sg_apply_bindings(&binds);
-                sg_draw(0, mesh->element_count, 1);
-            }
-        }
-    }
+    int num_items = 0;
+    RenderItem* items = _rq_build(ctx, scene, &frustum, cam, &num_items);
+    if (items) _rq_submit(ctx, scene, items, num_items, &u_vs);
 
     //(debug visualization)
     sgl_defaults();
@@ -991,7 +3323,7 @@ void gfx_render(RenderContext* ctx, Scene* scene, Camera* cam, sg_swapchain swap
 void gfx_reset(RenderContext* ctx) {
     for (int i = 0; i < ctx->meshes.pool.count; i++) {
         hp_Handle hnd = hp_handle_at(&ctx->meshes.pool, i);
-        release_model(&ctx->meshes.data[hp_index(hnd)]);
+        release_model(ctx, &ctx->meshes.data[hp_index(hnd)]);
     }
     hp_reset(&ctx->meshes.pool);
 
@@ -1006,7 +3338,70 @@ void gfx_reset(RenderContext* ctx) {
     gfx_clear_anims(ctx);
 }
 
+//frees unreferenced models and textures. when dropping, every reference goes first and only
+//uncached assets are freed, the cached ones wait for the new script
+static void _gfx_sweep(RenderContext* ctx, bool drop) {
+    //backwards, releasing a handle moves the last live one into its place
+    for (int i = ctx->meshes.pool.count - 1; i >= 0; i--) {
+        hp_Handle hnd = hp_handle_at(&ctx->meshes.pool, i);
+        int idx = hp_index(hnd);
+        if (drop) ctx->meshes.cache.refs[idx] = 0;
+        if (ctx->meshes.cache.refs[idx] == 0 && !(drop && ctx->meshes.cache.keys[idx] != 0)) {
+            ctx->meshes.cache.keys[idx] = 0;
+            release_model(ctx, &ctx->meshes.data[idx]);
+            hp_release_handle(&ctx->meshes.pool, hnd);
+        }
+    }
+    for (int i = ctx->textures.pool.count - 1; i >= 0; i--) {
+        hp_Handle hnd = hp_handle_at(&ctx->textures.pool, i);
+        int idx = hp_index(hnd);
+        if (drop) ctx->textures.cache.refs[idx] = 0;
+        if (ctx->textures.cache.refs[idx] == 0 && !(drop && ctx->textures.cache.keys[idx] != 0)) {
+            ctx->textures.cache.keys[idx] = 0;
+            sg_destroy_image(ctx->textures.data[idx].image);
+            sg_destroy_view(ctx->textures.data[idx].view);
+            hp_release_handle(&ctx->textures.pool, hnd);
+        }
+    }
+    //anim sets share one arena, so they can only go all at once: if the new script uses any of
+    //them the rest linger until the next reload
+    bool anims_used = false;
+    for (int i = 0; i < ctx->anims.pool.count; i++) {
+        int idx = hp_index(hp_handle_at(&ctx->anims.pool, i));
+        if (drop) ctx->anims.cache.refs[idx] = 0;
+        anims_used |= ctx->anims.cache.refs[idx] > 0;
+    }
+    if (!drop && !anims_used) gfx_clear_anims(ctx);
+}
+
+void gfx_begin_reload(RenderContext* ctx) {
+    ctx->meshes.cache.hold = ctx->textures.cache.hold = ctx->anims.cache.hold = true;
+    _gfx_sweep(ctx, true);
+}
+
+void gfx_end_reload(RenderContext* ctx) {
+    ctx->meshes.cache.hold = ctx->textures.cache.hold = ctx->anims.cache.hold = false;
+    _gfx_sweep(ctx, false);
+}
+
 void gfx_shutdown(RenderContext* ctx) {
+    _anim_workers_destroy(ctx->anim_workers);
+    ctx->anim_workers = NULL;
+    core_free(&ctx->queue.alloc, ctx->queue.items);
+    core_free(&ctx->queue.alloc, ctx->queue.tmp);
+    core_free(&ctx->queue.alloc, ctx->instances.mtx);
+    core_free(&ctx->queue.alloc, ctx->palette.mtx);
+    ctx->queue.items = NULL;
+    ctx->queue.tmp = NULL;
+    ctx->queue.cap = 0;
+    ctx->instances.mtx = NULL;
+    ctx->palette.mtx = NULL;
+    for (int i = 0; i < GEO_POOL_COUNT; i++) {
+        core_free(&ctx->geometry.alloc, ctx->geometry.pools[i].shadow);
+        core_free(&ctx->geometry.alloc, ctx->geometry.pools[i].free);
+        ctx->geometry.pools[i].shadow = NULL;
+        ctx->geometry.pools[i].free = NULL;
+    }
     arena_pop(&ctx->anims.alloc);
     hp_reset(&ctx->anims.pool);
     hp_reset(&ctx->meshes.pool);
@@ -1017,6 +3412,10 @@ void gfx_shutdown(RenderContext* ctx) {
     LOG_INFO("Graphics shutdown.\n");
 }
 
+RenderStats gfx_get_stats(RenderContext* ctx) {
+    return ctx->stats;
+}
+
 void gfx_load_cubemap(RenderContext* ctx, ArenaAlloc* alloc, IoMemory* mem) {
     ddsktx_texture_info tc = {0};
     if (!ddsktx_parse(&tc, (const void*)mem->ptr, (int)mem->size, NULL)) {
@@ -1114,37 +3513,63 @@ ModelHandle gfx_load_model(RenderContext* ctx, ArenaAlloc* alloc, const IoMemory
         LOG_ERROR("Failed to allocate handle!");
         return (ModelHandle) {HP_INVALID_HANDLE};
     }
-    Result result = load_model(alloc, &ctx->meshes.data[hp_index(hnd)], data);
+    Result result = load_model(ctx, alloc, &ctx->meshes.data[hp_index(hnd)], data, ctx->meshes.load_flags);
     if (result != RESULT_SUCCESS) {
         LOG_ERROR("Failed to load model");
         hp_release_handle(&ctx->meshes.pool, hnd);
         return (ModelHandle) {HP_INVALID_HANDLE};
     }
+    asset_cache_insert(&ctx->meshes.cache, hnd, 0);
     return (ModelHandle) { hnd };
 }
 
 void gfx_release_model(RenderContext* ctx, ModelHandle mesh) {
+    if (!hp_valid_handle(&ctx->meshes.pool, mesh.id)) return;
+    if (!asset_cache_release(&ctx->meshes.cache, mesh.id)) return;
     int idx = hp_index(mesh.id);
-    release_model(&ctx->meshes.data[idx]);
+    release_model(ctx, &ctx->meshes.data[idx]);
     hp_release_handle(&ctx->meshes.pool, mesh.id);
 }
 
-TextureHandle gfx_load_texture(RenderContext* ctx, ArenaAlloc* alloc, IoMemory* data) {
+static TextureCache _texture_cache(const RenderContext* ctx) {
+    return (TextureCache){
+        .dir = ctx->textures.cache_dir[0] ? ctx->textures.cache_dir : NULL,
+        .bc3 = ctx->textures.cache_bc3,
+    };
+}
+
+TextureHandle gfx_load_texture(RenderContext* ctx, IoMemory* data) {
     hp_Handle hnd = hp_create_handle(&ctx->textures.pool);
     if (hnd == HP_INVALID_HANDLE) {
         LOG_ERROR("Failed to allocate handle!");
         return (TextureHandle) {HP_INVALID_HANDLE};
     }
-    Result result = load_texture(alloc, &ctx->textures.data[hp_index(hnd)], data);
+    TextureCache cache = _texture_cache(ctx);
+    Result result = load_texture(&ctx->textures.data[hp_index(hnd)], data, &cache);
     if (result != RESULT_SUCCESS) {
         LOG_ERROR("Failed to create mesh");
         hp_release_handle(&ctx->textures.pool, hnd);
         return (TextureHandle) {HP_INVALID_HANDLE};
     }
+    asset_cache_insert(&ctx->textures.cache, hnd, 0);
     return (TextureHandle) { hnd };
 }
 
+bool gfx_texture_cache_miss(RenderContext* ctx, const IoMemory* data, uint64_t* hash) {
+    TextureCache cache = _texture_cache(ctx);
+    char path[512];
+    if (!cache.dir || !_is_webp(data)) return false;
+    cache.hash = _texture_cache_hash(data);
+    if (hash) *hash = cache.hash;
+    if (!_texture_cache_path(path, sizeof(path), &cache, data)) return false;
+    FILE* f = fopen(path, "rb");
+    if (f) fclose(f);
+    return f == NULL;
+}
+
 void gfx_release_texture(RenderContext* ctx, TextureHandle tex) {
+    if (!hp_valid_handle(&ctx->textures.pool, tex.id)) return;
+    if (!asset_cache_release(&ctx->textures.cache, tex.id)) return;
     int idx = hp_index(tex.id);
     sg_destroy_image(ctx->textures.data[idx].image);
     sg_destroy_view(ctx->textures.data[idx].view);
@@ -1157,16 +3582,26 @@ AnimSetHandle gfx_load_anims(RenderContext* ctx, const IoMemory* data) {
         LOG_ERROR("Failed to allocate handle!");
         return (AnimSetHandle) {HP_INVALID_HANDLE};
     }
-    Result result = load_anims(&ctx->anims.alloc, &ctx->anims.data[hp_index(hnd)], data);
+    Result result = load_anims(&ctx->anims.alloc, &ctx->anims.data[hp_index(hnd)], data, ctx->anims.storage);
     if (result != RESULT_SUCCESS) {
         LOG_ERROR("Failed to load anims");
         hp_release_handle(&ctx->anims.pool, hnd);
         return (AnimSetHandle) {HP_INVALID_HANDLE};
     }
+    asset_cache_insert(&ctx->anims.cache, hnd, 0);
     return (AnimSetHandle) { hnd };
 }
 
 void gfx_clear_anims(RenderContext* ctx) {
+    if (ctx->anims.cache.hold) {
+        //during a reload the sets stay around for the new script, gfx_end_reload decides
+        for (int i = 0; i < ctx->anims.pool.count; i++) {
+            ctx->anims.cache.refs[hp_index(hp_handle_at(&ctx->anims.pool, i))] = 0;
+        }
+        return;
+    }
+    memset(ctx->anims.cache.keys, 0, ctx->anims.pool.capacity * sizeof(uint64_t));
+    memset(ctx->anims.cache.refs, 0, ctx->anims.pool.capacity * sizeof(uint32_t));
     arena_reset(&ctx->anims.alloc);
     hp_reset(&ctx->anims.pool);
 }
@@ -1308,7 +3743,7 @@ AudioContext* sfx_new_context(Allocator* alloc, uint16_t max_buffers) {
         return NULL;
     }
     ctx->buffers.data = core_alloc(alloc, max_buffers * sizeof(SoundBuffer), alignof(SoundBuffer));
-    if (!ctx->buffers.data) {
+    if (!ctx->buffers.data || !asset_cache_init(&ctx->buffers.cache, alloc, max_buffers)) {
         return NULL;
     }
 
@@ -1422,11 +3857,35 @@ void sfx_reset(AudioContext* ctx) {
     tm_stop_all_sources();
     for (int i = 0; i < ctx->buffers.pool.count; i++) {
         hp_Handle hnd = hp_handle_at(&ctx->buffers.pool, i);
-        tm_release_buffer(ctx->buffers.data[hp_index(hnd)]);
+        if (ctx->buffers.data[hp_index(hnd)]) tm_release_buffer(ctx->buffers.data[hp_index(hnd)]);
     }
     hp_reset(&ctx->buffers.pool);
 }
 
+static void _sfx_sweep(AudioContext* ctx, bool drop) {
+    for (int i = ctx->buffers.pool.count - 1; i >= 0; i--) {
+        hp_Handle hnd = hp_handle_at(&ctx->buffers.pool, i);
+        int idx = hp_index(hnd);
+        if (drop) ctx->buffers.cache.refs[idx] = 0;
+        if (ctx->buffers.cache.refs[idx] == 0 && !(drop && ctx->buffers.cache.keys[idx] != 0)) {
+            ctx->buffers.cache.keys[idx] = 0;
+            if (ctx->buffers.data[idx]) tm_release_buffer(ctx->buffers.data[idx]);
+            hp_release_handle(&ctx->buffers.pool, hnd);
+        }
+    }
+}
+
+void sfx_begin_reload(AudioContext* ctx) {
+    tm_stop_all_sources();
+    ctx->buffers.cache.hold = true;
+    _sfx_sweep(ctx, true);
+}
+
+void sfx_end_reload(AudioContext* ctx) {
+    ctx->buffers.cache.hold = false;
+    _sfx_sweep(ctx, false);
+}
+
 void sfx_shutdown(AudioContext* ctx) {
     if (saudio_isvalid()) {
         tm_stop_all_sources();
@@ -1455,16 +3914,493 @@ SoundBufferHandle sfx_load_buffer(AudioContext* ctx, IoMemory* data) {
         hp_release_handle(&ctx->buffers.pool, hnd);
         return (SoundBufferHandle) {HP_INVALID_HANDLE};
     }
+    asset_cache_insert(&ctx->buffers.cache, hnd, 0);
     return (SoundBufferHandle) { hnd };
 }
 
 void sfx_release_buffer(AudioContext* ctx, SoundBufferHandle buf) {
+    if (!hp_valid_handle(&ctx->buffers.pool, buf.id)) return;
+    if (!asset_cache_release(&ctx->buffers.cache, buf.id)) return;
     int idx = hp_index(buf.id);
-    tm_release_buffer(ctx->buffers.data[idx]);
+    if (ctx->buffers.data[idx]) tm_release_buffer(ctx->buffers.data[idx]);
     hp_release_handle(&ctx->buffers.pool, buf.id);
 }
 
 
+//--ASSETS-----------------------------------------------------------------------------------
+
+//a job is owned by exactly one side at a time: sokol_fetch callbacks and asset_loader_update on the
+//main thread, or a decode thread between the todo and done queues
+enum {
+    ASSET_JOB_FREE = 0,
+    ASSET_JOB_FETCHING,
+    ASSET_JOB_DECODING,
+    ASSET_JOB_DONE,
+};
+
+typedef struct AssetJob {
+    AssetType type;
+    uint8_t state;
+    Result result;
+    hp_Handle hnd;
+    uint32_t epoch;  //loads started before the last asset_loader_reset are dropped
+    uint32_t load_flags; //RenderContext.meshes.load_flags, read off the main thread
+    TextureCache tex_cache; //from the RenderContext, cache dir storage outlives the loader
+    IoMemory file;
+    ArenaAlloc scratch; //decoded model data
+    union {
+        TextureData tex;
+        ModelData model;
+    } data;
+} AssetJob;
+
+typedef struct AssetQueue {
+    int* items;
+    int head;
+    int count;
+} AssetQueue;
+
+typedef struct AssetSlot {
+    hp_Handle hnd; //last async load into this pool slot
+    AssetStatus status;
+} AssetSlot;
+
+typedef struct AssetFetch {
+    AssetLoader* loader;
+    int job;
+} AssetFetch;
+
+struct AssetLoader {
+    Allocator alloc;
+    RenderContext* gfx;
+    AudioContext* sfx;
+    AssetJob* jobs;
+    int max_jobs;
+    int* free_jobs;
+    int num_free;
+    int max_creates;
+    uint32_t epoch;
+    AssetSlot* slots[ASSET_TYPE_COUNT];
+    int num_slots[ASSET_TYPE_COUNT];
+    mt_mutex lock; //guards todo and done
+    mt_sema work;
+    AssetQueue todo;
+    AssetQueue done;
+    mt_thread threads[ASSET_MAX_THREADS];
+    int num_threads;
+    mt_atomic_int32 quit;
+};
+
+static hp_Pool* _asset_pool(AssetLoader* l, AssetType type) {
+    switch (type) {
+        case ASSET_TEXTURE: return &l->gfx->textures.pool;
+        case ASSET_MODEL:   return &l->gfx->meshes.pool;
+        case ASSET_ANIMS:   return &l->gfx->anims.pool;
+        case ASSET_SOUND:   return &l->sfx->buffers.pool;
+        default: return NULL;
+    }
+}
+
+static AssetCache* _asset_cache(AssetLoader* l, AssetType type) {
+    switch (type) {
+        case ASSET_TEXTURE: return &l->gfx->textures.cache;
+        case ASSET_MODEL:   return &l->gfx->meshes.cache;
+        case ASSET_ANIMS:   return &l->gfx->anims.cache;
+        case ASSET_SOUND:   return &l->sfx->buffers.cache;
+        default: return NULL;
+    }
+}
+
+//clears the pool slot, so a pending asset draws and plays as empty
+static void _asset_clear_slot(AssetLoader* l, AssetType type, int idx) {
+    switch (type) {
+        case ASSET_TEXTURE: memset(&l->gfx->textures.data[idx], 0, sizeof(Texture)); break;
+        case ASSET_MODEL:   memset(&l->gfx->meshes.data[idx], 0, sizeof(Model)); break;
+        case ASSET_ANIMS:   memset(&l->gfx->anims.data[idx], 0, sizeof(AnimSet)); break;
+        case ASSET_SOUND:   l->sfx->buffers.data[idx] = NULL; break;
+        default: break;
+    }
+}
+
+static void _asset_push(AssetLoader* l, AssetQueue* q, int job) {
+    mt_mutex_lock(&l->lock);
+    q->items[(q->head + q->count) % l->max_jobs] = job;
+    q->count++;
+    mt_mutex_unlock(&l->lock);
+}
+
+static int _asset_pop(AssetLoader* l, AssetQueue* q) {
+    int job = -1;
+    mt_mutex_lock(&l->lock);
+    if (q->count > 0) {
+        job = q->items[q->head];
+        q->head = (q->head + 1) % l->max_jobs;
+        q->count--;
+    }
+    mt_mutex_unlock(&l->lock);
+    return job;
+}
+
+//cpu work that doesn't touch sokol_gfx, the mixer or the anim arena
+static void _asset_decode(AssetJob* job) {
+    switch (job->type) {
+        case ASSET_TEXTURE: job->result = _decode_texture(&job->data.tex, &job->file, &job->tex_cache); break;
+        case ASSET_MODEL:   job->result = _decode_model(&job->scratch, &job->data.model, &job->file, job->load_flags); break;
+        default: break;
+    }
+    job->state = ASSET_JOB_DONE;
+}
+
+static void* _asset_worker(void* arg) {
+    AssetLoader* l = arg;
+    for (;;) {
+        mt_sema_wait(&l->work);
+        if (mt_atomic_load(&l->quit)) break;
+        int job = _asset_pop(l, &l->todo);
+        if (job < 0) continue;
+        _asset_decode(&l->jobs[job]);
+        _asset_push(l, &l->done, job);
+    }
+    return NULL;
+}
+
+//hands a fetched file to the decode threads, anims and sounds only have main thread work left
+static void _asset_fetched(AssetLoader* l, int idx) {
+    AssetJob* job = &l->jobs[idx];
+    if (job->type == ASSET_MODEL && !model_is_cooked(&job->file)) {
+        //decode threads don't allocate, the scratch arena is sized from the header up front
+        size_t size = model_decode_size(&job->file, job->load_flags);
+        void* buffer = size > 0 ? core_alloc(&l->alloc, size, 16) : NULL;
+        if (!buffer) {
+            job->result = size > 0 ? RESULT_NOMEM : RESULT_UNKNOWN_ERROR;
+            job->state = ASSET_JOB_DONE;
+            _asset_push(l, &l->done, idx);
+            return;
+        }
+        arena_init(&job->scratch, buffer, size);
+    }
+    if (job->type == ASSET_TEXTURE || job->type == ASSET_MODEL) {
+        job->state = ASSET_JOB_DECODING;
+        _asset_push(l, &l->todo, idx);
+        if (l->num_threads > 0) mt_sema_post(&l->work, 1);
+    } else {
+        job->state = ASSET_JOB_DONE;
+        _asset_push(l, &l->done, idx);
+    }
+}
+
+static size_t _asset_file_size(const char* path) {
+    struct stat st;
+    if (stat(path, &st) != 0 || st.st_size <= 0) return 0;
+    return (size_t)st.st_size;
+}
+
+static void _asset_fetch_cb(const sfetch_response_t* res) {
+    const AssetFetch* fetch = (const AssetFetch*)res->user_data;
+    AssetLoader* l = fetch->loader;
+    AssetJob* job = &l->jobs[fetch->job];
+
+    if (res->dispatched) {
+        //sokol_fetch reads the whole file in one go, so the buffer has to fit it
+        size_t size = _asset_file_size(res->path);
+        job->file.ptr = size > 0 ? core_alloc(&l->alloc, size, 16) : NULL;
+        if (job->file.ptr) {
+            sfetch_bind_buffer(res->handle, (sfetch_range_t){ job->file.ptr, size });
+        }
+        return;
+    }
+    if (res->fetched) {
+        job->file.size = res->data.size;
+    }
+    if (res->finished) {
+        if (res->failed) {
+            LOG_ERROR("Failed to fetch %s (sfetch error %d)\n", res->path, (int)res->error_code);
+            job->result = RESULT_FILE_NOT_FOUND;
+            job->state = ASSET_JOB_DONE;
+            _asset_push(l, &l->done, fetch->job);
+            return;
+        }
+        _asset_fetched(l, fetch->job);
+    }
+}
+
+//gpu and mixer objects, then the job goes back to the free list
+static void _asset_finish(AssetLoader* l, int idx) {
+    AssetJob* job = &l->jobs[idx];
+    hp_Pool* pool = _asset_pool(l, job->type);
+    bool live = job->epoch == l->epoch && hp_valid_handle(pool, job->hnd);
+    int slot = hp_index(job->hnd);
+    Result result = job->result;
+
+    if (live && result == RESULT_SUCCESS) {
+        switch (job->type) {
+            case ASSET_TEXTURE: result = _create_texture(&l->gfx->textures.data[slot], &job->data.tex); break;
+            case ASSET_MODEL:   _create_model(l->gfx, &l->gfx->meshes.data[slot], &job->data.model); break;
+            case ASSET_ANIMS:
+                result = load_anims(&l->gfx->anims.alloc, &l->gfx->anims.data[slot], &job->file, l->gfx->anims.storage);
+                break;
+            case ASSET_SOUND:   result = load_sound_buffer(&job->file, &l->sfx->buffers.data[slot]); break;
+            default: break;
+        }
+    }
+    if (live) {
+        if (result != RESULT_SUCCESS) {
+            LOG_ERROR("Failed to load asset (type %d, handle %u)\n", job->type, job->hnd);
+            _asset_clear_slot(l, job->type, slot);
+            //the next request for the path gets a fresh try
+            _asset_cache(l, job->type)->keys[slot] = 0;
+        }
+        l->slots[job->type][slot].status = result == RESULT_SUCCESS ? ASSET_READY : ASSET_FAILED;
+    }
+
+    if (job->type == ASSET_TEXTURE) free(job->data.tex.pixels);
+    if (job->scratch.buffer) core_free(&l->alloc, job->scratch.buffer);
+    if (job->file.ptr) core_free(&l->alloc, job->file.ptr);
+    memset(job, 0, sizeof(AssetJob));
+    l->free_jobs[l->num_free++] = idx;
+}
+
+AssetLoader* asset_loader_new(Allocator* alloc, RenderContext* gfx, AudioContext* sfx, const AssetLoaderDesc* desc) {
+    if (!alloc || !gfx || !sfx || !desc) return NULL;
+
+    AssetLoader* l = core_alloc(alloc, sizeof(AssetLoader), alignof(AssetLoader));
+    if (!l) {
+        LOG_ERROR("Failed to allocate asset loader\n");
+        return NULL;
+    }
+    memset(l, 0, sizeof(AssetLoader));
+    l->alloc = *alloc;
+    l->gfx = gfx;
+    l->sfx = sfx;
+    l->max_jobs = desc->max_jobs > 0 ? desc->max_jobs : ASSET_DEFAULT_MAX_JOBS;
+    l->max_creates = desc->max_creates;
+
+    l->jobs = core_alloc(alloc, l->max_jobs * sizeof(AssetJob), alignof(AssetJob));
+    l->free_jobs = core_alloc(alloc, l->max_jobs * sizeof(int), alignof(int));
+    l->todo.items = core_alloc(alloc, l->max_jobs * sizeof(int), alignof(int));
+    l->done.items = core_alloc(alloc, l->max_jobs * sizeof(int), alignof(int));
+    bool ok = l->jobs && l->free_jobs && l->todo.items && l->done.items;
+    for (int t = 0; t < ASSET_TYPE_COUNT && ok; t++) {
+        l->num_slots[t] = _asset_pool(l, (AssetType)t)->capacity;
+        l->slots[t] = core_alloc(alloc, l->num_slots[t] * sizeof(AssetSlot), alignof(AssetSlot));
+        if (l->slots[t]) memset(l->slots[t], 0, l->num_slots[t] * sizeof(AssetSlot));
+        ok = l->slots[t] != NULL;
+    }
+    if (!ok || mt_mutex_init(&l->lock) != 0 || mt_sema_init(&l->work, 0) != 0) {
+        LOG_ERROR("Failed to allocate asset loader\n");
+        return NULL;
+    }
+    memset(l->jobs, 0, l->max_jobs * sizeof(AssetJob));
+    for (int i = 0; i < l->max_jobs; i++) {
+        l->free_jobs[i] = l->max_jobs - 1 - i;
+    }
+    l->num_free = l->max_jobs;
+
+    sfetch_setup(&(sfetch_desc_t){
+        .max_requests = (uint32_t)l->max_jobs,
+        .num_channels = (uint32_t)(desc->io_channels > 0 ? desc->io_channels : 1),
+        .num_lanes = (uint32_t)(desc->io_lanes > 0 ? desc->io_lanes : 4),
+        .logger.func = slog_func,
+    });
+
+    mt_atomic_init(&l->quit, 0);
+    int num_threads = HMM_MIN(desc->decode_threads, ASSET_MAX_THREADS);
+    for (int i = 0; i < num_threads; i++) {
+        if (mt_thread_create(&l->threads[i], _asset_worker, l) != 0) break;
+        l->num_threads++;
+    }
+    if (l->num_threads < num_threads) {
+        LOG_WARN("Started %d of %d asset decode threads\n", l->num_threads, num_threads);
+    }
+    return l;
+}
+
+//pool handle and a fresh job for path, *idx stays -1 when the asset is loaded or on its way already
+static hp_Handle _asset_start(AssetLoader* l, AssetType type, const char* path, int* idx) {
+    *idx = -1;
+    if (!l || !path || type >= ASSET_TYPE_COUNT) return HP_INVALID_HANDLE;
+    if (l->num_free == 0) {
+        LOG_ERROR("Too many assets in flight, can't load %s\n", path);
+        return HP_INVALID_HANDLE;
+    }
+    hp_Pool* pool = _asset_pool(l, type);
+    uint64_t key = asset_key(path);
+    hp_Handle hnd = asset_cache_acquire(_asset_cache(l, type), pool, key);
+    if (hnd != HP_INVALID_HANDLE) return hnd; //loaded or already on its way
+
+    hnd = hp_create_handle(pool);
+    if (hnd == HP_INVALID_HANDLE) {
+        LOG_ERROR("Failed to allocate handle!");
+        return HP_INVALID_HANDLE;
+    }
+    int slot = hp_index(hnd);
+    _asset_clear_slot(l, type, slot);
+    asset_cache_insert(_asset_cache(l, type), hnd, key);
+    l->slots[type][slot] = (AssetSlot){ .hnd = hnd, .status = ASSET_PENDING };
+
+    *idx = l->free_jobs[--l->num_free];
+    AssetJob* job = &l->jobs[*idx];
+    memset(job, 0, sizeof(AssetJob));
+    job->type = type;
+    job->hnd = hnd;
+    job->epoch = l->epoch;
+    job->load_flags = l->gfx->meshes.load_flags;
+    job->tex_cache = _texture_cache(l->gfx);
+    job->state = ASSET_JOB_FETCHING;
+    return hnd;
+}
+
+hp_Handle asset_load_texture_async(AssetLoader* l, const char* path, const IoMemory* data, uint64_t hash) {
+    if (!data || !data->ptr) return HP_INVALID_HANDLE;
+    int idx;
+    hp_Handle hnd = _asset_start(l, ASSET_TEXTURE, path, &idx);
+    if (idx < 0) return hnd;
+    AssetJob* job = &l->jobs[idx];
+    job->tex_cache.hash = hash;
+    job->file.ptr = core_alloc(&l->alloc, data->size > 0 ? data->size : 1, 16);
+    if (job->file.ptr) {
+        memcpy(job->file.ptr, data->ptr, data->size);
+        job->file.size = data->size;
+        _asset_fetched(l, idx);
+    } else {
+        job->result = RESULT_NOMEM;
+        job->state = ASSET_JOB_DONE;
+        _asset_push(l, &l->done, idx);
+    }
+    return hnd;
+}
+
+hp_Handle asset_load_async(AssetLoader* l, AssetType type, const char* path) {
+    int idx;
+    hp_Handle hnd = _asset_start(l, type, path, &idx);
+    if (idx < 0) return hnd;
+    AssetJob* job = &l->jobs[idx];
+
+    //packed assets are already in memory, no request needed
+    const PakMount* pak = NULL;
+    const PakEntry* entry = _pak_find(path, &pak);
+    if (entry) {
+        job->file.ptr = core_alloc(&l->alloc, entry->raw_size > 0 ? entry->raw_size : 1, 16);
+        job->result = job->file.ptr ? _pak_read(pak, entry, job->file.ptr) : RESULT_NOMEM;
+        if (job->result == RESULT_SUCCESS) {
+            job->file.size = entry->raw_size;
+            _asset_fetched(l, idx);
+        } else {
+            job->state = ASSET_JOB_DONE;
+            _asset_push(l, &l->done, idx);
+        }
+        return hnd;
+    }
+
+#ifdef __EMSCRIPTEN__
+    //assets are preloaded into the in-memory filesystem, sokol_fetch would go over http instead
+    size_t size = _asset_file_size(path);
+    job->file.ptr = size > 0 ? core_alloc(&l->alloc, size, 16) : NULL;
+    FILE* file = job->file.ptr ? fopen(path, "rb") : NULL;
+    if (file) {
+        job->file.size = fread(job->file.ptr, 1, size, file);
+        fclose(file);
+        _asset_fetched(l, idx);
+    } else {
+        LOG_ERROR("Failed to open file: %s", path);
+        job->result = RESULT_FILE_NOT_FOUND;
+        job->state = ASSET_JOB_DONE;
+        _asset_push(l, &l->done, idx);
+    }
+#else
+    AssetFetch fetch = { .loader = l, .job = idx };
+    sfetch_handle_t req = sfetch_send(&(sfetch_request_t){
+        .path = path,
+        .callback = _asset_fetch_cb,
+        .user_data = SFETCH_RANGE(fetch),
+    });
+    if (!sfetch_handle_valid(req)) {
+        job->result = RESULT_INVALID_PARAMS;
+        job->state = ASSET_JOB_DONE;
+        _asset_push(l, &l->done, idx);
+    }
+#endif
+    return hnd;
+}
+
+AssetStatus asset_status(AssetLoader* l, AssetType type, hp_Handle hnd) {
+    if (!l || type >= ASSET_TYPE_COUNT) return ASSET_INVALID;
+    if (!hp_valid_handle(_asset_pool(l, type), hnd)) return ASSET_INVALID;
+    AssetSlot* slot = &l->slots[type][hp_index(hnd)];
+    //handles from the blocking loaders never went through a job
+    return slot->hnd == hnd ? slot->status : ASSET_READY;
+}
+
+void asset_loader_update(AssetLoader* l) {
+    if (!l) return;
+    sfetch_dowork();
+
+    if (l->num_threads == 0) {
+        int job;
+        while ((job = _asset_pop(l, &l->todo)) >= 0) {
+            _asset_decode(&l->jobs[job]);
+            _asset_push(l, &l->done, job);
+        }
+    }
+
+    //gpu uploads are batched here, optionally spread over several frames
+    int created = 0;
+    while (l->max_creates <= 0 || created < l->max_creates) {
+        int job = _asset_pop(l, &l->done);
+        if (job < 0) break;
+        _asset_finish(l, job);
+        created++;
+    }
+}
+
+void asset_loader_reset(AssetLoader* l) {
+    if (!l) return;
+    //jobs still in flight finish normally and are thrown away in _asset_finish. their slots stay
+    //empty, so they mustn't be handed out by path anymore
+    for (int i = 0; i < l->max_jobs; i++) {
+        AssetJob* job = &l->jobs[i];
+        if (job->state == ASSET_JOB_FREE || job->epoch != l->epoch) continue;
+        if (hp_valid_handle(_asset_pool(l, job->type), job->hnd)) {
+            _asset_cache(l, job->type)->keys[hp_index(job->hnd)] = 0;
+        }
+    }
+    l->epoch++;
+    for (int t = 0; t < ASSET_TYPE_COUNT; t++) {
+        memset(l->slots[t], 0, l->num_slots[t] * sizeof(AssetSlot));
+    }
+}
+
+void asset_loader_destroy(AssetLoader* l) {
+    if (!l) return;
+    mt_atomic_store(&l->quit, 1);
+    mt_sema_post(&l->work, l->num_threads);
+    for (int i = 0; i < l->num_threads; i++) {
+        mt_thread_join(l->threads[i]);
+    }
+    sfetch_shutdown();
+
+    for (int i = 0; i < l->max_jobs; i++) {
+        AssetJob* job = &l->jobs[i];
+        if (job->state == ASSET_JOB_FREE) continue;
+        if (job->type == ASSET_TEXTURE) free(job->data.tex.pixels);
+        if (job->scratch.buffer) core_free(&l->alloc, job->scratch.buffer);
+        if (job->file.ptr) core_free(&l->alloc, job->file.ptr);
+    }
+    mt_sema_destroy(&l->work);
+    mt_mutex_destroy(&l->lock);
+
+    Allocator alloc = l->alloc;
+    for (int t = 0; t < ASSET_TYPE_COUNT; t++) {
+        core_free(&alloc, l->slots[t]);
+    }
+    core_free(&alloc, l->todo.items);
+    core_free(&alloc, l->done.items);
+    core_free(&alloc, l->free_jobs);
+    core_free(&alloc, l->jobs);
+    core_free(&alloc, l);
+}
+
+
 //--PHYSICS----------------------------------------------------------------------------------
 
 void ne_update(ne_Simulator sim, Scene* scene, float dt) {
@@ -1495,6 +4431,7 @@ void ne_update(ne_Simulator sim, Scene* scene, float dt) {
         if (flags[idx] & ENTITY_HAS_RIGIDBODY) {
             scene->transforms[idx].pos = ne_rigid_body_get_pos(bodies[idx].rigid);
             scene->transforms[idx].rot = ne_rigid_body_get_rot(bodies[idx].rigid);
+            scene->relation_flags[idx] |= ENTITY_TRANSFORM_DIRTY;
         }
     }
 }
@@ -1519,6 +4456,8 @@ Scene* scene_new(Allocator* alloc, uint16_t max_things) {
     if (!t->relation_flags) return NULL;
     t->transforms = core_alloc(alloc, max_things * sizeof(Transform), alignof(Transform));
     if (!t->transforms) return NULL;
+    t->world = core_alloc(alloc, max_things * sizeof(HMM_Mat4), alignof(HMM_Mat4));
+    if (!t->world) return NULL;
     t->parents = core_alloc(alloc, max_things * sizeof(Entity), alignof(Entity));
     if (!t->parents) return NULL;
     t->childs = core_alloc(alloc, max_things * sizeof(Children), alignof(Children));
@@ -1541,6 +4480,10 @@ Scene* scene_new(Allocator* alloc, uint16_t max_things) {
     if (!t->prev_anim_states) return NULL;
     t->anim_blend_weights = core_alloc(alloc, max_things * sizeof(float), alignof(float));
     if (!t->anim_blend_weights) return NULL;
+    t->anim_layers = core_alloc(alloc, max_things * ANIM_MAX_LAYERS * sizeof(AnimLayer), alignof(AnimLayer));
+    if (!t->anim_layers) return NULL;
+    t->poses = core_alloc(alloc, max_things * MAX_BONES * sizeof(HMM_Mat4), alignof(HMM_Mat4));
+    if (!t->poses) return NULL;
 
     t->sound_flags = core_alloc(alloc, max_things * sizeof(SoundFlags), alignof(SoundFlags));
     if (!t->sound_flags) return NULL;
@@ -1565,6 +4508,7 @@ Scene* scene_new(Allocator* alloc, uint16_t max_things) {
     memset(t->anims, 0, max_things * sizeof(AnimSetHandle));
     memset(t->anim_states, 0, max_things * sizeof(AnimState));
     memset(t->prev_anim_states, 0, max_things * sizeof(AnimState));
+    memset(t->anim_layers, 0, max_things * ANIM_MAX_LAYERS * sizeof(AnimLayer));
     for (int i = 0; i < max_things; i++) {
         t->anim_blend_weights[i] = 1.0f;
     }
@@ -1580,6 +4524,7 @@ Scene* scene_new(Allocator* alloc, uint16_t max_things) {
         t->transforms[i].pos = HMM_V3(0, 0, 0);
         t->transforms[i].scale = HMM_V3(1, 1, 1);
         t->transforms[i].rot = HMM_Q(0, 0, 0, 1);
+        t->world[i] = HMM_M4D(1.0f);
     }
 
     return t;
@@ -1601,6 +4546,7 @@ void scene_reset(Scene* scene) {
     memset(scene->anims, 0, cap * sizeof(AnimSetHandle));
     memset(scene->anim_states, 0, cap * sizeof(AnimState));
     memset(scene->prev_anim_states, 0, cap * sizeof(AnimState));
+    memset(scene->anim_layers, 0, cap * ANIM_MAX_LAYERS * sizeof(AnimLayer));
     for (int i = 0; i < cap; i++) {
         scene->anim_blend_weights[i] = 1.0f;
     }
@@ -1616,6 +4562,7 @@ void scene_reset(Scene* scene) {
         scene->transforms[i].pos = HMM_V3(0, 0, 0);
         scene->transforms[i].scale = HMM_V3(1, 1, 1);
         scene->transforms[i].rot = HMM_Q(0, 0, 0, 1);
+        scene->world[i] = HMM_M4D(1.0f);
     }
 }
 
@@ -1626,6 +4573,7 @@ void scene_destroy(Allocator* alloc, Scene* scene) {
 
     core_free(alloc, scene->relation_flags);
     core_free(alloc, scene->transforms);
+    core_free(alloc, scene->world);
     core_free(alloc, scene->parents);
     core_free(alloc, scene->childs);
 
@@ -1638,6 +4586,8 @@ void scene_destroy(Allocator* alloc, Scene* scene) {
     core_free(alloc, scene->anim_states);
     core_free(alloc, scene->prev_anim_states);
     core_free(alloc, scene->anim_blend_weights);
+    core_free(alloc, scene->anim_layers);
+    core_free(alloc, scene->poses);
 
     core_free(alloc, scene->sound_flags);
     core_free(alloc, scene->sound_buffers);
@@ -1652,6 +4602,9 @@ void scene_destroy(Allocator* alloc, Scene* scene) {
 
 Entity entity_new(Scene* scene) {
     hp_Handle h = hp_create_handle(&scene->pool);
+    if (h != HP_INVALID_HANDLE) {
+        scene->relation_flags[hp_index(h)] |= ENTITY_TRANSFORM_DIRTY;
+    }
     return (Entity){ .id = h };
 }
 
@@ -1664,6 +4617,16 @@ void entity_destroy(Scene* scene, Entity entity) {
 
     int idx = hp_index(entity.id);
 
+    //orphaned children have to drop the parent matrix on the next update
+    if (scene->relation_flags[idx] & ENTITY_HAS_CHILDREN) {
+        for (int i = 0; i < ENTITY_MAX_CHILDREN; i++) {
+            Entity child = scene->childs[idx].data[i];
+            if (entity_valid(scene, child)) {
+                scene->relation_flags[hp_index(child.id)] |= ENTITY_TRANSFORM_DIRTY;
+            }
+        }
+    }
+
     scene->relation_flags[idx] = 0;
     scene->transforms[idx].pos = HMM_V3(0, 0, 0);
     scene->transforms[idx].rot = HMM_Q(0, 0, 0, 1);
@@ -1678,6 +4641,7 @@ void entity_destroy(Scene* scene, Entity entity) {
     scene->anims[idx] = (AnimSetHandle) { 0 };
     memset(&scene->anim_states[idx], 0, sizeof(AnimState));
     memset(&scene->prev_anim_states[idx], 0, sizeof(AnimState));
+    memset(&scene->anim_layers[idx * ANIM_MAX_LAYERS], 0, ANIM_MAX_LAYERS * sizeof(AnimLayer));
     scene->anim_blend_weights[idx] = 1.0f;
 
     scene->sound_flags[idx] = 0;
@@ -1692,6 +4656,7 @@ void entity_set_position(Scene* scene, Entity e, HMM_Vec3 pos) {
     if (!entity_valid(scene, e)) return;
     int idx = hp_index(e.id);
     scene->transforms[idx].pos = pos;
+    scene->relation_flags[idx] |= ENTITY_TRANSFORM_DIRTY;
 }
 
 HMM_Vec3 entity_get_position(Scene* scene, Entity e) {
@@ -1706,6 +4671,7 @@ void entity_set_rotation(Scene* scene, Entity e, HMM_Quat rot) {
     }
     int idx = hp_index(e.id);
     scene->transforms[idx].rot = rot;
+    scene->relation_flags[idx] |= ENTITY_TRANSFORM_DIRTY;
 }
 
 HMM_Quat entity_get_rotation(Scene* scene, Entity e) {
@@ -1718,6 +4684,7 @@ void entity_set_scale(Scene* scene, Entity e, HMM_Vec3 scale) {
     if (!entity_valid(scene, e)) return;
     int idx = hp_index(e.id);
     scene->transforms[idx].scale = scale;
+    scene->relation_flags[idx] |= ENTITY_TRANSFORM_DIRTY;
 }
 
 HMM_Vec3 entity_get_scale(Scene* scene, Entity e) {
@@ -1730,6 +4697,7 @@ void entity_set_transform(Scene* scene, Entity e, Transform trs) {
     if (!entity_valid(scene, e)) return;
     int idx = hp_index(e.id);
     scene->transforms[idx] = trs;
+    scene->relation_flags[idx] |= ENTITY_TRANSFORM_DIRTY;
 }
 
 Transform entity_get_transform(Scene* scene, Entity e) {
@@ -1738,27 +4706,149 @@ Transform entity_get_transform(Scene* scene, Entity e) {
     return scene->transforms[idx];
 }
 
+int transform_stride(uint32_t parts) {
+    return ((parts & TRANSFORM_POS) ? 3 : 0) + ((parts & TRANSFORM_ROT) ? 4 : 0) + ((parts & TRANSFORM_SCALE) ? 3 : 0);
+}
+
+void entities_set_transforms(Scene* scene, const uint32_t* ids, const float* src, int count, uint32_t parts) {
+    int stride = transform_stride(parts);
+    for (int i = 0; i < count; i++, src += stride) {
+        if (!hp_valid_handle(&scene->pool, ids[i])) continue;
+        int idx = hp_index(ids[i]);
+        Transform* t = &scene->transforms[idx];
+        const float* f = src;
+        if (parts & TRANSFORM_POS) { t->pos = HMM_V3(f[0], f[1], f[2]); f += 3; }
+        if (parts & TRANSFORM_ROT) { t->rot = HMM_Q(f[0], f[1], f[2], f[3]); f += 4; }
+        if (parts & TRANSFORM_SCALE) t->scale = HMM_V3(f[0], f[1], f[2]);
+        scene->relation_flags[idx] |= ENTITY_TRANSFORM_DIRTY;
+    }
+}
+
+void entities_get_transforms(Scene* scene, const uint32_t* ids, float* dst, int count, uint32_t parts) {
+    int stride = transform_stride(parts);
+    for (int i = 0; i < count; i++, dst += stride) {
+        if (!hp_valid_handle(&scene->pool, ids[i])) {
+            memset(dst, 0, stride * sizeof(float));
+            continue;
+        }
+        const Transform* t = &scene->transforms[hp_index(ids[i])];
+        float* f = dst;
+        if (parts & TRANSFORM_POS) { f[0] = t->pos.X; f[1] = t->pos.Y; f[2] = t->pos.Z; f += 3; }
+        if (parts & TRANSFORM_ROT) { f[0] = t->rot.X; f[1] = t->rot.Y; f[2] = t->rot.Z; f[3] = t->rot.W; f += 4; }
+        if (parts & TRANSFORM_SCALE) { f[0] = t->scale.X; f[1] = t->scale.Y; f[2] = t->scale.Z; }
+    }
+}
+
+size_t scene_view_size(const Scene* scene) {
+    size_t cap = (size_t)scene->pool.capacity;
+    return sizeof(SceneView) + cap * (sizeof(uint32_t) + transform_stride(TRANSFORM_ALL) * sizeof(float) + sizeof(AnimState));
+}
+
+//the offsets in the header are only published for the script, which can overwrite them.
+//the host always derives them from the scene capacity
+static void _scene_view_offsets(uint32_t cap, uint32_t* ids, uint32_t* transforms, uint32_t* anims) {
+    *ids = sizeof(SceneView);
+    *transforms = *ids + cap * sizeof(uint32_t);
+    *anims = *transforms + cap * transform_stride(TRANSFORM_ALL) * sizeof(float);
+}
+
+void scene_view_publish(Scene* scene, SceneView* view) {
+    uint32_t cap = (uint32_t)scene->pool.capacity;
+    uint32_t ids_ofs, trs_ofs, anims_ofs;
+    _scene_view_offsets(cap, &ids_ofs, &trs_ofs, &anims_ofs);
+    view->capacity = cap;
+    view->dirty_begin = view->dirty_end = 0;
+    view->ids = ids_ofs;
+    view->transforms = trs_ofs;
+    view->anims = anims_ofs;
+
+    uint32_t* ids = (uint32_t*)((uint8_t*)view + ids_ofs);
+    float* trs = (float*)((uint8_t*)view + trs_ofs);
+    AnimState* anims = (AnimState*)((uint8_t*)view + anims_ofs);
+    memset(ids, 0, cap * sizeof(uint32_t));
+    for (int i = 0; i < scene->pool.count; i++) {
+        hp_Handle h = hp_handle_at(&scene->pool, i);
+        int idx = hp_index(h);
+        ids[idx] = h;
+        anims[idx] = scene->anim_states[idx];
+    }
+    //the transforms go through the batched path, it handles the float packing
+    entities_get_transforms(scene, ids, trs, (int)cap, TRANSFORM_ALL);
+}
+
+void scene_view_apply(Scene* scene, SceneView* view) {
+    uint32_t cap = (uint32_t)scene->pool.capacity;
+    uint32_t end = view->dirty_end < cap ? view->dirty_end : cap;
+    uint32_t begin = view->dirty_begin;
+    view->dirty_begin = view->dirty_end = 0;
+    if (begin >= end) return;
+
+    uint32_t ids_ofs, trs_ofs, anims_ofs;
+    _scene_view_offsets(cap, &ids_ofs, &trs_ofs, &anims_ofs);
+    const uint32_t* ids = (const uint32_t*)((uint8_t*)view + ids_ofs);
+    const float* trs = (const float*)((uint8_t*)view + trs_ofs);
+    const AnimState* anims = (const AnimState*)((uint8_t*)view + anims_ofs);
+    int stride = transform_stride(TRANSFORM_ALL);
+    entities_set_transforms(scene, ids + begin, trs + begin * stride, (int)(end - begin), TRANSFORM_ALL);
+    for (uint32_t idx = begin; idx < end; idx++) {
+        if (!hp_valid_handle(&scene->pool, ids[idx]) || hp_index(ids[idx]) != (int)idx) continue;
+        if (!(scene->anim_flags[idx] & ENTITY_HAS_ANIM)) continue;
+        AnimState* cur = &scene->anim_states[idx];
+        if (!memcmp(cur, &anims[idx], sizeof(AnimState))) continue;
+        if (cur->anim != anims[idx].anim || cur->flags != anims[idx].flags) {
+            entity_set_anim(scene, (Entity){ids[idx]}, scene->anims[idx], anims[idx]);
+        } else {
+            cur->current_frame = anims[idx].current_frame;
+            scene->anim_flags[idx] &= ~ENTITY_ANIM_CACHED;
+        }
+    }
+}
+
+//returns the cached world matrix as of the last scene_update_transforms()
 HMM_Mat4 entity_mtx(Scene* scene, Entity entity) {
     if (!entity_valid(scene, entity)) {
         return HMM_M4D(1.0f);
     }
+    return scene->world[hp_index(entity.id)];
+}
 
-    int idx = hp_index(entity.id);
-    Transform* t = &scene->transforms[idx];
+//transient flags, only valid during scene_update_transforms()
+#define ENTITY_WORLD_VISITED (1U << 14)
+#define ENTITY_WORLD_CHANGED (1U << 15)
+
+static void _update_world(Scene* scene, int idx) {
+    RelationFlags flags = scene->relation_flags[idx];
+    if (flags & ENTITY_WORLD_VISITED) return;
+    scene->relation_flags[idx] |= ENTITY_WORLD_VISITED;
+
+    //parents are resolved first, so every matrix is built at most once per pass
+    int pidx = -1;
+    bool parent_changed = false;
+    if ((flags & ENTITY_HAS_PARENT) && entity_valid(scene, scene->parents[idx])) {
+        pidx = hp_index(scene->parents[idx].id);
+        _update_world(scene, pidx);
+        parent_changed = scene->relation_flags[pidx] & ENTITY_WORLD_CHANGED;
+    }
 
-    HMM_Mat4 pos = HMM_Translate(t->pos);
-    HMM_Mat4 rot = HMM_QToM4(t->rot);
-    HMM_Mat4 scl = HMM_Scale(t->scale);
+    if (!(flags & ENTITY_TRANSFORM_DIRTY) && !parent_changed) return;
 
-    HMM_Mat4 ret = HMM_Mul(pos, HMM_Mul(rot, scl));
+    Transform* t = &scene->transforms[idx];
+    HMM_Mat4 local = HMM_TRS(t->pos, t->rot, t->scale);
+    scene->world[idx] = pidx >= 0 ? HMM_MulM4(scene->world[pidx], local) : local;
 
-    if (scene->relation_flags[idx] & ENTITY_HAS_PARENT) {
-        Entity parent = scene->parents[idx];
-        HMM_Mat4 parent_mtx = entity_mtx(scene, parent);
-        return HMM_Mul(parent_mtx, ret);
-    }
+    scene->relation_flags[idx] &= ~ENTITY_TRANSFORM_DIRTY;
+    scene->relation_flags[idx] |= ENTITY_WORLD_CHANGED;
+}
 
-    return ret;
+void scene_update_transforms(Scene* scene) {
+    if (!scene) return;
+    for (int i = 0; i < scene->pool.count; i++) {
+        int idx = hp_index(hp_handle_at(&scene->pool, i));
+        scene->relation_flags[idx] &= ~(ENTITY_WORLD_VISITED | ENTITY_WORLD_CHANGED);
+    }
+    for (int i = 0; i < scene->pool.count; i++) {
+        _update_world(scene, hp_index(hp_handle_at(&scene->pool, i)));
+    }
 }
 
 void entity_set_parent(Scene* scene, Entity entity, Entity parent) {
@@ -1767,7 +4857,7 @@ void entity_set_parent(Scene* scene, Entity entity, Entity parent) {
 
     int idx = hp_index(entity.id);
     scene->parents[idx] = parent;
-    scene->relation_flags[idx] |= ENTITY_HAS_PARENT;
+    scene->relation_flags[idx] |= ENTITY_HAS_PARENT | ENTITY_TRANSFORM_DIRTY;
 
     // Add as child to parent
     entity_add_child(scene, parent, entity);
@@ -1782,6 +4872,7 @@ void entity_remove_parent(Scene* scene, Entity entity) {
     Entity parent = scene->parents[idx];
     scene->parents[idx].id = 0;
     scene->relation_flags[idx] &= ~ENTITY_HAS_PARENT;
+    scene->relation_flags[idx] |= ENTITY_TRANSFORM_DIRTY;
 
     if (entity_valid(scene, parent)) {
         int pidx = hp_index(parent.id);
@@ -1880,6 +4971,7 @@ void entity_set_anim(Scene* scene, Entity entity, AnimSetHandle set, AnimState s
     scene->anims[idx] = set;
     scene->anim_states[idx] = state;
     scene->anim_flags[idx] |= ENTITY_HAS_ANIM;
+    scene->anim_flags[idx] &= ~ENTITY_ANIM_CACHED;
 }
 
 void entity_clear_anim(Scene* scene, Entity e) {
@@ -1889,9 +4981,25 @@ void entity_clear_anim(Scene* scene, Entity e) {
     scene->anims[idx].id = HP_INVALID_HANDLE;
     memset(&scene->anim_states[idx], 0, sizeof(AnimState));
     memset(&scene->prev_anim_states[idx], 0, sizeof(AnimState));
+    memset(&scene->anim_layers[idx * ANIM_MAX_LAYERS], 0, ANIM_MAX_LAYERS * sizeof(AnimLayer));
     scene->anim_blend_weights[idx] = 0.0f;
 }
 
+void entity_set_anim_layer(Scene* scene, Entity e, int layer, AnimLayer desc) {
+    if (!entity_valid(scene, e) || layer < 0 || layer >= ANIM_MAX_LAYERS) return;
+    scene->anim_layers[hp_index(e.id) * ANIM_MAX_LAYERS + layer] = desc;
+}
+
+void entity_set_anim_layer_weight(Scene* scene, Entity e, int layer, float weight) {
+    if (!entity_valid(scene, e) || layer < 0 || layer >= ANIM_MAX_LAYERS) return;
+    scene->anim_layers[hp_index(e.id) * ANIM_MAX_LAYERS + layer].weight = HMM_Clamp(0.0f, weight, 1.0f);
+}
+
+void entity_clear_anim_layer(Scene* scene, Entity e, int layer) {
+    if (!entity_valid(scene, e) || layer < 0 || layer >= ANIM_MAX_LAYERS) return;
+    memset(&scene->anim_layers[hp_index(e.id) * ANIM_MAX_LAYERS + layer], 0, sizeof(AnimLayer));
+}
+
 void entity_set_sound(Scene* scene, Entity e, SoundBufferHandle buffer, SoundProps props, uint32_t flags) {
     if (!entity_valid(scene, e)) return;
 
@@ -61,6 +61,7 @@ Allocator default_allocator(void);
 typedef struct {
     uint8_t* ptr;
     size_t size;
+    bool mapped; //ptr is a private file mapping, see map_file
 } IoMemory;
 
 typedef uint16_t Result;
@@ -74,6 +75,64 @@ enum {
 };
 
 Result load_file(ArenaAlloc* alloc, IoMemory* out, const char* path, bool null_terminate);
+//maps the file where the platform can, else reads it into fallback like load_file. pair with release_file
+Result map_file(ArenaAlloc* fallback, IoMemory* out, const char* path);
+void release_file(IoMemory* mem);
+//shared libraries, NULL where the platform has none (web)
+void* lib_open(const char* path);
+void* lib_symbol(void* lib, const char* name);
+void lib_close(void* lib);
+
+//per pool slot path keys and reference counts, so repeated loads of one file share a handle
+typedef struct AssetCache {
+    uint64_t* keys; //0 = not cached
+    uint32_t* refs;
+    bool hold;      //while set, unreferenced cached assets are kept for reuse (see gfx_begin_reload)
+} AssetCache;
+
+uint64_t asset_key(const char* path); //never 0, "./a\\b" and "a/b" give the same key
+bool asset_cache_init(AssetCache* cache, Allocator* alloc, int capacity);
+//returns the live handle loaded from key with its count bumped, or HP_INVALID_HANDLE
+hp_Handle asset_cache_acquire(AssetCache* cache, const hp_Pool* pool, uint64_t key);
+void asset_cache_insert(AssetCache* cache, hp_Handle hnd, uint64_t key);
+//drops one reference, true when the asset should be freed now
+bool asset_cache_release(AssetCache* cache, hp_Handle hnd);
+
+//ASSET PACKS
+//one file holding many assets (see pack.c). load_file, map_file and the async loader look in the
+//mounted packs before the filesystem, later mounts first
+
+#define PAK_MAGIC "LOFIPAK"
+#define PAK_VERSION 1
+#define PAK_MAX_MOUNTS 4
+#define PAK_DEFAULT_ALIGN 16
+
+enum {
+    PAK_ENTRY_LZ4 = 1 << 0, //stored as one lz4 block
+};
+
+//little endian on disk
+typedef struct PakHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_entries;
+    uint32_t ofs_entries; //PakEntry[num_entries], sorted by hash
+    uint32_t reserved;
+} PakHeader;
+
+typedef struct PakEntry {
+    uint64_t hash;     //asset_key of the path
+    uint32_t offset;   //from the start of the pack
+    uint32_t size;     //bytes stored
+    uint32_t raw_size; //bytes after decompression
+    uint32_t flags;
+} PakEntry;
+
+//the pack is mapped where the platform can, else read into alloc. don't unmount while a
+//map_file result still points into it
+Result pak_mount(Allocator* alloc, const char* path);
+void pak_unmount_all(void);
+bool lz4_decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size);
 
 //--GFX-------------------------------------------------------------------------------
 
@@ -90,6 +149,12 @@ typedef struct Camera {
 HMM_Mat4 camera_view_mtx(Camera* cam);
 HMM_Mat4 camera_proj_mtx(Camera* cam, int width, int height);
 
+typedef struct Frustum {
+    HMM_Vec4 planes[6]; //xyz = normal pointing inwards, w = distance
+} Frustum;
+
+Frustum frustum_from_mtx(HMM_Mat4 view_proj);
+
 //IMAGES
 
 typedef struct Texture {
@@ -110,6 +175,19 @@ typedef struct VertexSkin {
     uint8_t weights[4];
 } VertexSkin;
 
+//half the size of VertexPNT, drawn with the tex_lit_compact shaders
+typedef struct VertexCompact {
+    int16_t pos[4]; //snorm inside the model's quantization box, Model.dequant maps it back. w unused
+    int16_t nrm[2]; //octahedral snorm, divided by the box scale beforehand so Model.dequant keeps the direction
+    uint16_t uv[2]; //half floats
+} VertexCompact;
+
+enum {
+    MESH_INDEX16 = 1 << 0, //uint16_t indices, any mesh with up to 65536 vertices
+    MESH_COMPACT = 1 << 1, //VertexCompact vertices, unskinned meshes only
+};
+#define MESH_FORMAT_COUNT 4
+
 #define MESH_MAX_VBUFS 4
 
 typedef struct Mesh {
@@ -117,6 +195,10 @@ typedef struct Mesh {
     sg_buffer ibuf;
     int first_element;
     int element_count;
+    int vertex_count;
+    int base_vertex; //added to every index, meshes in the shared geometry buffers start past 0
+    uint8_t format;  //MESH_* bits, picks the pipeline variant
+    bool shared;     //vbufs and ibuf belong to RenderContext.geometry
 } Mesh;
 
 
@@ -125,15 +207,20 @@ typedef struct Bounds {
     float radius_xy, radius;
 } Bounds;
 
+#define MODEL_MAX_MESHES 4
+
 typedef struct Model{
     Bounds bounds;
-    Mesh meshes[4];
+    Mesh meshes[MODEL_MAX_MESHES];
     int meshes_count;
+    HMM_Mat4 dequant; //model space from MESH_COMPACT positions, applied before the world matrix
 } Model;
 
+bool bounds_in_frustum(const Frustum* frustum, const Bounds* bounds, HMM_Mat4 world);
+
 //ANIMATIONS
 
-#define MAX_BONES 32
+#define MAX_BONES 128 //joints per rig, Scene.poses is strided by this
 #define MAX_NAME_LEN 64
 
 typedef struct Transform {
@@ -149,13 +236,40 @@ typedef struct AnimInfo {
     float framerate;
 } AnimInfo;
 
+typedef uint8_t AnimStorage;
+
+enum {
+    ANIM_STORAGE_BAKED = 0, //one skinning matrix per joint and frame
+    ANIM_STORAGE_QUANTIZED, //16-bit TRS keys, composed into matrices when sampled
+};
+
+#define ANIM_QUAT_RANGE 0.70710678f //the three smallest components of a unit quaternion are within +-1/sqrt(2)
+
+//one joint in one frame: smallest-three rotation and IQM-quantized translation
+typedef struct AnimKey {
+    uint16_t rot[3];
+    uint16_t pos[3];
+} AnimKey;
+
+//per joint dequantization, value = offset + key * scale
+typedef struct AnimJointRange {
+    HMM_Vec3 pos_offset, pos_scale;
+    HMM_Vec3 scale_offset, scale_scale;
+} AnimJointRange;
+
 typedef struct AnimSet {
     AnimInfo* anims;
-    HMM_Mat4* frames;
+    HMM_Mat4* frames; //baked, num_frames * num_joints
+    AnimKey* keys; //quantized, num_frames * num_joints
+    uint16_t* scale_keys; //quantized, 3 per key, NULL if no joint animates its scale
+    AnimJointRange* ranges;
+    HMM_Mat4* inverse_bind;
     int* joint_parents;
     int num_anims;
     int num_frames;
     int num_joints;
+    AnimStorage storage;
+    size_t data_size; //bytes taken from the anim arena
 } AnimSet;
 
 #define ANIM_FLAG_NONE (0)
@@ -164,12 +278,33 @@ typedef struct AnimSet {
 
 #define ANIM_BLEND_DURATION 0.25f
 
+//default distances beyond which skeletons are re-sampled every 2nd/4th frame
+#define ANIM_LOD_DISTANCE_HALF 15.0f
+#define ANIM_LOD_DISTANCE_QUARTER 40.0f
+
+#define ANIM_MAX_THREADS 16
+
 typedef struct AnimState {
     int flags;
     int anim;
     float current_frame;
 } AnimState;
 
+#define ANIM_MAX_LAYERS 4
+#define ANIM_LAYER_ADDITIVE (1 << 0) //adds the clip's motion relative to its first frame instead of replacing
+
+typedef struct AnimMask {
+    uint32_t bits[MAX_BONES / 32]; //joints a layer affects, an empty mask affects all
+} AnimMask;
+
+//evaluated on top of the entity's base animation, in layer order
+typedef struct AnimLayer {
+    AnimState state;
+    AnimMask mask;
+    float weight; //0 skips the layer entirely
+    uint32_t flags;
+} AnimLayer;
+
 typedef struct RenderContextDesc {
     sg_environment environment;
     int width, height;
@@ -177,26 +312,93 @@ typedef struct RenderContextDesc {
     uint16_t max_anim_sets;
     uint16_t max_meshes;
     uint16_t max_textures;
+    float anim_lod_distances[2]; //0 picks ANIM_LOD_DISTANCE_HALF/QUARTER
+    int anim_threads; //extra worker threads for anim_update, 0 runs it on the calling thread
+    int max_instances; //instanced static draws per frame, 0 picks GFX_DEFAULT_MAX_INSTANCES
+    int max_palette_bones; //skinning matrices per frame, 0 picks GFX_DEFAULT_PALETTE_BONES
+    int geometry_vertices; //per shared vertex buffer, 0 picks GFX_DEFAULT_GEOMETRY_VERTICES
+    int geometry_indices;  //per shared index buffer, 0 picks GFX_DEFAULT_GEOMETRY_INDICES
+    AnimStorage anim_storage; //how gfx_load_anims keeps frames, ANIM_STORAGE_BAKED by default
+    bool compact_vertices; //load unskinned iqm meshes as MESH_COMPACT
+    bool optimize_meshes; //reorder iqm triangles and vertices for the gpu caches, see MODEL_LOAD_OPTIMIZE
+    const char* texture_cache_dir; //webp textures are decoded with mips once and kept here as dds, NULL to always decode
+    bool texture_cache_bc3; //compress cache entries to BC3 when the gpu samples it, lossy. sizes that aren't multiples of 4 stay RGBA8
 } RenderContextDesc;
 
-#define GFX_PIPELINE_COUNT 3
+typedef struct RenderStats {
+    int visible;
+    int culled;
+    int skeletons_sampled;
+    int draw_calls;
+    int pipeline_changes;
+    int binding_changes;
+} RenderStats;
+
+#define GFX_PIPELINE_COUNT 4
 #define GFX_PIP_DEFAULT 0
 #define GFX_PIP_SKINNED 1
 #define GFX_PIP_CUBEMAP 2
+#define GFX_PIP_INSTANCED 3
+
+#define GFX_DEFAULT_MAX_INSTANCES 1024
+#define GFX_DEFAULT_PALETTE_BONES 4096
+#define GFX_DEFAULT_GEOMETRY_VERTICES (1 << 16)
+#define GFX_DEFAULT_GEOMETRY_INDICES (1 << 18)
+#define GFX_PALETTE_WIDTH 1024 //texels per palette row, must match PALETTE_WIDTH in shaders.glsl
+#define GFX_PALETTE_SIZES 16 //palette textures of 1, 2, 4.. rows, the last one holds max_palette_bones
+
+typedef struct RenderItem {
+    uint64_t key; //pipeline | texture | model | mesh | depth, most significant first
+    int idx;      //entity index
+    int bone_base; //first palette matrix of a skinned entity
+} RenderItem;
+
+//shared mesh buffers, one per vertex or index format. sokol only updates whole buffers, so each
+//keeps a cpu copy that goes up once per frame after a model was added
+enum {
+    GEO_POOL_VERTS,    //VertexPNT
+    GEO_POOL_SKIN,     //VertexSkin, same ranges as GEO_POOL_VERTS
+    GEO_POOL_COMPACT,  //VertexCompact
+    GEO_POOL_INDEX16,
+    GEO_POOL_INDEX32,
+    GEO_POOL_COUNT
+};
+
+typedef struct GeoRange {
+    uint32_t start, count; //elements
+} GeoRange;
+
+typedef struct GeoPool {
+    sg_buffer buf;    //made on first use
+    uint8_t* shadow;
+    GeoRange* free;   //sorted by start, never overlapping or touching
+    int num_free;
+    uint32_t stride;
+    uint32_t capacity;
+    uint32_t used_end; //elements up to here are uploaded
+    bool dirty;
+} GeoPool;
 
 typedef struct RenderContext {
     struct {
         hp_Pool pool;
         AnimSet* data;
         ArenaAlloc alloc;
+        AnimStorage storage;
+        AssetCache cache;
     } anims;
     struct {
         hp_Pool pool;
         Model* data;
+        AssetCache cache;
+        uint32_t load_flags; //MODEL_LOAD_*, from RenderContextDesc
     } meshes;
     struct {
         hp_Pool pool;
         Texture* data;
+        AssetCache cache;
+        char cache_dir[256]; //RenderContextDesc.texture_cache_dir, empty when off
+        bool cache_bc3;
     } textures;
     struct {
         struct {
@@ -208,7 +410,7 @@ typedef struct RenderContext {
         int width, height;
         sg_image color_img;
         sg_image depth_img;
-        sg_pipeline pip[GFX_PIPELINE_COUNT];
+        sg_pipeline pip[GFX_PIPELINE_COUNT][MESH_FORMAT_COUNT]; //by Mesh.format, the cubemap only has [0]
         sgl_pipeline physics_pip;
         sg_sampler default_sampler;
         u_dir_light_t light;
@@ -219,29 +421,94 @@ typedef struct RenderContext {
         sg_pipeline pip;
         sg_bindings rect;
     } display;
+    struct {
+        float dist_sq[2];
+        uint32_t frame;
+    } anim_lod;
+    struct AnimWorkers* anim_workers; //NULL when anim_update runs serially
+    struct {
+        Allocator alloc;
+        RenderItem* items;
+        RenderItem* tmp; //radix sort scratch
+        int cap;
+    } queue;
+    struct {
+        sg_buffer buf; //world matrices, streamed once per frame
+        HMM_Mat4* mtx;
+        int max;
+    } instances;
+    struct {
+        //RGBA32F, 4 texels per matrix. sg_update_image always writes a whole image, so each frame
+        //rebuilds the smallest one that holds the bones it uses
+        sg_image img[GFX_PALETTE_SIZES];
+        sg_view view[GFX_PALETTE_SIZES];
+        sg_sampler smp;
+        HMM_Mat4* mtx;
+        int max;
+        int num_sizes;
+        int cur; //size updated this frame
+    } palette;
+    struct {
+        Allocator alloc;
+        GeoPool pools[GEO_POOL_COUNT];
+        int max_ranges;
+        bool base_vertex;   //sg_features.draw_base_vertex, else the vertex offset is bound per mesh
+        bool base_instance; //sg_features.draw_base_instance, else the instance offset is bound per run
+    } geometry;
+    RenderStats stats; //model entities drawn/culled by the last gfx_render
 } RenderContext;
 
 RenderContext* gfx_new_context(Allocator* alloc, const RenderContextDesc* desc);
-void gfx_render(RenderContext* gfx, Scene* scene, Camera* cam, sg_swapchain swapchain, float dt);
+void gfx_render(RenderContext* gfx, Scene* scene, Camera* cam, sg_swapchain swapchain);
 void gfx_reset(RenderContext* gfx);
+//keeps cached assets alive across a script reload: begin drops every reference and frees the
+//uncached ones, end frees whatever the new script didn't load again
+void gfx_begin_reload(RenderContext* gfx);
+void gfx_end_reload(RenderContext* gfx);
 void gfx_shutdown(RenderContext* gfx);
+RenderStats gfx_get_stats(RenderContext* gfx);
 void gfx_load_cubemap(RenderContext* ctx, ArenaAlloc* alloc, IoMemory* mem);
 
 typedef struct ModelHandle { hp_Handle id; } ModelHandle;
+size_t model_decode_size(const IoMemory* data, uint32_t flags); //arena space gfx_load_model needs for this file with MODEL_LOAD_* flags, 0 if it's no iqm or already cooked
+//how iqm meshes are converted, cooked models keep what they were cooked with
+enum {
+    MODEL_LOAD_COMPACT = 1 << 0,  //unskinned meshes as MESH_COMPACT
+    MODEL_LOAD_OPTIMIZE = 1 << 1, //triangles reordered for the post transform cache and overdraw, vertices for fetch
+};
+#define MODEL_VCACHE_SIZE 16 //fifo entries the triangle order is tuned for and acmr is measured with
+//acmr of each mesh as gfx_load_model would upload it with these flags, decodes into alloc. returns the mesh count
+int model_measure_acmr(ArenaAlloc* alloc, const IoMemory* iqm, uint32_t flags, float* acmr, int max_meshes);
+//models cooked offline (see cook.c) load without conversion, gfx_load_model and gfx_load_anims take both formats
+#define MODEL_COOKED_MAGIC "LOFIMDL"
+#define MODEL_COOKED_VERSION 4
+bool model_is_cooked(const IoMemory* data);
+size_t cook_model_size(const IoMemory* iqm, uint32_t flags); //arena space cook_model needs for this iqm
+//out points into alloc, flags are MODEL_LOAD_*. skeleton and clips are cooked along when the iqm has them
+Result cook_model(ArenaAlloc* alloc, IoMemory* out, const IoMemory* iqm, uint32_t flags);
 ModelHandle gfx_load_model(RenderContext* ctx, ArenaAlloc* alloc, const IoMemory* data);
 void gfx_release_model(RenderContext* ctx, ModelHandle mesh);
 
 typedef struct TextureHandle { hp_Handle id; } TextureHandle;
-TextureHandle gfx_load_texture(RenderContext* ctx, ArenaAlloc* alloc, IoMemory* data);
+TextureHandle gfx_load_texture(RenderContext* ctx, IoMemory* data);
+//true when loading data would decode a webp that has no cache entry yet, worth a loader thread.
+//hash (can be NULL) gets the cache key of data, for asset_load_texture_async
+bool gfx_texture_cache_miss(RenderContext* ctx, const IoMemory* data, uint64_t* hash);
 void gfx_release_texture(RenderContext* ctx, TextureHandle tex);
 
 typedef struct AnimSetHandle { hp_Handle id; } AnimSetHandle;
 AnimSetHandle gfx_load_anims(RenderContext* ctx, const IoMemory* data);
 void gfx_clear_anims(RenderContext* ctx);
+//iqm animations into out, without a RenderContext. the frames live in allocator
+Result load_anims(ArenaAlloc* allocator, AnimSet* out, const IoMemory* mem, AnimStorage storage);
 
 void update_anim_state(AnimState* state, AnimSet* set, float dt);
-void play_anim(u_skeleton_t* out, AnimSet* set, AnimState* state);
-void blend_anims(u_skeleton_t* out_a, const u_skeleton_t* out_b, float weight, int num_joints);
+void play_anim(HMM_Mat4* out, AnimSet* set, AnimState* state);
+void blend_anims(HMM_Mat4* out_a, const HMM_Mat4* out_b, float weight, int num_joints);
+//adds joint and all of its descendants, false if the set has no such joint.
+//an empty mask affects the whole skeleton, so don't use the mask when this fails
+bool anim_mask_add_joint(AnimMask* mask, const AnimSet* set, int joint);
+void anim_update(Scene* scene, RenderContext* gfx, Camera* cam, float dt);
 
 //--IMMEDIATE-MODE-HELPERS-------------------------------------------------------
 
@@ -276,6 +543,7 @@ typedef struct AudioContext {
     struct {
         hp_Pool pool;
         SoundBuffer* data;
+        AssetCache cache;
     } buffers;
     SoundListener listener;
 } AudioContext;
@@ -283,12 +551,60 @@ typedef struct AudioContext {
 AudioContext* sfx_new_context(Allocator* alloc, uint16_t max_buffers);
 void sfx_update(AudioContext* sfx, HMM_Vec3 listener_pos, HMM_Vec3 listener_forward, Scene* scene, float dt);
 void sfx_reset(AudioContext* sfx);
+void sfx_begin_reload(AudioContext* sfx); //see gfx_begin_reload
+void sfx_end_reload(AudioContext* sfx);
 void sfx_shutdown(AudioContext* sfx);
 
 typedef struct SoundBufferHandle { hp_Handle id; } SoundBufferHandle;
 SoundBufferHandle sfx_load_buffer(AudioContext* ctx, IoMemory* data);
 void sfx_release_buffer(AudioContext* sfx, SoundBufferHandle buf);
 
+//--ASSETS-----------------------------------------------------------------------
+
+//background loading: files are read on sokol_fetch io threads, decoded on worker threads,
+//and turned into gpu/mixer objects on the main thread in asset_loader_update.
+//asset_load_async hands out the pool handle right away, it draws and plays as empty until ready.
+
+typedef uint8_t AssetType;
+enum {
+    ASSET_TEXTURE = 0,
+    ASSET_MODEL,
+    ASSET_ANIMS,
+    ASSET_SOUND,
+    ASSET_TYPE_COUNT,
+};
+
+typedef uint8_t AssetStatus;
+enum {
+    ASSET_INVALID = 0, //not a live handle of that type
+    ASSET_PENDING,
+    ASSET_READY,
+    ASSET_FAILED,      //the handle stays reserved (and empty) until it is released
+};
+
+#define ASSET_DEFAULT_MAX_JOBS 256
+#define ASSET_MAX_THREADS 8
+
+typedef struct AssetLoaderDesc {
+    int max_jobs;       //loads in flight, 0 picks ASSET_DEFAULT_MAX_JOBS
+    int io_channels;    //sokol_fetch io threads, 0 picks 1
+    int io_lanes;       //concurrent reads per channel, 0 picks 4
+    int decode_threads; //0 decodes on the main thread inside asset_loader_update
+    int max_creates;    //assets finished per asset_loader_update, 0 is unlimited
+} AssetLoaderDesc;
+
+typedef struct AssetLoader AssetLoader;
+
+AssetLoader* asset_loader_new(Allocator* alloc, RenderContext* gfx, AudioContext* sfx, const AssetLoaderDesc* desc);
+void asset_loader_update(AssetLoader* loader); //once per frame, main thread
+void asset_loader_reset(AssetLoader* loader);  //forgets loads in flight, call before gfx_reset/sfx_reset or the end of a reload
+void asset_loader_destroy(AssetLoader* loader);
+hp_Handle asset_load_async(AssetLoader* loader, AssetType type, const char* path);
+//asset_load_async for a texture the caller has read already, data is copied and hash is what
+//gfx_texture_cache_miss gave for it, so the file isn't read and hashed a second time
+hp_Handle asset_load_texture_async(AssetLoader* loader, const char* path, const IoMemory* data, uint64_t hash);
+AssetStatus asset_status(AssetLoader* loader, AssetType type, hp_Handle hnd);
+
 //--PHYSICS--------------------------------
 
 void ne_update(ne_Simulator sim, Scene* scene, float dt);
@@ -297,12 +613,14 @@ void ne_update(ne_Simulator sim, Scene* scene, float dt);
 //--ENTITY---------------------------------
 
 
-#define ENTITY_HAS_PARENT   (1U << 0)
-#define ENTITY_HAS_CHILDREN (1U << 1)
+#define ENTITY_HAS_PARENT      (1U << 0)
+#define ENTITY_HAS_CHILDREN    (1U << 1)
+#define ENTITY_TRANSFORM_DIRTY (1U << 2)
 
 #define ENTITY_VISIBLE      (1U << 0)
 #define ENTITY_HAS_MODEL    (1U << 1)
 #define ENTITY_HAS_ANIM     (1U << 2)
+#define ENTITY_ANIM_CACHED  (1U << 3) //poses[idx * MAX_BONES] holds a valid pose
 
 #define ENTITY_HAS_SOUND     (1U << 0)
 #define ENTITY_SOUND_PLAY    (1U << 1)
@@ -316,6 +634,12 @@ void ne_update(ne_Simulator sim, Scene* scene, float dt);
 
 #define ENTITY_MAX_CHILDREN 8
 
+//parts of the packed transforms entities_set_transforms moves, floats per entity in this order
+#define TRANSFORM_POS   (1U << 0) //x y z
+#define TRANSFORM_ROT   (1U << 1) //quaternion x y z w
+#define TRANSFORM_SCALE (1U << 2) //x y z
+#define TRANSFORM_ALL   (TRANSFORM_POS | TRANSFORM_ROT | TRANSFORM_SCALE)
+
 typedef uint16_t RelationFlags;
 typedef uint16_t ModelFlags;
 typedef uint16_t AnimFlags;
@@ -340,6 +664,7 @@ typedef struct Scene {
 
     RelationFlags* relation_flags;
     Transform* transforms;
+    HMM_Mat4* world; //cached world matrices, refreshed by scene_update_transforms
     Entity* parents;
     Children* childs;
 
@@ -352,6 +677,8 @@ typedef struct Scene {
     AnimState* anim_states;
     AnimState* prev_anim_states;
     float* anim_blend_weights;
+    AnimLayer* anim_layers; //ANIM_MAX_LAYERS per entity
+    HMM_Mat4* poses; //last sampled pose, MAX_BONES matrices per entity, reused by the animation lod
 
     SoundFlags* sound_flags;
     SoundBufferHandle* sound_buffers;
@@ -365,6 +692,7 @@ typedef struct Scene {
 Scene* scene_new(Allocator* alloc, uint16_t max_things);
 void scene_reset(Scene* scene);
 void scene_destroy(Allocator* alloc, Scene* scene);
+void scene_update_transforms(Scene* scene);
 Entity entity_new(Scene* scene);
 bool entity_valid(Scene* scene, Entity entity);
 void entity_destroy(Scene* scene, Entity entity);
@@ -377,6 +705,29 @@ void entity_set_scale(Scene* scene, Entity e, HMM_Vec3 scale);
 HMM_Vec3 entity_get_scale(Scene* scene, Entity e);
 void entity_set_transform(Scene* scene, Entity e, Transform trs);
 Transform entity_get_transform(Scene* scene, Entity e);
+int transform_stride(uint32_t parts); //floats per entity
+//count entities in one go, ids are entity ids and the floats are packed (see TRANSFORM_*).
+//invalid ids are skipped on set and read back as zeros
+void entities_set_transforms(Scene* scene, const uint32_t* ids, const float* src, int count, uint32_t parts);
+void entities_get_transforms(Scene* scene, const uint32_t* ids, float* dst, int count, uint32_t parts);
+
+//flat copy of scene components in script memory, the layout lofi.h publishes as lo_SceneView.
+//arrays are indexed by slot (hp_index), the offsets are in bytes from the view
+typedef struct SceneView {
+    uint32_t capacity;
+    uint32_t dirty_begin; //slots the script changed, [dirty_begin, dirty_end)
+    uint32_t dirty_end;
+    uint32_t ids;         //uint32_t[capacity], entity in the slot or 0
+    uint32_t transforms;  //float[capacity][10], packed like TRANSFORM_ALL
+    uint32_t anims;       //AnimState[capacity]
+} SceneView;
+
+size_t scene_view_size(const Scene* scene);
+//copies all live entities into the view and clears its dirty range
+void scene_view_publish(Scene* scene, SceneView* view);
+//takes back the dirty range, slots whose entity changed since the publish are skipped.
+//view must be scene_view_size() bytes, only the dirty range is read from its header
+void scene_view_apply(Scene* scene, SceneView* view);
 HMM_Mat4 entity_mtx(Scene* scene, Entity entity);
 
 void entity_set_parent(Scene* scene, Entity entity, Entity parent);
@@ -391,6 +742,9 @@ void entity_set_textures(Scene* scene, Entity entity, TextureSet set);
 void entity_clear_textures(Scene* scene, Entity entity);
 void entity_set_anim(Scene* scene, Entity entity, AnimSetHandle set, AnimState state);
 void entity_clear_anim(Scene* scene, Entity entity);
+void entity_set_anim_layer(Scene* scene, Entity entity, int layer, AnimLayer desc);
+void entity_set_anim_layer_weight(Scene* scene, Entity entity, int layer, float weight);
+void entity_clear_anim_layer(Scene* scene, Entity entity, int layer);
 
 void entity_set_sound(Scene* scene, Entity e, SoundBufferHandle buffer, SoundProps props, uint32_t flags);
 void entity_play_sound(Scene* scene, Entity e);
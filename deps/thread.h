@@ -28,10 +28,16 @@ extern "C" {
 typedef HANDLE mt_thread;
 typedef CRITICAL_SECTION mt_mutex;
 typedef volatile LONG mt_atomic_int32;
+typedef HANDLE mt_sema;
 #else
 typedef pthread_t mt_thread;
 typedef pthread_mutex_t mt_mutex;
 typedef volatile int32_t mt_atomic_int32;
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int count;
+} mt_sema; //unnamed posix semaphores are not available on macos
 #endif
 
 typedef void* (*mt_thread_func)(void*);
@@ -99,6 +105,54 @@ static inline void mt_mutex_unlock(mt_mutex* mutex) {
 #endif
 }
 
+
+static inline int mt_sema_init(mt_sema* sema, int count) {
+#ifdef _WIN32
+    *sema = CreateSemaphore(NULL, count, 0x7fffffff, NULL);
+    return *sema != NULL ? 0 : -1;
+#else
+    sema->count = count;
+    if (pthread_mutex_init(&sema->lock, NULL) != 0) return -1;
+    if (pthread_cond_init(&sema->cond, NULL) != 0) {
+        pthread_mutex_destroy(&sema->lock);
+        return -1;
+    }
+    return 0;
+#endif
+}
+
+static inline void mt_sema_destroy(mt_sema* sema) {
+#ifdef _WIN32
+    CloseHandle(*sema);
+#else
+    pthread_cond_destroy(&sema->cond);
+    pthread_mutex_destroy(&sema->lock);
+#endif
+}
+
+static inline void mt_sema_wait(mt_sema* sema) {
+#ifdef _WIN32
+    WaitForSingleObject(*sema, INFINITE);
+#else
+    pthread_mutex_lock(&sema->lock);
+    while (sema->count <= 0) pthread_cond_wait(&sema->cond, &sema->lock);
+    sema->count--;
+    pthread_mutex_unlock(&sema->lock);
+#endif
+}
+
+static inline void mt_sema_post(mt_sema* sema, int count) {
+#ifdef _WIN32
+    ReleaseSemaphore(*sema, count, NULL);
+#else
+    pthread_mutex_lock(&sema->lock);
+    sema->count += count;
+    if (count > 1) pthread_cond_broadcast(&sema->cond);
+    else pthread_cond_signal(&sema->cond);
+    pthread_mutex_unlock(&sema->lock);
+#endif
+}
+
 static inline void mt_atomic_init(mt_atomic_int32* a, int32_t value) {
     *a = value;
 }
@@ -89,6 +89,21 @@ typedef struct Block {
     uint32_t   br_addr;     /* break address */
 } Block;
 
+/* one instruction of the translated code, immediates decoded and branch targets resolved */
+typedef struct Insn {
+    union {
+        const void *label;  /* handler address with threaded dispatch */
+        uint32_t    op;     /* internal opcode */
+    } h;
+    uint32_t   a, b;        /* immediates, 64 bit constants are split in two */
+} Insn;
+
+/* translated function */
+typedef struct FuncCode {
+    uint32_t   entry;       /* index of the first instruction in code */
+    uint32_t   frame;       /* stack slots needed above the arguments, locals and deepest operand stack */
+} FuncCode;
+
 /* one function frame on the call stack */
 typedef struct Frame {
     uint32_t   block;       /* if most significant bit set, index to functions, otherwise to cache */
@@ -111,6 +126,7 @@ typedef struct Memory {
     uint64_t   size;        /* address space size in bytes */
     uint64_t   start;       /* address space start (required size with WA_ALLOW_GROW / WA_DIRECTMEM) */
     uint64_t   limit;       /* address space end (always WA_MAXMEM with WA_ALLOW_GROW) */
+    uint64_t   maximum;     /* memory.grow limit with WA_GUARDMEM */
 } Memory;
 
 /* data segment */
@@ -145,6 +161,16 @@ enum { BRK_NONE, BRK_CODE, BRK_CALL, BRK_GET, BRK_SET, BRK_READ, BRK_WRITE, BRK_
 # endif
 # define WA_NUMBUF  1
 #endif
+/* WA_GUARDMEM reserves the whole 33 bit address range wasm code can reach and commits pages on memory.grow,
+ * out of bound accesses of translated code fault on the reserved pages and trap instead of being checked */
+#ifdef WA_GUARDMEM
+# if defined(WA_MAXALLOC) || defined(WA_ALLOW_GROW) || defined(WA_DIRECTMEM)
+#  error "WA_GUARDMEM is mutually exclusive with WA_MAXALLOC, WA_ALLOW_GROW and WA_DIRECTMEM"
+# endif
+# if defined(_WIN32) || UINTPTR_MAX <= 0xffffffffU
+#  error "WA_GUARDMEM needs a 64 bit POSIX system"
+# endif
+#endif
 enum { LIDX_MALLOC, LIDX_REALLOC, LIDX_FREE };
 
 /* the main WA context */
@@ -169,8 +195,14 @@ typedef struct Module {
     Block      *cache;          /* only for block type opcodes */
     uint32_t   *lookup;         /* pc to cache lookup */
     uint32_t    cache_count, lookup_first, lookup_count;
+    /* translated code (NULL if the wasm binary is interpreted directly) */
+    Insn       *code;
+    uint32_t   *code_pc;        /* wasm binary offset of each instruction, for err_pc */
+    FuncCode   *func_code;      /* indexed by fidx, only set for internal functions */
+    uint32_t    code_count, code_threaded;
+    struct WaNative *native;    /* ahead-of-time compiled code, see wa_native() */
     /* machine state */
-    uint32_t    pc;             /* program counter */
+    uint32_t    pc;             /* program counter (instruction index with translated code) */
     int         sp, sp_count;   /* stack pointer and size */
     int         fp;             /* frame pointer on stack */
     StackValue *stack;
@@ -186,6 +218,15 @@ typedef struct Module {
 #endif
 } Module;
 
+/* ahead-of-time compiled code of a module (made by wa2c), memory, globals, the table and imports stay in Module */
+typedef struct WaNative {
+    uint64_t    hash;           /* wa_hash() of the wasm binary it was compiled from */
+    uint32_t    function_count;
+    StackValue (*const *entries)(Module *m, StackValue *args);      /* by fidx, NULL for imports */
+    StackValue (*host)(Module *m, uint32_t fidx, StackValue *args); /* set by wa_native(), calls an import */
+    uint32_t   (*grow)(Module *m, uint32_t pages);                 /* set by wa_native(), memory.grow */
+} WaNative;
+
 int wa_init(Module *m, uint8_t *bytes, uint32_t byte_count, RTLink *link);
 int wa_sym(Module *m, char *name);
 int wa_set(Module *m, int gidx, StackValue value);
@@ -199,6 +240,8 @@ int wa_push_f32(Module *m, float  value);
 int wa_push_f64(Module *m, double value);
 #endif
 StackValue wa_call(Module *m, int fidx);
+uint64_t wa_hash(const uint8_t *bytes, uint32_t byte_count);
+int wa_native(Module *m, WaNative *native);
 int wa_free(Module *m);
 
 #ifdef WA_DEBUGGER
@@ -313,6 +356,15 @@ WA_illllllll =00222222221, WA_lllllllll =00222222222, WA_vlllllllll=02222222220,
 # define WA_MAXMEM  (256*WA_PAGESIZE)
 #endif
 
+/* function bodies are translated to Insn code on load, unless WA_NOTRANSLATE is defined or the debugger
+ * needs the wasm binary offsets. That code is run with computed gotos where available (WA_NOTHREADED forces a switch) */
+#if !defined(WA_NOTRANSLATE) && !defined(WA_DEBUGGER)
+# define WA_TRANSLATE
+# if !defined(WA_NOTHREADED) && defined(__GNUC__)
+#  define WA_THREADED
+# endif
+#endif
+
 /* math stuff */
 double sqrt(double);
 static __inline__ uint32_t rotl32(uint32_t n, uint32_t c) { c = c % 32; c &= 31; return (n << c) | (n >> ((0 - c) & 31)); }
@@ -368,6 +420,7 @@ static void *wa_recalloc(Module *m, void *ptr, size_t old_nmemb, size_t nmemb, s
     return res;
 }
 
+#ifndef WA_GUARDMEM
 /* check memory (address space) size and grow if necessary */
 static int wa_check_mem(Module *m)
 {
@@ -389,6 +442,91 @@ static int wa_check_mem(Module *m)
     }
     return 0;
 }
+#endif
+
+#ifdef WA_GUARDMEM
+#include <signal.h>
+#include <setjmp.h>
+#include <sys/mman.h>
+
+/* i32 address plus u32 offset plus the access size, nothing wasm code computes lands outside of this */
+#define WA_GUARDSIZE ((1ULL << 33) + WA_PAGESIZE)
+
+/* set by wa_run_guarded, a fault in the reservation of the innermost running module jumps back to it */
+typedef struct WaGuard {
+    uint8_t        *base;
+    sigjmp_buf      jmp;
+    struct WaGuard *outer;
+} WaGuard;
+static __thread WaGuard *wa_guard;
+static struct sigaction wa_guard_prev[2];
+static int wa_guard_installed;
+
+static void wa_guard_handler(int sig, siginfo_t *info, void *ctx)
+{
+    struct sigaction *prev = &wa_guard_prev[sig == SIGBUS];
+    uint8_t *addr = (uint8_t*)info->si_addr;
+
+    if(wa_guard && addr >= wa_guard->base && addr < wa_guard->base + WA_GUARDSIZE) siglongjmp(wa_guard->jmp, 1);
+    /* not ours, pass it on to whoever had it before */
+    if(prev->sa_flags & SA_SIGINFO) prev->sa_sigaction(sig, info, ctx);
+    else if(prev->sa_handler != SIG_DFL && prev->sa_handler != SIG_IGN) prev->sa_handler(sig);
+    else signal(sig, SIG_DFL); /* the faulting instruction runs again and takes the default action */
+}
+
+/* reserve the address space and commit the first size bytes */
+static int wa_guard_mem(Module *m, uint64_t size)
+{
+    struct sigaction sa;
+    uint8_t *bytes = (uint8_t*)mmap(NULL, WA_GUARDSIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if(bytes == MAP_FAILED || (size && mprotect(bytes, size, PROT_READ | PROT_WRITE))) {
+        ERR(("wa_guard_mem: could not reserve the address space"));
+        if(bytes != MAP_FAILED) munmap(bytes, WA_GUARDSIZE);
+        m->err_code = WA_ERR_MEMORY; return 0;
+    }
+    m->memory[0].bytes = bytes;
+    m->memory[0].start = 0;
+    m->memory[0].size = m->memory[0].limit = size;
+    DBG(("  memory size: %"LL"u pages, up to %"LL"u pages", size / WA_PAGESIZE, m->memory[0].maximum / WA_PAGESIZE));
+    if(!wa_guard_installed) {
+        /* SA_NODEFER, so leaving the handler with siglongjmp needs no signal mask restore */
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = wa_guard_handler;
+        sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGSEGV, &sa, &wa_guard_prev[0]);
+        sigaction(SIGBUS, &sa, &wa_guard_prev[1]);
+        wa_guard_installed = 1;
+    }
+    return 1;
+}
+#endif
+
+/* memory.grow, returns the previous size in pages or -1 */
+static uint32_t wa_grow(Module *m, uint32_t pages)
+{
+    uint32_t prev = (m->memory[0].size + WA_PAGESIZE - 1) / WA_PAGESIZE;
+    uint64_t d = m->memory[0].size + (uint64_t)pages * WA_PAGESIZE;
+
+    if(!pages) return prev;
+#ifdef WA_ALLOW_GROW
+    if(d < m->memory[0].limit && d < WA_MAXMEM) {
+        m->memory[0].bytes = wa_recalloc(m, m->memory[0].bytes, m->memory[0].size, d, sizeof(uint8_t), __LINE__);
+        m->memory[0].start = m->memory[0].size = d;
+        return prev;
+    }
+#endif
+#ifdef WA_GUARDMEM
+    if(d <= m->memory[0].maximum &&
+      !mprotect(m->memory[0].bytes + m->memory[0].size, d - m->memory[0].size, PROT_READ | PROT_WRITE)) {
+        m->memory[0].size = m->memory[0].limit = d;
+        return prev;
+    }
+#endif
+    (void)d;
+    return (uint32_t)-1;
+}
 
 /* check stack size (and grow it in smallish steps if necessary) */
 static int wa_check_stack(Module *m, int deltasp) {
@@ -500,7 +638,8 @@ static void wa_read_table_type(Module *m, uint32_t *pos) {
 
 static void wa_read_memory_type(Module *m, uint32_t *pos) {
     uint32_t flags = wa_read_LEB(m, pos, 32);
-    uint64_t pages = wa_read_LEB(m, pos, 32) * WA_PAGESIZE;
+    uint64_t pages = wa_read_LEB(m, pos, 32) * WA_PAGESIZE, initial = pages;
+    (void)initial;
     m->memory[0].limit = pages;
     if(flags & 0x1) {
         pages = wa_read_LEB(m, pos, 32) * WA_PAGESIZE;
@@ -508,6 +647,12 @@ static void wa_read_memory_type(Module *m, uint32_t *pos) {
     }
 #ifdef WA_ALLOW_GROW
     if(m->memory[0].limit < WA_MAXMEM) m->memory[0].limit = WA_MAXMEM;
+#endif
+#ifdef WA_GUARDMEM
+    /* only the initial pages are committed, the rest comes with memory.grow */
+    m->memory[0].maximum = flags & 0x1 ? m->memory[0].limit : 65536ULL * WA_PAGESIZE;
+    if(m->memory[0].maximum > WA_MAXMEM) m->memory[0].maximum = WA_MAXMEM;
+    m->memory[0].limit = initial;
 #endif
     if(m->memory[0].limit > WA_MAXMEM) {
         m->memory[0].limit = WA_MAXMEM;
@@ -543,7 +688,7 @@ static uint8_t *wa_read_addr(Module *m, int dir, uint64_t offs, uint32_t size)
             m->memory[0].bytes + offs;
 #else
     for(n = 0; n < WA_NUMBUF; n++)
-        if(offs >= m->memory[n].start && end < m->memory[n].limit) {
+        if(offs >= m->memory[n].start && end <= m->memory[n].limit) {
             maddr = m->memory[n].bytes - m->memory[n].start + offs;
             break;
         }
@@ -577,12 +722,40 @@ static uint64_t wa_read_init_value(Module *m, uint32_t *pos) {
     return ret.u64;
 }
 
+/* skip the immediates following an opcode */
+static void wa_skip_immediates(Module *m, uint32_t opcode, uint32_t *pos)
+{
+    uint32_t i, cnt;
+
+    switch (opcode) {
+    case 0x3f: case 0x40:                                                       /* current_memory, grow_memory */
+    case 0x0c: case 0x0d: case 0x10: case 0x12:                                 /* br, br_if, call, return_call */
+    case 0x1d: case 0x1e: case 0x20: case 0x21: case 0x22: case 0x23: case 0x24:/* get/local.set, local.tee, get/global.set */
+    case 0x41: case 0xfc09: case 0xfc0b: wa_read_LEB(m, pos, 32); break;        /* i32.const, data.drop, memory.fill */
+    case 0x11: case 0x13: wa_read_LEB(m, pos, 32); wa_read_LEB(m, pos, 1); break; /* call_indirect, return_call_indirect */
+    case 0x1c: cnt = wa_read_LEB(m, pos, 32); while(cnt--) wa_read_u8(m, pos); break; /* typed_select */
+    case 0x42: wa_read_LEB(m, pos, 64); break;                                  /* i64.const */
+    case 0x43: wa_read_u32(m, pos); break;                                      /* f32.const */
+    case 0x44: wa_read_u64(m, pos); break;                                      /* f64.const */
+    case 0x02: case 0x03: case 0x04: wa_read_LEB(m, pos, 7); break;             /* block, loop, if */
+    case 0x28: case 0x29: case 0x2a: case 0x2b: case 0x2c: case 0x2d: case 0x2e: case 0x2f:/* *.load*, *.store*, memory.init, memory.copy */
+    case 0x30: case 0x31: case 0x32: case 0x33: case 0x34: case 0x35: case 0x36:
+    case 0x37: case 0x38: case 0x39: case 0x3a: case 0x3b: case 0x3c: case 0x3d:
+    case 0x3e: case 0xfc08: case 0xfc0a: wa_read_LEB(m, pos, 32); wa_read_LEB(m, pos, 32); break;
+    case 0xc7: case 0xc9: case 0xca: wa_read_u8(m, pos); break;                 /* local.get/set/tee fast */
+    case 0x0e: cnt = wa_read_LEB(m, pos, 32);                                   /* br_table */
+        for(i = 0; i < cnt; i++) wa_read_LEB(m, pos, 32);
+        wa_read_LEB(m, pos, 32);
+        break;
+    }
+}
+
 /* build up block lookup cache for a function */
 static int wa_find_blocks(Module *m, Block *func)
 {
     Block    *block;
     int      top = -1;
-    uint32_t pos = func->start_addr, i, cnt, opcode;
+    uint32_t pos = func->start_addr, i, opcode;
     uint32_t *blockstack = wa_recalloc(m, NULL, 0, func->end_addr - pos, sizeof(uint32_t), __LINE__);
 
     while(!m->err_code && pos <= func->end_addr) {
@@ -620,28 +793,7 @@ static int wa_find_blocks(Module *m, Block *func)
                 block->start_addr, block->end_addr, block->br_addr, block->else_addr)); */
             break;
         }
-        /* skip immediates */
-        switch (opcode) {
-        case 0x3f: case 0x40:                                                       /* current_memory, grow_memory */
-        case 0x0c: case 0x0d: case 0x10: case 0x12:                                 /* br, br_if, call, return_call */
-        case 0x1d: case 0x1e: case 0x20: case 0x21: case 0x22: case 0x23: case 0x24:/* get/local.set, local.tee, get/global.set */
-        case 0x41: case 0xfc09: case 0xfc0b: wa_read_LEB(m, &pos, 32); break;       /* i32.const, data.drop, memory.fill */
-        case 0x11: case 0x13: wa_read_LEB(m, &pos, 32); wa_read_LEB(m, &pos, 1); break; /* call_indirect, return_call_indirect */
-        case 0x1c: { uint32_t tcount = wa_read_LEB(m, &pos, 32); while(tcount--) wa_read_u8(m, &pos); break; } /* typed_select */
-        case 0x42: wa_read_LEB(m, &pos, 64); break;                                 /* i64.const */
-        case 0x43: wa_read_u32(m, &pos); break;                                     /* f32.const */
-        case 0x44: wa_read_u64(m, &pos); break;                                     /* f64.const */
-        case 0x02: case 0x03: case 0x04: wa_read_LEB(m, &pos, 7); break;            /* block, loop, if */
-        case 0x28: case 0x29: case 0x2a: case 0x2b: case 0x2c: case 0x2d: case 0x2e: case 0x2f:/* *.load*, *.store*, memory.init, memory.copy */
-        case 0x30: case 0x31: case 0x32: case 0x33: case 0x34: case 0x35: case 0x36:
-        case 0x37: case 0x38: case 0x39: case 0x3a: case 0x3b: case 0x3c: case 0x3d:
-        case 0x3e: case 0xfc08: case 0xfc0a: wa_read_LEB(m, &pos, 32); wa_read_LEB(m, &pos, 32); break;
-        case 0xc7: case 0xc9: case 0xca: wa_read_u8(m, &pos); break;                /* local.get/set/tee fast */
-        case 0x0e: cnt = wa_read_LEB(m, &pos, 32);                                  /* br_table */
-            for(i = 0; i < cnt; i++) wa_read_LEB(m, &pos, 32);
-            wa_read_LEB(m, &pos, 32);
-            break;
-        }
+        wa_skip_immediates(m, opcode, &pos);
     }
     if(blockstack) free(blockstack);
     return !m->err_code;
@@ -1024,15 +1176,881 @@ static void wa_internal_call(Module *m, uint32_t fidx) {
 #endif
         func = &m->functions[fidx];
         if(m->sp + 1 < func->type.param_count) { ERR(("wa_internal_call: stack underflow")); m->err_code = WA_ERR_BOUND; return; }
-        wa_check_stack(m, func->type.param_count + func->local_count + 1);
+        wa_check_stack(m, func->type.param_count + func->local_count + 1 + (m->code ? m->func_code[fidx].frame : 0));
         wa_push_block(m, fidx | WA_FMSK, m->sp - func->type.param_count);
         memset(&m->stack[m->sp + 1], 0, func->local_count * sizeof(StackValue));
         m->fp = m->sp - func->type.param_count + 1;
         m->sp += func->local_count;
-        m->pc = func->start_addr;
+        m->pc = m->code ? m->func_code[fidx].entry : func->start_addr;
+    }
+}
+
+#ifdef WA_TRANSLATE
+/* internal opcodes of the translated code, the wasm ones below 0x100 keep their meaning */
+enum {
+    WA_OP_TRAP = 0x100, /* a: error code */
+    WA_OP_JMP,          /* a: target */
+    WA_OP_JMPZ,         /* a: target, pops the condition */
+    WA_OP_JMPNZ,
+    WA_OP_BR,           /* a: target, b: stack height | arity << 31, the result (if any) is moved down to height */
+    WA_OP_BRIF,
+    WA_OP_BRTABLE,      /* a: number of labels, followed by a + 1 entries shaped like WA_OP_BR */
+    WA_OP_RETURN,       /* a: result count */
+    WA_OP_CALL,         /* a: fidx of a wasm function */
+    WA_OP_CALLHOST,     /* a: fidx of an imported function */
+    WA_OP_CALLINDIRECT, /* a: tidx */
+    WA_OP_GLOBALGET,    /* a: gidx, b: size in bytes */
+    WA_OP_GLOBALSET,
+    WA_OP_MEMINIT,      /* a: data segment */
+    WA_OP_DATADROP,
+    WA_OP_MEMCOPY,
+    WA_OP_MEMFILL,
+    WA_OP_COUNT
+};
+
+/* an open block while translating */
+typedef struct Ctrl {
+    uint32_t   op;          /* 0x02 block, 0x03 loop, 0x04 if or WA_FUNCTION */
+    uint32_t   height;      /* operand stack height at entry, in slots above the frame pointer */
+    uint32_t   arity;       /* number of results */
+    uint32_t   start;       /* first instruction, loops branch here */
+    uint32_t   fixup;       /* forward branches to the end, chained through Insn.a */
+    uint32_t   else_fix;    /* if: conditional jump to the else branch, -1U once resolved */
+} Ctrl;
+
+/* append an instruction, returns its index or -1U */
+static uint32_t wa_emit(Module *m, uint32_t *cap, uint32_t pc, uint32_t op, uint32_t a, uint32_t b)
+{
+    uint32_t i = m->code_count;
+
+    if(i >= *cap) {
+        *cap += 1024 + *cap / 2;
+        if(!(m->code = wa_recalloc(m, m->code, i, *cap, sizeof(Insn), __LINE__)) ||
+           !(m->code_pc = wa_recalloc(m, m->code_pc, i, *cap, sizeof(uint32_t), __LINE__))) return -1U;
+    }
+    m->code[i].h.op = op;
+    m->code[i].a = a;
+    m->code[i].b = b;
+    m->code_pc[i] = pc;
+    m->code_count++;
+    return i;
+}
+
+/* resolve a chain of forward branches */
+static void wa_patch(Module *m, uint32_t chain, uint32_t target)
+{
+    uint32_t next;
+
+    for(; chain != -1U; chain = next) {
+        next = m->code[chain].a;
+        m->code[chain].a = target;
+    }
+}
+
+/* branch to an enclosing block, op is used when there's nothing to move on the stack, mop otherwise */
+static int wa_emit_branch(Module *m, uint32_t *cap, uint32_t pc, uint32_t op, uint32_t mop, Ctrl *c, uint32_t h)
+{
+    uint32_t arity = c->op == 0x03 ? 0 : c->arity, i;
+
+    if(h < c->height + arity) return 0;
+    if(h != c->height + arity) op = mop;
+    if((i = wa_emit(m, cap, pc, op, c->op == 0x03 ? c->start : c->fixup, c->height | arity << 31)) == -1U) return 0;
+    if(c->op != 0x03) c->fixup = i;
+    return 1;
+}
+
+/* translate one function, returns 0 on anything it doesn't handle (invalid or multi-value code) */
+static int wa_translate_func(Module *m, uint32_t fidx, uint32_t *cap, Ctrl **ctrl, uint32_t *ctrl_cap)
+{
+    Block *func = &m->functions[fidx];
+    Type *type;
+    Ctrl *c = *ctrl;
+    uint32_t pos = func->start_addr, pc, opcode, i, n, t, top = 0, dead = 0, was_dead, skip = 0;
+    uint32_t base = func->type.param_count + func->local_count, h = base, maxh = base;
+    uint64_t v;
+
+/* operand stack bookkeeping, the stack can't shrink below the entry of the current block */
+#define WA_POP(n)  do { if(h < (*ctrl)[top].height + (n)) return 0; h -= (n); } while(0)
+#define WA_PUSH(n) do { h += (n); if(h > maxh) maxh = h; } while(0)
+#define WA_EMIT(op, a, b) do { if(wa_emit(m, cap, pc, op, a, b) == -1U) return 0; } while(0)
+
+    if(func->type.result_count > 1) return 0;
+    m->func_code[fidx].entry = m->code_count;
+    c->op = WA_FUNCTION; c->height = base; c->arity = func->type.result_count;
+    c->start = m->code_count; c->fixup = c->else_fix = -1U;
+
+    while(!m->err_code && pos <= func->end_addr) {
+        pc = pos;
+        opcode = wa_read_opcode(m, &pos);
+        was_dead = dead;
+        if(dead) {
+            /* unreachable code is skipped up to the else / end of the current block */
+            if(opcode == 0x02 || opcode == 0x03 || opcode == 0x04) skip++; else
+            if((opcode == 0x05 || opcode == 0x0b) && skip) { if(opcode == 0x0b) skip--; opcode = 0x01; }
+            if(opcode != 0x05 && opcode != 0x0b) { wa_skip_immediates(m, opcode, &pos); continue; }
+            dead = 0;
+        }
+        switch(opcode) {
+
+        /*** Control flow operators ***/
+        case 0x00:  /* unreachable */
+            WA_EMIT(WA_OP_TRAP, WA_ERR_UD, 0);
+            dead = 1;
+            break;
+        case 0x01:  /* nop */
+        case 0xdc:  /* breakpoint */
+            break;
+        case 0x02:  /* block */
+        case 0x03:  /* loop */
+        case 0x04:  /* if */
+            t = m->bytes[pos++];
+            if(t != 0x40 && (t < 0x7c || t > 0x7f)) return 0;
+            if(opcode == 0x04) WA_POP(1);
+            if(top + 1 >= *ctrl_cap) {
+                i = *ctrl_cap; *ctrl_cap += 64;
+                if(!(*ctrl = wa_recalloc(m, *ctrl, i, *ctrl_cap, sizeof(Ctrl), __LINE__))) return 0;
+            }
+            c = &(*ctrl)[++top];
+            c->op = opcode; c->height = h; c->arity = t != 0x40;
+            c->start = m->code_count; c->fixup = c->else_fix = -1U;
+            if(opcode == 0x04) { c->else_fix = m->code_count; WA_EMIT(WA_OP_JMPZ, -1U, 0); }
+            break;
+        case 0x05:  /* else */
+            c = &(*ctrl)[top];
+            if(c->op != 0x04 || c->else_fix == -1U || (!was_dead && h != c->height + c->arity)) return 0;
+            i = m->code_count;
+            WA_EMIT(WA_OP_JMP, c->fixup, 0);
+            c->fixup = i;
+            m->code[c->else_fix].a = m->code_count;
+            c->else_fix = -1U;
+            h = c->height;
+            break;
+        case 0x0b:  /* end */
+            c = &(*ctrl)[top];
+            if(!was_dead && h != c->height + c->arity) return 0;
+            if(!top) {
+                /* branches to the function block return */
+                if(pc != func->end_addr) return 0;
+                wa_patch(m, c->fixup, m->code_count);
+                WA_EMIT(WA_OP_RETURN, c->arity, 0);
+                m->func_code[fidx].frame = maxh - func->type.param_count;
+                return 1;
+            }
+            if(c->else_fix != -1U) {
+                if(c->arity) return 0;
+                m->code[c->else_fix].a = m->code_count;
+            }
+            wa_patch(m, c->fixup, m->code_count);
+            h = c->height + c->arity;
+            top--;
+            break;
+        case 0x0c:  /* br */
+            n = wa_read_LEB(m, &pos, 32);
+            if(n > top || !wa_emit_branch(m, cap, pc, WA_OP_JMP, WA_OP_BR, &(*ctrl)[top - n], h)) return 0;
+            dead = 1;
+            break;
+        case 0x0d:  /* br_if */
+            n = wa_read_LEB(m, &pos, 32);
+            WA_POP(1);
+            if(n > top || !wa_emit_branch(m, cap, pc, WA_OP_JMPNZ, WA_OP_BRIF, &(*ctrl)[top - n], h)) return 0;
+            break;
+        case 0x0e:  /* br_table */
+            n = wa_read_LEB(m, &pos, 32);
+            WA_POP(1);
+            WA_EMIT(WA_OP_BRTABLE, n, 0);
+            for(i = 0; !m->err_code && i <= n; i++) {
+                t = wa_read_LEB(m, &pos, 32);
+                if(t > top || !wa_emit_branch(m, cap, pc, WA_OP_BR, WA_OP_BR, &(*ctrl)[top - t], h)) return 0;
+            }
+            dead = 1;
+            break;
+        case 0x0f:  /* return */
+            WA_POP(func->type.result_count);
+            WA_EMIT(WA_OP_RETURN, func->type.result_count, 0);
+            dead = 1;
+            break;
+
+        /*** Call operators ***/
+        case 0x10:  /* call */
+        case 0x12:  /* return_call */
+            n = wa_read_LEB(m, &pos, 32);
+            if(n >= m->function_count) { WA_EMIT(WA_OP_TRAP, WA_ERR_BOUND, 0); dead = 1; break; }
+            type = &m->functions[n].type;
+            if(type->result_count > 1) return 0;
+            WA_POP(type->param_count);
+            WA_EMIT(m->functions[n].start_addr ? WA_OP_CALL : WA_OP_CALLHOST, n, 0);
+            WA_PUSH(type->result_count);
+            if(opcode == 0x12) { WA_EMIT(WA_OP_RETURN, func->type.result_count, 0); dead = 1; }
+            break;
+        case 0x11:  /* call_indirect */
+        case 0x13:  /* return_call_indirect */
+            n = wa_read_LEB(m, &pos, 32);
+            wa_read_LEB(m, &pos, 1);
+            if(n >= m->type_count || m->types[n].result_count > 1) return 0;
+            WA_POP(1);
+            WA_POP(m->types[n].param_count);
+            WA_EMIT(WA_OP_CALLINDIRECT, n, 0);
+            WA_PUSH(m->types[n].result_count);
+            if(opcode == 0x13) { WA_EMIT(WA_OP_RETURN, func->type.result_count, 0); dead = 1; }
+            break;
+
+        /*** Parametric operators ***/
+        case 0x1a:  /* drop */
+        case 0xc5:  /* drop64 */
+            WA_POP(1);
+            WA_EMIT(0x1a, 0, 0);
+            break;
+        case 0x1c:  /* typed_select */
+            wa_skip_immediates(m, opcode, &pos);
+            /* fallthrough */
+        case 0x1b:  /* select */
+        case 0xc6:  /* select64 */
+            WA_POP(3); WA_PUSH(1);
+            WA_EMIT(0x1b, 0, 0);
+            break;
+
+        /*** Variable access ***/
+        case 0x20: case 0xc7:   /* local.get */
+        case 0x21: case 0xc9:   /* local.set */
+        case 0x22: case 0xca:   /* local.tee */
+            n = opcode < 0xc0 ? (uint32_t)wa_read_LEB(m, &pos, 32) : wa_read_u8(m, &pos) & 0x7fu;
+            if(n >= base) return 0;
+            if(opcode == 0xc7) opcode = 0x20; else if(opcode == 0xc9) opcode = 0x21; else if(opcode == 0xca) opcode = 0x22;
+            if(opcode != 0x20) WA_POP(1);
+            if(opcode != 0x21) WA_PUSH(1);
+            WA_EMIT(opcode, n, 0);
+            break;
+        case 0x1d:  /* global64.get */
+        case 0x23:  /* global.get */
+        case 0x1e:  /* global64.set */
+        case 0x24:  /* global.set */
+            n = wa_read_LEB(m, &pos, 32);
+            if(opcode == 0x1e || opcode == 0x24) WA_POP(1); else WA_PUSH(1);
+            if(n >= m->global_count || !m->gptrs[n]) { WA_EMIT(WA_OP_TRAP, WA_ERR_BOUND, 0); dead = 1; break; }
+            WA_EMIT(opcode == 0x1e || opcode == 0x24 ? WA_OP_GLOBALSET : WA_OP_GLOBALGET, n,
+                opcode == 0x1d || opcode == 0x1e || (m->gptrs[n] & WA_GMSK) ? 8 : 4);
+            break;
+
+        /*** Memory-related operators ***/
+        case 0x28: case 0x29: case 0x2a: case 0x2b: case 0x2c: case 0x2d: case 0x2e: case 0x2f:
+        case 0x30: case 0x31: case 0x32: case 0x33: case 0x34: case 0x35: /* loads */
+        case 0x36: case 0x37: case 0x38: case 0x39: case 0x3a: case 0x3b: case 0x3c: case 0x3d: case 0x3e: /* stores */
+            wa_read_LEB(m, &pos, 32); /* flags */
+            v = wa_read_LEB(m, &pos, 64);
+            if(v > 0xffffffffu) return 0;
+            if(opcode >= 0x36) WA_POP(2); else { WA_POP(1); WA_PUSH(1); }
+            WA_EMIT(opcode, (uint32_t)v, 0);
+            break;
+        case 0x3f:  /* memory.size */
+            wa_read_LEB(m, &pos, 32);
+            WA_PUSH(1);
+            WA_EMIT(opcode, 0, 0);
+            break;
+        case 0x40:  /* memory.grow */
+            wa_read_LEB(m, &pos, 32);
+            WA_POP(1); WA_PUSH(1);
+            WA_EMIT(opcode, 0, 0);
+            break;
+        case 0xfc08:  /* memory.init */
+            n = wa_read_LEB(m, &pos, 32);
+            wa_read_LEB(m, &pos, 32);
+            WA_POP(3);
+            WA_EMIT(WA_OP_MEMINIT, n, 0);
+            break;
+        case 0xfc09:  /* data.drop */
+            n = wa_read_LEB(m, &pos, 32);
+            WA_EMIT(WA_OP_DATADROP, n, 0);
+            break;
+        case 0xfc0a:  /* memory.copy */
+            wa_read_LEB(m, &pos, 32);
+            wa_read_LEB(m, &pos, 32);
+            WA_POP(3);
+            WA_EMIT(WA_OP_MEMCOPY, 0, 0);
+            break;
+        case 0xfc0b:  /* memory.fill */
+            wa_read_LEB(m, &pos, 32);
+            WA_POP(3);
+            WA_EMIT(WA_OP_MEMFILL, 0, 0);
+            break;
+
+        /*** Constants ***/
+        case 0x41: WA_PUSH(1); WA_EMIT(opcode, (uint32_t)wa_read_LEB_signed(m, &pos, 32), 0); break;   /* i32.const */
+        case 0x42: WA_PUSH(1); v = wa_read_LEB_signed(m, &pos, 64); WA_EMIT(opcode, (uint32_t)v, (uint32_t)(v >> 32)); break; /* i64.const */
+#ifndef WA_NOFLOAT
+        case 0x43: WA_PUSH(1); WA_EMIT(opcode, wa_read_u32(m, &pos), 0); break;                       /* f32.const */
+        case 0x44: WA_PUSH(1); v = wa_read_u64(m, &pos); WA_EMIT(opcode, (uint32_t)v, (uint32_t)(v >> 32)); break; /* f64.const */
+#endif
+
+        /*** Numeric operators ***/
+
+        /* unary */
+        case 0x45: case 0x50:                                                       /* eqz */
+        case 0x67: case 0x68: case 0x69: case 0x79: case 0x7a: case 0x7b:           /* clz, ctz, popcnt */
+        case 0xa7: case 0xac: case 0xad:                                            /* wrap, extend */
+        case 0xc0: case 0xc1: case 0xc2: case 0xc3: case 0xc4:                      /* sign extend */
+#ifndef WA_NOFLOAT
+        case 0x8b: case 0x8c: case 0x8d: case 0x8e: case 0x8f: case 0x90:           /* f32 unary */
+        case 0x99: case 0x9a: case 0x9b: case 0x9c: case 0x9d: case 0x9e:           /* f64 unary */
+        case 0xa8: case 0xa9: case 0xaa: case 0xab: case 0xae: case 0xaf: case 0xb0: case 0xb1: /* trunc */
+        case 0xb2: case 0xb3: case 0xb4: case 0xb5: case 0xb6: case 0xb7: case 0xb8: case 0xb9:
+        case 0xba: case 0xbb:                                                       /* convert, demote, promote */
+#ifndef WA_NOLIBM
+        case 0x91: case 0x9f:                                                       /* sqrt */
+#endif
+#endif
+            WA_POP(1); WA_PUSH(1);
+            WA_EMIT(opcode, 0, 0);
+            break;
+        case 0xbc: case 0xbd: case 0xbe: case 0xbf:                                 /* reinterpretations, nothing to do */
+            WA_POP(1); WA_PUSH(1);
+            break;
+
+        /* binary */
+        case 0x46: case 0x47: case 0x48: case 0x49: case 0x4a: case 0x4b: case 0x4c: case 0x4d: case 0x4e: case 0x4f:
+        case 0x51: case 0x52: case 0x53: case 0x54: case 0x55: case 0x56: case 0x57: case 0x58: case 0x59: case 0x5a:
+        case 0x6a: case 0x6b: case 0x6c: case 0x6d: case 0x6e: case 0x6f: case 0x70:
+        case 0x71: case 0x72: case 0x73: case 0x74: case 0x75: case 0x76: case 0x77: case 0x78:
+        case 0x7c: case 0x7d: case 0x7e: case 0x7f: case 0x80: case 0x81: case 0x82:
+        case 0x83: case 0x84: case 0x85: case 0x86: case 0x87: case 0x88: case 0x89: case 0x8a:
+#ifndef WA_NOFLOAT
+        case 0x5b: case 0x5c: case 0x5d: case 0x5e: case 0x5f: case 0x60:
+        case 0x61: case 0x62: case 0x63: case 0x64: case 0x65: case 0x66:
+        case 0x92: case 0x93: case 0x94: case 0x95: case 0x96: case 0x97: case 0x98:
+        case 0xa0: case 0xa1: case 0xa2: case 0xa3: case 0xa4: case 0xa5: case 0xa6:
+#endif
+            WA_POP(2); WA_PUSH(1);
+            WA_EMIT(opcode, 0, 0);
+            break;
+
+        default:
+            /* fails when reached, like in wa_interpret */
+            WA_EMIT(WA_OP_TRAP, WA_ERR_UD, 0);
+            dead = 1;
+            break;
+        }
     }
+#undef WA_POP
+#undef WA_PUSH
+#undef WA_EMIT
+    return 0;
 }
 
+/* translate every wasm function, if one of them can't be, the whole module is interpreted by wa_interpret */
+static void wa_translate(Module *m)
+{
+    Ctrl *ctrl = NULL;
+    uint32_t i = 0, cap = 0, ctrl_cap = 64;
+
+    if(!m->function_count ||
+       !(m->func_code = wa_recalloc(m, NULL, 0, m->function_count, sizeof(FuncCode), __LINE__)) ||
+       !(ctrl = wa_recalloc(m, NULL, 0, ctrl_cap, sizeof(Ctrl), __LINE__))) goto fail;
+    for(i = 0; i < m->function_count; i++)
+        if(m->functions[i].start_addr && !wa_translate_func(m, i, &cap, &ctrl, &ctrl_cap)) goto fail;
+    free(ctrl);
+    /* the block cache is only used by wa_interpret */
+    if(m->cache) { free(m->cache); m->cache = NULL; }
+    if(m->lookup) { free(m->lookup); m->lookup = NULL; }
+    m->cache_count = 0;
+    DBG(("  translated code: %u instructions", m->code_count));
+    return;
+fail:
+    DBG(("  translation failed at fidx %u, interpreting the wasm binary", i));
+    if(ctrl) free(ctrl);
+    if(m->code) free(m->code);
+    if(m->code_pc) free(m->code_pc);
+    if(m->func_code) free(m->func_code);
+    m->code = NULL; m->code_pc = NULL; m->func_code = NULL;
+    m->code_count = 0;
+    m->err_code = WA_SUCCESS;
+}
+
+#ifdef WA_THREADED
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#pragma GCC diagnostic ignored "-Woverride-init"
+#endif
+/* run translated code, same contract as wa_interpret */
+static int wa_run(Module *m)
+{
+#ifdef WA_THREADED
+/* with gcc and clang the dispatch is direct-threaded, every instruction jumps to the handler of the next one */
+# define WA_CASE(n)  op_##n
+# define WA_JUMP()   goto *ip->h.label
+# define WA_L(n)     [n] = &&op_##n
+    static const void *const labels[WA_OP_COUNT] = { [0 ... WA_OP_COUNT - 1] = &&op_bad,
+        WA_L(WA_OP_TRAP), WA_L(WA_OP_JMP), WA_L(WA_OP_JMPZ), WA_L(WA_OP_JMPNZ), WA_L(WA_OP_BR), WA_L(WA_OP_BRIF),
+        WA_L(WA_OP_BRTABLE), WA_L(WA_OP_RETURN), WA_L(WA_OP_CALL), WA_L(WA_OP_CALLHOST), WA_L(WA_OP_CALLINDIRECT),
+        WA_L(WA_OP_GLOBALGET), WA_L(WA_OP_GLOBALSET), WA_L(WA_OP_MEMINIT), WA_L(WA_OP_DATADROP), WA_L(WA_OP_MEMCOPY),
+        WA_L(WA_OP_MEMFILL), WA_L(0x1a), WA_L(0x1b), WA_L(0x20), WA_L(0x21), WA_L(0x22), WA_L(0x28), WA_L(0x29), WA_L(0x2a),
+        WA_L(0x2b), WA_L(0x2c), WA_L(0x2d), WA_L(0x2e), WA_L(0x2f), WA_L(0x30), WA_L(0x31), WA_L(0x32), WA_L(0x33), WA_L(0x34),
+        WA_L(0x35), WA_L(0x36), WA_L(0x37), WA_L(0x38), WA_L(0x39), WA_L(0x3a), WA_L(0x3b), WA_L(0x3c), WA_L(0x3d), WA_L(0x3e),
+        WA_L(0x3f), WA_L(0x40), WA_L(0x41), WA_L(0x42), WA_L(0x45), WA_L(0x46), WA_L(0x47), WA_L(0x48), WA_L(0x49), WA_L(0x4a),
+        WA_L(0x4b), WA_L(0x4c), WA_L(0x4d), WA_L(0x4e), WA_L(0x4f), WA_L(0x50), WA_L(0x51), WA_L(0x52), WA_L(0x53), WA_L(0x54),
+        WA_L(0x55), WA_L(0x56), WA_L(0x57), WA_L(0x58), WA_L(0x59), WA_L(0x5a), WA_L(0x67), WA_L(0x68), WA_L(0x69), WA_L(0x6a),
+        WA_L(0x6b), WA_L(0x6c), WA_L(0x6d), WA_L(0x6e), WA_L(0x6f), WA_L(0x70), WA_L(0x71), WA_L(0x72), WA_L(0x73), WA_L(0x74),
+        WA_L(0x75), WA_L(0x76), WA_L(0x77), WA_L(0x78), WA_L(0x79), WA_L(0x7a), WA_L(0x7b), WA_L(0x7c), WA_L(0x7d), WA_L(0x7e),
+        WA_L(0x7f), WA_L(0x80), WA_L(0x81), WA_L(0x82), WA_L(0x83), WA_L(0x84), WA_L(0x85), WA_L(0x86), WA_L(0x87), WA_L(0x88),
+        WA_L(0x89), WA_L(0x8a), WA_L(0xa7), WA_L(0xac), WA_L(0xad), WA_L(0xc0), WA_L(0xc1), WA_L(0xc2), WA_L(0xc3), WA_L(0xc4),
+#ifndef WA_NOFLOAT
+        WA_L(0x43), WA_L(0x44), WA_L(0x5b), WA_L(0x5c), WA_L(0x5d), WA_L(0x5e), WA_L(0x5f), WA_L(0x60), WA_L(0x61), WA_L(0x62),
+        WA_L(0x63), WA_L(0x64), WA_L(0x65), WA_L(0x66), WA_L(0x8b), WA_L(0x8c), WA_L(0x8d), WA_L(0x8e), WA_L(0x8f), WA_L(0x90),
+        WA_L(0x92), WA_L(0x93), WA_L(0x94), WA_L(0x95), WA_L(0x96), WA_L(0x97), WA_L(0x98), WA_L(0x99), WA_L(0x9a), WA_L(0x9b),
+        WA_L(0x9c), WA_L(0x9d), WA_L(0x9e), WA_L(0xa0), WA_L(0xa1), WA_L(0xa2), WA_L(0xa3), WA_L(0xa4), WA_L(0xa5), WA_L(0xa6),
+        WA_L(0xa8), WA_L(0xa9), WA_L(0xaa), WA_L(0xab), WA_L(0xae), WA_L(0xaf), WA_L(0xb0), WA_L(0xb1), WA_L(0xb2), WA_L(0xb3),
+        WA_L(0xb4), WA_L(0xb5), WA_L(0xb6), WA_L(0xb7), WA_L(0xb8), WA_L(0xb9), WA_L(0xba), WA_L(0xbb),
+#ifndef WA_NOLIBM
+        WA_L(0x91), WA_L(0x9f),
+#endif
+#endif
+    };
+# undef WA_L
+#else
+# define WA_CASE(n)  case n
+# define WA_JUMP()   continue
+#endif
+/* no do-while wrapping on these, continue must reach the dispatch loop */
+#define WA_NEXT()    { ip++; WA_JUMP(); }
+#define WA_TRAP(e, s) do { ERR(s); m->err_code = e; goto trap; } while(0)
+#ifdef WA_GUARDMEM
+    /* the reservation never moves, out of bound accesses fault into wa_guard_handler */
+    uint8_t     *mem = m->memory[0].bytes;
+# define WA_LOAD(T, conv) { addr = (uint64_t)ip->a + sp->u32; maddr = mem + addr; \
+    { T v_; memcpy(&v_, maddr, sizeof(T)); sp->u64 = conv; } WA_NEXT(); }
+# define WA_STORE(T) { addr = (uint64_t)ip->a + sp[-1].u32; maddr = mem + addr; \
+    { T v_ = (T)sp->u64; memcpy(maddr, &v_, sizeof(T)); } sp -= 2; WA_NEXT(); }
+#elif !defined(WA_MAXALLOC)
+# if !defined(WA_ALLOW_GROW) && !defined(WA_DIRECTMEM)
+    /* the address space is allocated once in wa_init and never moves */
+    uint8_t     *mem = m->memory[0].bytes - m->memory[0].start;
+    uint64_t     mem_start = m->memory[0].start, mem_limit = m->memory[0].limit;
+#  define WA_ADDR(dir, offs, size) ((offs) >= mem_start && (offs) + (size) <= mem_limit ? mem + (offs) : NULL)
+# endif
+#endif
+#ifndef WA_LOAD
+# ifndef WA_ADDR
+#  define WA_ADDR(dir, offs, size) wa_read_addr(m, dir, offs, size)
+# endif
+# define WA_LOAD(T, conv) { addr = (uint64_t)ip->a + sp->u32; \
+    if(!(maddr = WA_ADDR(BRK_READ, addr, sizeof(T)))) goto oob; \
+    { T v_; memcpy(&v_, maddr, sizeof(T)); sp->u64 = conv; } WA_NEXT(); }
+# define WA_STORE(T) { addr = (uint64_t)ip->a + sp[-1].u32; \
+    if(!(maddr = WA_ADDR(BRK_WRITE, addr, sizeof(T)))) goto oob; \
+    { T v_ = (T)sp->u64; memcpy(maddr, &v_, sizeof(T)); } sp -= 2; WA_NEXT(); }
+#endif
+#define WA_BIN(f, expr) { sp--; sp->f = expr; WA_NEXT(); }
+    const Insn  *code = m->code, *ip = code + m->pc, *ent;
+    StackValue  *stack = m->stack, *sp = stack + m->sp, *fp = stack + m->fp;
+    Frame       *frame;
+    Block       *func;
+    uint8_t     *maddr, *msrc;
+    uint64_t     addr, d, e;
+    uint32_t     a, b, fidx;
+    int          n, csp = m->csp;
+
+#ifdef WA_THREADED
+    if(!m->code_threaded) {
+        for(a = 0; a < m->code_count; a++) { b = m->code[a].h.op; m->code[a].h.label = labels[b]; }
+        m->code_threaded = 1;
+    }
+    WA_JUMP();
+#else
+    for(;;) switch(ip->h.op) {
+#endif
+
+    /*** Control flow ***/
+    WA_CASE(WA_OP_TRAP):
+        WA_TRAP(ip->a, ("wa_run: %s", ip->a == WA_ERR_UD ? "unreachable" : "bad function or global index"));
+    WA_CASE(WA_OP_JMP):
+        ip = code + ip->a; WA_JUMP();
+    WA_CASE(WA_OP_JMPZ):
+        if(!(sp--)->u32) { ip = code + ip->a; WA_JUMP(); }
+        WA_NEXT();
+    WA_CASE(WA_OP_JMPNZ):
+        if((sp--)->u32) { ip = code + ip->a; WA_JUMP(); }
+        WA_NEXT();
+    WA_CASE(WA_OP_BRIF):
+        if((sp--)->u32) { ent = ip; goto branch; }
+        WA_NEXT();
+    WA_CASE(WA_OP_BR):
+        ent = ip;
+branch: /* keep the result (if any) and drop everything above the target's stack height */
+        if(ent->b >> 31) fp[ent->b & 0x7fffffff] = *sp;
+        sp = fp + (ent->b & 0x7fffffff) + (ent->b >> 31) - 1;
+        ip = code + ent->a; WA_JUMP();
+    WA_CASE(WA_OP_BRTABLE):
+        a = (sp--)->u32;
+        ent = ip + 1 + (a < ip->a ? a : ip->a);
+        goto branch;
+    WA_CASE(WA_OP_RETURN):
+        frame = &m->callstack[m->csp--];
+        n = frame->sp + ip->a;
+        if(ip->a) stack[n] = *sp;
+        if(m->csp < csp) {
+            /* returned from the function called by the host */
+            m->sp = n; m->fp = frame->fp; m->pc = frame->ra;
+            return 1;
+        }
+        sp = stack + n; fp = stack + frame->fp; ip = code + frame->ra;
+        WA_JUMP();
+    WA_CASE(WA_OP_CALL):
+        fidx = ip->a;
+call:
+        func = &m->functions[fidx];
+        n = m->func_code[fidx].frame;
+        if(m->csp + 1 >= m->csp_count || (sp - stack) + n + 1 >= m->sp_count) {
+            m->sp = sp - stack; m->fp = fp - stack;
+            if(!wa_check_stack(m, n)) goto trap;
+            stack = m->stack; sp = stack + m->sp; fp = stack + m->fp;
+        }
+        frame = &m->callstack[++m->csp];
+        frame->block = fidx | WA_FMSK;
+        frame->sp = (sp - stack) - func->type.param_count;
+        frame->fp = fp - stack;
+        frame->ra = ip - code + 1;
+        fp = sp - func->type.param_count + 1;
+        if(func->local_count) { memset(sp + 1, 0, func->local_count * sizeof(StackValue)); sp += func->local_count; }
+        ip = code + m->func_code[fidx].entry;
+        WA_JUMP();
+    WA_CASE(WA_OP_CALLHOST):
+        fidx = ip->a;
+hostcall:
+        m->sp = sp - stack; m->fp = fp - stack; m->pc = ip - code;
+        if(!wa_external_call(m, fidx) || m->err_code) goto trap;
+        stack = m->stack; sp = stack + m->sp; fp = stack + m->fp;
+        WA_NEXT();
+    WA_CASE(WA_OP_CALLINDIRECT):
+        a = (sp--)->u32;
+        if(a >= m->table.size || (fidx = m->table.entries[a]) >= m->function_count)
+            WA_TRAP(WA_ERR_BOUND, ("wa_run: undefined element 0x%x (size: 0x%x) in table", a, m->table.size));
+        func = &m->functions[fidx];
+        if(func->type.param_count != m->types[ip->a].param_count || func->type.result_count != m->types[ip->a].result_count)
+            WA_TRAP(WA_ERR_PROTO, ("wa_run: call type mismatch"));
+        if(func->start_addr) goto call;
+        goto hostcall;
+
+    /*** Parametric operators ***/
+    WA_CASE(0x1a): sp--; WA_NEXT();                                       /* drop */
+    WA_CASE(0x1b): a = sp->u32; sp -= 2; if(!a) sp[0] = sp[1]; WA_NEXT(); /* select */
+
+    /*** Variable access ***/
+    WA_CASE(0x20): *++sp = fp[ip->a]; WA_NEXT();                          /* local.get */
+    WA_CASE(0x21): fp[ip->a] = *sp--; WA_NEXT();                          /* local.set */
+    WA_CASE(0x22): fp[ip->a] = *sp; WA_NEXT();                            /* local.tee */
+    WA_CASE(WA_OP_GLOBALGET):
+        (++sp)->u64 = 0;
+        memcpy(sp, (void*)(uintptr_t)(m->gptrs[ip->a] & ~WA_GMSK), ip->b);
+        WA_NEXT();
+    WA_CASE(WA_OP_GLOBALSET):
+        memcpy((void*)(uintptr_t)(m->gptrs[ip->a] & ~WA_GMSK), sp--, ip->b);
+        WA_NEXT();
+
+    /*** Memory-related operators ***/
+    WA_CASE(0x3f):  /* memory.size */
+        (++sp)->u32 = (m->memory[0].size + WA_PAGESIZE - 1) / WA_PAGESIZE;
+        WA_NEXT();
+    WA_CASE(0x40):  /* memory.grow */
+        sp->u32 = wa_grow(m, sp->u32);
+        if(m->err_code) goto trap;
+        WA_NEXT();
+    WA_CASE(WA_OP_MEMINIT):
+        a = (sp--)->u32; b = (sp--)->u32; d = (sp--)->u64;
+        if(!(maddr = wa_read_addr(m, BRK_WRITE, d, a))) goto trap;
+        if(ip->a >= (uint32_t)m->segs_count || !m->segs || b + a >= m->segs[ip->a].size)
+            WA_TRAP(WA_ERR_BOUND, ("wa_run: out of bound data segment %u", ip->a));
+        memcpy(maddr, m->bytes + m->segs[ip->a].start + b, a);
+        WA_NEXT();
+    WA_CASE(WA_OP_DATADROP):
+        if(ip->a < (uint32_t)m->segs_count && m->segs) m->segs[ip->a].size = 0;
+        WA_NEXT();
+    WA_CASE(WA_OP_MEMCOPY):
+        a = (sp--)->u32; e = (sp--)->u64; d = (sp--)->u64;
+        if(!(msrc = wa_read_addr(m, BRK_READ, e, a)) || !(maddr = wa_read_addr(m, BRK_WRITE, d, a))) goto trap;
+        if(a > 0 && maddr != msrc) memmove(maddr, msrc, a);
+        WA_NEXT();
+    WA_CASE(WA_OP_MEMFILL):
+        a = (sp--)->u32; b = (sp--)->u32; d = (sp--)->u64;
+        if(!(maddr = wa_read_addr(m, BRK_WRITE, d, a))) goto trap;
+        if(a > 0) memset(maddr, b, a);
+        WA_NEXT();
+
+    /* Memory load operators */
+    WA_CASE(0x28): WA_LOAD(uint32_t, v_);                                 /* i32.load */
+    WA_CASE(0x29): WA_LOAD(uint64_t, v_);                                 /* i64.load */
+    WA_CASE(0x2a): WA_LOAD(uint32_t, v_);                                 /* f32.load */
+    WA_CASE(0x2b): WA_LOAD(uint64_t, v_);                                 /* f64.load */
+    WA_CASE(0x2c): WA_LOAD(int8_t,   (uint32_t)(int32_t)v_);              /* i32.load8_s */
+    WA_CASE(0x2d): WA_LOAD(uint8_t,  v_);                                 /* i32.load8_u */
+    WA_CASE(0x2e): WA_LOAD(int16_t,  (uint32_t)(int32_t)v_);              /* i32.load16_s */
+    WA_CASE(0x2f): WA_LOAD(uint16_t, v_);                                 /* i32.load16_u */
+    WA_CASE(0x30): WA_LOAD(int8_t,   (uint64_t)(int64_t)v_);              /* i64.load8_s */
+    WA_CASE(0x31): WA_LOAD(uint8_t,  v_);                                 /* i64.load8_u */
+    WA_CASE(0x32): WA_LOAD(int16_t,  (uint64_t)(int64_t)v_);              /* i64.load16_s */
+    WA_CASE(0x33): WA_LOAD(uint16_t, v_);                                 /* i64.load16_u */
+    WA_CASE(0x34): WA_LOAD(int32_t,  (uint64_t)(int64_t)v_);              /* i64.load32_s */
+    WA_CASE(0x35): WA_LOAD(uint32_t, v_);                                 /* i64.load32_u */
+
+    /* Memory store operators */
+    WA_CASE(0x36): WA_STORE(uint32_t);                                    /* i32.store */
+    WA_CASE(0x37): WA_STORE(uint64_t);                                    /* i64.store */
+    WA_CASE(0x38): WA_STORE(uint32_t);                                    /* f32.store */
+    WA_CASE(0x39): WA_STORE(uint64_t);                                    /* f64.store */
+    WA_CASE(0x3a): WA_STORE(uint8_t);                                     /* i32.store8 */
+    WA_CASE(0x3b): WA_STORE(uint16_t);                                    /* i32.store16 */
+    WA_CASE(0x3c): WA_STORE(uint8_t);                                     /* i64.store8 */
+    WA_CASE(0x3d): WA_STORE(uint16_t);                                    /* i64.store16 */
+    WA_CASE(0x3e): WA_STORE(uint32_t);                                    /* i64.store32 */
+
+    /*** Constants ***/
+    WA_CASE(0x41): (++sp)->u32 = ip->a; WA_NEXT();                        /* i32.const */
+    WA_CASE(0x42): (++sp)->u64 = ip->a | (uint64_t)ip->b << 32; WA_NEXT();/* i64.const */
+#ifndef WA_NOFLOAT
+    WA_CASE(0x43): (++sp)->u32 = ip->a; WA_NEXT();                        /* f32.const */
+    WA_CASE(0x44): (++sp)->u64 = ip->a | (uint64_t)ip->b << 32; WA_NEXT();/* f64.const */
+#endif
+
+    /*** Comparison operators ***/
+    WA_CASE(0x45): sp->u32 = sp->u32 == 0; WA_NEXT();                     /* i32.eqz */
+    WA_CASE(0x50): sp->u32 = sp->u64 == 0; WA_NEXT();                     /* i64.eqz */
+    WA_CASE(0x46): WA_BIN(u64, sp[0].u32 == sp[1].u32);                   /* i32.eq */
+    WA_CASE(0x47): WA_BIN(u64, sp[0].u32 != sp[1].u32);                   /* i32.ne */
+    WA_CASE(0x48): WA_BIN(u64, sp[0].i32 <  sp[1].i32);                   /* i32.lt_s */
+    WA_CASE(0x49): WA_BIN(u64, sp[0].u32 <  sp[1].u32);                   /* i32.lt_u */
+    WA_CASE(0x4a): WA_BIN(u64, sp[0].i32 >  sp[1].i32);                   /* i32.gt_s */
+    WA_CASE(0x4b): WA_BIN(u64, sp[0].u32 >  sp[1].u32);                   /* i32.gt_u */
+    WA_CASE(0x4c): WA_BIN(u64, sp[0].i32 <= sp[1].i32);                   /* i32.le_s */
+    WA_CASE(0x4d): WA_BIN(u64, sp[0].u32 <= sp[1].u32);                   /* i32.le_u */
+    WA_CASE(0x4e): WA_BIN(u64, sp[0].i32 >= sp[1].i32);                   /* i32.ge_s */
+    WA_CASE(0x4f): WA_BIN(u64, sp[0].u32 >= sp[1].u32);                   /* i32.ge_u */
+    WA_CASE(0x51): WA_BIN(u64, sp[0].u64 == sp[1].u64);                   /* i64.eq */
+    WA_CASE(0x52): WA_BIN(u64, sp[0].u64 != sp[1].u64);                   /* i64.ne */
+    WA_CASE(0x53): WA_BIN(u64, sp[0].i64 <  sp[1].i64);                   /* i64.lt_s */
+    WA_CASE(0x54): WA_BIN(u64, sp[0].u64 <  sp[1].u64);                   /* i64.lt_u */
+    WA_CASE(0x55): WA_BIN(u64, sp[0].i64 >  sp[1].i64);                   /* i64.gt_s */
+    WA_CASE(0x56): WA_BIN(u64, sp[0].u64 >  sp[1].u64);                   /* i64.gt_u */
+    WA_CASE(0x57): WA_BIN(u64, sp[0].i64 <= sp[1].i64);                   /* i64.le_s */
+    WA_CASE(0x58): WA_BIN(u64, sp[0].u64 <= sp[1].u64);                   /* i64.le_u */
+    WA_CASE(0x59): WA_BIN(u64, sp[0].i64 >= sp[1].i64);                   /* i64.ge_s */
+    WA_CASE(0x5a): WA_BIN(u64, sp[0].u64 >= sp[1].u64);                   /* i64.ge_u */
+#ifndef WA_NOFLOAT
+    WA_CASE(0x5b): WA_BIN(u64, sp[0].f32 == sp[1].f32);                   /* f32.eq */
+    WA_CASE(0x5c): WA_BIN(u64, sp[0].f32 != sp[1].f32);                   /* f32.ne */
+    WA_CASE(0x5d): WA_BIN(u64, sp[0].f32 <  sp[1].f32);                   /* f32.lt */
+    WA_CASE(0x5e): WA_BIN(u64, sp[0].f32 >  sp[1].f32);                   /* f32.gt */
+    WA_CASE(0x5f): WA_BIN(u64, sp[0].f32 <= sp[1].f32);                   /* f32.le */
+    WA_CASE(0x60): WA_BIN(u64, sp[0].f32 >= sp[1].f32);                   /* f32.ge */
+    WA_CASE(0x61): WA_BIN(u64, sp[0].f64 == sp[1].f64);                   /* f64.eq */
+    WA_CASE(0x62): WA_BIN(u64, sp[0].f64 != sp[1].f64);                   /* f64.ne */
+    WA_CASE(0x63): WA_BIN(u64, sp[0].f64 <  sp[1].f64);                   /* f64.lt */
+    WA_CASE(0x64): WA_BIN(u64, sp[0].f64 >  sp[1].f64);                   /* f64.gt */
+    WA_CASE(0x65): WA_BIN(u64, sp[0].f64 <= sp[1].f64);                   /* f64.le */
+    WA_CASE(0x66): WA_BIN(u64, sp[0].f64 >= sp[1].f64);                   /* f64.ge */
+#endif
+
+    /*** Numeric operators ***/
+
+    /* unary integer */
+    WA_CASE(0x67): a = sp->u32; sp->u32 = a == 0 ? 32 : __builtin_clz(a); WA_NEXT();       /* i32.clz */
+    WA_CASE(0x68): a = sp->u32; sp->u32 = a == 0 ? 32 : __builtin_ctz(a); WA_NEXT();       /* i32.ctz */
+    WA_CASE(0x69): sp->u32 = __builtin_popcount(sp->u32); WA_NEXT();                       /* i32.popcnt */
+    WA_CASE(0x79): d = sp->u64; sp->u64 = d == 0 ? 64 : __builtin_clzll(d); WA_NEXT();     /* i64.clz */
+    WA_CASE(0x7a): d = sp->u64; sp->u64 = d == 0 ? 64 : __builtin_ctzll(d); WA_NEXT();     /* i64.ctz */
+    WA_CASE(0x7b): sp->u64 = __builtin_popcountll(sp->u64); WA_NEXT();                     /* i64.popcnt */
+
+    /* i32 binary */
+    WA_CASE(0x6a): WA_BIN(u32, sp[0].u32 + sp[1].u32);                    /* i32.add */
+    WA_CASE(0x6b): WA_BIN(u32, sp[0].u32 - sp[1].u32);                    /* i32.sub */
+    WA_CASE(0x6c): WA_BIN(u32, sp[0].u32 * sp[1].u32);                    /* i32.mul */
+    WA_CASE(0x6d):                                                        /* i32.div_s */
+        if(!sp->u32) goto divz;
+        if(sp[-1].u32 == 0x80000000 && sp->u32 == -1U) goto ovf;
+        WA_BIN(u32, (uint32_t)(sp[0].i32 / sp[1].i32));
+    WA_CASE(0x6e): if(!sp->u32) goto divz; WA_BIN(u32, sp[0].u32 / sp[1].u32);              /* i32.div_u */
+    WA_CASE(0x6f): if(!sp->u32) goto divz;                                                  /* i32.rem_s */
+        WA_BIN(u32, sp[1].u32 == -1U ? 0 : (uint32_t)(sp[0].i32 % sp[1].i32));
+    WA_CASE(0x70): if(!sp->u32) goto divz; WA_BIN(u32, sp[0].u32 % sp[1].u32);              /* i32.rem_u */
+    WA_CASE(0x71): WA_BIN(u32, sp[0].u32 & sp[1].u32);                    /* i32.and */
+    WA_CASE(0x72): WA_BIN(u32, sp[0].u32 | sp[1].u32);                    /* i32.or */
+    WA_CASE(0x73): WA_BIN(u32, sp[0].u32 ^ sp[1].u32);                    /* i32.xor */
+    WA_CASE(0x74): WA_BIN(u32, sp[0].u32 << (sp[1].u32 & 31));            /* i32.shl */
+    WA_CASE(0x75): WA_BIN(u32, (uint32_t)(sp[0].i32 >> (sp[1].u32 & 31)));/* i32.shr_s */
+    WA_CASE(0x76): WA_BIN(u32, sp[0].u32 >> (sp[1].u32 & 31));            /* i32.shr_u */
+    WA_CASE(0x77): WA_BIN(u32, rotl32(sp[0].u32, sp[1].u32));             /* i32.rotl */
+    WA_CASE(0x78): WA_BIN(u32, rotr32(sp[0].u32, sp[1].u32));             /* i32.rotr */
+
+    /* i64 binary */
+    WA_CASE(0x7c): WA_BIN(u64, sp[0].u64 + sp[1].u64);                    /* i64.add */
+    WA_CASE(0x7d): WA_BIN(u64, sp[0].u64 - sp[1].u64);                    /* i64.sub */
+    WA_CASE(0x7e): WA_BIN(u64, sp[0].u64 * sp[1].u64);                    /* i64.mul */
+    WA_CASE(0x7f):                                                        /* i64.div_s */
+        if(!sp->u64) goto divz;
+        if(sp[-1].u64 == 0x8000000000000000 && sp->u64 == (uint64_t)-1) goto ovf;
+        WA_BIN(u64, (uint64_t)(sp[0].i64 / sp[1].i64));
+    WA_CASE(0x80): if(!sp->u64) goto divz; WA_BIN(u64, sp[0].u64 / sp[1].u64);              /* i64.div_u */
+    WA_CASE(0x81): if(!sp->u64) goto divz;                                                  /* i64.rem_s */
+        WA_BIN(u64, sp[1].u64 == (uint64_t)-1 ? 0 : (uint64_t)(sp[0].i64 % sp[1].i64));
+    WA_CASE(0x82): if(!sp->u64) goto divz; WA_BIN(u64, sp[0].u64 % sp[1].u64);              /* i64.rem_u */
+    WA_CASE(0x83): WA_BIN(u64, sp[0].u64 & sp[1].u64);                    /* i64.and */
+    WA_CASE(0x84): WA_BIN(u64, sp[0].u64 | sp[1].u64);                    /* i64.or */
+    WA_CASE(0x85): WA_BIN(u64, sp[0].u64 ^ sp[1].u64);                    /* i64.xor */
+    WA_CASE(0x86): WA_BIN(u64, sp[0].u64 << (sp[1].u64 & 63));            /* i64.shl */
+    WA_CASE(0x87): WA_BIN(u64, (uint64_t)(sp[0].i64 >> (sp[1].u64 & 63)));/* i64.shr_s */
+    WA_CASE(0x88): WA_BIN(u64, sp[0].u64 >> (sp[1].u64 & 63));            /* i64.shr_u */
+    WA_CASE(0x89): WA_BIN(u64, rotl64(sp[0].u64, sp[1].u64));             /* i64.rotl */
+    WA_CASE(0x8a): WA_BIN(u64, rotr64(sp[0].u64, sp[1].u64));             /* i64.rotr */
+
+#ifndef WA_NOFLOAT
+    /* unary f32 */
+    WA_CASE(0x8b): sp->f32 = __builtin_fabs(sp->f32); WA_NEXT();          /* f32.abs */
+    WA_CASE(0x8c): sp->f32 = -sp->f32; WA_NEXT();                         /* f32.neg */
+    WA_CASE(0x8d): sp->f32 = __builtin_ceil(sp->f32); WA_NEXT();          /* f32.ceil */
+    WA_CASE(0x8e): sp->f32 = __builtin_floor(sp->f32); WA_NEXT();         /* f32.floor */
+    WA_CASE(0x8f): sp->f32 = __builtin_trunc(sp->f32); WA_NEXT();         /* f32.trunc */
+    WA_CASE(0x90): sp->f32 = __builtin_rint(sp->f32); WA_NEXT();          /* f32.nearest */
+
+    /* unary f64 */
+    WA_CASE(0x99): sp->f64 = __builtin_fabs(sp->f64); WA_NEXT();          /* f64.abs */
+    WA_CASE(0x9a): sp->f64 = -sp->f64; WA_NEXT();                         /* f64.neg */
+    WA_CASE(0x9b): sp->f64 = __builtin_ceil(sp->f64); WA_NEXT();          /* f64.ceil */
+    WA_CASE(0x9c): sp->f64 = __builtin_floor(sp->f64); WA_NEXT();         /* f64.floor */
+    WA_CASE(0x9d): sp->f64 = __builtin_trunc(sp->f64); WA_NEXT();         /* f64.trunc */
+    WA_CASE(0x9e): sp->f64 = __builtin_rint(sp->f64); WA_NEXT();          /* f64.nearest */
+#ifndef WA_NOLIBM
+    WA_CASE(0x91): sp->f32 = (float)sqrt((double)sp->f32); WA_NEXT();     /* f32.sqrt */
+    WA_CASE(0x9f): sp->f64 = sqrt(sp->f64); WA_NEXT();                    /* f64.sqrt */
+#endif
+
+    /* f32 binary */
+    WA_CASE(0x92): WA_BIN(f32, sp[0].f32 + sp[1].f32);                    /* f32.add */
+    WA_CASE(0x93): WA_BIN(f32, sp[0].f32 - sp[1].f32);                    /* f32.sub */
+    WA_CASE(0x94): WA_BIN(f32, sp[0].f32 * sp[1].f32);                    /* f32.mul */
+    WA_CASE(0x95): WA_BIN(f32, sp[0].f32 / sp[1].f32);                    /* f32.div */
+    WA_CASE(0x96): WA_BIN(f32, f32_min(sp[0].f32, sp[1].f32));            /* f32.min */
+    WA_CASE(0x97): WA_BIN(f32, f32_max(sp[0].f32, sp[1].f32));            /* f32.max */
+    WA_CASE(0x98): WA_BIN(f32, __builtin_signbit(sp[1].f32) ? -__builtin_fabs(sp[0].f32) : __builtin_fabs(sp[0].f32)); /* f32.copysign */
+
+    /* f64 binary */
+    WA_CASE(0xa0): WA_BIN(f64, sp[0].f64 + sp[1].f64);                    /* f64.add */
+    WA_CASE(0xa1): WA_BIN(f64, sp[0].f64 - sp[1].f64);                    /* f64.sub */
+    WA_CASE(0xa2): WA_BIN(f64, sp[0].f64 * sp[1].f64);                    /* f64.mul */
+    WA_CASE(0xa3): WA_BIN(f64, sp[0].f64 / sp[1].f64);                    /* f64.div */
+    WA_CASE(0xa4): WA_BIN(f64, f64_min(sp[0].f64, sp[1].f64));            /* f64.min */
+    WA_CASE(0xa5): WA_BIN(f64, f64_max(sp[0].f64, sp[1].f64));            /* f64.max */
+    WA_CASE(0xa6): WA_BIN(f64, __builtin_signbit(sp[1].f64) ? -__builtin_fabs(sp[0].f64) : __builtin_fabs(sp[0].f64)); /* f64.copysign */
+#endif
+
+    /*** conversion operations ***/
+    WA_CASE(0xa7): sp->u64 &= 0x00000000ffffffff; WA_NEXT();              /* i32.wrap_i64 */
+    WA_CASE(0xac): sp->u64 = (uint64_t)(int64_t)sp->i32; WA_NEXT();       /* i64.extend_i32_s */
+    WA_CASE(0xad): sp->u64 = sp->u32; WA_NEXT();                          /* i64.extend_i32_u */
+#ifndef WA_NOFLOAT
+    WA_CASE(0xa8): if(__builtin_isnan(sp->f32)) goto nan;                 /* i32.trunc_f32_s */
+        if(sp->f32 >= (float)INT32_MAX || sp->f32 < INT32_MIN) goto ovf;
+        sp->i32 = sp->f32; WA_NEXT();
+    WA_CASE(0xa9): if(__builtin_isnan(sp->f32)) goto nan;                 /* i32.trunc_f32_u */
+        if(sp->f32 >= (float)UINT32_MAX || sp->f32 <= -1) goto ovf;
+        sp->u32 = sp->f32; WA_NEXT();
+    WA_CASE(0xaa): if(__builtin_isnan(sp->f64)) goto nan;                 /* i32.trunc_f64_s */
+        if(sp->f64 > (double)INT32_MAX || sp->f64 < INT32_MIN) goto ovf;
+        sp->i32 = sp->f64; WA_NEXT();
+    WA_CASE(0xab): if(__builtin_isnan(sp->f64)) goto nan;                 /* i32.trunc_f64_u */
+        if(sp->f64 > (double)UINT32_MAX || sp->f64 <= -1) goto ovf;
+        sp->u32 = sp->f64; WA_NEXT();
+    WA_CASE(0xae): if(__builtin_isnan(sp->f32)) goto nan;                 /* i64.trunc_f32_s */
+        if(sp->f32 >= (float)INT64_MAX || sp->f32 < INT64_MIN) goto ovf;
+        sp->i64 = sp->f32; WA_NEXT();
+    WA_CASE(0xaf): if(__builtin_isnan(sp->f32)) goto nan;                 /* i64.trunc_f32_u */
+        if(sp->f32 >= (double)UINT64_MAX || sp->f32 <= -1) goto ovf;
+        sp->u64 = sp->f32; WA_NEXT();
+    WA_CASE(0xb0): if(__builtin_isnan(sp->f64)) goto nan;                 /* i64.trunc_f64_s */
+        if(sp->f64 >= (double)INT64_MAX || sp->f64 < INT64_MIN) goto ovf;
+        sp->i64 = sp->f64; WA_NEXT();
+    WA_CASE(0xb1): if(__builtin_isnan(sp->f64)) goto nan;                 /* i64.trunc_f64_u */
+        if(sp->f64 >= (double)UINT64_MAX || sp->f64 <= -1) goto ovf;
+        sp->u64 = sp->f64; WA_NEXT();
+    WA_CASE(0xb2): sp->f32 = sp->i32; WA_NEXT();                          /* f32.convert_i32_s */
+    WA_CASE(0xb3): sp->f32 = sp->u32; WA_NEXT();                          /* f32.convert_i32_u */
+    WA_CASE(0xb4): sp->f32 = sp->i64; WA_NEXT();                          /* f32.convert_i64_s */
+    WA_CASE(0xb5): sp->f32 = sp->u64; WA_NEXT();                          /* f32.convert_i64_u */
+    WA_CASE(0xb6): sp->f32 = sp->f64; WA_NEXT();                          /* f32.demote_f64 */
+    WA_CASE(0xb7): sp->f64 = sp->i32; WA_NEXT();                          /* f64.convert_i32_s */
+    WA_CASE(0xb8): sp->f64 = sp->u32; WA_NEXT();                          /* f64.convert_i32_u */
+    WA_CASE(0xb9): sp->f64 = sp->i64; WA_NEXT();                          /* f64.convert_i64_s */
+    WA_CASE(0xba): sp->f64 = sp->u64; WA_NEXT();                          /* f64.convert_i64_u */
+    WA_CASE(0xbb): sp->f64 = sp->f32; WA_NEXT();                          /* f64.promote_f32 */
+#endif
+
+    /* sign extend */
+    WA_CASE(0xc0): sp->u64 = (uint32_t)(int32_t)(int8_t)sp->u32; WA_NEXT();   /* i32.extend8_s */
+    WA_CASE(0xc1): sp->u64 = (uint32_t)(int32_t)(int16_t)sp->u32; WA_NEXT();  /* i32.extend16_s */
+    WA_CASE(0xc2): sp->u64 = (uint64_t)(int64_t)(int8_t)sp->u64; WA_NEXT();   /* i64.extend8_s */
+    WA_CASE(0xc3): sp->u64 = (uint64_t)(int64_t)(int16_t)sp->u64; WA_NEXT();  /* i64.extend16_s */
+    WA_CASE(0xc4): sp->u64 = (uint64_t)(int64_t)(int32_t)sp->u64; WA_NEXT();  /* i64.extend32_s */
+
+#ifdef WA_THREADED
+op_bad:
+#else
+    default:
+#endif
+        WA_TRAP(WA_ERR_UD, ("wa_run: bad internal opcode 0x%x", m->code_threaded ? 0 : ip->h.op));
+#ifndef WA_THREADED
+    }
+#endif
+
+divz:
+    WA_TRAP(WA_ERR_ARITH, ("wa_run: divide by zero"));
+ovf:
+    WA_TRAP(WA_ERR_ARITH, ("wa_run: int overflow"));
+#ifndef WA_NOFLOAT
+nan:
+    WA_TRAP(WA_ERR_ARITH, ("wa_run: invalid int conversion"));
+#endif
+#ifndef WA_GUARDMEM
+oob:
+    WA_TRAP(WA_ERR_BOUND, ("wa_run: out of bound access 0x%"LL"x", addr));
+#endif
+trap:
+    /* m->err_code is set, report the wasm address of the failing instruction */
+    m->pc = ip - code;
+    m->err_pc = m->code_pc[ip - code];
+    m->sp = sp - stack; m->fp = fp - stack;
+    return 0;
+#undef WA_CASE
+#undef WA_JUMP
+#undef WA_NEXT
+#undef WA_TRAP
+#undef WA_ADDR
+#undef WA_LOAD
+#undef WA_STORE
+#undef WA_BIN
+}
+#ifdef WA_THREADED
+#pragma GCC diagnostic pop
+#endif
+
+#ifdef WA_GUARDMEM
+/* wa_run with a fault in the reservation turned into a trap. This sits outside of wa_run, so the
+ * setjmp doesn't keep its locals out of registers, the trapping instruction isn't known then (err_pc 0) */
+static int wa_run_guarded(Module *m)
+{
+    WaGuard guard;
+    int ret;
+
+    guard.base = m->memory[0].bytes;
+    guard.outer = wa_guard;
+    if(sigsetjmp(guard.jmp, 0)) {
+        wa_guard = guard.outer;
+        ERR(("wa_run: out of bound access"));
+        m->err_code = WA_ERR_BOUND; m->err_pc = 0;
+        return 0;
+    }
+    wa_guard = &guard;
+    ret = wa_run(m);
+    wa_guard = guard.outer;
+    return ret;
+}
+#endif
+#endif
+
 /* interpret wasm bytecodes */
 static int wa_interpret(Module *m) {
     const uint32_t IMM_SIZE[] = {
@@ -1050,6 +2068,11 @@ static int wa_interpret(Module *m) {
 #endif
     int          n;
 
+#if defined(WA_TRANSLATE) && defined(WA_GUARDMEM)
+    if(m->code) return wa_run_guarded(m);
+#elif defined(WA_TRANSLATE)
+    if(m->code) return wa_run(m);
+#endif
     while(!m->err_code && m->pc < m->byte_count) {
         cur_pc = m->err_pc = m->pc;
         opcode = wa_read_opcode(m, &m->pc);
@@ -1246,23 +2269,13 @@ static int wa_interpret(Module *m) {
             continue;
         case 0x40:  /* memory.grow */
             wa_read_LEB(m, &m->pc, 32); /* ignore memory index */
-            arg = stack[m->sp].u32 * WA_PAGESIZE;
-            stack[m->sp].u32 = (m->memory[0].size + WA_PAGESIZE - 1) / WA_PAGESIZE;
-            d = m->memory[0].size + arg;
+            arg = stack[m->sp].u32;
 #ifdef WA_DEBUGGER
+            d = m->memory[0].size + (uint64_t)arg * WA_PAGESIZE;
             for(n = 0; n < WA_NUMBRK && (m->breakpoints[n].type != BRK_GROW); n++);
             if(n < WA_NUMBRK) WA_DEBUGGER(m, BRK_GROW, d);
 #endif
-            if(arg == 0) {
-                continue; /* No change */
-            } else
-#ifdef WA_ALLOW_GROW
-            if(d < m->memory[0].limit && d < WA_MAXMEM) {
-                m->memory[0].bytes = wa_recalloc(m, m->memory[0].bytes, m->memory[0].size, d, sizeof(uint8_t), __LINE__);
-                m->memory[0].start = m->memory[0].size = d;
-            } else
-#endif
-                stack[m->sp].u32 = -1;
+            stack[m->sp].u32 = wa_grow(m, arg);
             continue;
         case 0xfc08:  /* memory.init */
             c = wa_read_LEB(m, &m->pc, 32);
@@ -1700,16 +2713,77 @@ int wa_push_f64(Module *m, double   value) { DBG(("wa_push_f64 %g", value)); if(
  * @return function's return value and error code in m->err_code
  */
 StackValue wa_call(Module *m, int fidx) {
-    StackValue zero = { 0 };
+    StackValue zero = { 0 }, ret;
+    Block *func;
     if(fidx < 0 || (uint32_t)fidx >= m->function_count || !m->functions[fidx].start_addr) {
         ERR(("wa_call: bad function index %d", fidx));
         m->err_code = WA_ERR_BOUND; return zero;
     }
     DBG(("wa_call: %d (pc 0x%x)", fidx, m->functions[fidx].start_addr));
+    if(m->native && m->native->entries[fidx]) {
+        func = &m->functions[fidx];
+        if(m->err_code) return zero;
+        if(m->sp + 1 < (int)func->type.param_count) { ERR(("wa_call: stack underflow")); m->err_code = WA_ERR_BOUND; return zero; }
+        m->sp -= func->type.param_count;
+        ret = m->native->entries[fidx](m, &m->stack[m->sp + 1]);
+        if(m->err_code) return zero;
+        if(func->type.result_count) {
+            if(!wa_check_stack(m, 1)) return zero;
+            m->stack[++m->sp] = ret;
+        }
+        return m->sp >= 0 ? m->stack[m->sp] : zero;
+    }
     wa_internal_call(m, fidx);
     return wa_interpret(m) && !m->err_code && m->sp >= 0 ? m->stack[m->sp] : zero;
 }
 
+/**
+ * Hash of a wasm binary, identifies the binary native code was compiled from
+ * @param bytes buffer with the wasm binary
+ * @param byte_count length of the wasm binary
+ * @return 64 bit FNV-1a hash
+ */
+uint64_t wa_hash(const uint8_t *bytes, uint32_t byte_count) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    uint32_t i;
+    for(i = 0; i < byte_count; i++) { hash ^= bytes[i]; hash *= 0x100000001b3ULL; }
+    return hash;
+}
+
+/* import call from native code, args are copied on the stack like the interpreter leaves them */
+static StackValue wa_native_host(Module *m, uint32_t fidx, StackValue *args) {
+    StackValue zero = { 0 };
+    uint32_t i, n;
+
+    if(m->err_code) return zero;
+    if(fidx >= m->function_count) { ERR(("wa_native_host: bad function index %u", fidx)); m->err_code = WA_ERR_BOUND; return zero; }
+    n = m->functions[fidx].type.param_count;
+    if(!wa_check_stack(m, n + 1)) return zero;
+    for(i = 0; i < n; i++) m->stack[++m->sp] = args[i];
+    if(!wa_external_call(m, fidx) || m->err_code) return zero;
+    return m->functions[fidx].type.result_count ? m->stack[m->sp--] : zero;
+}
+
+/**
+ * Run the module's functions as ahead-of-time compiled code, call after wa_init()
+ * @param m module instance
+ * @param native code compiled from the same wasm binary with the same WA_* options, NULL to interpret again
+ * @return 1 on success, 0 if the native code doesn't belong to the loaded binary (the module is interpreted then)
+ */
+int wa_native(Module *m, WaNative *native) {
+    m->native = NULL;
+    if(!native) return 1;
+    if(m->err_code || !m->bytes || native->hash != wa_hash(m->bytes, m->byte_count) ||
+      native->function_count != m->function_count || !native->entries) {
+        DBG(("wa_native: native code doesn't match the wasm binary"));
+        return 0;
+    }
+    native->host = wa_native_host;
+    native->grow = wa_grow;
+    m->native = native;
+    return 1;
+}
+
 /**
  * Load a wasm binary into the context
  * @param m module instance
@@ -1771,6 +2845,9 @@ int wa_init(Module *m, uint8_t *bytes, uint32_t byte_count, RTLink *link)
     m->csp_count = 0; m->callstack = NULL;
     m->function_count = m->global_count = 0;
     memset(m->memory, 0, sizeof(m->memory));
+    m->code = NULL; m->code_pc = NULL; m->func_code = NULL;
+    m->code_count = m->code_threaded = 0;
+    m->native = NULL;
 
     while(!m->err_code && pos < byte_count) {
         /* read in section header */
@@ -1939,7 +3016,9 @@ int wa_init(Module *m, uint8_t *bytes, uint32_t byte_count, RTLink *link)
             DBG(("  memory count: 0x%x", count));
             if(count != 1) { ERR(("wa_init: more than 1 memory not supported in MVP")); m->err_code = WA_ERR_BOUND; return 0; }
             wa_read_memory_type(m, &pos);
-#if !defined(WA_ALLOW_GROW) && !defined(WA_DIRECTMEM)
+#ifdef WA_GUARDMEM
+            if(!wa_guard_mem(m, m->memory[0].limit)) return 0;
+#elif !defined(WA_ALLOW_GROW) && !defined(WA_DIRECTMEM)
             /* in normal mode we allocate the entire address space in advance with a single malloc call */
             wa_check_mem(m);
 #endif
@@ -2128,6 +3207,13 @@ int wa_init(Module *m, uint8_t *bytes, uint32_t byte_count, RTLink *link)
     }
 #ifdef WA_DEBUGGER
     if(m->single_step && start_function >= m->function_count) { m->pc = first_code; WA_DEBUGGER(m, 255, first_code); }
+#endif
+#ifdef WA_GUARDMEM
+    /* without a Memory section every access has to fault */
+    if(!m->err_code && !m->memory[0].bytes) wa_guard_mem(m, 0);
+#endif
+#ifdef WA_TRANSLATE
+    if(!m->err_code) wa_translate(m);
 #endif
     /* call constructor (if any) */
     if(!m->err_code && start_function != -1U && start_function < m->function_count) {
@@ -2149,7 +3235,8 @@ size_t wa_sizeof(Module *m) {
     return m->type_count * sizeof(Type) + (m->function_count + m->cache_count) * sizeof(Block) +
         (m->global_count + m->sp_count) * sizeof(StackValue) + m->global_count * sizeof(uint64_t) +
         m->csp_count * sizeof(Frame) + (m->table.size + m->br_count) * sizeof(uint32_t) +
-        m->segs_count * sizeof(Segment) + sum;
+        m->segs_count * sizeof(Segment) + m->code_count * (sizeof(Insn) + sizeof(uint32_t)) +
+        (m->func_code ? m->function_count * sizeof(FuncCode) : 0) + sum;
 }
 
 /**
@@ -2161,8 +3248,13 @@ int wa_free(Module *m) {
     int ret = m->err_code, i;
     DBG(("wa_free bytes %p byte_count %u sizeof %"LL"u limit %"LL"u err_code %d",
         (void*)m->bytes, m->byte_count, wa_sizeof(m), m->memory[0].size, ret));
+#ifdef WA_GUARDMEM
+    if(m->memory[0].bytes) munmap(m->memory[0].bytes, WA_GUARDSIZE);
+    (void)i;
+#else
     for(i = 0; i < WA_NUMBUF; i++)
         if(m->memory[i].bytes) free(m->memory[i].bytes);
+#endif
     if(m->segs) free(m->segs);
     if(m->types) free(m->types);
     if(m->functions) free(m->functions);
@@ -2171,6 +3263,9 @@ int wa_free(Module *m) {
     if(m->table.entries) free(m->table.entries);
     if(m->cache) free(m->cache);
     if(m->lookup) free(m->lookup);
+    if(m->code) free(m->code);
+    if(m->code_pc) free(m->code_pc);
+    if(m->func_code) free(m->func_code);
     if(m->stack) free(m->stack);
     if(m->callstack) free(m->callstack);
     if(m->br_table) free(m->br_table);
@@ -45,17 +45,35 @@ Geom_Desc :: struct {
 // Flags
 ANIM_PLAY :: 1 << 0
 ANIM_LOOP :: 1 << 1
+ANIM_ADDITIVE :: 1 << 2 // layers only
 
 SOUND_PLAY :: 1 << 1
 SOUND_LOOP :: 1 << 2
 SOUND_SPATIAL :: 1 << 3
 
+ASSET_TEXTURE :: 0
+ASSET_MODEL :: 1
+ASSET_ANIMS :: 2
+ASSET_SOUND :: 3
+
+ASSET_INVALID :: 0
+ASSET_PENDING :: 1
+ASSET_READY :: 2
+ASSET_FAILED :: 3
+
 Anim_Desc :: struct {
 	set:   Anim_Set,
 	flags: i32,
 	anim:  i32,
 }
 
+Anim_Layer_Desc :: struct {
+	flags:      i32,
+	anim:       i32,
+	weight:     f32,
+	mask_joint: i32, // -1 affects the whole skeleton
+}
+
 Sound_Desc :: struct {
 	sound:     Sound,
 	vol:       f32,
@@ -64,6 +82,28 @@ Sound_Desc :: struct {
 	flags:     u32,
 }
 
+Transform :: struct {
+	pos:   [3]f32,
+	rot:   [4]f32,
+	scale: [3]f32,
+}
+
+// shared scene view, see lofi.h: arrays are indexed by the entity slot (id & 0x3ffff), offsets are in bytes
+Scene_View :: struct {
+	capacity:    u32,
+	dirty_begin: u32,
+	dirty_end:   u32,
+	ids:         u32,
+	transforms:  u32,
+	anims:       u32,
+}
+
+Anim_State :: struct {
+	flags: i32,
+	anim:  i32,
+	frame: f32,
+}
+
 foreign import env "env"
 
 @(default_calling_convention = "c")
@@ -92,6 +132,21 @@ foreign env {
 	@(link_name = "lo_release_sound")
 	release_sound :: proc(sound: Sound) ---
 
+	@(link_name = "lo_load_texture_async")
+	load_texture_async :: proc(path: cstring) -> Texture ---
+
+	@(link_name = "lo_load_model_async")
+	load_model_async :: proc(path: cstring) -> Model ---
+
+	@(link_name = "lo_load_anims_async")
+	load_anims_async :: proc(path: cstring) -> Anim_Set ---
+
+	@(link_name = "lo_load_sound_async")
+	load_sound_async :: proc(path: cstring) -> Sound ---
+
+	@(link_name = "lo_asset_status")
+	asset_status :: proc(type: i32, handle: u32) -> i32 ---
+
 	@(link_name = "lo_create")
 	create :: proc() -> Entity ---
 
@@ -119,6 +174,31 @@ foreign env {
 	@(link_name = "lo_get_scale")
 	get_scale :: proc(e: Entity, out: [^]f32) ---
 
+	// batched, count entities per call; invalid entities are skipped on set and read back as zeros
+	@(link_name = "lo_set_positions")
+	set_positions :: proc(ids: [^]Entity, pos: [^]f32, count: i32) ---
+
+	@(link_name = "lo_get_positions")
+	get_positions :: proc(ids: [^]Entity, out: [^]f32, count: i32) ---
+
+	@(link_name = "lo_set_rotations")
+	set_rotations :: proc(ids: [^]Entity, rot: [^]f32, count: i32) ---
+
+	@(link_name = "lo_get_rotations")
+	get_rotations :: proc(ids: [^]Entity, out: [^]f32, count: i32) ---
+
+	@(link_name = "lo_set_scales")
+	set_scales :: proc(ids: [^]Entity, scale: [^]f32, count: i32) ---
+
+	@(link_name = "lo_get_scales")
+	get_scales :: proc(ids: [^]Entity, out: [^]f32, count: i32) ---
+
+	@(link_name = "lo_set_transforms")
+	set_transforms :: proc(ids: [^]Entity, trs: [^]Transform, count: i32) ---
+
+	@(link_name = "lo_get_transforms")
+	get_transforms :: proc(ids: [^]Entity, out: [^]Transform, count: i32) ---
+
 	@(link_name = "lo_set_parent")
 	set_parent :: proc(entity: Entity, parent: Entity) ---
 
@@ -152,6 +232,21 @@ foreign env {
 	@(link_name = "lo_clear_anims")
 	clear_anims :: proc(entity: Entity) ---
 
+	@(link_name = "lo_set_anim_layer")
+	set_anim_layer :: proc(entity: Entity, layer: i32, desc: ^Anim_Layer_Desc) ---
+
+	@(link_name = "lo_set_anim_layer_weight")
+	set_anim_layer_weight :: proc(entity: Entity, layer: i32, weight: f32) ---
+
+	@(link_name = "lo_clear_anim_layer")
+	clear_anim_layer :: proc(entity: Entity, layer: i32) ---
+
+	@(link_name = "lo_scene_view_size")
+	scene_view_size :: proc() -> u32 ---
+
+	@(link_name = "lo_share_scene")
+	share_scene :: proc(view: ^Scene_View, size: u32) -> bool ---
+
 	@(link_name = "lo_set_sound")
 	set_sound :: proc(e: Entity, desc: ^Sound_Desc) ---
 
@@ -16,8 +16,12 @@
 #include "deps/sokol_audio.h"
 #include "deps/sokol_debugtext.h"
 #include "deps/sokol_log.h"
+#include "deps/sokol_fetch.h"
 #include "deps/tlsf.h"
 #define WA_IMPLEMENTATION
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__))
+#define WA_GUARDMEM //out of bound wasm accesses fault on guard pages instead of being checked
+#endif
 //#define DEBUG
 #include "deps/wa.h"
 
@@ -29,10 +33,13 @@ static struct {
     Camera cam;
     RenderContext* gfx;
     AudioContext* sfx;
+    AssetLoader* loader;
     ne_Simulator sim;
     Scene* scene;
     Module mod;
     IoMemory wasm;
+    void* native; //game_native library made by wa2c, NULL runs the interpreter
+    uint32_t scene_view; //lo_SceneView in wasm memory the scene is mirrored to, 0 when not shared
     ArenaAlloc arena;
     void* tlsf_pool;
     tlsf_t tlsf;
@@ -46,12 +53,34 @@ static inline void* wa_ptr(uint32_t offset) {
     return ctx.mod.memory[0].bytes + offset;
 }
 
+//wa_ptr for a whole array, NULL when it doesn't fit in the wasm memory
+static inline void* wa_span(uint32_t offset, uint64_t size) {
+    if ((uint64_t)offset + size > ctx.mod.memory[0].size) return NULL;
+    return wa_ptr(offset);
+}
+
 static uint32_t wa_load_texture(uint64_t path_ptr) {
     const char* path = (const char*)wa_ptr((uint32_t)path_ptr);
+    uint64_t key = asset_key(path);
+    hp_Handle cached = asset_cache_acquire(&ctx.gfx->textures.cache, &ctx.gfx->textures.pool, key);
+    if (cached != HP_INVALID_HANDLE) return cached;
     IoMemory data = {0};
-    Result result = load_file(&ctx.arena, &data, path, false);
+    uint64_t hash = 0;
+    Result result = map_file(&ctx.arena, &data, path);
+    if(result == RESULT_SUCCESS && gfx_texture_cache_miss(ctx.gfx, &data, &hash)) {
+        //first run decodes on a loader thread and fills the cache, the texture is empty until then.
+        //the job gets the bytes and hash from here instead of reading the file again
+        hp_Handle hnd = asset_load_texture_async(ctx.loader, path, &data, hash);
+        if (hnd != HP_INVALID_HANDLE) {
+            release_file(&data);
+            arena_reset(&ctx.arena);
+            return hnd;
+        }
+    }
     if(result == RESULT_SUCCESS) {
-        TextureHandle ret = gfx_load_texture(ctx.gfx, &ctx.arena, &data);
+        TextureHandle ret = gfx_load_texture(ctx.gfx, &data);
+        if (ret.id != HP_INVALID_HANDLE) asset_cache_insert(&ctx.gfx->textures.cache, ret.id, key);
+        release_file(&data);
         arena_reset(&ctx.arena);
         return ret.id;
     }
@@ -61,10 +90,24 @@ static uint32_t wa_load_texture(uint64_t path_ptr) {
 }
 static uint32_t wa_load_model(uint64_t path_ptr) {
     const char* path = (const char*)wa_ptr((uint32_t)path_ptr);
+    uint64_t key = asset_key(path);
+    hp_Handle cached = asset_cache_acquire(&ctx.gfx->meshes.cache, &ctx.gfx->meshes.pool, key);
+    if (cached != HP_INVALID_HANDLE) return cached;
     IoMemory data = {0};
-    Result result = load_file(&ctx.arena, &data, path, false);
+    Result result = map_file(&ctx.arena, &data, path);
     if(result == RESULT_SUCCESS) {
-        ModelHandle ret = gfx_load_model(ctx.gfx, &ctx.arena, &data);
+        //big meshes convert into a temporary heap arena instead of failing in the scratch one
+        ArenaAlloc* scratch = &ctx.arena;
+        ArenaAlloc heap_arena = {0};
+        Allocator heap = default_allocator();
+        size_t needed = model_decode_size(&data, ctx.gfx->meshes.load_flags);
+        if (needed > ctx.arena.capacity - ctx.arena.offset) {
+            if (arena_init(&heap_arena, core_alloc(&heap, needed, 16), needed)) scratch = &heap_arena;
+        }
+        ModelHandle ret = gfx_load_model(ctx.gfx, scratch, &data);
+        if (ret.id != HP_INVALID_HANDLE) asset_cache_insert(&ctx.gfx->meshes.cache, ret.id, key);
+        if (heap_arena.buffer) core_free(&heap, heap_arena.buffer);
+        release_file(&data);
         arena_reset(&ctx.arena);
         return ret.id;
     }
@@ -74,10 +117,15 @@ static uint32_t wa_load_model(uint64_t path_ptr) {
 }
 static uint32_t wa_load_anims(uint64_t path_ptr) {
     const char* path = (const char*)wa_ptr((uint32_t)path_ptr);
+    uint64_t key = asset_key(path);
+    hp_Handle cached = asset_cache_acquire(&ctx.gfx->anims.cache, &ctx.gfx->anims.pool, key);
+    if (cached != HP_INVALID_HANDLE) return cached;
     IoMemory data = {0};
-    Result result = load_file(&ctx.arena, &data, path, false);
+    Result result = map_file(&ctx.arena, &data, path);
     if(result == RESULT_SUCCESS) {
         AnimSetHandle ret = gfx_load_anims(ctx.gfx, &data);
+        if (ret.id != HP_INVALID_HANDLE) asset_cache_insert(&ctx.gfx->anims.cache, ret.id, key);
+        release_file(&data);
         arena_reset(&ctx.arena);
         return ret.id;
     }
@@ -87,10 +135,15 @@ static uint32_t wa_load_anims(uint64_t path_ptr) {
 }
 static uint32_t wa_load_sound(uint64_t path_ptr) {
     const char* path = (const char*)wa_ptr((uint32_t)path_ptr);
+    uint64_t key = asset_key(path);
+    hp_Handle cached = asset_cache_acquire(&ctx.sfx->buffers.cache, &ctx.sfx->buffers.pool, key);
+    if (cached != HP_INVALID_HANDLE) return cached;
     IoMemory data = {0};
-    Result result = load_file(&ctx.arena, &data, path, false);
+    Result result = map_file(&ctx.arena, &data, path);
     if(result == RESULT_SUCCESS) {
         SoundBufferHandle ret = sfx_load_buffer(ctx.sfx, &data);
+        if (ret.id != HP_INVALID_HANDLE) asset_cache_insert(&ctx.sfx->buffers.cache, ret.id, key);
+        release_file(&data);
         arena_reset(&ctx.arena);
         return ret.id;
     }
@@ -99,6 +152,22 @@ static uint32_t wa_load_sound(uint64_t path_ptr) {
     return HP_INVALID_HANDLE;
 }
 
+static uint32_t wa_load_texture_async(uint64_t path_ptr) {
+    return asset_load_async(ctx.loader, ASSET_TEXTURE, (const char*)wa_ptr((uint32_t)path_ptr));
+}
+static uint32_t wa_load_model_async(uint64_t path_ptr) {
+    return asset_load_async(ctx.loader, ASSET_MODEL, (const char*)wa_ptr((uint32_t)path_ptr));
+}
+static uint32_t wa_load_anims_async(uint64_t path_ptr) {
+    return asset_load_async(ctx.loader, ASSET_ANIMS, (const char*)wa_ptr((uint32_t)path_ptr));
+}
+static uint32_t wa_load_sound_async(uint64_t path_ptr) {
+    return asset_load_async(ctx.loader, ASSET_SOUND, (const char*)wa_ptr((uint32_t)path_ptr));
+}
+static uint32_t wa_asset_status(uint64_t type, uint64_t id) {
+    return asset_status(ctx.loader, (AssetType)type, (hp_Handle)id);
+}
+
 static void wa_release_texture(uint64_t id) {
     gfx_release_texture(ctx.gfx, (TextureHandle){(uint32_t)id});
 }
@@ -150,6 +219,65 @@ static void wa_get_scale(uint64_t id, uint64_t ptr) {
     out[0] = scale.X; out[1] = scale.Y; out[2] = scale.Z;
 }
 
+//batched transforms, count entities per import call: ids is an array of entities, ptr the packed floats
+static void wa_move_transforms(uint64_t ids_ptr, uint64_t ptr, uint64_t count, uint32_t parts, bool set) {
+    int stride = transform_stride(parts);
+    //count is an int32 in lofi.h, a negative one arrives sign extended
+    if (count > INT32_MAX) {
+        LOG_ERROR("Transform batch with negative count\n");
+        return;
+    }
+    const uint32_t* ids = wa_span((uint32_t)ids_ptr, count * sizeof(uint32_t));
+    float* data = wa_span((uint32_t)ptr, count * stride * sizeof(float));
+    if (!ids || !data) {
+        LOG_ERROR("Transform batch of %d entities is outside the wasm memory\n", (int)count);
+        return;
+    }
+    if (set) entities_set_transforms(ctx.scene, ids, data, (int)count, parts);
+    else entities_get_transforms(ctx.scene, ids, data, (int)count, parts);
+}
+static void wa_set_positions(uint64_t ids, uint64_t ptr, uint64_t count) {
+    wa_move_transforms(ids, ptr, count, TRANSFORM_POS, true);
+}
+static void wa_get_positions(uint64_t ids, uint64_t ptr, uint64_t count) {
+    wa_move_transforms(ids, ptr, count, TRANSFORM_POS, false);
+}
+static void wa_set_rotations(uint64_t ids, uint64_t ptr, uint64_t count) {
+    wa_move_transforms(ids, ptr, count, TRANSFORM_ROT, true);
+}
+static void wa_get_rotations(uint64_t ids, uint64_t ptr, uint64_t count) {
+    wa_move_transforms(ids, ptr, count, TRANSFORM_ROT, false);
+}
+static void wa_set_scales(uint64_t ids, uint64_t ptr, uint64_t count) {
+    wa_move_transforms(ids, ptr, count, TRANSFORM_SCALE, true);
+}
+static void wa_get_scales(uint64_t ids, uint64_t ptr, uint64_t count) {
+    wa_move_transforms(ids, ptr, count, TRANSFORM_SCALE, false);
+}
+static void wa_set_transforms(uint64_t ids, uint64_t ptr, uint64_t count) {
+    wa_move_transforms(ids, ptr, count, TRANSFORM_ALL, true);
+}
+static void wa_get_transforms(uint64_t ids, uint64_t ptr, uint64_t count) {
+    wa_move_transforms(ids, ptr, count, TRANSFORM_ALL, false);
+}
+
+//the view is looked up again on every use, memory.grow can move the wasm memory
+static SceneView* scene_view() {
+    if (!ctx.scene_view) return NULL;
+    return wa_span(ctx.scene_view, scene_view_size(ctx.scene));
+}
+static uint32_t wa_scene_view_size() {
+    return (uint32_t)scene_view_size(ctx.scene);
+}
+static uint32_t wa_share_scene(uint64_t ptr, uint64_t size) {
+    ctx.scene_view = 0;
+    if (!ptr || size < scene_view_size(ctx.scene) || (ptr & 3)) return false;
+    if (!wa_span((uint32_t)ptr, scene_view_size(ctx.scene))) return false;
+    ctx.scene_view = (uint32_t)ptr;
+    scene_view_publish(ctx.scene, scene_view());
+    return true;
+}
+
 static void wa_set_parent(uint64_t entity, uint64_t parent) {
     entity_set_parent(ctx.scene, (Entity){(uint32_t)entity}, (Entity){(uint32_t)parent});
 }
@@ -199,6 +327,33 @@ static void wa_set_anims(uint64_t entity, uint64_t ptr) {
 static void wa_clear_anims(uint64_t entity) {
     entity_clear_anim(ctx.scene, (Entity){(uint32_t)entity});
 }
+static void wa_set_anim_layer(uint64_t entity, uint64_t layer, uint64_t ptr) {
+    Entity e = {(uint32_t)entity};
+    if (!entity_valid(ctx.scene, e)) return;
+    int idx = hp_index(e.id);
+    if (!(ctx.scene->anim_flags[idx] & ENTITY_HAS_ANIM)) return;
+
+    lo_AnimLayerDesc* desc = (lo_AnimLayerDesc*)wa_ptr((uint32_t)ptr);
+    AnimLayer l = {
+        .state = { .flags = desc->flags & (ANIM_PLAY | ANIM_LOOP), .anim = desc->anim },
+        .weight = HMM_Clamp(0.0f, desc->weight, 1.0f),
+        .flags = (desc->flags & ANIM_ADDITIVE) ? ANIM_LAYER_ADDITIVE : 0,
+    };
+    if (desc->mask_joint != -1) {
+        AnimSet* set = &ctx.gfx->anims.data[hp_index(ctx.scene->anims[idx].id)];
+        if (!anim_mask_add_joint(&l.mask, set, desc->mask_joint)) {
+            LOG_ERROR("Anim layer %d: mask joint %d doesn't exist, layer not set\n", (int)layer, desc->mask_joint);
+            return;
+        }
+    }
+    entity_set_anim_layer(ctx.scene, e, (int)layer, l);
+}
+static void wa_set_anim_layer_weight(uint64_t entity, uint64_t layer, float weight) {
+    entity_set_anim_layer_weight(ctx.scene, (Entity){(uint32_t)entity}, (int)layer, weight);
+}
+static void wa_clear_anim_layer(uint64_t entity, uint64_t layer) {
+    entity_clear_anim_layer(ctx.scene, (Entity){(uint32_t)entity}, (int)layer);
+}
 
 static void wa_set_sound(uint64_t entity, uint64_t ptr) {
     lo_SoundDesc* desc = (lo_SoundDesc*)wa_ptr((uint32_t)ptr);
@@ -399,6 +554,11 @@ static RTLink link[] = {
     { "lo_load_model",     &wa_load_model,    0, WA_il },
     { "lo_load_anims",     &wa_load_anims,    0, WA_il },
     { "lo_load_sound",     &wa_load_sound,    0, WA_il },
+    { "lo_load_texture_async", &wa_load_texture_async, 0, WA_il },
+    { "lo_load_model_async",   &wa_load_model_async,   0, WA_il },
+    { "lo_load_anims_async",   &wa_load_anims_async,   0, WA_il },
+    { "lo_load_sound_async",   &wa_load_sound_async,   0, WA_il },
+    { "lo_asset_status",       &wa_asset_status,       0, WA_ill },
     { "lo_release_texture",&wa_release_texture,0, WA_vl },
     { "lo_release_model",  &wa_release_model, 0, WA_vl },
     { "lo_release_anims",  &wa_release_anims, 0, WA_v },
@@ -412,6 +572,16 @@ static RTLink link[] = {
     { "lo_get_rotation",   &wa_get_rotation,  0, WA_vll },
     { "lo_set_scale",      &wa_set_scale,     0, WA_vll },
     { "lo_get_scale",      &wa_get_scale,     0, WA_vll },
+    { "lo_set_positions",  &wa_set_positions, 0, WA_vlll },
+    { "lo_get_positions",  &wa_get_positions, 0, WA_vlll },
+    { "lo_set_rotations",  &wa_set_rotations, 0, WA_vlll },
+    { "lo_get_rotations",  &wa_get_rotations, 0, WA_vlll },
+    { "lo_set_scales",     &wa_set_scales,    0, WA_vlll },
+    { "lo_get_scales",     &wa_get_scales,    0, WA_vlll },
+    { "lo_set_transforms", &wa_set_transforms, 0, WA_vlll },
+    { "lo_get_transforms", &wa_get_transforms, 0, WA_vlll },
+    { "lo_scene_view_size",&wa_scene_view_size,0, WA_i },
+    { "lo_share_scene",    &wa_share_scene,   0, WA_ill },
     { "lo_set_parent",     &wa_set_parent,    0, WA_vll },
     { "lo_remove_parent",  &wa_remove_parent, 0, WA_vl },
     { "lo_add_child",      &wa_add_child,     0, WA_vll },
@@ -423,6 +593,9 @@ static RTLink link[] = {
     { "lo_clear_textures", &wa_clear_textures,0, WA_vl },
     { "lo_set_anims",      &wa_set_anims,     0, WA_vll },
     { "lo_clear_anims",    &wa_clear_anims,   0, WA_vl },
+    { "lo_set_anim_layer", &wa_set_anim_layer,0, WA_vlll },
+    { "lo_set_anim_layer_weight", &wa_set_anim_layer_weight, 0, WA_vllf },
+    { "lo_clear_anim_layer", &wa_clear_anim_layer, 0, WA_vll },
     { "lo_set_sound",      &wa_set_sound,     0, WA_vll },
     { "lo_play_sound",     &wa_play_sound,    0, WA_vl },
     { "lo_stop_sound",     &wa_stop_sound,    0, WA_vl },
@@ -469,17 +642,46 @@ static RTLink link[] = {
 };
 
 
+#ifdef _WIN32
+#define GAME_NATIVE "game_native.dll"
+#else
+#define GAME_NATIVE "./game_native.so"
+#endif
+
+//runs game.wasm as native code when game_native was built from this exact game.wasm (see wa2c.c)
+static void load_native(void) {
+#ifndef __EMSCRIPTEN__
+    ctx.native = lib_open(GAME_NATIVE);
+    if (!ctx.native) return;
+    WaNative* native = lib_symbol(ctx.native, "wa_native_module");
+    if (native && wa_native(&ctx.mod, native)) {
+        LOG_INFO("Running game.wasm from %s\n", GAME_NATIVE);
+        return;
+    }
+    LOG_WARN("%s does not match game.wasm, using the interpreter\n", GAME_NATIVE);
+    lib_close(ctx.native);
+    ctx.native = NULL;
+#endif
+}
+
 static void reload_game() {
+    //assets the new script loads again by path survive, the rest is freed in gfx_end_reload
+    gfx_begin_reload(ctx.gfx);
+    sfx_begin_reload(ctx.sfx);
     if (ctx.mod.bytes) {
         ctx.function = wa_sym(&ctx.mod, "lo_cleanup");
         wa_call(&ctx.mod, ctx.function);
         wa_free(&ctx.mod);
     }
+    lib_close(ctx.native);
+    ctx.native = NULL;
+    ctx.scene_view = 0;
     if (ctx.wasm.ptr) {
         core_free(&ctx.allocator, ctx.wasm.ptr);
         ctx.wasm = (IoMemory){0};
     }
     scene_reset(ctx.scene);
+    asset_loader_reset(ctx.loader);
     if(ctx.sim != NULL) {
         ne_destroy_sim(ctx.sim);
     }
@@ -487,8 +689,6 @@ static void reload_game() {
         .allocator = &ctx.ne_alloc,
         .gravity = HMM_V3(0, -9.8f, 0),
     });
-    gfx_reset(ctx.gfx);
-    sfx_reset(ctx.sfx);
     Result result = load_wasm(&ctx.wasm, "game.wasm");
     if (result != RESULT_SUCCESS) {
         LOG_ERROR("Failed to load game.wasm!\n");
@@ -496,12 +696,15 @@ static void reload_game() {
     }
 
     wa_init(&ctx.mod, ctx.wasm.ptr, ctx.wasm.size, link);
+    load_native();
 
     ctx.function = wa_sym(&ctx.mod, "lo_init");
     //printf("fidx %d\n\n", ctx.function);
     StackValue ret = {0};
     ret = wa_call(&ctx.mod, ctx.function);
     //printf("WASM function returned: %lld (err_code %d)\n\n", ret.i64, ctx.mod.err_code);
+    gfx_end_reload(ctx.gfx);
+    sfx_end_reload(ctx.sfx);
     ctx.function = wa_sym(&ctx.mod, "lo_frame");
     ctx.fn_mouse_pos = wa_sym(&ctx.mod, "lo_mouse_pos");
     ctx.fn_mouse_button = wa_sym(&ctx.mod, "lo_mouse_button");
@@ -554,11 +757,26 @@ static void init(void) {
         .max_anim_sets = 32,
         .max_meshes = 32,
         .max_textures = 32,
+        .anim_threads = 3,
+        .anim_storage = ANIM_STORAGE_QUANTIZED,
+        .compact_vertices = true,
+        .optimize_meshes = true,
+#ifndef __EMSCRIPTEN__
+        .texture_cache_dir = "cache", //nothing persists on the web
+#endif
         .width = 800,
         .height = 600,
     });
     ctx.sfx = sfx_new_context(&ctx.allocator, 32);
+    ctx.loader = asset_loader_new(&ctx.allocator, ctx.gfx, ctx.sfx, &(AssetLoaderDesc) {
+        .io_channels = 2,
+        .io_lanes = 4,
+        .decode_threads = 2,
+    });
     ctx.scene = scene_new(&ctx.allocator, 512);
+    //assets.pak is optional, anything it doesn't hold still loads from the loose files
+    Allocator heap = default_allocator();
+    pak_mount(&heap, "assets.pak");
 
     reload_game();
 }
@@ -566,23 +784,37 @@ static void init(void) {
 static void frame(void) {
     float dt = (float)sapp_frame_duration();
 
+    asset_loader_update(ctx.loader);
+    //the view takes what input callbacks wrote, then shows physics and animation of the last frame
+    SceneView* view = scene_view();
+    if (view) {
+        scene_view_apply(ctx.scene, view);
+        scene_view_publish(ctx.scene, view);
+    }
     wa_push_f32(&ctx.mod, dt);
     wa_call(&ctx.mod, ctx.function);
+    view = scene_view();
+    if (view) scene_view_apply(ctx.scene, view);
 
     ne_update(ctx.sim, ctx.scene, dt);
+    scene_update_transforms(ctx.scene);
+    anim_update(ctx.scene, ctx.gfx, &ctx.cam, dt);
 
     HMM_Vec3 listener_forward = HMM_Norm(HMM_SubV3(ctx.cam.target, ctx.cam.position));
     sfx_update(ctx.sfx, ctx.cam.position, listener_forward, ctx.scene, dt);
 
-    gfx_render(ctx.gfx, ctx.scene, &ctx.cam, sglue_swapchain(), dt);
+    gfx_render(ctx.gfx, ctx.scene, &ctx.cam, sglue_swapchain());
 }
 
 static void cleanup(void) {
     ctx.function = wa_sym(&ctx.mod, "lo_cleanup");
     wa_call(&ctx.mod, ctx.function);
     wa_free(&ctx.mod);
+    lib_close(ctx.native);
+    asset_loader_destroy(ctx.loader);
     sfx_shutdown(ctx.sfx);
     gfx_shutdown(ctx.gfx);
+    pak_unmount_all();
 }
 
 static void event(const sapp_event* ev) {
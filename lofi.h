@@ -12,6 +12,7 @@
 
 #define ANIM_PLAY (1 << 0)
 #define ANIM_LOOP (1 << 1)
+#define ANIM_ADDITIVE (1 << 2) //layers only
 
 #define SOUND_PLAY    (1U << 1)
 #define SOUND_LOOP    (1U << 2)
@@ -33,6 +34,24 @@ typedef struct lo_Sound { uint32_t id; } lo_Sound;
 IMPORT(lo_load_sound) lo_Sound lo_load_sound(const char* path);
 IMPORT(lo_release_sound) void lo_release_sound(lo_Sound sound);
 
+//the async loaders return right away, the asset draws/plays as empty until its status is LO_ASSET_READY.
+//a failed handle stays reserved until it is released.
+#define LO_ASSET_TEXTURE 0
+#define LO_ASSET_MODEL   1
+#define LO_ASSET_ANIMS   2
+#define LO_ASSET_SOUND   3
+
+#define LO_ASSET_INVALID 0
+#define LO_ASSET_PENDING 1
+#define LO_ASSET_READY   2
+#define LO_ASSET_FAILED  3
+
+IMPORT(lo_load_texture_async) lo_Texture lo_load_texture_async(const char* path);
+IMPORT(lo_load_model_async) lo_Model lo_load_model_async(const char* path);
+IMPORT(lo_load_anims_async) lo_AnimSet lo_load_anims_async(const char* path);
+IMPORT(lo_load_sound_async) lo_Sound lo_load_sound_async(const char* path);
+IMPORT(lo_asset_status) int32_t lo_asset_status(int32_t type, uint32_t handle);
+
 typedef struct lo_Entity { uint32_t id; } lo_Entity;
 
 IMPORT(lo_create) lo_Entity lo_create();
@@ -46,6 +65,18 @@ IMPORT(lo_get_rotation) void lo_get_rotation(lo_Entity e, float out[4]);
 IMPORT(lo_set_scale) void lo_set_scale(lo_Entity e, float scale[3]);
 IMPORT(lo_get_scale) void lo_get_scale(lo_Entity e, float out[3]);
 
+//batched versions, one call moves count entities: 3 floats per entity for positions and scales, 4 for rotations.
+//invalid entities are skipped on set and read back as zeros, a batch reaching outside script memory is ignored
+typedef struct lo_Transform { float pos[3]; float rot[4]; float scale[3]; } lo_Transform;
+IMPORT(lo_set_positions) void lo_set_positions(const lo_Entity* ids, const float* pos, int32_t count);
+IMPORT(lo_get_positions) void lo_get_positions(const lo_Entity* ids, float* out, int32_t count);
+IMPORT(lo_set_rotations) void lo_set_rotations(const lo_Entity* ids, const float* rot, int32_t count);
+IMPORT(lo_get_rotations) void lo_get_rotations(const lo_Entity* ids, float* out, int32_t count);
+IMPORT(lo_set_scales) void lo_set_scales(const lo_Entity* ids, const float* scale, int32_t count);
+IMPORT(lo_get_scales) void lo_get_scales(const lo_Entity* ids, float* out, int32_t count);
+IMPORT(lo_set_transforms) void lo_set_transforms(const lo_Entity* ids, const lo_Transform* trs, int32_t count);
+IMPORT(lo_get_transforms) void lo_get_transforms(const lo_Entity* ids, lo_Transform* out, int32_t count);
+
 IMPORT(lo_set_parent) void lo_set_parent(lo_Entity entity, lo_Entity parent);
 IMPORT(lo_remove_parent) void lo_remove_parent(lo_Entity entity);
 IMPORT(lo_add_child) void lo_add_child(lo_Entity entity, lo_Entity child);
@@ -61,6 +92,39 @@ typedef struct lo_AnimDesc { lo_AnimSet set; int32_t flags; int32_t anim; } lo_A
 IMPORT(lo_set_anims) void lo_set_anims(lo_Entity entity, lo_AnimDesc* desc);
 IMPORT(lo_clear_anims) void lo_clear_anims(lo_Entity entity);
 
+//up to 4 layers on top of the base animation, using the entity's anim set.
+//mask_joint limits the layer to that joint and its children, -1 affects the whole skeleton.
+//a joint the anim set doesn't have logs an error and leaves the layer unchanged.
+typedef struct lo_AnimLayerDesc { int32_t flags; int32_t anim; float weight; int32_t mask_joint; } lo_AnimLayerDesc;
+IMPORT(lo_set_anim_layer) void lo_set_anim_layer(lo_Entity entity, int32_t layer, lo_AnimLayerDesc* desc);
+IMPORT(lo_set_anim_layer_weight) void lo_set_anim_layer_weight(lo_Entity entity, int32_t layer, float weight);
+IMPORT(lo_clear_anim_layer) void lo_clear_anim_layer(lo_Entity entity, int32_t layer);
+
+//shared scene view: the engine mirrors every entity's transform and animation state into a buffer of
+//lo_scene_view_size() bytes in script memory before each lo_frame. arrays are indexed by lo_slot(e),
+//ids[slot] is 0 for a free slot. write to the arrays, call lo_view_touch() for each changed slot and the
+//engine takes the dirty range back after lo_frame (and before the next one, for input callbacks).
+//entities created during a frame show up in the next one; don't also set a touched entity through the
+//single entity imports in the same frame, the view overwrites them. lo_share_scene(0, 0) stops sharing
+typedef struct lo_SceneView {
+    uint32_t capacity;
+    uint32_t dirty_begin, dirty_end;
+    uint32_t ids, transforms, anims; //byte offsets from the view, changing them has no effect
+} lo_SceneView;
+typedef struct lo_AnimState { int32_t flags; int32_t anim; float frame; } lo_AnimState;
+IMPORT(lo_scene_view_size) uint32_t lo_scene_view_size(void);
+IMPORT(lo_share_scene) bool lo_share_scene(lo_SceneView* view, uint32_t size);
+
+static inline uint32_t lo_slot(lo_Entity e) { return e.id & 0x3ffff; }
+static inline lo_Entity* lo_view_ids(lo_SceneView* v) { return (lo_Entity*)((uint8_t*)v + v->ids); }
+static inline lo_Transform* lo_view_transforms(lo_SceneView* v) { return (lo_Transform*)((uint8_t*)v + v->transforms); }
+static inline lo_AnimState* lo_view_anims(lo_SceneView* v) { return (lo_AnimState*)((uint8_t*)v + v->anims); }
+static inline void lo_view_touch(lo_SceneView* v, uint32_t slot) {
+    if (v->dirty_begin == v->dirty_end) { v->dirty_begin = slot; v->dirty_end = slot + 1; return; }
+    if (slot < v->dirty_begin) v->dirty_begin = slot;
+    if (slot >= v->dirty_end) v->dirty_end = slot + 1;
+}
+
 typedef struct lo_SoundDesc { lo_Sound sound; float vol; float min_range; float max_range; uint32_t flags; } lo_SoundDesc;
 IMPORT(lo_set_sound) void lo_set_sound(lo_Entity e, lo_SoundDesc* desc);
 IMPORT(lo_play_sound) void lo_play_sound(lo_Entity e);
@@ -19,17 +19,35 @@ pub const GeomDesc = extern struct {
 
 pub const ANIM_PLAY: i32 = 1 << 0;
 pub const ANIM_LOOP: i32 = 1 << 1;
+pub const ANIM_ADDITIVE: i32 = 1 << 2; // layers only
 
 pub const SOUND_PLAY: u32 = 1 << 1;
 pub const SOUND_LOOP: u32 = 1 << 2;
 pub const SOUND_SPATIAL: u32 = 1 << 3;
 
+pub const ASSET_TEXTURE: i32 = 0;
+pub const ASSET_MODEL: i32 = 1;
+pub const ASSET_ANIMS: i32 = 2;
+pub const ASSET_SOUND: i32 = 3;
+
+pub const ASSET_INVALID: i32 = 0;
+pub const ASSET_PENDING: i32 = 1;
+pub const ASSET_READY: i32 = 2;
+pub const ASSET_FAILED: i32 = 3;
+
 pub const AnimDesc = extern struct {
     set: AnimSet,
     flags: i32,
     anim: i32,
 };
 
+pub const AnimLayerDesc = extern struct {
+    flags: i32,
+    anim: i32,
+    weight: f32,
+    mask_joint: i32, // -1 affects the whole skeleton
+};
+
 pub const SoundDesc = extern struct {
     sound: Sound,
     vol: f32,
@@ -38,6 +56,28 @@ pub const SoundDesc = extern struct {
     flags: u32,
 };
 
+pub const Transform = extern struct {
+    pos: [3]f32,
+    rot: [4]f32,
+    scale: [3]f32,
+};
+
+// shared scene view, see lofi.h: arrays are indexed by the entity slot (id & 0x3ffff), offsets are in bytes
+pub const SceneView = extern struct {
+    capacity: u32,
+    dirty_begin: u32,
+    dirty_end: u32,
+    ids: u32,
+    transforms: u32,
+    anims: u32,
+};
+
+pub const AnimState = extern struct {
+    flags: i32,
+    anim: i32,
+    frame: f32,
+};
+
 const env = struct {
     extern "env" fn lo_create() Entity;
     extern "env" fn lo_valid(entity: Entity) bool;
@@ -51,6 +91,11 @@ const env = struct {
     extern "env" fn lo_release_anims() void;
     extern "env" fn lo_load_sound(path: [*:0]const u8) Sound;
     extern "env" fn lo_release_sound(sound: Sound) void;
+    extern "env" fn lo_load_texture_async(path: [*:0]const u8) Texture;
+    extern "env" fn lo_load_model_async(path: [*:0]const u8) Model;
+    extern "env" fn lo_load_anims_async(path: [*:0]const u8) AnimSet;
+    extern "env" fn lo_load_sound_async(path: [*:0]const u8) Sound;
+    extern "env" fn lo_asset_status(typ: i32, handle: u32) i32;
 
     extern "env" fn lo_set_position(e: Entity, pos: [*]const f32) void;
     extern "env" fn lo_get_position(e: Entity, out: [*]f32) void;
@@ -58,6 +103,14 @@ const env = struct {
     extern "env" fn lo_get_rotation(e: Entity, out: [*]f32) void;
     extern "env" fn lo_set_scale(e: Entity, scale: [*]const f32) void;
     extern "env" fn lo_get_scale(e: Entity, out: [*]f32) void;
+    extern "env" fn lo_set_positions(ids: [*]const Entity, pos: [*]const f32, count: i32) void;
+    extern "env" fn lo_get_positions(ids: [*]const Entity, out: [*]f32, count: i32) void;
+    extern "env" fn lo_set_rotations(ids: [*]const Entity, rot: [*]const f32, count: i32) void;
+    extern "env" fn lo_get_rotations(ids: [*]const Entity, out: [*]f32, count: i32) void;
+    extern "env" fn lo_set_scales(ids: [*]const Entity, scale: [*]const f32, count: i32) void;
+    extern "env" fn lo_get_scales(ids: [*]const Entity, out: [*]f32, count: i32) void;
+    extern "env" fn lo_set_transforms(ids: [*]const Entity, trs: [*]const Transform, count: i32) void;
+    extern "env" fn lo_get_transforms(ids: [*]const Entity, out: [*]Transform, count: i32) void;
 
     extern "env" fn lo_set_parent(entity: Entity, parent: Entity) void;
     extern "env" fn lo_remove_parent(entity: Entity) void;
@@ -72,6 +125,12 @@ const env = struct {
 
     extern "env" fn lo_set_anims(entity: Entity, desc: *const AnimDesc) void;
     extern "env" fn lo_clear_anims(entity: Entity) void;
+    extern "env" fn lo_set_anim_layer(entity: Entity, layer: i32, desc: *const AnimLayerDesc) void;
+    extern "env" fn lo_set_anim_layer_weight(entity: Entity, layer: i32, weight: f32) void;
+    extern "env" fn lo_clear_anim_layer(entity: Entity, layer: i32) void;
+
+    extern "env" fn lo_scene_view_size() u32;
+    extern "env" fn lo_share_scene(view: ?*SceneView, size: u32) bool;
 
     extern "env" fn lo_set_sound(e: Entity, desc: *const SoundDesc) void;
     extern "env" fn lo_play_sound(e: Entity) void;
@@ -133,6 +192,11 @@ pub const loadAnims = env.lo_load_anims;
 pub const releaseAnims = env.lo_release_anims;
 pub const loadSound = env.lo_load_sound;
 pub const releaseSound = env.lo_release_sound;
+pub const loadTextureAsync = env.lo_load_texture_async;
+pub const loadModelAsync = env.lo_load_model_async;
+pub const loadAnimsAsync = env.lo_load_anims_async;
+pub const loadSoundAsync = env.lo_load_sound_async;
+pub const assetStatus = env.lo_asset_status;
 
 pub const setPosition = env.lo_set_position;
 pub const getPosition = env.lo_get_position;
@@ -140,6 +204,15 @@ pub const setRotation = env.lo_set_rotation;
 pub const getRotation = env.lo_get_rotation;
 pub const setScale = env.lo_set_scale;
 pub const getScale = env.lo_get_scale;
+// batched, count entities per call; invalid entities are skipped on set and read back as zeros
+pub const setPositions = env.lo_set_positions;
+pub const getPositions = env.lo_get_positions;
+pub const setRotations = env.lo_set_rotations;
+pub const getRotations = env.lo_get_rotations;
+pub const setScales = env.lo_set_scales;
+pub const getScales = env.lo_get_scales;
+pub const setTransforms = env.lo_set_transforms;
+pub const getTransforms = env.lo_get_transforms;
 
 pub const setParent = env.lo_set_parent;
 pub const removeParent = env.lo_remove_parent;
@@ -154,6 +227,12 @@ pub const clearTextures = env.lo_clear_textures;
 
 pub const setAnims = env.lo_set_anims;
 pub const clearAnims = env.lo_clear_anims;
+pub const setAnimLayer = env.lo_set_anim_layer;
+pub const setAnimLayerWeight = env.lo_set_anim_layer_weight;
+pub const clearAnimLayer = env.lo_clear_anim_layer;
+
+pub const sceneViewSize = env.lo_scene_view_size;
+pub const shareScene = env.lo_share_scene;
 
 pub const setSound = env.lo_set_sound;
 pub const playSound = env.lo_play_sound;
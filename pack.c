@@ -0,0 +1,235 @@
+//asset packer, writes the .pak files pak_mount reads
+//usage: pack [-lz4] [-align N] <out.pak> <file>...
+//entries are found by the path as given, so run it from the directory the game runs in:
+//  pack -lz4 assets.pak assets/floor.webp assets/game_base.iqm ...
+#include "core.h"
+#define SOKOL_IMPL
+#define SOKOL_DUMMY_BACKEND
+#include "deps/sokol_gfx.h"
+#include "deps/sokol_gl.h"
+#include "deps/sokol_audio.h"
+#include "deps/sokol_debugtext.h"
+#include "deps/sokol_log.h"
+#include "deps/sokol_fetch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct PackItem {
+    const char* path;
+    PakEntry entry;
+    uint8_t* data; //what gets written, compressed or not
+} PackItem;
+
+#define LZ4_HASH_BITS 16
+
+static uint32_t read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static size_t put_length(uint8_t* dst, size_t op, size_t len) {
+    for (; len >= 255; len -= 255) dst[op++] = 255;
+    dst[op++] = (uint8_t)len;
+    return op;
+}
+
+//greedy lz4 block compressor, returns 0 when the result wouldn't fit in cap
+static size_t lz4_compress(const uint8_t* src, size_t n, uint8_t* dst, size_t cap, uint32_t* table) {
+    memset(table, 0, sizeof(uint32_t) << LZ4_HASH_BITS);
+    size_t ip = 0, anchor = 0, op = 0;
+    //the format wants the last match to start 12 bytes and end 5 bytes before the end
+    size_t match_limit = n > 12 ? n - 12 : 0;
+    size_t end_limit = n > 5 ? n - 5 : 0;
+
+    while (ip < match_limit) {
+        uint32_t seq = read32(src + ip);
+        uint32_t h = (seq * 2654435761u) >> (32 - LZ4_HASH_BITS);
+        size_t ref = table[h];
+        table[h] = (uint32_t)ip;
+        if (ref >= ip || ip - ref > 65535 || read32(src + ref) != seq) {
+            ip++;
+            continue;
+        }
+        size_t len = 4;
+        while (ip + len < end_limit && src[ref + len] == src[ip + len]) len++;
+
+        size_t lit = ip - anchor;
+        //token, lengths, literals and offset, worst case
+        if (op + 1 + lit / 255 + 1 + lit + 2 + len / 255 + 1 > cap) return 0;
+        size_t token = op++;
+        dst[token] = (uint8_t)((lit >= 15 ? 15 : lit) << 4);
+        if (lit >= 15) op = put_length(dst, op, lit - 15);
+        memcpy(dst + op, src + anchor, lit);
+        op += lit;
+        dst[op++] = (uint8_t)(ip - ref);
+        dst[op++] = (uint8_t)((ip - ref) >> 8);
+        size_t ml = len - 4;
+        dst[token] |= (uint8_t)(ml >= 15 ? 15 : ml);
+        if (ml >= 15) op = put_length(dst, op, ml - 15);
+
+        ip += len;
+        anchor = ip;
+    }
+
+    size_t lit = n - anchor;
+    if (op + 1 + lit / 255 + 1 + lit > cap) return 0;
+    dst[op++] = (uint8_t)((lit >= 15 ? 15 : lit) << 4);
+    if (lit >= 15) op = put_length(dst, op, lit - 15);
+    memcpy(dst + op, src + anchor, lit);
+    return op + lit;
+}
+
+static uint8_t* read_whole(const char* path, size_t* size) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t* data = len >= 0 ? malloc((size_t)len + 1) : NULL;
+    if (data && fread(data, 1, (size_t)len, f) != (size_t)len) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    *size = (size_t)len;
+    return data;
+}
+
+static int compare_items(const void* a, const void* b) {
+    uint64_t ha = ((const PackItem*)a)->entry.hash, hb = ((const PackItem*)b)->entry.hash;
+    return ha < hb ? -1 : ha > hb;
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static void put64(uint8_t* p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static void pad_to(FILE* f, size_t* pos, size_t align) {
+    static const uint8_t zeros[256] = {0};
+    while (*pos % align) {
+        size_t n = HMM_MIN(align - *pos % align, sizeof(zeros));
+        fwrite(zeros, 1, n, f);
+        *pos += n;
+    }
+}
+
+int main(int argc, char** argv) {
+    bool lz4 = false;
+    size_t align = PAK_DEFAULT_ALIGN;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (strcmp(argv[arg], "-lz4") == 0) {
+            lz4 = true;
+        } else if (strcmp(argv[arg], "-align") == 0 && arg + 1 < argc) {
+            align = (size_t)strtoul(argv[++arg], NULL, 10);
+        } else {
+            break;
+        }
+    }
+    //entries are read as uint32 arrays in place, so keep at least that
+    if (align < 4 || (align & (align - 1)) != 0 || arg + 2 > argc) {
+        printf("usage: pack [-lz4] [-align N] <out.pak> <file>...\n");
+        return 1;
+    }
+    const char* out_path = argv[arg++];
+    int num_items = argc - arg;
+
+    PackItem* items = calloc((size_t)num_items, sizeof(PackItem));
+    uint32_t* table = malloc(sizeof(uint32_t) << LZ4_HASH_BITS);
+    if (!items || !table) return 1;
+
+    size_t raw_total = 0, stored_total = 0;
+    for (int i = 0; i < num_items; i++) {
+        PackItem* item = &items[i];
+        item->path = argv[arg + i];
+        size_t size = 0;
+        item->data = read_whole(item->path, &size);
+        if (!item->data || size > UINT32_MAX) {
+            LOG_ERROR("Failed to read %s\n", item->path);
+            return 1;
+        }
+        item->entry.hash = asset_key(item->path);
+        item->entry.raw_size = item->entry.size = (uint32_t)size;
+
+        //compressed entries can't be handed out in place, only keep those that pay for the copy
+        if (lz4 && size > 64) {
+            size_t cap = size - size / 8;
+            uint8_t* packed = malloc(cap);
+            size_t packed_size = packed ? lz4_compress(item->data, size, packed, cap, table) : 0;
+            if (packed_size > 0) {
+                free(item->data);
+                item->data = packed;
+                item->entry.size = (uint32_t)packed_size;
+                item->entry.flags |= PAK_ENTRY_LZ4;
+            } else {
+                free(packed);
+            }
+        }
+        raw_total += item->entry.raw_size;
+        stored_total += item->entry.size;
+    }
+
+    qsort(items, (size_t)num_items, sizeof(PackItem), compare_items);
+    for (int i = 1; i < num_items; i++) {
+        if (items[i].entry.hash == items[i - 1].entry.hash) {
+            LOG_ERROR("%s and %s have the same path hash\n", items[i - 1].path, items[i].path);
+            return 1;
+        }
+    }
+
+    //header, entry table, then the data
+    size_t pos = sizeof(PakHeader) + (size_t)num_items * sizeof(PakEntry);
+    for (int i = 0; i < num_items; i++) {
+        pos = (pos + align - 1) & ~(align - 1);
+        if (pos > UINT32_MAX) {
+            LOG_ERROR("Pack is larger than 4 GB\n");
+            return 1;
+        }
+        items[i].entry.offset = (uint32_t)pos;
+        pos += items[i].entry.size;
+    }
+
+    FILE* f = fopen(out_path, "wb");
+    if (!f) {
+        LOG_ERROR("Failed to open %s\n", out_path);
+        return 1;
+    }
+    uint8_t header[sizeof(PakHeader)] = {0};
+    memcpy(header, PAK_MAGIC, sizeof(((PakHeader*)0)->magic));
+    put32(header + offsetof(PakHeader, version), PAK_VERSION);
+    put32(header + offsetof(PakHeader, num_entries), (uint32_t)num_items);
+    put32(header + offsetof(PakHeader, ofs_entries), sizeof(PakHeader));
+    fwrite(header, 1, sizeof(header), f);
+    for (int i = 0; i < num_items; i++) {
+        uint8_t e[sizeof(PakEntry)] = {0};
+        put64(e + offsetof(PakEntry, hash), items[i].entry.hash);
+        put32(e + offsetof(PakEntry, offset), items[i].entry.offset);
+        put32(e + offsetof(PakEntry, size), items[i].entry.size);
+        put32(e + offsetof(PakEntry, raw_size), items[i].entry.raw_size);
+        put32(e + offsetof(PakEntry, flags), items[i].entry.flags);
+        fwrite(e, 1, sizeof(e), f);
+    }
+    pos = sizeof(PakHeader) + (size_t)num_items * sizeof(PakEntry);
+    bool ok = true;
+    for (int i = 0; i < num_items; i++) {
+        pad_to(f, &pos, align);
+        ok &= fwrite(items[i].data, 1, items[i].entry.size, f) == items[i].entry.size;
+        pos += items[i].entry.size;
+        free(items[i].data);
+    }
+    ok &= fclose(f) == 0;
+    free(table);
+    free(items);
+    if (!ok) {
+        LOG_ERROR("Failed to write %s\n", out_path);
+        return 1;
+    }
+    LOG_INFO("Packed %d files into %s: %zu bytes, %zu stored\n", num_items, out_path, raw_total, stored_total);
+    return 0;
+}
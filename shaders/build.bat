@@ -1,14 +1,8 @@
 #/bin/bash 2>nul || goto :windows
-
-# bash
-echo hello Bash
-ls
-
-LANG="hlsl5:glsl430:wgsl"
-
-sokol-shdc -i shaders.glsl -o shaders.glsl.h --slang $LANG
-
-exit
+LANG="hlsl5:glsl430:glsl300es:wgsl:spirv_vk" #
+sokol-shdc -i shaders.glsl -o shaders.glsl.h --slang $LANG #
+sokol-shdc -i display.glsl -o display.glsl.h --slang $LANG #
+exit #
 
 :windows
 
@@ -30,6 +30,16 @@ vec3 lambert_light(vec3 v_pos, vec3 v_normal, vec3 viewpos, vec3 material_ambien
 }
 @end
 
+@block oct_normal
+//octahedral normal from two snorm components, the lower hemisphere is folded
+//over the diagonals. the encoder is _oct_encode in core.c
+vec3 oct_decode(vec2 e) {
+    float z = 1.0 - abs(e.x) - abs(e.y);
+    vec2 xy = e - (step(0.0, e) * 2.0 - 1.0) * max(-z, 0.0);
+    return normalize(vec3(xy, z));
+}
+@end
+
 @block dither
 float bayer4x4(vec2 pos) {
     int x = int(mod(pos.x, 4.0));
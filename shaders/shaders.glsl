@@ -75,34 +75,33 @@ out vec3 v_viewpos;
 
 @include_block vs_uniforms
 
-#define MAX_BONES 32
-layout(binding=1) uniform u_skeleton {
-    mat4 bones[MAX_BONES];
+//bone palette: every skinned entity gets a run of matrices in a float texture,
+//4 texels per matrix, starting at bone_base. see RenderContext.palette.
+@image_sample_type bone_tex unfilterable_float
+@sampler_type bone_smp nonfiltering
+layout(binding=1) uniform texture2D bone_tex;
+layout(binding=1) uniform sampler bone_smp;
+
+layout(binding=1) uniform u_skin {
+    int bone_base;
 };
 
-//SOKOL_GLES3 does not seem to do the trick(?)
-#ifdef SOKOL_GLSL
+#define PALETTE_WIDTH 1024
+
 mat4 get_bone(int index) {
-    for (int i = 0; i < MAX_BONES; i++) {
-        if (i == index) return bones[i];
-    }
-    return mat4(1.0);
+    int texel = (bone_base + index) * 4;
+    ivec2 uv = ivec2(texel % PALETTE_WIDTH, texel / PALETTE_WIDTH);
+    return mat4(texelFetch(sampler2D(bone_tex, bone_smp), uv, 0),
+                texelFetch(sampler2D(bone_tex, bone_smp), uv + ivec2(1, 0), 0),
+                texelFetch(sampler2D(bone_tex, bone_smp), uv + ivec2(2, 0), 0),
+                texelFetch(sampler2D(bone_tex, bone_smp), uv + ivec2(3, 0), 0));
 }
-#endif
 
 void main() {
-#ifdef SOKOL_GLSL
     mat4 skin_mat = weights.x * get_bone(int(bone_indices.x)) +
                     weights.y * get_bone(int(bone_indices.y)) +
                     weights.z * get_bone(int(bone_indices.z)) +
                     weights.w * get_bone(int(bone_indices.w));
-#else
-    uvec4 idx = bone_indices;
-    mat4 skin_mat = weights.x * bones[idx.x] +
-                    weights.y * bones[idx.y] +
-                    weights.z * bones[idx.z] +
-                    weights.w * bones[idx.w];
-#endif
 
     vec4 skinned_pos = skin_mat * vec4(position, 1.0);
     vec3 skinned_nrm = mat3(skin_mat) * normal;
@@ -117,6 +116,90 @@ void main() {
 }
 @end
 
+@vs tex_lit_instanced_vs
+layout(location=0) in vec3 position;
+layout(location=1) in vec3 normal;
+layout(location=2) in vec2 uv;
+layout(location=3) in vec4 inst_mtx0;
+layout(location=4) in vec4 inst_mtx1;
+layout(location=5) in vec4 inst_mtx2;
+layout(location=6) in vec4 inst_mtx3;
+
+out vec3 v_pos;
+out vec3 v_normal;
+out vec2 v_uv;
+out vec3 v_viewpos;
+
+@include_block vs_uniforms
+
+//model matrix comes from the per-instance stream, the uniform one is ignored
+void main() {
+    mat4 inst_model = mat4(inst_mtx0, inst_mtx1, inst_mtx2, inst_mtx3);
+    mat4 viewproj = proj * view;
+    vec4 world_pos = inst_model * vec4(position, 1.0);
+    gl_Position = viewproj * world_pos;
+    v_pos = world_pos.xyz;
+    v_viewpos = vec4(viewproj * vec4(v_pos, 1.0)).xyz;
+    v_normal = mat3(inst_model) * normal;
+    v_uv = uv;
+}
+@end
+
+//compact meshes (MESH_COMPACT): snorm16 positions inside the model's quantization
+//box, Model.dequant is already in the model or instance matrix. the normal is
+//octahedral encoded and gets unpacked here
+@vs tex_lit_compact_vs
+layout(location=0) in vec3 position;
+layout(location=1) in vec2 normal;
+layout(location=2) in vec2 uv;
+
+out vec3 v_pos;
+out vec3 v_normal;
+out vec2 v_uv;
+out vec3 v_viewpos;
+
+@include_block vs_uniforms
+@include_block oct_normal
+
+void main() {
+    gl_Position = proj * view * model * vec4(position, 1.0);
+    mat4 viewproj = proj * view;
+    v_pos = vec3(model * vec4(position, 1.0));
+    v_viewpos = vec4(viewproj * vec4(v_pos, 1.0)).xyz;
+    v_normal = mat3(model) * oct_decode(normal);
+    v_uv = uv;
+}
+@end
+
+@vs tex_lit_instanced_compact_vs
+layout(location=0) in vec3 position;
+layout(location=1) in vec2 normal;
+layout(location=2) in vec2 uv;
+layout(location=3) in vec4 inst_mtx0;
+layout(location=4) in vec4 inst_mtx1;
+layout(location=5) in vec4 inst_mtx2;
+layout(location=6) in vec4 inst_mtx3;
+
+out vec3 v_pos;
+out vec3 v_normal;
+out vec2 v_uv;
+out vec3 v_viewpos;
+
+@include_block vs_uniforms
+@include_block oct_normal
+
+void main() {
+    mat4 inst_model = mat4(inst_mtx0, inst_mtx1, inst_mtx2, inst_mtx3);
+    mat4 viewproj = proj * view;
+    vec4 world_pos = inst_model * vec4(position, 1.0);
+    gl_Position = viewproj * world_pos;
+    v_pos = world_pos.xyz;
+    v_viewpos = vec4(viewproj * vec4(v_pos, 1.0)).xyz;
+    v_normal = mat3(inst_model) * oct_decode(normal);
+    v_uv = uv;
+}
+@end
+
 @fs tex_lit_fs
 in vec3 v_pos;
 in vec3 v_normal;
@@ -142,3 +225,6 @@ void main() {
 
 @program tex_lit tex_lit_vs tex_lit_fs
 @program tex_lit_skinned tex_lit_skinned_vs tex_lit_fs
+@program tex_lit_instanced tex_lit_instanced_vs tex_lit_fs
+@program tex_lit_compact tex_lit_compact_vs tex_lit_fs
+@program tex_lit_instanced_compact tex_lit_instanced_compact_vs tex_lit_fs
@@ -0,0 +1,1054 @@
+//ahead-of-time compiler for game.wasm, translates the module to C that runs against the wa.h Module
+//usage: wa2c <in.wasm> <out.c>
+//build the output into a shared library next to lofi (see build_game_native.bat). lofi.c loads it when
+//the hash in it matches game.wasm, any other game.wasm (mods) keeps running in the interpreter.
+//memory, globals, the table and the imports stay in the Module wa_init set up, only the code is native.
+//the output expects a Module built with the default WA_* options or WA_GUARDMEM (no WA_ALLOW_GROW, WA_MAXALLOC, WA_NOFLOAT)
+#define WA_IMPLEMENTATION
+#include "deps/wa.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdbool.h>
+
+#define MAX_PARAMS 64
+
+typedef struct FuncType {
+    char params[MAX_PARAMS + 1]; //one of i l f d per param, zero terminated
+    char result;                 //0 = none
+} FuncType;
+
+typedef struct Func {
+    uint32_t type;
+    char name[64];      //import or export name, only for comments
+    uint32_t body, end; //code offsets, body = 0 for imports
+    char* locals;       //types of the params and locals
+    uint32_t local_count;
+} Func;
+
+typedef struct Reader {
+    const uint8_t* p;
+    uint32_t pos, size;
+    bool err;
+} Reader;
+
+typedef struct Buf {
+    char* p;
+    size_t len, cap;
+} Buf;
+
+//an open block while translating
+typedef struct Scope {
+    uint8_t op;      //0x02 block, 0x03 loop, 0x04 if, 0 function
+    char type;       //result type, 0 = none
+    uint32_t height; //operand stack height at entry
+    uint32_t label;
+    bool has_else;
+} Scope;
+
+typedef struct Gen {
+    Reader r;
+    FuncType* types;
+    uint32_t type_count;
+    Func* funcs;
+    uint32_t func_count, import_count;
+    char* globals; //global types
+    uint32_t global_count;
+    //per function state
+    Buf body;
+    char* stack;       //operand types
+    uint8_t* slots;    //used slot types per height, bit per type
+    uint32_t stack_cap;
+    Scope* ctrl;
+    uint32_t ctrl_cap;
+} Gen;
+
+static const char TYPES[] = "ilfd";
+static const char* CTYPES[] = { "uint32_t", "uint64_t", "float", "double" };
+static const char* FIELDS[] = { "u32", "u64", "f32", "f64" };
+
+static int type_index(char t) {
+    return (int)(strchr(TYPES, t) - TYPES);
+}
+
+static char valtype(uint8_t b) {
+    switch (b) {
+        case 0x7f: return 'i';
+        case 0x7e: return 'l';
+        case 0x7d: return 'f';
+        case 0x7c: return 'd';
+        default: return 0;
+    }
+}
+
+//--READING---------------------------------------------------------
+
+static uint8_t rd_u8(Reader* r) {
+    if (r->pos >= r->size) {
+        r->err = true;
+        return 0;
+    }
+    return r->p[r->pos++];
+}
+
+static uint64_t rd_leb(Reader* r, bool sign, uint32_t bits) {
+    uint64_t result = 0;
+    uint32_t shift = 0;
+    uint8_t byte;
+    do {
+        byte = rd_u8(r);
+        if (shift < 64) result |= (uint64_t)(byte & 0x7f) << shift;
+        shift += 7;
+    } while ((byte & 0x80) && !r->err);
+    if (sign && shift < 64 && (byte & 0x40)) result |= ~(uint64_t)0 << shift;
+    if (bits < 64 && !sign) result &= ((uint64_t)1 << bits) - 1;
+    return result;
+}
+
+static uint32_t rd_u32(Reader* r) {
+    return (uint32_t)rd_leb(r, false, 32);
+}
+
+static void rd_name(Reader* r, char* out, size_t size) {
+    uint32_t len = rd_u32(r);
+    if (r->pos + len > r->size) {
+        r->err = true;
+        return;
+    }
+    snprintf(out, size, "%.*s", (int)len, (const char*)r->p + r->pos);
+    r->pos += len;
+}
+
+//constant expressions of globals and segments, only the simple forms
+static void skip_init_expr(Reader* r) {
+    uint8_t op = rd_u8(r);
+    switch (op) {
+        case 0x41: case 0x42: case 0x23: rd_leb(r, true, 64); break;
+        case 0x43: r->pos += 4; break;
+        case 0x44: r->pos += 8; break;
+        default: r->err = true; break;
+    }
+    if (rd_u8(r) != 0x0b) r->err = true;
+}
+
+static bool parse(Gen* g) {
+    Reader* r = &g->r;
+    if (r->size < 8 || memcmp(r->p, "\0asm\1\0\0\0", 8)) {
+        fprintf(stderr, "Not a wasm binary\n");
+        return false;
+    }
+    r->pos = 8;
+    uint32_t defined = 0;
+    while (!r->err && r->pos < r->size) {
+        uint8_t id = rd_u8(r);
+        uint32_t len = rd_u32(r);
+        uint32_t next = r->pos + len;
+        switch (id) {
+            case 1: { //types
+                g->type_count = rd_u32(r);
+                g->types = calloc(g->type_count + 1, sizeof(FuncType));
+                for (uint32_t i = 0; i < g->type_count && !r->err; i++) {
+                    FuncType* t = &g->types[i];
+                    if (rd_u8(r) != 0x60) r->err = true;
+                    uint32_t n = rd_u32(r);
+                    if (n > MAX_PARAMS) {
+                        fprintf(stderr, "Too many params in type %u\n", i);
+                        return false;
+                    }
+                    for (uint32_t j = 0; j < n; j++) {
+                        t->params[j] = valtype(rd_u8(r));
+                        if (!t->params[j]) r->err = true;
+                    }
+                    n = rd_u32(r);
+                    if (n > 1) {
+                        fprintf(stderr, "Multi-value type %u not supported\n", i);
+                        return false;
+                    }
+                    if (n) t->result = valtype(rd_u8(r));
+                    if (n && !t->result) r->err = true;
+                }
+            } break;
+            case 2: { //imports
+                uint32_t count = rd_u32(r);
+                for (uint32_t i = 0; i < count && !r->err; i++) {
+                    char mod[64] = "", field[64] = "";
+                    rd_name(r, mod, sizeof(mod));
+                    rd_name(r, field, sizeof(field));
+                    uint8_t kind = rd_u8(r);
+                    switch (kind) {
+                        case 0: {
+                            g->funcs = realloc(g->funcs, (g->func_count + 1) * sizeof(Func));
+                            Func* f = &g->funcs[g->func_count++];
+                            memset(f, 0, sizeof(*f));
+                            f->type = rd_u32(r);
+                            snprintf(f->name, sizeof(f->name), "%s.%s", mod, field);
+                            g->import_count++;
+                        } break;
+                        case 1: rd_u8(r); if (rd_u8(r) & 1) rd_u32(r); rd_u32(r); break; //wa.h refuses these anyway
+                        case 2: if (rd_u8(r) & 1) rd_u32(r); rd_u32(r); break;
+                        case 3:
+                            g->globals = realloc(g->globals, g->global_count + 1);
+                            g->globals[g->global_count++] = valtype(rd_u8(r));
+                            rd_u8(r);
+                            break;
+                        default: r->err = true; break;
+                    }
+                }
+            } break;
+            case 3: { //functions
+                uint32_t count = rd_u32(r);
+                g->funcs = realloc(g->funcs, (g->func_count + count) * sizeof(Func));
+                for (uint32_t i = 0; i < count && !r->err; i++) {
+                    Func* f = &g->funcs[g->func_count++];
+                    memset(f, 0, sizeof(*f));
+                    f->type = rd_u32(r);
+                }
+            } break;
+            case 6: { //globals
+                uint32_t count = rd_u32(r);
+                g->globals = realloc(g->globals, g->global_count + count);
+                for (uint32_t i = 0; i < count && !r->err; i++) {
+                    g->globals[g->global_count++] = valtype(rd_u8(r));
+                    rd_u8(r);
+                    skip_init_expr(r);
+                }
+            } break;
+            case 7: { //exports, names for the comments
+                uint32_t count = rd_u32(r);
+                for (uint32_t i = 0; i < count && !r->err; i++) {
+                    char name[64] = "";
+                    rd_name(r, name, sizeof(name));
+                    uint8_t kind = rd_u8(r);
+                    uint32_t idx = rd_u32(r);
+                    if (kind == 0 && idx < g->func_count) memcpy(g->funcs[idx].name, name, sizeof(name));
+                }
+            } break;
+            case 10: { //code
+                uint32_t count = rd_u32(r);
+                for (uint32_t i = 0; i < count && !r->err; i++) {
+                    uint32_t size = rd_u32(r);
+                    uint32_t start = r->pos;
+                    uint32_t fidx = g->import_count + defined++;
+                    if (fidx >= g->func_count || g->funcs[fidx].type >= g->type_count) {
+                        r->err = true;
+                        break;
+                    }
+                    Func* f = &g->funcs[fidx];
+                    const char* params = g->types[f->type].params;
+                    uint32_t n = (uint32_t)strlen(params), decls = rd_u32(r);
+                    f->locals = malloc(n + 1);
+                    memcpy(f->locals, params, n);
+                    for (uint32_t j = 0; j < decls && !r->err; j++) {
+                        uint32_t num = rd_u32(r);
+                        char t = valtype(rd_u8(r));
+                        if (!t || num > 50000) {
+                            r->err = true;
+                            break;
+                        }
+                        f->locals = realloc(f->locals, n + num + 1);
+                        memset(f->locals + n, t, num);
+                        n += num;
+                    }
+                    f->local_count = n;
+                    f->body = r->pos;
+                    f->end = start + size - 1;
+                    r->pos = start + size;
+                }
+            } break;
+            default: break;
+        }
+        r->pos = next;
+    }
+    if (r->err || defined != g->func_count - g->import_count) {
+        fprintf(stderr, "Malformed wasm binary\n");
+        return false;
+    }
+    for (uint32_t i = 0; i < g->func_count; i++) {
+        if (g->funcs[i].type >= g->type_count) {
+            fprintf(stderr, "Bad type index in function %u\n", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+//--WRITING---------------------------------------------------------
+
+static void out(Buf* b, const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    if (b->len + n + 1 > b->cap) {
+        b->cap = (b->len + n + 1) * 2;
+        b->p = realloc(b->p, b->cap);
+    }
+    va_start(ap, fmt);
+    vsnprintf(b->p + b->len, n + 1, fmt, ap);
+    va_end(ap);
+    b->len += n;
+}
+
+//operand stack slots are named by height and type, so block results meet in the same variable
+static const char* slot(Gen* g, uint32_t h, char t) {
+    static char names[4][32];
+    static int next;
+    g->slots[h] |= (uint8_t)(1 << type_index(t));
+    char* s = names[next++ & 3];
+    snprintf(s, 32, "s%u_%c", h, t);
+    return s;
+}
+
+static const char* c_type(char t) {
+    return t ? CTYPES[type_index(t)] : "void";
+}
+
+static void params_decl(Buf* b, const FuncType* t, const char* prefix) {
+    size_t n = strlen(t->params);
+    if (!n) out(b, "void");
+    for (size_t i = 0; i < n; i++) {
+        out(b, "%s%s", i ? ", " : "", c_type(t->params[i]));
+        if (prefix) out(b, " %s%zu", prefix, i);
+    }
+}
+
+//signature id for call_indirect, functions with identical types share one
+static uint32_t sig_id(const Gen* g, uint32_t type) {
+    for (uint32_t i = 0; i < type; i++) {
+        if (!strcmp(g->types[i].params, g->types[type].params) && g->types[i].result == g->types[type].result) return i;
+    }
+    return type;
+}
+
+//numeric operators, $0 and $1 are the operands
+typedef struct NumOp {
+    uint8_t op;
+    const char* in;
+    char out;
+    const char* expr;
+} NumOp;
+
+static const NumOp NUMERIC[] = {
+    { 0x45, "i", 'i', "$0 == 0" }, { 0x46, "ii", 'i', "$0 == $1" }, { 0x47, "ii", 'i', "$0 != $1" },
+    { 0x48, "ii", 'i', "(int32_t)$0 < (int32_t)$1" }, { 0x49, "ii", 'i', "$0 < $1" },
+    { 0x4a, "ii", 'i', "(int32_t)$0 > (int32_t)$1" }, { 0x4b, "ii", 'i', "$0 > $1" },
+    { 0x4c, "ii", 'i', "(int32_t)$0 <= (int32_t)$1" }, { 0x4d, "ii", 'i', "$0 <= $1" },
+    { 0x4e, "ii", 'i', "(int32_t)$0 >= (int32_t)$1" }, { 0x4f, "ii", 'i', "$0 >= $1" },
+    { 0x50, "l", 'i', "$0 == 0" }, { 0x51, "ll", 'i', "$0 == $1" }, { 0x52, "ll", 'i', "$0 != $1" },
+    { 0x53, "ll", 'i', "(int64_t)$0 < (int64_t)$1" }, { 0x54, "ll", 'i', "$0 < $1" },
+    { 0x55, "ll", 'i', "(int64_t)$0 > (int64_t)$1" }, { 0x56, "ll", 'i', "$0 > $1" },
+    { 0x57, "ll", 'i', "(int64_t)$0 <= (int64_t)$1" }, { 0x58, "ll", 'i', "$0 <= $1" },
+    { 0x59, "ll", 'i', "(int64_t)$0 >= (int64_t)$1" }, { 0x5a, "ll", 'i', "$0 >= $1" },
+    { 0x5b, "ff", 'i', "$0 == $1" }, { 0x5c, "ff", 'i', "$0 != $1" }, { 0x5d, "ff", 'i', "$0 < $1" },
+    { 0x5e, "ff", 'i', "$0 > $1" }, { 0x5f, "ff", 'i', "$0 <= $1" }, { 0x60, "ff", 'i', "$0 >= $1" },
+    { 0x61, "dd", 'i', "$0 == $1" }, { 0x62, "dd", 'i', "$0 != $1" }, { 0x63, "dd", 'i', "$0 < $1" },
+    { 0x64, "dd", 'i', "$0 > $1" }, { 0x65, "dd", 'i', "$0 <= $1" }, { 0x66, "dd", 'i', "$0 >= $1" },
+    { 0x67, "i", 'i', "i32_clz($0)" }, { 0x68, "i", 'i', "i32_ctz($0)" }, { 0x69, "i", 'i', "i32_popcnt($0)" },
+    { 0x6a, "ii", 'i', "$0 + $1" }, { 0x6b, "ii", 'i', "$0 - $1" }, { 0x6c, "ii", 'i', "$0 * $1" },
+    { 0x6d, "ii", 'i', "i32_div_s($0, $1)" }, { 0x6e, "ii", 'i', "i32_div_u($0, $1)" },
+    { 0x6f, "ii", 'i', "i32_rem_s($0, $1)" }, { 0x70, "ii", 'i', "i32_rem_u($0, $1)" },
+    { 0x71, "ii", 'i', "$0 & $1" }, { 0x72, "ii", 'i', "$0 | $1" }, { 0x73, "ii", 'i', "$0 ^ $1" },
+    { 0x74, "ii", 'i', "$0 << ($1 & 31)" }, { 0x75, "ii", 'i', "(uint32_t)((int32_t)$0 >> ($1 & 31))" },
+    { 0x76, "ii", 'i', "$0 >> ($1 & 31)" }, { 0x77, "ii", 'i', "i32_rotl($0, $1)" }, { 0x78, "ii", 'i', "i32_rotr($0, $1)" },
+    { 0x79, "l", 'l', "i64_clz($0)" }, { 0x7a, "l", 'l', "i64_ctz($0)" }, { 0x7b, "l", 'l', "i64_popcnt($0)" },
+    { 0x7c, "ll", 'l', "$0 + $1" }, { 0x7d, "ll", 'l', "$0 - $1" }, { 0x7e, "ll", 'l', "$0 * $1" },
+    { 0x7f, "ll", 'l', "i64_div_s($0, $1)" }, { 0x80, "ll", 'l', "i64_div_u($0, $1)" },
+    { 0x81, "ll", 'l', "i64_rem_s($0, $1)" }, { 0x82, "ll", 'l', "i64_rem_u($0, $1)" },
+    { 0x83, "ll", 'l', "$0 & $1" }, { 0x84, "ll", 'l', "$0 | $1" }, { 0x85, "ll", 'l', "$0 ^ $1" },
+    { 0x86, "ll", 'l', "$0 << ($1 & 63)" }, { 0x87, "ll", 'l', "(uint64_t)((int64_t)$0 >> ($1 & 63))" },
+    { 0x88, "ll", 'l', "$0 >> ($1 & 63)" }, { 0x89, "ll", 'l', "i64_rotl($0, $1)" }, { 0x8a, "ll", 'l', "i64_rotr($0, $1)" },
+    { 0x8b, "f", 'f', "fabsf($0)" }, { 0x8c, "f", 'f', "-$0" }, { 0x8d, "f", 'f', "ceilf($0)" },
+    { 0x8e, "f", 'f', "floorf($0)" }, { 0x8f, "f", 'f', "truncf($0)" }, { 0x90, "f", 'f', "rintf($0)" },
+    { 0x91, "f", 'f', "sqrtf($0)" }, { 0x92, "ff", 'f', "$0 + $1" }, { 0x93, "ff", 'f', "$0 - $1" },
+    { 0x94, "ff", 'f', "$0 * $1" }, { 0x95, "ff", 'f', "$0 / $1" }, { 0x96, "ff", 'f', "f32_min($0, $1)" },
+    { 0x97, "ff", 'f', "f32_max($0, $1)" }, { 0x98, "ff", 'f', "copysignf($0, $1)" },
+    { 0x99, "d", 'd', "fabs($0)" }, { 0x9a, "d", 'd', "-$0" }, { 0x9b, "d", 'd', "ceil($0)" },
+    { 0x9c, "d", 'd', "floor($0)" }, { 0x9d, "d", 'd', "trunc($0)" }, { 0x9e, "d", 'd', "rint($0)" },
+    { 0x9f, "d", 'd', "sqrt($0)" }, { 0xa0, "dd", 'd', "$0 + $1" }, { 0xa1, "dd", 'd', "$0 - $1" },
+    { 0xa2, "dd", 'd', "$0 * $1" }, { 0xa3, "dd", 'd', "$0 / $1" }, { 0xa4, "dd", 'd', "f64_min($0, $1)" },
+    { 0xa5, "dd", 'd', "f64_max($0, $1)" }, { 0xa6, "dd", 'd', "copysign($0, $1)" },
+    { 0xa7, "l", 'i', "(uint32_t)$0" },
+    { 0xa8, "f", 'i', "i32_trunc_f32_s($0)" }, { 0xa9, "f", 'i', "i32_trunc_f32_u($0)" },
+    { 0xaa, "d", 'i', "i32_trunc_f64_s($0)" }, { 0xab, "d", 'i', "i32_trunc_f64_u($0)" },
+    { 0xac, "i", 'l', "(uint64_t)(int64_t)(int32_t)$0" }, { 0xad, "i", 'l', "(uint64_t)$0" },
+    { 0xae, "f", 'l', "i64_trunc_f32_s($0)" }, { 0xaf, "f", 'l', "i64_trunc_f32_u($0)" },
+    { 0xb0, "d", 'l', "i64_trunc_f64_s($0)" }, { 0xb1, "d", 'l', "i64_trunc_f64_u($0)" },
+    { 0xb2, "i", 'f', "(float)(int32_t)$0" }, { 0xb3, "i", 'f', "(float)$0" },
+    { 0xb4, "l", 'f', "(float)(int64_t)$0" }, { 0xb5, "l", 'f', "(float)$0" }, { 0xb6, "d", 'f', "(float)$0" },
+    { 0xb7, "i", 'd', "(double)(int32_t)$0" }, { 0xb8, "i", 'd', "(double)$0" },
+    { 0xb9, "l", 'd', "(double)(int64_t)$0" }, { 0xba, "l", 'd', "(double)$0" }, { 0xbb, "f", 'd', "(double)$0" },
+    { 0xbc, "f", 'i', "f32_bits($0)" }, { 0xbd, "d", 'l', "f64_bits($0)" },
+    { 0xbe, "i", 'f', "bits_f32($0)" }, { 0xbf, "l", 'd', "bits_f64($0)" },
+    { 0xc0, "i", 'i', "(uint32_t)(int32_t)(int8_t)$0" }, { 0xc1, "i", 'i', "(uint32_t)(int32_t)(int16_t)$0" },
+    { 0xc2, "l", 'l', "(uint64_t)(int64_t)(int8_t)$0" }, { 0xc3, "l", 'l', "(uint64_t)(int64_t)(int16_t)$0" },
+    { 0xc4, "l", 'l', "(uint64_t)(int64_t)(int32_t)$0" },
+};
+
+//loads 0x28..0x35 and stores 0x36..0x3e: value type and helper
+static const struct { char type; const char* name; } MEMOPS[] = {
+    { 'i', "i32_load" }, { 'l', "i64_load" }, { 'f', "f32_load" }, { 'd', "f64_load" },
+    { 'i', "i32_load8_s" }, { 'i', "i32_load8_u" }, { 'i', "i32_load16_s" }, { 'i', "i32_load16_u" },
+    { 'l', "i64_load8_s" }, { 'l', "i64_load8_u" }, { 'l', "i64_load16_s" }, { 'l', "i64_load16_u" },
+    { 'l', "i64_load32_s" }, { 'l', "i64_load32_u" },
+    { 'i', "i32_store" }, { 'l', "i64_store" }, { 'f', "f32_store" }, { 'd', "f64_store" },
+    { 'i', "i32_store8" }, { 'i', "i32_store16" }, { 'l', "i64_store8" }, { 'l', "i64_store16" }, { 'l', "i64_store32" },
+};
+
+static bool push(Gen* g, uint32_t* h, char t) {
+    if (*h + 1 >= g->stack_cap) {
+        uint32_t cap = g->stack_cap * 2 + 64;
+        g->stack = realloc(g->stack, cap);
+        g->slots = realloc(g->slots, cap);
+        memset(g->slots + g->stack_cap, 0, cap - g->stack_cap);
+        g->stack_cap = cap;
+    }
+    g->stack[(*h)++] = t;
+    return true;
+}
+
+//pops the operands of types in, checking them against the current block
+static bool pop(Gen* g, uint32_t* h, uint32_t top, const char* in) {
+    size_t n = strlen(in);
+    if (*h < g->ctrl[top].height + n) return false;
+    for (size_t i = 0; i < n; i++) {
+        if (g->stack[*h - n + i] != in[i]) return false;
+    }
+    *h -= (uint32_t)n;
+    return true;
+}
+
+static void indent(Gen* g, uint32_t top) {
+    out(&g->body, "%*s", (int)(top + 1) * 4, "");
+}
+
+//branch to an enclosing block: its result (if any) goes into the block's slot
+static bool branch(Gen* g, uint32_t h, const Scope* c) {
+    if (c->op != 0x03 && c->type) {
+        if (h < c->height + 1 || g->stack[h - 1] != c->type) return false;
+        if (h - 1 != c->height) out(&g->body, "%s = %s; ", slot(g, c->height, c->type), slot(g, h - 1, c->type));
+    }
+    out(&g->body, "goto L%u;", c->label);
+    return true;
+}
+
+static void call_args(Gen* g, uint32_t h, const FuncType* t) {
+    size_t n = strlen(t->params);
+    for (size_t i = 0; i < n; i++) out(&g->body, "%s%s", i ? ", " : "", slot(g, h + (uint32_t)i, t->params[i]));
+}
+
+static bool emit_func(Gen* g, Buf* o, uint32_t fidx) {
+    Reader* r = &g->r;
+    Func* f = &g->funcs[fidx];
+    const FuncType* ft = &g->types[f->type];
+    uint32_t h = 0, top = 0, labels = 1, skip = 0;
+    bool dead = false;
+
+    g->body.len = 0;
+    memset(g->slots, 0, g->stack_cap);
+    g->ctrl[0] = (Scope){ .op = 0, .type = ft->result, .height = 0, .label = 0 };
+    r->pos = f->body;
+
+    while (!r->err && r->pos <= f->end) {
+        uint32_t op = rd_u8(r);
+        if (op == 0xfc) op = 0xfc00 | rd_u32(r);
+        if (dead) {
+            //unreachable code is skipped up to the else / end of the current block
+            if (op == 0x02 || op == 0x03 || op == 0x04) skip++;
+            else if ((op == 0x05 || op == 0x0b) && skip) {
+                if (op == 0x0b) skip--;
+                op = 0x01;
+            }
+            if (op != 0x05 && op != 0x0b) {
+                //same immediates as the live path below, parsed into nowhere
+                switch (op) {
+                    case 0x02: case 0x03: case 0x04: rd_u8(r); break;
+                    case 0x0c: case 0x0d: case 0x10: case 0x12: case 0x20: case 0x21: case 0x22:
+                    case 0x23: case 0x24: case 0x3f: case 0x40: case 0x41: case 0xfc09: case 0xfc0b:
+                        rd_leb(r, true, 64); break;
+                    case 0x42: rd_leb(r, true, 64); break;
+                    case 0x43: r->pos += 4; break;
+                    case 0x44: r->pos += 8; break;
+                    case 0x0e: { uint32_t n = rd_u32(r); for (uint32_t i = 0; i <= n && !r->err; i++) rd_u32(r); } break;
+                    case 0x11: case 0x13: case 0xfc08: case 0xfc0a: rd_u32(r); rd_u32(r); break;
+                    case 0x1c: { uint32_t n = rd_u32(r); r->pos += n; } break;
+                    default:
+                        if (op >= 0x28 && op <= 0x3e) { rd_u32(r); rd_u32(r); }
+                        break;
+                }
+                continue;
+            }
+        }
+        bool was_dead = dead;
+        dead = false;
+        Scope* c = &g->ctrl[top];
+        switch (op) {
+            case 0x00: //unreachable
+                indent(g, top); out(&g->body, "trap(WA_ERR_UD);\n");
+                dead = true;
+                break;
+            case 0x01: //nop
+                break;
+            case 0x02: case 0x03: case 0x04: { //block, loop, if
+                uint8_t bt = rd_u8(r);
+                char t = bt == 0x40 ? 0 : valtype(bt);
+                if (bt != 0x40 && !t) {
+                    fprintf(stderr, "Block type 0x%x not supported\n", bt);
+                    return false;
+                }
+                if (op == 0x04 && !pop(g, &h, top, "i")) return false;
+                if (top + 2 >= g->ctrl_cap) {
+                    g->ctrl_cap = g->ctrl_cap * 2 + 16;
+                    g->ctrl = realloc(g->ctrl, g->ctrl_cap * sizeof(Scope));
+                }
+                indent(g, top);
+                if (op == 0x03) out(&g->body, "L%u:;\n", labels);
+                else if (op == 0x04) out(&g->body, "if (%s) {\n", slot(g, h, 'i'));
+                else out(&g->body, "{\n");
+                g->ctrl[++top] = (Scope){ .op = (uint8_t)op, .type = t, .height = h, .label = labels++ };
+            } break;
+            case 0x05: //else
+                if (c->op != 0x04 || c->has_else) return false;
+                if (!was_dead && (h != c->height + (c->type ? 1 : 0) || (c->type && g->stack[h - 1] != c->type))) return false;
+                indent(g, top - 1); out(&g->body, "} else {\n");
+                c->has_else = true;
+                h = c->height;
+                break;
+            case 0x0b: //end
+                if (!was_dead && (h != c->height + (c->type ? 1 : 0) || (c->type && g->stack[h - 1] != c->type))) return false;
+                h = c->height;
+                if (c->type) push(g, &h, c->type);
+                if (!top) {
+                    if (r->pos - 1 != f->end) return false;
+                    out(&g->body, "L0:;\n    RETURN(%s);\n", ft->result ? slot(g, 0, ft->result) : "");
+                    goto done;
+                }
+                if (c->op == 0x04 && c->type && !c->has_else) return false;
+                if (c->op != 0x03) {
+                    indent(g, top - 1); out(&g->body, "}\n");
+                    indent(g, top - 1); out(&g->body, "L%u:;\n", c->label);
+                }
+                top--;
+                break;
+            case 0x0c: { //br
+                uint32_t depth = rd_u32(r);
+                if (depth > top) return false;
+                indent(g, top);
+                if (!branch(g, h, &g->ctrl[top - depth])) return false;
+                out(&g->body, "\n");
+                dead = true;
+            } break;
+            case 0x0d: { //br_if
+                uint32_t depth = rd_u32(r);
+                if (depth > top || !pop(g, &h, top, "i")) return false;
+                indent(g, top); out(&g->body, "if (%s) { ", slot(g, h, 'i'));
+                if (!branch(g, h, &g->ctrl[top - depth])) return false;
+                out(&g->body, " }\n");
+            } break;
+            case 0x0e: { //br_table
+                uint32_t n = rd_u32(r);
+                if (!pop(g, &h, top, "i")) return false;
+                indent(g, top); out(&g->body, "switch (%s) {\n", slot(g, h, 'i'));
+                for (uint32_t i = 0; i <= n && !r->err; i++) {
+                    uint32_t depth = rd_u32(r);
+                    if (depth > top) return false;
+                    indent(g, top);
+                    if (i < n) out(&g->body, "case %u: ", i);
+                    else out(&g->body, "default: ");
+                    if (!branch(g, h, &g->ctrl[top - depth])) return false;
+                    out(&g->body, "\n");
+                }
+                indent(g, top); out(&g->body, "}\n");
+                dead = true;
+            } break;
+            case 0x0f: //return
+                if (ft->result && (h < g->ctrl[top].height + 1 || g->stack[h - 1] != ft->result)) return false;
+                indent(g, top); out(&g->body, "RETURN(%s);\n", ft->result ? slot(g, h - 1, ft->result) : "");
+                dead = true;
+                break;
+            case 0x10: case 0x12: //call, return_call
+            case 0x11: case 0x13: { //call_indirect, return_call_indirect
+                uint32_t idx = rd_u32(r);
+                bool indirect = op == 0x11 || op == 0x13;
+                if (indirect) rd_u32(r);
+                if (indirect ? idx >= g->type_count : idx >= g->func_count) return false;
+                const FuncType* t = indirect ? &g->types[idx] : &g->types[g->funcs[idx].type];
+                uint32_t target = 0;
+                if (indirect) {
+                    if (!pop(g, &h, top, "i")) return false;
+                    target = h;
+                }
+                if (!pop(g, &h, top, t->params)) return false;
+                indent(g, top);
+                if (t->result) out(&g->body, "%s = ", slot(g, h, t->result));
+                if (indirect) {
+                    out(&g->body, "((%s (*)(", c_type(t->result));
+                    params_decl(&g->body, t, NULL);
+                    out(&g->body, "))call_ref(%s, %u))(", slot(g, target, 'i'), sig_id(g, idx));
+                } else {
+                    out(&g->body, "f%u(", idx);
+                }
+                call_args(g, h, t);
+                out(&g->body, ");\n");
+                if (t->result) push(g, &h, t->result);
+                if (op == 0x12 || op == 0x13) {
+                    if (t->result != ft->result) return false;
+                    indent(g, top); out(&g->body, "RETURN(%s);\n", ft->result ? slot(g, h - 1, ft->result) : "");
+                    dead = true;
+                }
+            } break;
+            case 0x1a: //drop
+                if (h <= c->height) return false;
+                h--;
+                break;
+            case 0x1b: case 0x1c: { //select, typed select
+                if (op == 0x1c) {
+                    uint32_t n = rd_u32(r);
+                    r->pos += n;
+                }
+                if (!pop(g, &h, top, "i") || h < c->height + 2 || g->stack[h - 1] != g->stack[h - 2]) return false;
+                char t = g->stack[h - 1];
+                indent(g, top);
+                out(&g->body, "if (!%s) ", slot(g, h, 'i'));
+                out(&g->body, "%s = ", slot(g, h - 2, t));
+                out(&g->body, "%s;\n", slot(g, h - 1, t));
+                h--;
+            } break;
+            case 0x20: case 0x21: case 0x22: { //local.get, local.set, local.tee
+                uint32_t idx = rd_u32(r);
+                if (idx >= f->local_count) return false;
+                char t = f->locals[idx];
+                indent(g, top);
+                if (op == 0x20) {
+                    out(&g->body, "%s = l%u;\n", slot(g, h, t), idx);
+                    push(g, &h, t);
+                } else {
+                    char in[2] = { t, 0 };
+                    if (!pop(g, &h, top, in)) return false;
+                    out(&g->body, "l%u = %s;\n", idx, slot(g, h, t));
+                    if (op == 0x22) push(g, &h, t);
+                }
+            } break;
+            case 0x23: case 0x24: { //global.get, global.set
+                uint32_t idx = rd_u32(r);
+                if (idx >= g->global_count || !g->globals[idx]) return false;
+                char t = g->globals[idx];
+                indent(g, top);
+                if (op == 0x23) {
+                    out(&g->body, "%s = G(%u, %s);\n", slot(g, h, t), idx, c_type(t));
+                    push(g, &h, t);
+                } else {
+                    char in[2] = { t, 0 };
+                    if (!pop(g, &h, top, in)) return false;
+                    out(&g->body, "G(%u, %s) = %s;\n", idx, c_type(t), slot(g, h, t));
+                }
+            } break;
+            case 0x3f: //memory.size
+                rd_u32(r);
+                indent(g, top); out(&g->body, "%s = mem_pages();\n", slot(g, h, 'i'));
+                push(g, &h, 'i');
+                break;
+            case 0x40: //memory.grow
+                rd_u32(r);
+                if (!pop(g, &h, top, "i")) return false;
+                indent(g, top); out(&g->body, "%s = mem_grow(%s);\n", slot(g, h, 'i'), slot(g, h, 'i'));
+                push(g, &h, 'i');
+                break;
+            case 0x41: { //i32.const
+                uint32_t v = (uint32_t)rd_leb(r, true, 32);
+                indent(g, top); out(&g->body, "%s = %uu;\n", slot(g, h, 'i'), v);
+                push(g, &h, 'i');
+            } break;
+            case 0x42: { //i64.const
+                uint64_t v = rd_leb(r, true, 64);
+                indent(g, top); out(&g->body, "%s = UINT64_C(%llu);\n", slot(g, h, 'l'), (unsigned long long)v);
+                push(g, &h, 'l');
+            } break;
+            case 0x43: { //f32.const, by bits so nan payloads and -0 survive
+                uint32_t v;
+                if (r->pos + 4 > r->size) return false;
+                memcpy(&v, r->p + r->pos, 4);
+                r->pos += 4;
+                indent(g, top); out(&g->body, "%s = bits_f32(0x%08xu);\n", slot(g, h, 'f'), v);
+                push(g, &h, 'f');
+            } break;
+            case 0x44: { //f64.const
+                uint64_t v;
+                if (r->pos + 8 > r->size) return false;
+                memcpy(&v, r->p + r->pos, 8);
+                r->pos += 8;
+                indent(g, top); out(&g->body, "%s = bits_f64(UINT64_C(0x%016llx));\n", slot(g, h, 'd'), (unsigned long long)v);
+                push(g, &h, 'd');
+            } break;
+            case 0xfc08: { //memory.init
+                uint32_t seg = rd_u32(r);
+                rd_u32(r);
+                if (!pop(g, &h, top, "iii")) return false;
+                indent(g, top);
+                out(&g->body, "mem_init(%u, %s, ", seg, slot(g, h, 'i'));
+                out(&g->body, "%s, ", slot(g, h + 1, 'i'));
+                out(&g->body, "%s);\n", slot(g, h + 2, 'i'));
+            } break;
+            case 0xfc09: //data.drop
+                indent(g, top); out(&g->body, "data_drop(%u);\n", rd_u32(r));
+                break;
+            case 0xfc0a: case 0xfc0b: //memory.copy, memory.fill
+                rd_u32(r);
+                if (op == 0xfc0a) rd_u32(r);
+                if (!pop(g, &h, top, "iii")) return false;
+                indent(g, top);
+                out(&g->body, "%s(%s, ", op == 0xfc0a ? "mem_copy" : "mem_fill", slot(g, h, 'i'));
+                out(&g->body, "%s, ", slot(g, h + 1, 'i'));
+                out(&g->body, "%s);\n", slot(g, h + 2, 'i'));
+                break;
+            default:
+                if (op >= 0x28 && op <= 0x3e) { //loads and stores
+                    rd_u32(r);
+                    uint64_t offset = rd_leb(r, false, 64);
+                    char t = MEMOPS[op - 0x28].type;
+                    const char* name = MEMOPS[op - 0x28].name;
+                    if (offset > 0xffffffffu) return false;
+                    indent(g, top);
+                    if (op <= 0x35) {
+                        if (!pop(g, &h, top, "i")) return false;
+                        out(&g->body, "%s = ", slot(g, h, t));
+                        out(&g->body, "%s((uint64_t)%s + %lluu);\n", name, slot(g, h, 'i'), (unsigned long long)offset);
+                        push(g, &h, t);
+                    } else {
+                        char in[3] = { 'i', t, 0 };
+                        if (!pop(g, &h, top, in)) return false;
+                        out(&g->body, "%s((uint64_t)%s + %lluu, ", name, slot(g, h, 'i'), (unsigned long long)offset);
+                        out(&g->body, "%s);\n", slot(g, h + 1, t));
+                    }
+                    break;
+                }
+                const NumOp* n = NULL;
+                for (size_t i = 0; i < sizeof(NUMERIC) / sizeof(NUMERIC[0]); i++) {
+                    if (NUMERIC[i].op == op) {
+                        n = &NUMERIC[i];
+                        break;
+                    }
+                }
+                if (!n) {
+                    fprintf(stderr, "Opcode 0x%x not supported (function %u)\n", op, fidx);
+                    return false;
+                }
+                if (!pop(g, &h, top, n->in)) return false;
+                indent(g, top);
+                out(&g->body, "%s = ", slot(g, h, n->out));
+                for (const char* e = n->expr; *e; e++) {
+                    if (*e == '$') {
+                        e++;
+                        out(&g->body, "%s", slot(g, h + (uint32_t)(*e - '0'), n->in[*e - '0']));
+                    } else {
+                        out(&g->body, "%c", *e);
+                    }
+                }
+                out(&g->body, ";\n");
+                push(g, &h, n->out);
+                break;
+        }
+    }
+    return false;
+
+done:
+    //signature, locals and the slots used, then the body
+    out(o, "static %s f%u(", c_type(ft->result), fidx);
+    size_t params = strlen(ft->params);
+    if (!params) out(o, "void");
+    for (size_t i = 0; i < params; i++) out(o, "%s%s l%zu", i ? ", " : "", c_type(ft->params[i]), i);
+    out(o, ") {%s%s\n", f->name[0] ? " //" : "", f->name);
+    for (uint32_t i = (uint32_t)params; i < f->local_count; i++) out(o, "    %s l%u = 0;\n", c_type(f->locals[i]), i);
+    for (uint32_t i = 0; i < g->stack_cap; i++) {
+        for (int t = 0; t < 4; t++) {
+            if (g->slots[i] & (1 << t)) out(o, "    %s s%u_%c = 0;\n", CTYPES[t], i, TYPES[t]);
+        }
+    }
+    out(o, "    ENTER();\n%.*s}\n\n", (int)g->body.len, g->body.p);
+    return true;
+}
+
+//runtime of the generated code, the Module wa_init set up holds all state
+static const char PRELUDE[] =
+    "#include \"deps/wa.h\"\n"
+    "#include <string.h>\n"
+    "#include <math.h>\n"
+    "#include <setjmp.h>\n"
+    "\n"
+    "#if defined(__GNUC__) || defined(__clang__)\n"
+    "#pragma GCC diagnostic ignored \"-Wunused-label\"\n"
+    "#pragma GCC diagnostic ignored \"-Wunused-variable\"\n"
+    "#pragma GCC diagnostic ignored \"-Wunused-but-set-variable\"\n"
+    "#pragma GCC diagnostic ignored \"-Wunused-function\"\n"
+    "#endif\n"
+    "#if defined(__GNUC__) && !defined(__clang__)\n"
+    "#pragma GCC diagnostic ignored \"-Wclobbered\" //slots of inlined functions, dead after a trap\n"
+    "#endif\n"
+    "#ifdef _WIN32\n"
+    "#define EXPORT __declspec(dllexport)\n"
+    "#else\n"
+    "#define EXPORT __attribute__((visibility(\"default\")))\n"
+    "#endif\n"
+    "\n"
+    "#define PAGE_SIZE 65536 //WA_PAGESIZE\n"
+    "#define MAX_DEPTH 50000 //wasm calls before the stack overflow trap\n"
+    "\n"
+    "extern WaNative wa_native_module;\n"
+    "static Module* M;\n"
+    "static uint8_t* mem;\n"
+    "static uint64_t mem_start, mem_limit;\n"
+    "static jmp_buf* trap_jmp;\n"
+    "static uint32_t depth;\n"
+    "\n"
+    "_Noreturn static void trap(int err) {\n"
+    "    M->err_code = err;\n"
+    "    M->err_pc = 0;\n"
+    "    longjmp(*trap_jmp, 1);\n"
+    "}\n"
+    "\n"
+    "#define ENTER() if (++depth > MAX_DEPTH) trap(WA_ERR_BOUND)\n"
+    "#define RETURN(x) do { depth--; return x; } while (0)\n"
+    "#define G(i, T) (*(T*)(uintptr_t)(M->gptrs[i] & ~(uint64_t)1)) //WA_GMSK\n"
+    "\n"
+    "static void mem_reload(void) {\n"
+    "    mem = M->memory[0].bytes - M->memory[0].start;\n"
+    "    mem_start = M->memory[0].start;\n"
+    "    mem_limit = M->memory[0].limit;\n"
+    "}\n"
+    "\n"
+    "//same bounds as wa_read_addr\n"
+    "static inline uint8_t* mem_at(uint64_t a, uint64_t n) {\n"
+    "    if (a < mem_start || a + n > mem_limit) trap(WA_ERR_BOUND);\n"
+    "    return mem + a;\n"
+    "}\n"
+    "\n"
+    "static uint32_t mem_pages(void) { return (uint32_t)((M->memory[0].size + PAGE_SIZE - 1) / PAGE_SIZE); }\n"
+    "static uint32_t mem_grow(uint32_t n) {\n"
+    "    uint32_t r = wa_native_module.grow(M, n);\n"
+    "    if (M->err_code) trap(M->err_code);\n"
+    "    mem_reload();\n"
+    "    return r;\n"
+    "}\n"
+    "static void mem_fill(uint32_t d, uint32_t v, uint32_t n) { uint8_t* p = mem_at(d, n); if (n) memset(p, (int)v, n); }\n"
+    "static void mem_copy(uint32_t d, uint32_t s, uint32_t n) {\n"
+    "    uint8_t* src = mem_at(s, n);\n"
+    "    uint8_t* dst = mem_at(d, n);\n"
+    "    if (n && src != dst) memmove(dst, src, n);\n"
+    "}\n"
+    "static void mem_init(uint32_t seg, uint32_t d, uint32_t s, uint32_t n) {\n"
+    "    uint8_t* dst = mem_at(d, n);\n"
+    "    if (seg >= M->segs_count || !M->segs || s + n >= M->segs[seg].size) trap(WA_ERR_BOUND);\n"
+    "    memcpy(dst, M->bytes + M->segs[seg].start + s, n);\n"
+    "}\n"
+    "static void data_drop(uint32_t seg) { if (seg < M->segs_count && M->segs) M->segs[seg].size = 0; }\n"
+    "\n"
+    "#define LOAD(name, T, R, conv) static inline R name(uint64_t a) { T v; memcpy(&v, mem_at(a, sizeof(T)), sizeof(T)); return (R)conv; }\n"
+    "LOAD(i32_load, uint32_t, uint32_t, v)\n"
+    "LOAD(i64_load, uint64_t, uint64_t, v)\n"
+    "LOAD(f32_load, float, float, v)\n"
+    "LOAD(f64_load, double, double, v)\n"
+    "LOAD(i32_load8_s, int8_t, uint32_t, (int32_t)v)\n"
+    "LOAD(i32_load8_u, uint8_t, uint32_t, v)\n"
+    "LOAD(i32_load16_s, int16_t, uint32_t, (int32_t)v)\n"
+    "LOAD(i32_load16_u, uint16_t, uint32_t, v)\n"
+    "LOAD(i64_load8_s, int8_t, uint64_t, (int64_t)v)\n"
+    "LOAD(i64_load8_u, uint8_t, uint64_t, v)\n"
+    "LOAD(i64_load16_s, int16_t, uint64_t, (int64_t)v)\n"
+    "LOAD(i64_load16_u, uint16_t, uint64_t, v)\n"
+    "LOAD(i64_load32_s, int32_t, uint64_t, (int64_t)v)\n"
+    "LOAD(i64_load32_u, uint32_t, uint64_t, v)\n"
+    "#define STORE(name, V, T) static inline void name(uint64_t a, V x) { T v = (T)x; memcpy(mem_at(a, sizeof(T)), &v, sizeof(T)); }\n"
+    "STORE(i32_store, uint32_t, uint32_t)\n"
+    "STORE(i64_store, uint64_t, uint64_t)\n"
+    "STORE(f32_store, float, float)\n"
+    "STORE(f64_store, double, double)\n"
+    "STORE(i32_store8, uint32_t, uint8_t)\n"
+    "STORE(i32_store16, uint32_t, uint16_t)\n"
+    "STORE(i64_store8, uint64_t, uint8_t)\n"
+    "STORE(i64_store16, uint64_t, uint16_t)\n"
+    "STORE(i64_store32, uint64_t, uint32_t)\n"
+    "\n"
+    "static inline uint32_t f32_bits(float x) { uint32_t v; memcpy(&v, &x, 4); return v; }\n"
+    "static inline uint64_t f64_bits(double x) { uint64_t v; memcpy(&v, &x, 8); return v; }\n"
+    "static inline float bits_f32(uint32_t x) { float v; memcpy(&v, &x, 4); return v; }\n"
+    "static inline double bits_f64(uint64_t x) { double v; memcpy(&v, &x, 8); return v; }\n"
+    "\n"
+    "static inline uint32_t i32_clz(uint32_t a) { return a ? (uint32_t)__builtin_clz(a) : 32; }\n"
+    "static inline uint32_t i32_ctz(uint32_t a) { return a ? (uint32_t)__builtin_ctz(a) : 32; }\n"
+    "static inline uint32_t i32_popcnt(uint32_t a) { return (uint32_t)__builtin_popcount(a); }\n"
+    "static inline uint64_t i64_clz(uint64_t a) { return a ? (uint64_t)__builtin_clzll(a) : 64; }\n"
+    "static inline uint64_t i64_ctz(uint64_t a) { return a ? (uint64_t)__builtin_ctzll(a) : 64; }\n"
+    "static inline uint64_t i64_popcnt(uint64_t a) { return (uint64_t)__builtin_popcountll(a); }\n"
+    "static inline uint32_t i32_rotl(uint32_t a, uint32_t b) { b &= 31; return (a << b) | (a >> ((32 - b) & 31)); }\n"
+    "static inline uint32_t i32_rotr(uint32_t a, uint32_t b) { b &= 31; return (a >> b) | (a << ((32 - b) & 31)); }\n"
+    "static inline uint64_t i64_rotl(uint64_t a, uint64_t b) { b &= 63; return (a << b) | (a >> ((64 - b) & 63)); }\n"
+    "static inline uint64_t i64_rotr(uint64_t a, uint64_t b) { b &= 63; return (a >> b) | (a << ((64 - b) & 63)); }\n"
+    "\n"
+    "static inline uint32_t i32_div_s(uint32_t a, uint32_t b) {\n"
+    "    if (!b || (a == 0x80000000u && b == 0xffffffffu)) trap(WA_ERR_ARITH);\n"
+    "    return (uint32_t)((int32_t)a / (int32_t)b);\n"
+    "}\n"
+    "static inline uint32_t i32_div_u(uint32_t a, uint32_t b) { if (!b) trap(WA_ERR_ARITH); return a / b; }\n"
+    "static inline uint32_t i32_rem_s(uint32_t a, uint32_t b) {\n"
+    "    if (!b) trap(WA_ERR_ARITH);\n"
+    "    return b == 0xffffffffu ? 0 : (uint32_t)((int32_t)a % (int32_t)b);\n"
+    "}\n"
+    "static inline uint32_t i32_rem_u(uint32_t a, uint32_t b) { if (!b) trap(WA_ERR_ARITH); return a % b; }\n"
+    "static inline uint64_t i64_div_s(uint64_t a, uint64_t b) {\n"
+    "    if (!b || (a == UINT64_C(0x8000000000000000) && b == ~UINT64_C(0))) trap(WA_ERR_ARITH);\n"
+    "    return (uint64_t)((int64_t)a / (int64_t)b);\n"
+    "}\n"
+    "static inline uint64_t i64_div_u(uint64_t a, uint64_t b) { if (!b) trap(WA_ERR_ARITH); return a / b; }\n"
+    "static inline uint64_t i64_rem_s(uint64_t a, uint64_t b) {\n"
+    "    if (!b) trap(WA_ERR_ARITH);\n"
+    "    return b == ~UINT64_C(0) ? 0 : (uint64_t)((int64_t)a % (int64_t)b);\n"
+    "}\n"
+    "static inline uint64_t i64_rem_u(uint64_t a, uint64_t b) { if (!b) trap(WA_ERR_ARITH); return a % b; }\n"
+    "\n"
+    "//nan and -0 handling like f32_min / f32_max in wa.h\n"
+    "static inline float f32_min(float a, float b) { if (a != a || b != b) return NAN; if (a == 0 && a == b) return signbit(a) ? a : b; return a < b ? a : b; }\n"
+    "static inline float f32_max(float a, float b) { if (a != a || b != b) return NAN; if (a == 0 && a == b) return signbit(a) ? b : a; return a > b ? a : b; }\n"
+    "static inline double f64_min(double a, double b) { if (a != a || b != b) return NAN; if (a == 0 && a == b) return signbit(a) ? a : b; return a < b ? a : b; }\n"
+    "static inline double f64_max(double a, double b) { if (a != a || b != b) return NAN; if (a == 0 && a == b) return signbit(a) ? b : a; return a > b ? a : b; }\n"
+    "\n"
+    "//same range checks as wa_run\n"
+    "#define TRUNC(name, F, R, T, ovf) static inline R name(F x) { if (x != x || (ovf)) trap(WA_ERR_ARITH); return (R)(T)x; }\n"
+    "TRUNC(i32_trunc_f32_s, float, uint32_t, int32_t, x >= (float)INT32_MAX || x < INT32_MIN)\n"
+    "TRUNC(i32_trunc_f32_u, float, uint32_t, uint32_t, x >= (float)UINT32_MAX || x <= -1)\n"
+    "TRUNC(i32_trunc_f64_s, double, uint32_t, int32_t, x > (double)INT32_MAX || x < INT32_MIN)\n"
+    "TRUNC(i32_trunc_f64_u, double, uint32_t, uint32_t, x > (double)UINT32_MAX || x <= -1)\n"
+    "TRUNC(i64_trunc_f32_s, float, uint64_t, int64_t, x >= (float)INT64_MAX || x < INT64_MIN)\n"
+    "TRUNC(i64_trunc_f32_u, float, uint64_t, uint64_t, x >= (double)UINT64_MAX || x <= -1)\n"
+    "TRUNC(i64_trunc_f64_s, double, uint64_t, int64_t, x >= (double)INT64_MAX || x < INT64_MIN)\n"
+    "TRUNC(i64_trunc_f64_u, double, uint64_t, uint64_t, x >= (double)UINT64_MAX || x <= -1)\n"
+    "\n"
+    "//entering native code from wa_call, nested when an import calls back into the module\n"
+    "typedef struct Outer { Module* m; jmp_buf* jmp; uint32_t depth; } Outer;\n"
+    "static void enter(Module* m, Outer* o, jmp_buf* jmp) {\n"
+    "    o->m = M; o->jmp = trap_jmp; o->depth = depth;\n"
+    "    M = m; trap_jmp = jmp;\n"
+    "    mem_reload();\n"
+    "}\n"
+    "static void leave(const Outer* o) {\n"
+    "    M = o->m; trap_jmp = o->jmp; depth = o->depth;\n"
+    "    if (M) mem_reload();\n"
+    "}\n"
+    "\n"
+    "typedef void (*fn_t)(void);\n"
+    "static fn_t call_ref(uint32_t i, uint32_t sig);\n"
+    "\n";
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: wa2c <in.wasm> <out.c>\n");
+        return 1;
+    }
+    FILE* in = fopen(argv[1], "rb");
+    if (!in) {
+        fprintf(stderr, "Failed to open %s\n", argv[1]);
+        return 1;
+    }
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    uint8_t* bytes = malloc(size > 0 ? (size_t)size : 1);
+    if (!bytes || size <= 0 || fread(bytes, 1, (size_t)size, in) != (size_t)size) {
+        fprintf(stderr, "Failed to read %s\n", argv[1]);
+        fclose(in);
+        return 1;
+    }
+    fclose(in);
+
+    Gen g = { .r = { .p = bytes, .size = (uint32_t)size } };
+    if (!parse(&g)) return 1;
+
+    Buf o = {0};
+    out(&o, "//generated by wa2c from %s, do not edit\n", argv[1]);
+    out(&o, "%s", PRELUDE);
+
+    //prototypes, every function has a typed C version
+    for (uint32_t i = 0; i < g.func_count; i++) {
+        const FuncType* t = &g.types[g.funcs[i].type];
+        out(&o, "static %s f%u(", c_type(t->result), i);
+        params_decl(&o, t, "a");
+        out(&o, ");\n");
+    }
+
+    //imports go through the host call of wa.h
+    out(&o, "\n");
+    for (uint32_t i = 0; i < g.import_count; i++) {
+        const FuncType* t = &g.types[g.funcs[i].type];
+        size_t n = strlen(t->params);
+        out(&o, "static %s f%u(", c_type(t->result), i);
+        params_decl(&o, t, "a");
+        out(&o, ") { //%s\n    StackValue args[%zu] = {0};\n", g.funcs[i].name, n + 1);
+        for (size_t j = 0; j < n; j++) out(&o, "    args[%zu].%s = a%zu;\n", j, FIELDS[type_index(t->params[j])], j);
+        out(&o, "    StackValue ret = wa_native_module.host(M, %u, args);\n", i);
+        out(&o, "    if (M->err_code) trap(M->err_code);\n    mem_reload();\n");
+        if (t->result) out(&o, "    return ret.%s;\n", FIELDS[type_index(t->result)]);
+        else out(&o, "    (void)ret;\n");
+        out(&o, "}\n\n");
+    }
+
+    g.stack_cap = 64;
+    g.stack = malloc(g.stack_cap);
+    g.slots = calloc(g.stack_cap, 1);
+    g.ctrl_cap = 64;
+    g.ctrl = malloc(g.ctrl_cap * sizeof(Scope));
+    for (uint32_t i = g.import_count; i < g.func_count; i++) {
+        if (!emit_func(&g, &o, i)) {
+            fprintf(stderr, "Failed to translate function %u %s (at 0x%x)\n", i, g.funcs[i].name, g.r.pos);
+            return 1;
+        }
+    }
+
+    //call_indirect checks the signature, wasm traps on a mismatch
+    out(&o, "static const fn_t ftab[%u] = {\n", g.func_count);
+    for (uint32_t i = 0; i < g.func_count; i++) out(&o, "    (fn_t)f%u,\n", i);
+    out(&o, "};\nstatic const uint32_t fsig[%u] = {\n    ", g.func_count);
+    for (uint32_t i = 0; i < g.func_count; i++) out(&o, "%u,%s", sig_id(&g, g.funcs[i].type), (i % 16 == 15) ? "\n    " : " ");
+    out(&o, "\n};\n\n");
+    out(&o, "static fn_t call_ref(uint32_t i, uint32_t sig) {\n"
+            "    uint32_t f;\n"
+            "    if (i >= M->table.size || (f = M->table.entries[i]) >= %u) trap(WA_ERR_BOUND);\n"
+            "    if (fsig[f] != sig) trap(WA_ERR_PROTO);\n"
+            "    return ftab[f];\n"
+            "}\n\n", g.func_count);
+
+    //stack based entries for wa_call
+    for (uint32_t i = g.import_count; i < g.func_count; i++) {
+        const FuncType* t = &g.types[g.funcs[i].type];
+        size_t n = strlen(t->params);
+        out(&o, "static StackValue e%u(Module* m, StackValue* a) {\n"
+                "    StackValue r = {0};\n"
+                "    Outer o;\n"
+                "    jmp_buf jmp;\n"
+                "    (void)a;\n"
+                "    enter(m, &o, &jmp);\n"
+                "    if (!setjmp(jmp)) ", i);
+        if (t->result) out(&o, "r.%s = ", FIELDS[type_index(t->result)]);
+        out(&o, "f%u(", i);
+        for (size_t j = 0; j < n; j++) out(&o, "%sa[%zu].%s", j ? ", " : "", j, FIELDS[type_index(t->params[j])]);
+        out(&o, ");\n    leave(&o);\n    return r;\n}\n\n");
+    }
+
+    out(&o, "static StackValue (*const entries[%u])(Module* m, StackValue* a) = {\n", g.func_count);
+    for (uint32_t i = 0; i < g.func_count; i++) {
+        if (i < g.import_count) out(&o, "    NULL,\n");
+        else out(&o, "    e%u,\n", i);
+    }
+    out(&o, "};\n\n");
+    out(&o, "EXPORT WaNative wa_native_module = { UINT64_C(0x%016llx), %u, entries, NULL, NULL };\n",
+        (unsigned long long)wa_hash(bytes, (uint32_t)size), g.func_count);
+
+    FILE* f = fopen(argv[2], "wb");
+    if (!f || fwrite(o.p, 1, o.len, f) != o.len) {
+        fprintf(stderr, "Failed to write %s\n", argv[2]);
+        if (f) fclose(f);
+        return 1;
+    }
+    fclose(f);
+    printf("Translated %s -> %s (%u functions, %u imports)\n", argv[1], argv[2], g.func_count - g.import_count, g.import_count);
+    return 0;
+}